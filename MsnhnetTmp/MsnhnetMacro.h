@@ -0,0 +1,6 @@
+#ifndef MSNHNETMACRO_H
+#define MSNHNETMACRO_H
+#define USE_OMP
+#define USE_X86
+#define USE_SHARED_MSNHNET
+#endif
\ No newline at end of file
@@ -0,0 +1,1522 @@
+﻿#include <iostream>
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <set>
+#include <tuple>
+#include <new>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "Msnhnet/net/MsnhNetBuilder.h"
+#include "Msnhnet/net/MsnhBatchServer.h"
+#include "Msnhnet/net/MsnhPipelineExecutor.h"
+#include "Msnhnet/core/MsnhGemm.h"
+#include "Msnhnet/core/MsnhNCHWc.h"
+#include "Msnhnet/core/MsnhWinograd.h"
+#include "Msnhnet/core/MsnhDepthwiseConv.h"
+#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/config/MsnhnetCfg.h"
+
+/* every heap allocation of the process is counted, inference should not add any once warmed up.
+ * the pool, batch server and pipeline threads allocate too */
+static std::atomic<size_t> allocCount(0);
+
+void* operator new(size_t size)
+{
+    allocCount++;
+    void *ptr = malloc(size);
+    if(ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+typedef std::tuple<int,int,int> GemmShape;
+/* channel, height, width, num, kernel, stride, padding */
+typedef std::tuple<int,int,int,int,int,int,int> ConvShape;
+
+void collectConvLayers(const std::vector<Msnhnet::BaseLayer*> &layers, std::vector<Msnhnet::ConvolutionalLayer*> &convs);
+
+void collectConvLayers(Msnhnet::BaseLayer *const &layer, std::vector<Msnhnet::ConvolutionalLayer*> &convs)
+{
+    if(layer->type == LayerType::CONVOLUTIONAL)
+    {
+        convs.push_back(reinterpret_cast<Msnhnet::ConvolutionalLayer*>(layer));
+    }
+    else if(layer->type == LayerType::RES_BLOCK)
+    {
+        collectConvLayers(reinterpret_cast<Msnhnet::ResBlockLayer*>(layer)->baseLayers, convs);
+    }
+    else if(layer->type == LayerType::RES_2_BLOCK)
+    {
+        collectConvLayers(reinterpret_cast<Msnhnet::Res2BlockLayer*>(layer)->baseLayers, convs);
+        collectConvLayers(reinterpret_cast<Msnhnet::Res2BlockLayer*>(layer)->branchLayers, convs);
+    }
+    else if(layer->type == LayerType::ADD_BLOCK)
+    {
+        for(auto &branch : reinterpret_cast<Msnhnet::AddBlockLayer*>(layer)->branchLayers)
+        {
+            collectConvLayers(branch, convs);
+        }
+    }
+    else if(layer->type == LayerType::CONCAT_BLOCK)
+    {
+        for(auto &branch : reinterpret_cast<Msnhnet::ConcatBlockLayer*>(layer)->branchLayers)
+        {
+            collectConvLayers(branch, convs);
+        }
+    }
+}
+
+void collectConvLayers(const std::vector<Msnhnet::BaseLayer*> &layers, std::vector<Msnhnet::ConvolutionalLayer*> &convs)
+{
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        collectConvLayers(layers[i], convs);
+    }
+}
+
+/* stands in for the camera side of a video loop: nearest resize of an 8 bit hwc frame to the chw float input */
+std::vector<float> preprocessFrame(const std::vector<uint8_t> &frame, const int &frameH, const int &frameW, const int &c, const int &h, const int &w)
+{
+    std::vector<float> img(static_cast<size_t>(c) * h * w);
+    for (int k = 0; k < c; ++k)
+    {
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                const size_t src = (static_cast<size_t>(y * frameH / h) * frameW + x * frameW / w) * 3 + k % 3;
+                img[(static_cast<size_t>(k) * h + y) * w + x] = frame[src] / 255.f;
+            }
+        }
+    }
+    return img;
+}
+
+/* and the drawing: one pass over the frame */
+void postprocessFrame(std::vector<uint8_t> &frame)
+{
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+        frame[i] = static_cast<uint8_t>(255 - frame[i]);
+    }
+}
+
+/* max abs difference between a batch context's outputs and single runs of the same images, -1 when the yolo box
+ * lists differ in size */
+double compareBatch(Msnhnet::NetBuilder &single, Msnhnet::ExecutionContext *const &batched, const std::vector<float> &imgs, const int &batch,
+                    const bool &yolo)
+{
+    const size_t inNum = imgs.size() / batch;
+    double maxDiff = 0;
+
+    if(yolo)
+    {
+        std::vector<std::vector<Msnhnet::Yolov3Box>> boxes = batched->runYolov3(imgs);
+        for (int b = 0; b < batch; ++b)
+        {
+            std::vector<std::vector<Msnhnet::Yolov3Box>> one = single.runYolov3(std::vector<float>(imgs.begin() + b*inNum, imgs.begin() + (b + 1)*inNum));
+            if(boxes.size() != static_cast<size_t>(batch) || one.size() != 1 || boxes[b].size() != one[0].size())
+            {
+                return -1;
+            }
+
+            for (size_t j = 0; j < one[0].size(); ++j)
+            {
+                const Msnhnet::Yolov3Box &x = boxes[b][j];
+                const Msnhnet::Yolov3Box &y = one[0][j];
+                const double diffs[5] = {x.xywhBox.x - y.xywhBox.x, x.xywhBox.y - y.xywhBox.y, x.xywhBox.w - y.xywhBox.w,
+                                         x.xywhBox.h - y.xywhBox.h, x.conf - y.conf};
+                for (int d = 0; d < 5; ++d)
+                {
+                    maxDiff = std::max(maxDiff, std::fabs(diffs[d]));
+                }
+            }
+        }
+    }
+    else
+    {
+        std::vector<float> preds = batched->runClassify(imgs);
+        const size_t outNum = preds.size() / batch;
+        for (int b = 0; b < batch; ++b)
+        {
+            std::vector<float> one = single.runClassify(std::vector<float>(imgs.begin() + b*inNum, imgs.begin() + (b + 1)*inNum));
+            if(one.size() != outNum)
+            {
+                return -1;
+            }
+
+            for (size_t j = 0; j < outNum; ++j)
+            {
+                maxDiff = std::max(maxDiff, static_cast<double>(std::fabs(preds[b*outNum + j] - one[j])));
+            }
+        }
+    }
+    return maxDiff;
+}
+
+/* a model of the list as the sections of main run it: the builder, whether the net ends in a yolo out, an image of
+ * 0.5 and a forward of an image on the builder or on one of its contexts */
+struct BenchModel
+{
+
+    std::string         path;
+    std::string         binPath;
+    Msnhnet::NetBuilder builder;
+    bool                yolo = false;
+    std::vector<float>  img;
+    std::function<void(std::vector<float>)> infer;
+    std::function<void(Msnhnet::ExecutionContext *const &, std::vector<float>)> inferContext;
+};
+
+/* builds root/model.msnhnet, after setup when one is given, and loads its .msnhbin when weights is set. nullptr when
+ * one of them is missing, before any builder is made */
+std::unique_ptr<BenchModel> loadModel(const std::string &root, const std::string &model, const bool &weights = true,
+                                      const std::function<void(Msnhnet::NetBuilder &)> &setup = nullptr)
+{
+    const std::string path    = root + "/" + model + ".msnhnet";
+    const std::string binPath = root + "/" + model + ".msnhbin";
+    if(!std::ifstream(path).good() || (weights && !std::ifstream(binPath).good()))
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<BenchModel> bench(new BenchModel());
+    bench->path    = path;
+    bench->binPath = binPath;
+    if(setup)
+    {
+        setup(bench->builder);
+    }
+
+    bench->builder.buildNetFromMsnhNet(path);
+    if(weights)
+    {
+        bench->builder.loadWeightsFromMsnhBin(binPath);
+    }
+
+    bench->yolo = bench->builder.net->layers.back()->type == LayerType::YOLOV3_OUT;
+    bench->img.assign(static_cast<size_t>(bench->builder.net->layers[0]->inputNum), 0.5f);
+
+    /* the sections only time the forward, its result is dropped */
+    BenchModel *const self = bench.get();
+    bench->infer = [self](std::vector<float> in)
+    {
+        if(self->yolo)
+        {
+            self->builder.runYolov3(std::move(in));
+        }
+        else
+        {
+            self->builder.runClassify(std::move(in));
+        }
+    };
+    bench->inferContext = [self](Msnhnet::ExecutionContext *const &context, std::vector<float> in)
+    {
+        if(self->yolo)
+        {
+            context->runYolov3(std::move(in));
+        }
+        else
+        {
+            context->runClassify(std::move(in));
+        }
+    };
+    return bench;
+}
+
+template<typename Func>
+double bestOf(const int &rounds, Func func)
+{
+    double best = 1e30;
+    for (int i = 0; i < rounds; ++i)
+    {
+        auto st = std::chrono::system_clock::now();
+        func();
+        auto so = std::chrono::system_clock::now();
+        double t = 1.0 * (std::chrono::duration_cast<std::chrono::microseconds>(so - st)).count() / 1000000.0;
+        best = (t < best) ? t : best;
+    }
+    return best;
+}
+
+/* the kernel benchmarks below share their inputs, their round count and their reference: a gemm on A packed once */
+void fillRandom(std::vector<float> &v, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    for (auto &x : v) x = dist(rng);
+}
+
+int benchRounds(const int &m, const int &n, const int &k)
+{
+    return (2.0 * m * n * k < 1e9) ? 5 : 2;
+}
+
+class PackedA
+{
+public:
+    PackedA(std::vector<float> &a, const int &m, const int &k)
+    {
+        data = static_cast<float*>(Msnhnet::Gemm::alignedMalloc(Msnhnet::Gemm::getPackedASize(m, k) * sizeof(float)));
+        Msnhnet::Gemm::cpuGemmPackA(m, k, 1.f, a.data(), k, data);
+    }
+
+    ~PackedA()
+    {
+        Msnhnet::Gemm::alignedFree(data);
+    }
+
+    PackedA(const PackedA &) = delete;
+    PackedA &operator=(const PackedA &) = delete;
+
+    float *data = nullptr;
+};
+
+/* C = A * B, the empty epilogue makes the first k block overwrite C */
+void referenceGemm(const PackedA &a, const int &m, const int &n, const int &k, float *const &b, std::vector<float> &c)
+{
+    Msnhnet::GemmEpilogue epi;
+    Msnhnet::Gemm::cpuGemmPrePacked(m, n, k, a.data, b, n, c.data(), n, &epi);
+}
+
+/* max |ref - out| over max |ref| */
+float relError(const std::vector<float> &ref, const std::vector<float> &out)
+{
+    float maxDiff = 0.f;
+    float maxRef  = 0.f;
+    for (size_t i = 0; i < ref.size(); ++i)
+    {
+        maxDiff = std::max(maxDiff, std::abs(ref[i] - out[i]));
+        maxRef  = std::max(maxRef, std::abs(ref[i]));
+    }
+    return (maxRef > 0) ? maxDiff / maxRef : maxDiff;
+}
+
+bool checkError(const float &err, const float &tolerance)
+{
+    return err <= tolerance;
+}
+
+/* a conv shape as the gemm it becomes */
+struct ConvDims
+{
+    explicit ConvDims(const ConvShape &shape)
+        : channel(std::get<0>(shape)), height(std::get<1>(shape)), width(std::get<2>(shape)), num(std::get<3>(shape)),
+          kSize(std::get<4>(shape)), stride(std::get<5>(shape)), padding(std::get<6>(shape)),
+          outH((height + 2 * padding - kSize) / stride + 1), outW((width + 2 * padding - kSize) / stride + 1),
+          m(num), n(outH * outW), k(channel * kSize * kSize)
+    {
+    }
+
+    const int channel, height, width, num, kSize, stride, padding;
+    const int outH, outW;
+    const int m, n, k;
+};
+
+/* im2col + the reference gemm, 1x1 stride 1 convs use the input as B */
+void referenceConv(const ConvDims &d, const PackedA &a, std::vector<float> &input, std::vector<float> &workspace, std::vector<float> &c)
+{
+    float *b = input.data();
+    if(!(d.kSize == 1 && d.stride == 1 && d.padding == 0))
+    {
+        Msnhnet::Gemm::cpuIm2colEx(input.data(), d.channel, d.height, d.width, d.kSize, d.kSize, d.padding, d.padding, d.stride, d.stride,
+                                   1, 1, workspace.data());
+        b = workspace.data();
+    }
+    referenceGemm(a, d.m, d.n, d.k, b, c);
+}
+
+/* each kernel benchmark returns false when its output is off the reference by more than its tolerance */
+bool benchGemm(const GemmShape &shape)
+{
+    const int m = std::get<0>(shape);
+    const int n = std::get<1>(shape);
+    const int k = std::get<2>(shape);
+
+    std::mt19937 rng(2020);
+    std::vector<float> a(static_cast<size_t>(m) * k);
+    std::vector<float> b(static_cast<size_t>(k) * n);
+    std::vector<float> cRef(static_cast<size_t>(m) * n);
+    std::vector<float> cNew(static_cast<size_t>(m) * n);
+    fillRandom(a, rng);
+    fillRandom(b, rng);
+
+    const int rounds = benchRounds(m, n, k);
+
+    double tRef = bestOf(rounds, [&]()
+    {
+        std::fill(cRef.begin(), cRef.end(), 0.f);
+        Msnhnet::Gemm::cpuGemmNNFast(m, n, k, 1.f, a.data(), k, b.data(), n, cRef.data(), n);
+    });
+
+    double tNew = bestOf(rounds, [&]()
+    {
+        std::fill(cNew.begin(), cNew.end(), 0.f);
+        Msnhnet::Gemm::cpuGemmPacked(m, n, k, 1.f, a.data(), k, b.data(), n, cNew.data(), n);
+    });
+
+    const float err = relError(cRef, cNew);
+    const bool ok   = checkError(err, 1e-4f);
+
+    double gflop = 2.0 * m * n * k / 1e9;
+    printf("%6d %8d %6d | NNFast %8.3f ms %7.2f GFLOPS | Packed %8.3f ms %7.2f GFLOPS | x%5.2f | err %.1e %s\n",
+           m, n, k, tRef * 1000, gflop / tRef, tNew * 1000, gflop / tNew, tRef / tNew, static_cast<double>(err), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+bool benchInt8Gemm(const GemmShape &shape)
+{
+    const int m = std::get<0>(shape);
+    const int n = std::get<1>(shape);
+    const int k = std::get<2>(shape);
+
+    std::mt19937 rng(2020);
+    std::vector<float> a(static_cast<size_t>(m) * k);
+    std::vector<float> b(static_cast<size_t>(k) * n);
+    std::vector<float> cRef(static_cast<size_t>(m) * n);
+    std::vector<float> cNew(static_cast<size_t>(m) * n);
+    fillRandom(a, rng);
+    fillRandom(b, rng);
+
+    std::vector<int8_t>  q(static_cast<size_t>(m) * k);
+    std::vector<float>   scales(static_cast<size_t>(m));
+    std::vector<int32_t> sums(static_cast<size_t>(m));
+
+    PackedA packedA(a, m, k);
+    int8_t *int8A   = static_cast<int8_t *>(Msnhnet::Gemm::alignedMalloc(Msnhnet::Quant::getPackedASize(m, k)));
+    Msnhnet::Quant::quantizeWeights(a.data(), m, k, q.data(), scales.data());
+    Msnhnet::Quant::packA(q.data(), m, k, int8A, sums.data());
+
+    Msnhnet::GemmEpilogue epi;
+    const float inScale = 1.f / 63.f;
+    const int rounds    = benchRounds(m, n, k);
+
+    double tRef = bestOf(rounds, [&]()
+    {
+        referenceGemm(packedA, m, n, k, b.data(), cRef);
+    });
+
+    /* every int8 table this cpu can run, each one checked against the fp32 reference */
+    const Msnhnet::KernelIsa best   = Msnhnet::Kernels::get().isa;
+    const Msnhnet::KernelIsa isas[] = {Msnhnet::ISA_AVX2, Msnhnet::ISA_AVX512, Msnhnet::ISA_AVX512_VNNI};
+    const double gop    = 2.0 * m * n * k / 1e9;
+    bool ok             = true;
+
+    printf("%6d %8d %6d | fp32 %8.3f ms", m, n, k, tRef * 1000);
+    for (size_t s = 0; s < 3; ++s)
+    {
+        if(!Msnhnet::Kernels::select(isas[s]) || Msnhnet::Kernels::get().quantGemm4x16 == nullptr)
+        {
+            continue;
+        }
+
+        const double t = bestOf(rounds, [&]()
+        {
+            Msnhnet::Quant::gemm(m, n, k, int8A, scales.data(), sums.data(), b.data(), n, inScale, 64, cNew.data(), n, epi);
+        });
+
+        const float err = relError(cRef, cNew);
+        ok              = checkError(err, 5e-2f) && ok;
+        printf(" | %s %8.3f ms %7.2f GOPS x%5.2f err %.1e", Msnhnet::Kernels::get().name, t * 1000, gop / t, tRef / t, static_cast<double>(err));
+    }
+    Msnhnet::Kernels::select(best);
+
+    Msnhnet::Gemm::alignedFree(int8A);
+
+    printf(" | %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+bool benchHalfGemm(const GemmShape &shape)
+{
+    const int m = std::get<0>(shape);
+    const int n = std::get<1>(shape);
+    const int k = std::get<2>(shape);
+
+    std::mt19937 rng(2020);
+    std::vector<float> a(static_cast<size_t>(m) * k);
+    std::vector<float> b(static_cast<size_t>(k) * n);
+    std::vector<float> cRef(static_cast<size_t>(m) * n);
+    std::vector<float> cNew(static_cast<size_t>(m) * n);
+    fillRandom(a, rng);
+    fillRandom(b, rng);
+
+    const size_t halfSize = Msnhnet::Gemm::getPackedASize(m, k) + GEMM_HALF_PAD;
+
+    PackedA packedA(a, m, k);
+    uint16_t *f16A      = static_cast<uint16_t *>(Msnhnet::Gemm::alignedMalloc(halfSize * sizeof(uint16_t)));
+    uint16_t *bf16A     = static_cast<uint16_t *>(Msnhnet::Gemm::alignedMalloc(halfSize * sizeof(uint16_t)));
+    Msnhnet::Gemm::cpuGemmPackAHalf(m, k, a.data(), k, f16A, WEIGHT_F16);
+    Msnhnet::Gemm::cpuGemmPackAHalf(m, k, a.data(), k, bf16A, WEIGHT_BF16);
+
+    Msnhnet::GemmEpilogue epi;
+    const int rounds    = benchRounds(m, n, k);
+
+    double tRef = bestOf(rounds, [&]()
+    {
+        referenceGemm(packedA, m, n, k, b.data(), cRef);
+    });
+
+    /* fp16 keeps 11 bits of mantissa, bf16 8 */
+    const double tF16   = bestOf(rounds, [&]()
+    {
+        Msnhnet::Gemm::cpuGemmPrePackedHalf(m, n, k, f16A, WEIGHT_F16, b.data(), n, cNew.data(), n, &epi);
+    });
+
+    const float errF16  = relError(cRef, cNew);
+    const bool okF16    = checkError(errF16, 5e-3f);
+
+    double tBf16 = bestOf(rounds, [&]()
+    {
+        Msnhnet::Gemm::cpuGemmPrePackedHalf(m, n, k, bf16A, WEIGHT_BF16, b.data(), n, cNew.data(), n, &epi);
+    });
+
+    const float errBf16 = relError(cRef, cNew);
+    const bool okBf16   = checkError(errBf16, 2e-2f);
+
+    Msnhnet::Gemm::alignedFree(f16A);
+    Msnhnet::Gemm::alignedFree(bf16A);
+
+    printf("%6d %8d %6d | fp32 %8.3f ms", m, n, k, tRef * 1000);
+    printf(" | fp16 %8.3f ms x%5.2f err %.1e", tF16 * 1000, tRef / tF16, static_cast<double>(errF16));
+    printf(" | bf16 %8.3f ms x%5.2f err %.1e %s\n", tBf16 * 1000, tRef / tBf16, static_cast<double>(errBf16), (okF16 && okBf16) ? "ok" : "FAIL");
+    return okF16 && okBf16;
+}
+
+bool benchImplicitGemm(const ConvShape &shape)
+{
+    const ConvDims d(shape);
+
+    std::mt19937 rng(2020);
+    std::vector<float> a(static_cast<size_t>(d.m) * d.k);
+    std::vector<float> input(static_cast<size_t>(d.channel) * d.height * d.width);
+    std::vector<float> workspace(static_cast<size_t>(d.k) * d.n);
+    std::vector<float> cRef(static_cast<size_t>(d.m) * d.n);
+    std::vector<float> cNew(static_cast<size_t>(d.m) * d.n);
+    fillRandom(a, rng);
+    fillRandom(input, rng);
+
+    PackedA packedA(a, d.m, d.k);
+    const int rounds = benchRounds(d.m, d.n, d.k);
+
+    double tRef = bestOf(rounds, [&]()
+    {
+        referenceConv(d, packedA, input, workspace, cRef);
+    });
+
+    double tNew = bestOf(rounds, [&]()
+    {
+        std::fill(cNew.begin(), cNew.end(), 0.f);
+        Msnhnet::Gemm::cpuImplicitGemmConv(d.m, packedA.data, input.data(), d.channel, d.height, d.width, d.kSize, d.kSize, d.padding, d.padding,
+                                           d.stride, d.stride, 1, 1, cNew.data());
+    });
+
+    const float err = relError(cRef, cNew);
+    const bool ok   = checkError(err, 1e-4f);
+
+    printf("%5d %4dx%-4d %5d %dx%d/%d | im2col %8.3f ms | implicit %8.3f ms | x%5.2f | workspace saved %7.2f MB | err %.1e %s\n",
+           d.channel, d.height, d.width, d.num, d.kSize, d.kSize, d.stride, tRef * 1000, tNew * 1000, tRef / tNew,
+           workspace.size() * sizeof(float) / 1048576.0, static_cast<double>(err), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+/* F(2x2) and F(4x4) both run against the im2col gemm, the shape fails when either is off */
+bool benchWinograd(const ConvShape &shape)
+{
+    const ConvDims d(shape);
+
+    std::mt19937 rng(2020);
+    std::vector<float> a(static_cast<size_t>(d.m) * d.k);
+    std::vector<float> input(static_cast<size_t>(d.channel) * d.height * d.width);
+    std::vector<float> workspace(static_cast<size_t>(d.k) * d.n);
+    std::vector<float> cRef(static_cast<size_t>(d.m) * d.n);
+    std::vector<float> cNew(static_cast<size_t>(d.m) * d.n);
+    fillRandom(a, rng);
+    fillRandom(input, rng);
+
+    PackedA packedA(a, d.m, d.k);
+    const int rounds = benchRounds(d.m, d.n, d.k);
+
+    double tRef = bestOf(rounds, [&]()
+    {
+        referenceConv(d, packedA, input, workspace, cRef);
+    });
+
+    printf("%5d %4dx%-4d %5d %dx%d/%d | im2col %8.3f ms", d.channel, d.height, d.width, d.num, d.kSize, d.kSize, d.stride, tRef * 1000);
+
+    bool ok = true;
+    const int tiles[] = {2, 4};
+    for (const int &tile : tiles)
+    {
+        float *transW = static_cast<float*>(Msnhnet::Gemm::alignedMalloc(Msnhnet::Winograd::getTransformedWeightsSize(tile, d.m, d.channel) * sizeof(float)));
+        std::vector<float> wgWorkspace(Msnhnet::Winograd::getWorkSpaceSize(tile, d.channel, d.m, d.outH, d.outW));
+        Msnhnet::Winograd::transformWeights3x3(tile, a.data(), d.m, d.channel, transW);
+
+        double tNew = bestOf(rounds, [&]()
+        {
+            Msnhnet::Winograd::conv3x3s1(tile, input.data(), d.channel, d.height, d.width, d.padding, d.padding, transW, d.m, d.outH, d.outW,
+                                         wgWorkspace.data(), cNew.data());
+        });
+        Msnhnet::Gemm::alignedFree(transW);
+
+        const float err = relError(cRef, cNew);
+        ok = checkError(err, 1e-4f) && ok;
+
+        printf(" | F(%dx%d) %8.3f ms x%5.2f err %.1e", tile, tile, tNew * 1000, tRef / tNew, static_cast<double>(err));
+    }
+
+    printf(" %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+/* channel == num, the reference is the grouped path of the conv layer: one 1 x 9 gemm per channel with bias and leaky in its epilogue */
+bool benchDepthwise(const ConvShape &shape)
+{
+    const ConvDims d(shape);
+    const ConvDims g(ConvShape(1, d.height, d.width, 1, d.kSize, d.stride, d.padding));
+
+    std::mt19937 rng(2020);
+    std::vector<float> a(static_cast<size_t>(d.channel) * g.k);
+    std::vector<float> bias(d.channel);
+    std::vector<float> input(static_cast<size_t>(d.channel) * d.height * d.width);
+    std::vector<float> workspace(static_cast<size_t>(g.k) * g.n);
+    std::vector<float> cRef(static_cast<size_t>(d.channel) * g.n);
+    std::vector<float> cNew(static_cast<size_t>(d.channel) * g.n);
+    fillRandom(a, rng);
+    fillRandom(bias, rng);
+    fillRandom(input, rng);
+
+    const size_t groupSize = Msnhnet::Gemm::getPackedASize(g.m, g.k);
+    float *packedA = static_cast<float*>(Msnhnet::Gemm::alignedMalloc(groupSize * d.channel * sizeof(float)));
+    for (int c = 0; c < d.channel; ++c)
+    {
+        Msnhnet::Gemm::cpuGemmPackA(g.m, g.k, 1.f, a.data() + static_cast<size_t>(c) * g.k, g.k, packedA + groupSize * c);
+    }
+
+    Msnhnet::GemmEpilogue epi;
+    epi.activation  = ActivationType::LEAKY;
+    epi.actParam    = 0.1f;
+    const int rounds = benchRounds(d.channel, g.n, g.k);
+
+    double tRef = bestOf(rounds, [&]()
+    {
+        for (int c = 0; c < d.channel; ++c)
+        {
+            Msnhnet::Gemm::cpuIm2colEx(input.data() + static_cast<size_t>(c) * d.height * d.width, 1, d.height, d.width, d.kSize, d.kSize,
+                                       d.padding, d.padding, d.stride, d.stride, 1, 1, workspace.data());
+            epi.bias = bias.data() + c;
+            Msnhnet::Gemm::cpuGemmPrePacked(g.m, g.n, g.k, packedA + groupSize * c, workspace.data(), g.n, cRef.data() + static_cast<size_t>(c) * g.n,
+                                            g.n, &epi);
+        }
+    });
+
+    double tNew = bestOf(rounds, [&]()
+    {
+        Msnhnet::DepthwiseConv::conv3x3(d.stride, input.data(), 1, d.channel, d.height, d.width, d.padding, d.padding, a.data(), bias.data(),
+                                        d.outH, d.outW, ActivationType::LEAKY, 0.1f, cNew.data());
+    });
+
+    Msnhnet::Gemm::alignedFree(packedA);
+
+    const float err = relError(cRef, cNew);
+    const bool ok   = checkError(err, 1e-4f);
+
+    printf("%5d %4dx%-4d %5d %dx%d/%d | grouped gemm %8.3f ms | depthwise %8.3f ms | x%5.2f | err %.1e %s\n",
+           d.channel, d.height, d.width, d.num, d.kSize, d.kSize, d.stride, tRef * 1000, tNew * 1000, tRef / tNew,
+           static_cast<double>(err), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+bool benchXnorConv(const ConvShape &shape)
+{
+    const ConvDims d(shape);
+    const int m = d.m;
+    const int k = d.k;
+
+    std::mt19937 rng(2020);
+    std::vector<float> a(static_cast<size_t>(m) * k);
+    std::vector<float> binA(static_cast<size_t>(m) * k);
+    std::vector<float> input(static_cast<size_t>(d.channel) * d.height * d.width);
+    std::vector<float> workspace(static_cast<size_t>(k) * d.n);
+    std::vector<float> cRef(static_cast<size_t>(m) * d.n);
+    std::vector<float> cNew(static_cast<size_t>(m) * d.n);
+    std::vector<float> meanArr(m);
+    std::vector<int>   tapSums(static_cast<size_t>(m) * d.kSize * d.kSize);
+    fillRandom(a, rng);
+    fillRandom(input, rng);
+    for (auto &v : input) v = (v > 0) ? 1.f : -1.f;
+
+    /* float xnor reference: sign(w) * mean|w| against the binarized input */
+    for (int i = 0; i < m; ++i)
+    {
+        float mean = 0.f;
+        for (int j = 0; j < k; ++j)
+        {
+            mean += std::abs(a[i * k + j]);
+        }
+        mean = mean / k;
+        for (int j = 0; j < k; ++j)
+        {
+            binA[i * k + j] = (a[i * k + j] > 0) ? mean : -mean;
+        }
+    }
+
+    const int ld    = Msnhnet::Gemm::getXnorLd(d.channel, d.kSize, d.kSize);
+    std::vector<uint32_t> bitA(static_cast<size_t>(m) * ld);
+    std::vector<uint32_t> bitWorkspace(Msnhnet::Gemm::getXnorWorkSpaceSize(d.channel, d.height, d.width, d.kSize, d.kSize, d.outH, d.outW));
+    Msnhnet::Gemm::cpuXnorPackWeights(a.data(), m, d.channel, d.kSize, d.kSize, bitA.data(), meanArr.data(), tapSums.data());
+
+    PackedA packedA(binA, m, k);
+    const int rounds = benchRounds(m, d.n, k);
+
+    double tRef = bestOf(rounds, [&]()
+    {
+        referenceConv(d, packedA, input, workspace, cRef);
+    });
+
+    double tNew = bestOf(rounds, [&]()
+    {
+        Msnhnet::Gemm::cpuXnorConv(input.data(), d.channel, d.height, d.width, d.kSize, d.kSize, d.padding, d.padding, d.stride, d.stride, 1, 1,
+                                   bitA.data(), m, meanArr.data(), tapSums.data(), bitWorkspace.data(), cNew.data());
+    });
+
+    const float err = relError(cRef, cNew);
+    const bool ok   = checkError(err, 1e-4f);
+
+    printf("%5d %4dx%-4d %5d %dx%d/%d | float %8.3f ms | xnor %8.3f ms | x%5.2f | weights %7.2f -> %6.2f MB | err %.1e %s\n",
+           d.channel, d.height, d.width, d.num, d.kSize, d.kSize, d.stride, tRef * 1000, tNew * 1000, tRef / tNew,
+           a.size() * sizeof(float) / 1048576.0, bitA.size() * sizeof(uint32_t) / 1048576.0, static_cast<double>(err), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+bool benchNCHWc(const ConvShape &shape)
+{
+    const ConvDims d(shape);
+
+    std::mt19937 rng(2020);
+    std::vector<float> a(static_cast<size_t>(d.m) * d.k);
+    std::vector<float> input(static_cast<size_t>(d.channel) * d.height * d.width);
+    std::vector<float> blocked(input.size());
+    std::vector<float> workspace(std::max(static_cast<size_t>(d.k) * d.n, Msnhnet::NCHWc::getWorkSpaceSize(d.channel, d.height, d.width, d.padding)));
+    std::vector<float> cRef(static_cast<size_t>(d.m) * d.n);
+    std::vector<float> cNew(static_cast<size_t>(d.m) * d.n);
+    std::vector<float> cPlain(static_cast<size_t>(d.m) * d.n);
+    fillRandom(a, rng);
+    fillRandom(input, rng);
+
+    PackedA packedA(a, d.m, d.k);
+    float *packedW = static_cast<float*>(Msnhnet::Gemm::alignedMalloc(Msnhnet::NCHWc::getPackedWeightsSize(d.m, d.channel, d.kSize) * sizeof(float)));
+    Msnhnet::NCHWc::packWeights(a.data(), d.m, d.channel, d.kSize, packedW);
+
+    const int rounds = benchRounds(d.m, d.n, d.k);
+
+    double tRef = bestOf(rounds, [&]()
+    {
+        referenceConv(d, packedA, input, workspace, cRef);
+    });
+
+    Msnhnet::NCHWc::toBlocked(input.data(), 1, d.channel, d.height, d.width, blocked.data());
+
+    double tNew = bestOf(rounds, [&]()
+    {
+        Msnhnet::NCHWc::conv(blocked.data(), 1, d.channel, d.height, d.width, d.kSize, d.stride, d.padding, 1, packedW, nullptr, d.m, d.outH, d.outW,
+                    workspace.data(), cNew.data());
+    });
+
+    double tReorder = bestOf(rounds, [&]()
+    {
+        Msnhnet::NCHWc::toBlocked(input.data(), 1, d.channel, d.height, d.width, blocked.data());
+    });
+
+    Msnhnet::NCHWc::toPlain(cNew.data(), 1, d.m, d.outH, d.outW, cPlain.data());
+    Msnhnet::Gemm::alignedFree(packedW);
+
+    const float err = relError(cRef, cPlain);
+    const bool ok   = checkError(err, 1e-4f);
+
+    /* the layout NetBuilder::planLayout gives this conv */
+    const bool picked  = Msnhnet::NCHWc::isFaster(d.num, d.kSize, d.stride, d.outH, d.outW);
+
+    printf("%5d %4dx%-4d %5d %dx%d/%d | nchw %8.3f ms | nchwc %8.3f ms | x%5.2f | reorder %6.3f ms | picks %-5s | err %.1e %s\n",
+           d.channel, d.height, d.width, d.num, d.kSize, d.kSize, d.stride, tRef * 1000, tNew * 1000, tRef / tNew, tReorder * 1000,
+           picked ? "nchwc" : "nchw", static_cast<double>(err), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 2)
+    {
+        std::cout<<"\nYou need to give models dir path.\neg: benchmark /your/models/dir/path/ \n\nOnly *.msnhnet files are needed, conv shapes are read in preview mode.";
+        getchar();
+        return 0;
+    }
+
+    std::string root = argv[1];
+    /* correctness checks below count here, any of them makes the run fail */
+    int failures = 0;
+    std::vector<std::string> models = {"yolov3/yolov3", "yolov3_tiny/yolov3_tiny", "yolov4/yolov4", "darknet53/darknet53",
+                                       "Resnet18/resnet18", "Resnet50/resnet50", "mobilenetv2/mobilenetv2", "googLenet/googLenet",
+                                       "alexnet/alexnet", "vgg16/vgg16"};
+    try
+    {
+        Msnhnet::NetBuilder  msnhNet;
+        msnhNet.setPreviewMode(true);
+
+        // ================================= gemm ======================================
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::string path = root + "/" + models[i] + ".msnhnet";
+            if(!std::ifstream(path).good())
+            {
+                continue;
+            }
+
+            msnhNet.buildNetFromMsnhNet(path);
+
+            std::vector<Msnhnet::ConvolutionalLayer*> convs;
+            collectConvLayers(msnhNet.net->layers, convs);
+
+            std::set<GemmShape> shapes;
+            std::set<ConvShape> convShapes;
+            std::set<ConvShape> nchwcShapes;
+            std::set<ConvShape> depthwiseShapes;
+            for (auto &conv : convs)
+            {
+                shapes.insert(GemmShape(conv->num / conv->groups, conv->outHeight * conv->outWidth,
+                                        conv->kSizeX * conv->kSizeY * conv->channel / conv->groups));
+
+                if(conv->groups == 1 && conv->kSizeX == conv->kSizeY && conv->strideX == conv->strideY && conv->paddingX == conv->paddingY &&
+                        conv->dilationX == 1 && conv->dilationY == 1 && !(conv->kSizeX == 1 && conv->strideX == 1 && conv->paddingX == 0))
+                {
+                    convShapes.insert(ConvShape(conv->channel, conv->height, conv->width, conv->num, conv->kSizeX, conv->strideX, conv->paddingX));
+                }
+
+                if(conv->groups == 1 && conv->kSizeX == conv->kSizeY && conv->strideX == conv->strideY && conv->paddingX == conv->paddingY &&
+                        conv->dilationX == 1 && conv->dilationY == 1 && conv->channel % NCHWC_PACK == 0 && conv->num % NCHWC_PACK == 0 &&
+                        conv->outHeight * conv->outWidth <= NCHWC_MAX_SPATIAL)
+                {
+                    nchwcShapes.insert(ConvShape(conv->channel, conv->height, conv->width, conv->num, conv->kSizeX, conv->strideX, conv->paddingX));
+                }
+
+                if(conv->groups == conv->num && conv->channel == conv->num && conv->kSizeX == 3 && conv->kSizeY == 3 && conv->strideX == conv->strideY &&
+                        (conv->strideX == 1 || conv->strideX == 2) && conv->paddingX == conv->paddingY && conv->dilationX == 1 && conv->dilationY == 1)
+                {
+                    depthwiseShapes.insert(ConvShape(conv->channel, conv->height, conv->width, conv->num, conv->kSizeX, conv->strideX, conv->paddingX));
+                }
+            }
+
+            std::cout<<"\n=============================== "<<models[i]<<" ==============================="<<std::endl;
+            std::cout<<"     M        N      K"<<std::endl;
+            for (auto &shape : shapes)
+            {
+                failures += benchGemm(shape) ? 0 : 1;
+            }
+
+            std::cout<<"\n------------------------------- int8 gemm -------------------------------------"<<std::endl;
+            std::cout<<"     M        N      K"<<std::endl;
+            for (auto &shape : shapes)
+            {
+                failures += benchInt8Gemm(shape) ? 0 : 1;
+            }
+
+            std::cout<<"\n------------------------------- fp16 / bf16 weight gemm -----------------------"<<std::endl;
+            std::cout<<"     M        N      K"<<std::endl;
+            for (auto &shape : shapes)
+            {
+                failures += benchHalfGemm(shape) ? 0 : 1;
+            }
+
+            std::cout<<"\n------------------------------- implicit gemm ---------------------------------"<<std::endl;
+            std::cout<<"    C   HxW       OC  k/s"<<std::endl;
+            for (auto &shape : convShapes)
+            {
+                failures += benchImplicitGemm(shape) ? 0 : 1;
+            }
+
+            /* the transforms are avx2 only, layers without avx2 + fma never pick winograd */
+            if(Msnhnet::BaseLayer::supportAvx && Msnhnet::BaseLayer::supportFma)
+            {
+                std::cout<<"\n------------------------------- winograd 3x3/1 --------------------------------"<<std::endl;
+                std::cout<<"    C   HxW       OC  k/s"<<std::endl;
+                for (auto &shape : convShapes)
+                {
+                    if(std::get<4>(shape) == 3 && std::get<5>(shape) == 1)
+                    {
+                        failures += benchWinograd(shape) ? 0 : 1;
+                    }
+                }
+            }
+
+            if(!depthwiseShapes.empty())
+            {
+                std::cout<<"\n------------------------------- depthwise 3x3 + bias + leaky ------------------"<<std::endl;
+                std::cout<<"    C   HxW       OC  k/s"<<std::endl;
+                for (auto &shape : depthwiseShapes)
+                {
+                    failures += benchDepthwise(shape) ? 0 : 1;
+                }
+            }
+
+            std::cout<<"\n------------------------------- xnor conv -------------------------------------"<<std::endl;
+            std::cout<<"    C   HxW       OC  k/s"<<std::endl;
+            for (auto &shape : convShapes)
+            {
+                failures += benchXnorConv(shape) ? 0 : 1;
+            }
+
+            std::cout<<"\n------------------------------- nchw"<<NCHWC_PACK<<"c conv ----------------------------------"<<std::endl;
+            std::cout<<"    C   HxW       OC  k/s"<<std::endl;
+            for (auto &shape : nchwcShapes)
+            {
+                failures += benchNCHWc(shape) ? 0 : 1;
+            }
+        }
+
+        // ================================ weight loading ==============================
+        msnhNet.setPreviewMode(false);
+        std::cout<<"\n------------------------- weight loading (models with a .msnhbin) ---------------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            if(!std::ifstream(root + "/" + models[i] + ".msnhbin").good())
+            {
+                continue;
+            }
+
+            /* only the load is timed, so the nets are built without weights */
+            double times[2] = {-1, -1};
+            for (int mapped = 0; mapped < 2; ++mapped)
+            {
+                std::unique_ptr<BenchModel> bench = loadModel(root, models[i], false, [&](Msnhnet::NetBuilder &builder)
+                {
+                    builder.setUseMappedWeights(mapped == 1);
+                });
+                if(!bench)
+                {
+                    break;
+                }
+
+                times[mapped] = bestOf(1, [&]()
+                {
+                    bench->builder.loadWeightsFromMsnhBin(bench->binPath);
+                });
+            }
+
+            if(times[1] < 0)
+            {
+                continue;
+            }
+
+            printf("%-26s | copy %8.3f ms | mapped %8.3f ms | x%6.2f\n", models[i].c_str(), times[0] * 1000, times[1] * 1000, times[0] / times[1]);
+        }
+
+       // ============================ startup with a plan cache =======================
+        std::cout<<"\n------------------------- startup (msnhmodel, no plan vs cached plan) ------------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::string path        = root + "/" + models[i] + ".msnhnet";
+            std::string binPath     = root + "/" + models[i] + ".msnhbin";
+            std::string modelPath   = root + "/" + models[i] + ".bench.msnhmodel";
+            if(!std::ifstream(path).good() || !std::ifstream(binPath).good())
+            {
+                continue;
+            }
+
+           Msnhnet::NetBuilder::convertMsnhModel(path, binPath, modelPath);
+
+           /* the first build with a cache dir writes the plan, the second one loads it */
+            std::string planPath;
+            double times[2] = {0, 0};
+            for (int cached = 0; cached < 2; ++cached)
+            {
+                times[cached] = bestOf(1, [&]()
+                {
+                    Msnhnet::NetBuilder startNet;
+                    startNet.setPlanCacheDir(root);
+                    startNet.buildNetFromMsnhModel(modelPath);
+                    planPath = startNet.getPlanPath(startNet.getPlanKey(Msnhnet::ModelFile::readContentHash(modelPath)));
+                });
+            }
+
+           std::remove(planPath.c_str());
+            std::remove(modelPath.c_str());
+
+           printf("%-26s | no plan %8.3f ms | plan %8.3f ms | x%6.2f\n", models[i].c_str(), times[0] * 1000, times[1] * 1000, times[0] / times[1]);
+        }
+
+        // ============================ concurrent execution contexts ====================
+        const int contextNum = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+        std::cout<<"\n------------------------- concurrent contexts (1 net vs "<<contextNum<<" contexts, one thread each) ---"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i]);
+            if(!bench)
+            {
+                continue;
+            }
+
+           std::vector<Msnhnet::ExecutionContext*> contexts;
+            for (int c = 0; c < contextNum; ++c)
+            {
+                contexts.push_back(bench->builder.createContext());
+            }
+
+           /* the same number of images, run one after another on one context or spread over all of them */
+            const int images = contextNum * 2;
+            double single = bestOf(1, [&]()
+            {
+                for (int n = 0; n < images; ++n)
+                {
+                    bench->inferContext(contexts[0], bench->img);
+                }
+            });
+
+           double parallel = bestOf(1, [&]()
+            {
+                std::vector<std::thread> threads;
+                for (int c = 0; c < contextNum; ++c)
+                {
+                    threads.emplace_back([&, c]()
+                    {
+                        for (int n = 0; n < images / contextNum; ++n)
+                        {
+                            bench->inferContext(contexts[static_cast<size_t>(c)], bench->img);
+                        }
+                    });
+                }
+                for (auto &thread : threads)
+                {
+                    thread.join();
+                }
+            });
+
+           printf("%-26s | 1 context %8.2f img/s | %2d contexts %8.2f img/s | x%6.2f\n", models[i].c_str(), images / single,
+                   contextNum, images / parallel, single / parallel);
+        }
+
+       // ============================ batched forward =================================
+        const int foldBatch = 8;
+        std::cout<<"\n------------------------- batch "<<foldBatch<<" context vs "<<foldBatch<<" single runs (folded conv gemm) -------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i]);
+            if(!bench)
+            {
+                continue;
+            }
+
+           Msnhnet::ExecutionContext *batchContext = bench->builder.createContext(foldBatch);
+
+           std::vector<Msnhnet::ConvolutionalLayer*> convs;
+            collectConvLayers(batchContext->net->layers, convs);
+            int folded = 0;
+            for (size_t j = 0; j < convs.size(); ++j)
+            {
+                folded += convs[j]->foldBatch() ? 1 : 0;
+            }
+
+           /* every image of the batch differs, a mixed up slice shows in the comparison */
+            const size_t inNum = bench->img.size();
+            std::mt19937 rng(2020);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+            std::vector<float> imgs(inNum * foldBatch);
+            for (auto &v : imgs) v = dist(rng);
+
+           const double maxDiff = compareBatch(bench->builder, batchContext, imgs, foldBatch, bench->yolo);
+            const bool ok = maxDiff >= 0 && maxDiff < 1e-3;
+            failures += ok ? 0 : 1;
+
+           double single = bestOf(3, [&]()
+            {
+                for (int b = 0; b < foldBatch; ++b)
+                {
+                    bench->infer(std::vector<float>(imgs.begin() + b*inNum, imgs.begin() + (b + 1)*inNum));
+                }
+            });
+            double batched = bestOf(3, [&]()
+            {
+                bench->inferContext(batchContext, imgs);
+            });
+            bench->builder.releaseContext(batchContext);
+
+           printf("%-26s | %2d folded convs | single %8.2f img/s | batch %8.2f img/s | x%6.2f | max diff %g %s\n", models[i].c_str(), folded,
+                   foldBatch / single, foldBatch / batched, single / batched, maxDiff, ok ? "ok" : "FAIL");
+        }
+
+       /* prepacked weights without the fused epilogue: the folded packed gemm accumulates into its workspace.
+         * both flags are process wide, they go back to their defaults after the loop */
+        std::cout<<"\n------------------------- batch "<<foldBatch<<" vs single runs (prepacked, no epilogue fusion) ------"<<std::endl;
+        msnhNet.setPrePackWeights(true);
+        msnhNet.setUseEpilogueFusion(false);
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i]);
+            if(!bench)
+            {
+                continue;
+            }
+
+           Msnhnet::ExecutionContext *batchContext = bench->builder.createContext(foldBatch);
+
+           std::mt19937 rng(2020);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+            std::vector<float> imgs(bench->img.size() * foldBatch);
+            for (auto &v : imgs) v = dist(rng);
+
+           const double maxDiff = compareBatch(bench->builder, batchContext, imgs, foldBatch, bench->yolo);
+            const bool ok = maxDiff >= 0 && maxDiff < 1e-3;
+            failures += ok ? 0 : 1;
+            bench->builder.releaseContext(batchContext);
+
+           printf("%-26s | max diff %g %s\n", models[i].c_str(), maxDiff, ok ? "ok" : "FAIL");
+        }
+        msnhNet.setPrePackWeights(false);
+        msnhNet.setUseEpilogueFusion(true);
+
+       // ============================ dynamic batching ================================
+        const int clientNum = 8;
+        std::cout<<"\n------------------------- batch server ("<<clientNum<<" client threads, maxBatch 1 vs 8) -------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i]);
+            if(!bench)
+            {
+                continue;
+            }
+
+           double times[2]     = {0, 0};
+            float  meanBatch[2] = {0, 0};
+            const int maxBatches[2] = {1, 8};
+            for (int s = 0; s < 2; ++s)
+            {
+                Msnhnet::BatchServer server(&bench->builder, maxBatches[s]);
+                times[s] = bestOf(1, [&]()
+                {
+                    std::vector<std::thread> clients;
+                    for (int c = 0; c < clientNum; ++c)
+                    {
+                        clients.emplace_back([&]()
+                        {
+                            for (int n = 0; n < 2; ++n)
+                            {
+                                if(bench->yolo)
+                                {
+                                    server.submitYolov3(bench->img).get();
+                                }
+                                else
+                                {
+                                    server.submitClassify(bench->img).get();
+                                }
+                            }
+                        });
+                    }
+                    for (auto &client : clients)
+                    {
+                        client.join();
+                    }
+                });
+                meanBatch[s] = server.getMeanBatchSize();
+            }
+
+           printf("%-26s | maxBatch 1 %8.2f img/s | maxBatch 8 %8.2f img/s (mean batch %4.1f) | x%6.2f\n", models[i].c_str(),
+                   clientNum * 2 / times[0], clientNum * 2 / times[1], meanBatch[1], times[0] / times[1]);
+        }
+
+       // ============================ pipelined stream ================================
+        const int frameNum = 16;
+        std::cout<<"\n------------------------- pipelined stream ("<<frameNum<<" frames, 1 stage vs 2 / 4 stages) ------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i]);
+            if(!bench)
+            {
+                continue;
+            }
+
+           const int stageNums[3] = {1, 2, 4};
+            float fps[3] = {0, 0, 0};
+            std::string detail;
+            for (int s = 0; s < 3; ++s)
+            {
+                Msnhnet::PipelineExecutor pipe(&bench->builder, stageNums[s]);
+                std::vector<std::future<std::vector<float>>> classify;
+                std::vector<std::future<std::vector<Msnhnet::Yolov3Box>>> boxes;
+                for (int f = 0; f < frameNum; ++f)
+                {
+                    if(bench->yolo)
+                    {
+                        boxes.push_back(pipe.submitYolov3(bench->img));
+                    }
+                    else
+                    {
+                        classify.push_back(pipe.submitClassify(bench->img));
+                    }
+                }
+                for (auto &result : classify)
+                {
+                    result.get();
+                }
+                for (auto &result : boxes)
+                {
+                    result.get();
+                }
+                fps[s]  = pipe.getThroughput();
+                detail  = pipe.getStageDetail();
+            }
+
+           printf("%-26s | 1 stage %8.2f fps | 2 stages %8.2f fps | 4 stages %8.2f fps\n", models[i].c_str(), fps[0], fps[1], fps[2]);
+            std::cout<<detail<<std::endl;
+        }
+
+       // ============================ async stream =====================================
+        std::cout<<"\n------------------------- async stream ("<<frameNum<<" 640x480 frames, serial vs overlapped pre / post) ---"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i]);
+            if(!bench)
+            {
+                continue;
+            }
+
+           const int c     = bench->builder.net->layers[0]->channel;
+            const int h     = bench->builder.net->layers[0]->height;
+            const int w     = bench->builder.net->layers[0]->width;
+            const int frameH = 480;
+            const int frameW = 640;
+            std::vector<uint8_t> camera(static_cast<size_t>(frameH) * frameW * 3);
+            for (size_t p = 0; p < camera.size(); ++p)
+            {
+                camera[p] = static_cast<uint8_t>(p * 7);
+            }
+
+           /* grab, preprocess, forward and draw one after the other */
+            const double serial = bestOf(1, [&]()
+            {
+                for (int f = 0; f < frameNum; ++f)
+                {
+                    std::vector<uint8_t> frame = camera;
+                    bench->infer(preprocessFrame(frame, frameH, frameW, c, h, w));
+                    postprocessFrame(frame);
+                }
+            });
+
+           /* preprocess on the executor's thread and draw the oldest frame here, 3 frames in flight */
+            const size_t inFlight = 3;
+            const double overlapped = bestOf(1, [&]()
+            {
+                Msnhnet::PipelineExecutor pipe(&bench->builder, 1, 0, inFlight);
+                std::deque<std::pair<std::vector<uint8_t>, std::future<std::vector<float>>>> classify;
+                std::deque<std::pair<std::vector<uint8_t>, std::future<std::vector<Msnhnet::Yolov3Box>>>> boxes;
+                for (int f = 0; f < frameNum + static_cast<int>(inFlight); ++f)
+                {
+                    if(f < frameNum)
+                    {
+                        std::vector<uint8_t> frame = camera;
+                        std::function<std::vector<float>()> preprocess = [frame, frameH, frameW, c, h, w]()
+                        {
+                            return preprocessFrame(frame, frameH, frameW, c, h, w);
+                        };
+
+                       if(bench->yolo)
+                        {
+                            boxes.emplace_back(std::move(frame), pipe.submitYolov3(std::move(preprocess)));
+                        }
+                        else
+                        {
+                            classify.emplace_back(std::move(frame), pipe.submitClassify(std::move(preprocess)));
+                        }
+                    }
+
+                   if(f + 1 < static_cast<int>(inFlight))
+                    {
+                        continue;
+                    }
+
+                   if(!boxes.empty())
+                    {
+                        boxes.front().second.get();
+                        postprocessFrame(boxes.front().first);
+                        boxes.pop_front();
+                    }
+                    else if(!classify.empty())
+                    {
+                        classify.front().second.get();
+                        postprocessFrame(classify.front().first);
+                        classify.pop_front();
+                    }
+                }
+            });
+
+           printf("%-26s | serial %8.2f fps | overlapped %8.2f fps | x%6.2f\n", models[i].c_str(),
+                   frameNum / serial, frameNum / overlapped, serial / overlapped);
+        }
+
+       // ============================ concurrent branches ==============================
+        std::cout<<"\n------------------------- block branches (serial vs concurrent, batch 1) ---------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i]);
+            if(!bench)
+            {
+                continue;
+            }
+
+           double times[2] = {0, 0};
+            for (int concurrent = 0; concurrent < 2; ++concurrent)
+            {
+                Msnhnet::BaseLayer::setUseConcurrentBranches(concurrent == 1);
+                times[concurrent] = bestOf(3, [&]()
+                {
+                    bench->infer(bench->img);
+                });
+            }
+            Msnhnet::BaseLayer::setUseConcurrentBranches(true);
+
+           printf("%-26s | serial %8.2f ms | concurrent %8.2f ms | x%6.2f\n", models[i].c_str(), times[0] * 1000, times[1] * 1000, times[0] / times[1]);
+        }
+
+        // ============================ layer loops and thread count ====================
+        std::cout<<"\n------------------------- small layer loops (omp fork/join vs pool) --------------"<<std::endl;
+        {
+            const int threads = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+            Msnhnet::ThreadPool pool(threads);
+            Msnhnet::ThreadPoolScope scope(&pool);
+
+           /* the leaky activation of a 13x13 yolov3_tiny layer up to a 104x104 one */
+            const int sizes[] = {13*13*256, 26*26*256, 104*104*64};
+            for (size_t s = 0; s < 3; ++s)
+            {
+                std::vector<float> x(static_cast<size_t>(sizes[s]), 0.5f);
+                float *const data = x.data();
+                const int n = sizes[s];
+
+               /* 100 loops per round, the clock counts microseconds */
+                const double tOmp = bestOf(5, [&]()
+                {
+                    for (int r = 0; r < 100; ++r)
+                    {
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(threads)
+#endif
+                        for (int j = 0; j < n; ++j)
+                        {
+                            data[j] = Msnhnet::Activations::activate(data[j], LEAKY);
+                        }
+                    }
+                });
+                const double tPool = bestOf(5, [&]()
+                {
+                    for (int r = 0; r < 100; ++r)
+                    {
+                        Msnhnet::Activations::activateArray(data, n, LEAKY);
+                    }
+                });
+
+               printf("leaky %8d floats %2d threads | omp %8.2f us | pool %8.2f us | x%6.2f\n", n, threads, tOmp * 1e4, tPool * 1e4, tOmp / tPool);
+            }
+        }
+
+       std::cout<<"\n------------------------- threads per net (NetBuilder::setThreadNum) -------------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i]);
+            if(!bench)
+            {
+                continue;
+            }
+
+           const int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            printf("%-26s", models[i].c_str());
+            for (int threads = 1; threads <= maxThreads; threads *= 2)
+            {
+                bench->builder.setThreadNum(threads);
+                const double t = bestOf(3, [&]()
+                {
+                    bench->infer(bench->img);
+                });
+                printf(" | %2d threads %8.2f ms", threads, t * 1000);
+            }
+            printf("\n");
+        }
+
+        // ============================ kernel tables ===================================
+        std::cout<<"\n------------------------- kernel tables (each isa this cpu can run) ---------------"<<std::endl;
+        {
+            const Msnhnet::KernelIsa best = Msnhnet::Kernels::get().isa;
+            const Msnhnet::KernelIsa isas[] = {Msnhnet::ISA_GENERIC, Msnhnet::ISA_SSE4, Msnhnet::ISA_AVX2, Msnhnet::ISA_AVX512, Msnhnet::ISA_AVX512_VNNI,
+                                               Msnhnet::ISA_NEON};
+
+           /* a 104x104x64 plane set like yolov3_tiny's second block, the gemm is a kc 256 tile row */
+            const int plane = 104 * 104;
+            const int channels = 64;
+            const int kc = 256;
+            std::vector<float> src(static_cast<size_t>(plane) * channels, 0.5f);
+            std::vector<float> dst(static_cast<size_t>(plane) * channels);
+            std::vector<float> pooled(static_cast<size_t>(plane / 4) * channels);
+            std::vector<float> packA(static_cast<size_t>(kc) * 6, 0.01f);
+            /* 64 byte aligned like Gemm::alignedMalloc, a zmm load of a 32 byte aligned panel splits a cache line */
+            std::vector<float> packB(static_cast<size_t>(kc) * 32 + 16, 0.01f);
+            float *const alignedB = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(packB.data()) + 63) & ~static_cast<uintptr_t>(63));
+            float tile[6 * 32];
+
+            for (size_t s = 0; s < 6; ++s)
+            {
+                if(!Msnhnet::Kernels::select(isas[s]))
+                {
+                    continue;
+                }
+                const Msnhnet::KernelTable &kernels = Msnhnet::Kernels::get();
+
+               const double tGemm = bestOf(5, [&]()
+                {
+                    for (int r = 0; r < 1000; ++r)
+                    {
+                        kernels.gemm6x16(kc, packA.data(), alignedB, tile, 16, true, nullptr, 0, nullptr);
+                    }
+                }) / 1000;
+                const double tGemm32 = (kernels.gemm6x32 == nullptr) ? 0 : bestOf(5, [&]()
+                {
+                    for (int r = 0; r < 1000; ++r)
+                    {
+                        kernels.gemm6x32(kc, packA.data(), alignedB, tile, 32, true, nullptr, 0, nullptr);
+                    }
+                }) / 1000;
+                const double tPool = bestOf(5, [&]()
+                {
+                    kernels.maxPool(src.data(), pooled.data(), 2, 2, 104, 104, 52, 52, 0, 0, 2, channels);
+                });
+                const double tBn = bestOf(5, [&]()
+                {
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        kernels.batchNorm(src.data() + c * plane, dst.data() + c * plane, plane, 1.f, 0.1f, 0.9f, 0.2f);
+                    }
+                });
+                const double tAct = bestOf(5, [&]()
+                {
+                    if(!kernels.activate(dst.data(), plane * channels, LEAKY, 0.1f))
+                    {
+                        Msnhnet::Activations::activateArray(dst.data(), plane * channels, LEAKY);
+                    }
+                });
+
+               printf("%-10s | gemm 6x16x%d %7.2f GFlops", kernels.name, kc, 2.0 * 6 * 16 * kc / tGemm * 1e-9);
+                if(tGemm32 > 0)
+                {
+                    printf(" | 6x32 %7.2f GFlops", 2.0 * 6 * 32 * kc / tGemm32 * 1e-9);
+                }
+                else
+                {
+                    printf(" | 6x32        -      ");
+                }
+                printf(" | maxpool 2x2 %7.2f us | batchnorm %7.2f us | leaky %7.2f us\n", tPool * 1e6, tBn * 1e6, tAct * 1e6);
+            }
+
+           Msnhnet::Kernels::select(best);
+        }
+
+        // ============================ co-hosted nets ==================================
+        std::cout<<"\n------------------------- two nets side by side (shared vs disjoint cores) --------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            const int cores = static_cast<int>(std::thread::hardware_concurrency());
+            std::unique_ptr<BenchModel> hosts[2];
+            hosts[0] = loadModel(root, models[i]);
+            if(!hosts[0])
+            {
+                continue;
+            }
+
+           if(cores < 2)
+            {
+                printf("%-26s | needs 2 cores\n", models[i].c_str());
+                continue;
+            }
+            hosts[1] = loadModel(root, models[i]);
+
+           /* both nets infer 10 times at once, the slower one counts */
+            double times[2] = {0, 0};
+            for (int disjoint = 0; disjoint < 2; ++disjoint)
+            {
+                for (int n = 0; n < 2; ++n)
+                {
+                    std::vector<int> cpus;
+                    for (int c = n * cores / 2; c < (n + 1) * cores / 2 && disjoint == 1; ++c)
+                    {
+                        cpus.push_back(c);
+                    }
+                    hosts[n]->builder.setThreadNum(disjoint ? cores / 2 : cores, cpus);
+                }
+
+               times[disjoint] = bestOf(3, [&]()
+                {
+                    std::thread other([&]()
+                    {
+                        for (int r = 0; r < 10; ++r)
+                        {
+                            hosts[1]->infer(hosts[1]->img);
+                        }
+                    });
+                    for (int r = 0; r < 10; ++r)
+                    {
+                        hosts[0]->infer(hosts[0]->img);
+                    }
+                    other.join();
+                }) / 10;
+            }
+
+           printf("%-26s | shared %2d threads each %8.2f ms | disjoint %2d cores each %8.2f ms\n", models[i].c_str(),
+                   cores, times[0] * 1000, cores / 2, times[1] * 1000);
+        }
+
+        // ============================ allocations per inference =======================
+        std::cout<<"\n------------------------- heap allocations per inference -------------------------"<<std::endl;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            std::unique_ptr<BenchModel> bench = loadModel(root, models[i], false);
+            if(!bench)
+            {
+                continue;
+            }
+
+            /* yolov3 out builds its box lists per frame */
+            if(bench->yolo)
+            {
+                continue;
+            }
+
+            bench->infer(bench->img);
+
+            const size_t before = allocCount;
+            bench->infer(std::move(bench->img));
+
+            /* the prediction the forward returns is the only expected allocation */
+            const size_t allocs = allocCount - before - 1;
+            printf("%-26s %4d %s\n", models[i].c_str(), static_cast<int>(allocs), allocs == 0 ? "ok" : "FAIL");
+            failures += (allocs == 0) ? 0 : 1;
+        }
+        // ==============================================================================
+    }
+    catch (Msnhnet::Exception ex)
+    {
+        std::cout<<ex.what()<<std::endl;
+        failures++;
+    }
+
+   if(failures > 0)
+    {
+        std::cout<<"\n"<<failures<<" check(s) failed"<<std::endl;
+    }
+    return (failures > 0) ? 1 : 0;
+}
@@ -243,6 +243,56 @@ int main(int argc, char** argv)
         std::cout<<"index : pytorch[  285   ]  msnhnet: " << bestIndex<<std::endl;
         std::cout<<"time  : " << msnhNet.getInferenceTime()<<"s"<<std::endl<<std::flush;
         // ==============================================================================
+
+        // ========================= int8 vs float32 top-1 ==============================
+        // calibrated on the test images themselves, it only shows how far int8 moves the float result
+        std::vector<std::string> imgPaths = {"../images/cat.jpg", "../images/dog.jpg"};
+        std::vector<std::string> int8Nets = {"resnet18", "resnet50", "darknet53"};
+
+        std::vector<std::vector<float>> imgs;
+        for (size_t i = 0; i < imgPaths.size(); ++i)
+        {
+            imgs.push_back(Msnhnet::OpencvUtil::getImgDataF32C3(imgPaths[i],cv::Size(224,224)));
+        }
+
+        for (size_t i = 0; i < int8Nets.size(); ++i)
+        {
+            config_file_ = root + "/" + int8Nets[i] + "/" + int8Nets[i] + ".msnhnet";
+            std::string weights_file_ = root + "/" + int8Nets[i] + "/" + int8Nets[i] + ".msnhbin";
+
+            Msnhnet::NetBuilder floatNet;
+            floatNet.buildNetFromMsnhNet(config_file_);
+            floatNet.loadWeightsFromMsnhBin(weights_file_);
+
+            Msnhnet::NetBuilder int8Net;
+            int8Net.setUseInt8(true);
+            int8Net.buildNetFromMsnhNet(config_file_);
+            int8Net.loadWeightsFromMsnhBin(weights_file_);
+            int8Net.calibrate(imgs);
+
+            int   agree      = 0;
+            float maxDelta   = 0;
+            float floatTime  = 0;
+            float int8Time   = 0;
+            for (size_t j = 0; j < imgs.size(); ++j)
+            {
+                std::vector<float> floatResult = floatNet.runClassify(imgs[j]);
+                floatTime += floatNet.getInferenceTime();
+                std::vector<float> int8Result  = int8Net.runClassify(imgs[j]);
+                int8Time  += int8Net.getInferenceTime();
+
+                int floatIndex = static_cast<int>(Msnhnet::ExVector::maxIndex(floatResult));
+                int int8Index  = static_cast<int>(Msnhnet::ExVector::maxIndex(int8Result));
+                agree         += (floatIndex == int8Index) ? 1 : 0;
+                maxDelta       = std::max(maxDelta, std::abs(floatResult[floatIndex] - int8Result[floatIndex]));
+            }
+
+            std::cout<<"\n===== "<<int8Nets[i]<<" int8 top-1 agrees with float32 on "<<agree<<"/"<<imgs.size()<<" images ====="<<std::endl;
+            std::cout<<"top-1 accuracy delta : "<<100.f*(imgs.size() - agree)/imgs.size()<<"%"<<std::endl;
+            std::cout<<"top-1 score delta    : "<<maxDelta<<std::endl;
+            std::cout<<"time  : float32 "<<floatTime/imgs.size()<<"s  int8 "<<int8Time/imgs.size()<<"s"<<std::endl<<std::flush;
+        }
+        // ==============================================================================
     }
     catch(Msnhnet::Exception &ex)
     {
@@ -0,0 +1,110 @@
+﻿#include <iostream>
+#include "Msnhnet/net/MsnhNetBuilder.h"
+#include "Msnhnet/utils/MsnhOpencvUtil.h"
+#include "Msnhnet/config/MsnhnetCfg.h"
+
+/* calibrates a float net on a few images and writes its int8 weight file, which
+ * NetBuilder::loadQuantWeights reads back after loadWeightsFromMsnhBin (setUseInt8(true) before building).
+ * --f16 / --bf16 instead rewrite a msnhbin with 16 bit weights, loadWeightsFromMsnhBin reads both.
+ * --model packs msnhnet + msnhbin (+ an optional msnhq8) into one msnhmodel for NetBuilder::buildNetFromMsnhModel */
+int main(int argc, char** argv)
+{
+    if(argc >= 5 && std::string(argv[1]) == "--model")
+    {
+        try
+        {
+            WeightStorage storage   = WEIGHT_F32;
+            std::string quantPath   = "";
+            for (int i = 5; i < argc; ++i)
+            {
+                if(std::string(argv[i]) == "--f16")
+                {
+                    storage = WEIGHT_F16;
+                }
+                else if(std::string(argv[i]) == "--bf16")
+                {
+                    storage = WEIGHT_BF16;
+                }
+                else
+                {
+                    quantPath = argv[i];
+                }
+            }
+            Msnhnet::NetBuilder::convertMsnhModel(argv[2], argv[3], argv[4], storage, quantPath);
+            std::cout<<argv[2]<<" + "<<argv[3]<<" -> "<<argv[4]<<std::endl;
+        }
+        catch(Msnhnet::Exception &ex)
+        {
+            std::cout << ex.what() << " { " << ex.getErrFile() << " " << ex.getErrLine() << "}";
+        }
+        return 0;
+    }
+
+    if(argc == 4 && (std::string(argv[1]) == "--f16" || std::string(argv[1]) == "--bf16"))
+    {
+        try
+        {
+            const WeightStorage storage = (std::string(argv[1]) == "--f16") ? WEIGHT_F16 : WEIGHT_BF16;
+            Msnhnet::Parser::convertMsnhBin(argv[2], argv[3], storage);
+            std::cout<<argv[2]<<" -> "<<argv[3]<<" ("<<argv[1] + 2<<")"<<std::endl;
+        }
+        catch(Msnhnet::Exception &ex)
+        {
+            std::cout << ex.what() << " { " << ex.getErrFile() << " " << ex.getErrLine() << "}";
+        }
+        return 0;
+    }
+
+    if(argc < 5)
+    {
+        std::cout<<"\nusage: quantize net.msnhnet net.msnhbin out.msnhq8 img0 [img1 ...] [--minmax]\n"
+                 <<"       quantize --f16|--bf16 in.msnhbin out.msnhbin\n"
+                 <<"       quantize --model net.msnhnet net.msnhbin out.msnhmodel [--f16|--bf16] [net.msnhq8]\n"
+                 <<"eg: quantize resnet18.msnhnet resnet18.msnhbin resnet18.msnhq8 ../images/cat.jpg ../images/dog.jpg\n";
+        return 0;
+    }
+
+    std::vector<std::string> imgPaths;
+    Msnhnet::QuantCalibration method = Msnhnet::QUANT_PERCENTILE;
+
+    for (int i = 4; i < argc; ++i)
+    {
+        if(std::string(argv[i]) == "--minmax")
+        {
+            method = Msnhnet::QUANT_MINMAX;
+        }
+        else
+        {
+            imgPaths.push_back(argv[i]);
+        }
+    }
+
+    try
+    {
+        Msnhnet::NetBuilder msnhNet;
+        msnhNet.setUseInt8(true);
+        msnhNet.buildNetFromMsnhNet(argv[1]);
+        msnhNet.loadWeightsFromMsnhBin(argv[2]);
+
+        const int width     = msnhNet.net->layers[0]->width;
+        const int height    = msnhNet.net->layers[0]->height;
+
+        std::vector<std::vector<float>> imgs;
+        for (size_t i = 0; i < imgPaths.size(); ++i)
+        {
+            imgs.push_back(Msnhnet::OpencvUtil::getImgDataF32C3(imgPaths[i], cv::Size(width, height)));
+        }
+
+        msnhNet.calibrate(imgs, method);
+        msnhNet.saveQuantWeights(argv[3]);
+
+        std::cout<<"calibrated on "<<imgs.size()<<" images ("<<(method == Msnhnet::QUANT_MINMAX ? "min/max" : "percentile")
+                 <<"), int8 weights saved to "<<argv[3]<<std::endl;
+    }
+    catch(Msnhnet::Exception &ex)
+    {
+        std::cout << ex.what() << " { " << ex.getErrFile() << " " << ex.getErrLine() << "}";
+    }
+
+    return 0;
+}
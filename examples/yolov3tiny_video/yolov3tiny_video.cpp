@@ -1,5 +1,7 @@
 ﻿#include <iostream>
+#include <deque>
 #include "Msnhnet/net/MsnhNetBuilder.h"
+#include "Msnhnet/net/MsnhPipelineExecutor.h"
 #include "Msnhnet/io/MsnhIO.h"
 #include "Msnhnet/config/MsnhnetCfg.h"
 #include "Msnhnet/utils/MsnhOpencvUtil.h"
@@ -33,21 +35,44 @@ int main(int argc, char** argv)
             std::cout<< "cam err" <<std::endl;
         }
 
+        /* this thread grabs and draws, the executor resizes / normalizes frame N+1 on its preprocessing thread while
+         * frame N is in its 2 stages and frame N-1 is drawn here. A submit waits while 3 frames are unfinished */
+        const size_t inFlight = 3;
+        Msnhnet::PipelineExecutor pipe(&msnhNet, 2, 0, inFlight);
+        std::deque<std::pair<cv::Mat, std::future<std::vector<Msnhnet::Yolov3Box>>>> frames;
+
         while (1)
         {
             cap >> mat;
-            cv::Mat org = mat.clone();
-            std::vector<float> img = Msnhnet::OpencvUtil::getPaddingZeroF32C3(mat, cv::Size(416,416));
-            std::vector<std::vector<Msnhnet::Yolov3Box>> result = msnhNet.runYolov3(img);
-            Msnhnet::OpencvUtil::drawYolov3Box(org,labels,result);
-            std::cout<<msnhNet.getInferenceTime()<<std::endl;
-            cv::imshow("test",org);
+            cv::Mat org   = mat.clone();
+            cv::Mat input = mat.clone();
+            frames.emplace_back(org, pipe.submitYolov3([input]() mutable
+            {
+                return Msnhnet::OpencvUtil::getPaddingZeroF32C3(input, cv::Size(416,416));
+            }));
+
+            if(frames.size() < inFlight)
+            {
+                continue;
+            }
+
+            std::vector<std::vector<Msnhnet::Yolov3Box>> result = {frames.front().second.get()};
+            Msnhnet::OpencvUtil::drawYolov3Box(frames.front().first,labels,result);
+            std::cout<<pipe.getThroughput()<<" fps"<<std::endl;
+            cv::imshow("test",frames.front().first);
+            frames.pop_front();
             if(cv::waitKey(20) == 27)
             {
                 break;
             }
 
         }
+
+        for (auto &frame : frames)
+        {
+            frame.second.wait();
+        }
+        std::cout<<pipe.getStageDetail()<<std::endl;
     }
     catch (Msnhnet::Exception ex)
     {
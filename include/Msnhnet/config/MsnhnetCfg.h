@@ -20,10 +20,20 @@
 #include <cblas.h>
 #endif
 
+/* omp regions take the thread count of the calling thread, a net sets its own while it runs (see ThreadPoolScope) */
 #ifndef OMP_THREAD
 #define OMP_THREAD omp_get_max_threads()
 #endif
 
+/* threads of a net until NetBuilder::setThreadNum, fixed by cmake when OMP_MAX_THREAD is off */
+#ifndef MSNH_DEFAULT_THREADS
+#ifdef USE_OMP
+#define MSNH_DEFAULT_THREADS omp_get_max_threads()
+#else
+#define MSNH_DEFAULT_THREADS 1
+#endif
+#endif
+
 enum ActivationType
 {
     LOGISTIC,
@@ -110,4 +120,11 @@ enum WeightsNorm
     SOFTMAX_NORM
 };
 
+enum WeightStorage
+{
+    WEIGHT_F32,
+    WEIGHT_F16,
+    WEIGHT_BF16
+};
+
 #endif // MSNHINFERENCECFG_H
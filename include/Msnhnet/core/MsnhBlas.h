@@ -3,6 +3,7 @@
 
 #include "Msnhnet/config/MsnhnetCfg.h"
 #include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/core/MsnhThreadPool.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
 namespace Msnhnet
@@ -12,7 +13,7 @@ class MsnhNet_API Blas
 public:
     Blas();
 
-   static void cpuCopy(const int &inputN, float *const &input, const int &inputStep,
+   static void cpuCopy(const int &inputN, const float *const &input, const int &inputStep,
                         float *const &output, const int &outputStep);
 
    static void cpuFill(const int &inputN, const float &alpha, float *const &x, const int &step);
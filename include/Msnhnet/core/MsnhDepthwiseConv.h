@@ -0,0 +1,24 @@
+﻿#ifndef MSNHDEPTHWISECONV_H
+#define MSNHDEPTHWISECONV_H
+#include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+namespace Msnhnet
+{
+/* Direct 3x3 depthwise convolution (groups == channel == num), stride 1 or 2.
+ * output = act(conv(input) + biases[c]), no workspace is used. */
+class MsnhNet_API DepthwiseConv
+{
+public:
+
+    static bool isFusedActivation(const ActivationType &activation);
+
+    static void conv3x3(const int &stride, float *const &input, const int &batch, const int &channel, const int &height, const int &width,
+                        const int &paddingX, const int &paddingY, float *const &weights, float *const &biases,
+                        const int &outHeight, const int &outWidth, const ActivationType &activation, const float &actParam,
+                        float *const &output);
+};
+}
+
+#endif
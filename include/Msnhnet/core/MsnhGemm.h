@@ -2,6 +2,8 @@
 #define MSNHGEMM_H
 #include "Msnhnet/config/MsnhnetCfg.h"
 #include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/core/MsnhHalf.h"
+#include "Msnhnet/core/MsnhKernels.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
 namespace Msnhnet
@@ -26,7 +28,7 @@ public:
    static void cpuIm2colEx(float *input, const int &channelNum, const int &height, const int &width,
                             const int &kernelH, const int &kernelW, const int &padH, const int &padW,
                             const int &strideH,  const int &strideW, const int &dilationH, const int &dilationW,
-                            float *output);
+                            float *output, const int &ldOutput = 0);
 
    static void cpuIm2colWithAvx(float * const &input, const int &channelNum, const int &height, const int &width,const int &kSize,
                                  const int &stride, const int &padding, float * const &output,const bool &supportAvxAndFma);
@@ -96,6 +98,63 @@ public:
                               float *const &B, const int &ldb,
                               float *const &C, const int &ldc);
 
+#define GEMM_MR 6
+
+#define GEMM_NR 16
+
+#define GEMM_MC 72
+
+#define GEMM_KC 256
+
+#define GEMM_NC 3072
+
+/* the fp16 / bf16 kernel loads 8 weights per k step of GEMM_MR, half packed buffers need this many extra elements */
+#define GEMM_HALF_PAD 8
+
+   static void *alignedMalloc(const size_t &size, const size_t &align = 64);
+
+   static void alignedFree(void *const &ptr);
+
+   static void cpuGemmPackA(const int &M, const int &K, const float &ALPHA,
+                             float *const &A, const int &lda, float *const &packedA);
+
+   static void cpuGemmPackB(const int &K, const int &N, float *const &B, const int &ldb, float *const &packedB);
+
+   static void cpuGemmPacked(const int &M, const int &N, const int &K, const float &ALPHA,
+                              float *const &A, const int &lda,
+                              float *const &B, const int &ldb,
+                              float *const &C, const int &ldc);
+
+   static size_t getPackedASize(const int &M, const int &K);
+
+   static bool isEpilogueActivation(const ActivationType &activation);
+
+   /* with an epilogue C is overwritten instead of accumulated into, residual uses ldc */
+    static void cpuGemmPrePacked(const int &M, const int &N, const int &K, float *const &packedA,
+                                 float *const &B, const int &ldb,
+                                 float *const &C, const int &ldc, const GemmEpilogue *const &epilogue = nullptr);
+
+   /* weights stored as fp16 / bf16 in the cpuGemmPackA layout, widened to float inside the micro kernel */
+    static void cpuGemmPackAHalf(const int &M, const int &K, float *const &A, const int &lda, uint16_t *const &packedA, const WeightStorage &storage);
+
+   static void cpuGemmPrePackedHalf(const int &M, const int &N, const int &K, uint16_t *const &packedA, const WeightStorage &storage,
+                                     float *const &B, const int &ldb,
+                                     float *const &C, const int &ldc, const GemmEpilogue *const &epilogue = nullptr);
+
+   /* y = A*x, A is M x K row major fp16 / bf16 */
+    static void cpuGemvHalf(const int &M, const int &K, uint16_t *const &A, const WeightStorage &storage, float *const &x, float *const &y);
+
+   static void cpuImplicitGemmPackB(float *const &input, const int &channel, const int &height, const int &width,
+                                     const int &kernelH, const int &kernelW, const int &padH, const int &padW,
+                                     const int &strideH, const int &strideW, const int &dilationH, const int &dilationW,
+                                     const int &outWidth, const int &pc, const int &kc, const int &jc, const int &nc,
+                                     float *const &packedB);
+
+   static void cpuImplicitGemmConv(const int &M, float *const &packedA, float *const &input, const int &channel, const int &height, const int &width,
+                                    const int &kernelH, const int &kernelW, const int &padH, const int &padW,
+                                    const int &strideH, const int &strideW, const int &dilationH, const int &dilationW,
+                                    float *const &C, const GemmEpilogue *const &epilogue = nullptr);
+
    static void swapVal(uint32_t &a0, uint32_t&a1, int &j, unsigned &m);
 
    static uint8_t lookup[16] ;
@@ -139,6 +198,13 @@ public:
    static void transposeUint32(uint32_t *const &input, uint32_t *const &output, const int &inH,
                                 const int &inW, const int &inAlign, const int &outAlign);
 
+   /* xnor conv: the sign bits of one pixel's channels are packed into getXnorWords(channel) uint32 words (channel c is bit c%32
+     * of word c/32). A row holds kernelH*kernelW taps of those words, zero padded to getXnorLd words (a multiple of 256 bits) */
+    static int getXnorWords(const int &channel);
+    static int getXnorLd(const int &channel, const int &kernelH, const int &kernelW);
+    static size_t getXnorWorkSpaceSize(const int &channel, const int &height, const int &width, const int &kernelH, const int &kernelW,
+                                       const int &outHeight, const int &outWidth);
+
 #ifdef USE_X86
 
    static void gemmNNBinMeanTrans(int M, int N, int K, float ALPHA_UNUSED,
@@ -146,7 +212,19 @@ public:
                                    unsigned char *B, int ldb,
                                    float *C, int ldc, float *mean_arr);
 
-   static inline void xnorAvx2Popcnt(__m256i aBit256, __m256i bBit256, __m256i *countSum)
+   /* weights: num x channel x kernelH x kernelW (binarized or not, only the sign is kept). meanArr gets the mean |w| of each filter,
+     * tapSums the +-1 sum over channels of each filter tap, which corrects taps that fall into the zero padding */
+    static void cpuXnorPackWeights(float *const &weights, const int &num, const int &channel, const int &kernelH, const int &kernelW,
+                                   uint32_t *const &packed, float *const &meanArr, int *const &tapSums);
+
+   /* output = meanArr[m] * (sign(w) . sign(x)), zero padding contributes 0 like the float path. workspace: getXnorWorkSpaceSize words */
+    static void cpuXnorConv(float *const &input, const int &channel, const int &height, const int &width,
+                            const int &kernelH, const int &kernelW, const int &padH, const int &padW,
+                            const int &strideH, const int &strideW, const int &dilationH, const int &dilationW,
+                            uint32_t *const &packedWeights, const int &num, float *const &meanArr, const int *const &tapSums,
+                            uint32_t *const &workspace, float *const &output);
+
+   MSNH_AVX2_TARGET static inline void xnorAvx2Popcnt(__m256i aBit256, __m256i bBit256, __m256i *countSum)
     {
         __m256i cBit256 = _mm256_set1_epi8(static_cast<char>(-1));
         __m256i xor256  = _mm256_xor_si256(aBit256, bBit256);  
@@ -157,7 +235,7 @@ public:
 
    }
 
-   static inline int getCountMula(__m256i countSum)
+   MSNH_AVX2_TARGET static inline int getCountMula(__m256i countSum)
     {
 
        return  static_cast<int>(_mm256_extract_epi64(countSum, 0)
@@ -167,7 +245,7 @@ public:
 
    }
 
-   static inline int popcnt128(__m128i n)
+   MSNH_AVX2_TARGET static inline int popcnt128(__m128i n)
     {
         const __m128i nHi = _mm_unpackhi_epi64(n, n);
 #if defined(_MSC_VER)
@@ -179,12 +257,12 @@ public:
 #endif
     }
 
-   static inline int popcnt256(__m256i n)
+   MSNH_AVX2_TARGET static inline int popcnt256(__m256i n)
     {
         return popcnt128(_mm256_extractf128_si256(n, 0)) + popcnt128(_mm256_extractf128_si256(n, 1));
     }
 
-   static inline __m256i count256(__m256i v)
+   MSNH_AVX2_TARGET static inline __m256i count256(__m256i v)
     {
         __m256i lookup   = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
                                             2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3,
@@ -201,7 +279,7 @@ public:
        return _mm256_sad_epu8(total, _mm256_setzero_si256());
     }
 
-   static inline int popcnt256_custom(__m256i n)
+   MSNH_AVX2_TARGET static inline int popcnt256_custom(__m256i n)
     {
         __m256i val = count256(n);
 
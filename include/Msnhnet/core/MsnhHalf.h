@@ -0,0 +1,28 @@
+﻿#ifndef MSNHHALF_H
+#define MSNHHALF_H
+#include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+namespace Msnhnet
+{
+/* 16 bit weight storage: IEEE fp16 or bfloat16 (upper half of a float), both rounded to nearest even */
+class MsnhNet_API Half
+{
+public:
+    static uint16_t floatToHalf(const float &val);
+
+    static float halfToFloat(const uint16_t &val);
+
+    static uint16_t floatToBFloat16(const float &val);
+
+    static float bFloat16ToFloat(const uint16_t &val);
+
+    static uint16_t fromFloat(const float &val, const WeightStorage &storage);
+
+    static float toFloat(const uint16_t &val, const WeightStorage &storage);
+
+    static void fromFloat(const float *const &src, const size_t &n, const WeightStorage &storage, uint16_t *const &dst);
+};
+}
+
+#endif
@@ -0,0 +1,143 @@
+﻿#ifndef MSNHKERNELS_H
+#define MSNHKERNELS_H
+#include <atomic>
+#include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+namespace Msnhnet
+{
+/* applied to C tiles while they are still in registers:
+ * C = postActivation(activation(A*B + bias[row]) + residual) */
+class GemmEpilogue
+{
+public:
+    float          *bias            =   nullptr;
+    ActivationType  activation      =   ActivationType::NONE;
+    float           actParam        =   0.1f;
+    float          *residual        =   nullptr;
+    ActivationType  postActivation  =   ActivationType::NONE;
+    float           postActParam    =   0.1f;
+};
+
+/* one int8 C tile of Quant::gemm and what dequantizes it:
+ * C = epilogue(wScales[row] * inScale * (sum - inZeroPoint * rowSums[row])), residual rows res use ldc */
+struct QuantTile
+{
+    float           *C;
+    int             ldc;
+    int             mr;
+    int             nr;
+    int             row;
+    const float     *res;
+    const float     *wScales;
+    const int32_t   *rowSums;
+    float           inScale;
+    int             inZeroPoint;
+    const GemmEpilogue *epi;
+};
+
+enum KernelIsa
+{
+    ISA_GENERIC,
+    ISA_SSE4,
+    ISA_AVX2,
+    ISA_AVX512,
+    ISA_NEON,
+    ISA_AVX512_VNNI
+};
+
+/* One instruction set's build of the hot loops. Every isa lives in its own src/core/MsnhKernels<Isa>.cpp compiled
+ * with that isa's flags, while the rest of the library keeps the baseline flags (sse4.1 on x86). Those sources use intrinsics and
+ * plain loops only, no inline library code, so nothing built for a wider isa ends up shared with the other sources.
+ * The kernels work on plain arrays, never allocate and never spawn threads, the callers split the work. */
+struct KernelTable
+{
+    KernelIsa   isa;
+    const char  *name;
+
+    /* C[6 x 16] (+)= a * b over kc packed steps (a: 6 floats, b: 16 floats per step, b 32 byte aligned), the
+     * epilogue only on the last k block (epi == nullptr otherwise), see Gemm::cpuGemmPrePacked */
+    void (*gemm6x16)(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                     const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res);
+
+    /* gemm6x16 with fp16 / bf16 a, widened in registers. a may be read up to GEMM_HALF_PAD weights past the last step */
+    void (*gemm6x16Half)(const int &kc, const uint16_t *a, const WeightStorage &storage, const float *b, float *const &C, const int &ldc,
+                         const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res);
+
+    /* C[6 x 32] over two adjacent b panels (the second at b + 16 * kc), for isas whose registers fit 12 accumulators.
+     * nullptr where gemm6x16 already fills the register file, the caller then runs one panel at a time */
+    void (*gemm6x32)(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                     const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res);
+    void (*gemm6x32Half)(const int &kc, const uint16_t *a, const WeightStorage &storage, const float *b, float *const &C, const int &ldc,
+                         const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res);
+
+    /* a . x over K fp16 / bf16 weights, one row of Gemm::cpuGemvHalf */
+    float (*dotHalf)(const int &K, const uint16_t *const &a, const WeightStorage &storage, const float *const &x);
+
+    /* the int8 gemm of Quant, nullptr for an isa without one (int8 layers need avx2).
+     * quantPackB quantizes cols [0, nr) of a K x nr block of B into a [k4][16][4] u8 panel (32 byte aligned),
+     * quantGemm4x16 sums k4 steps of a [k4][4][4] s8 panel of A against one of them into the tile t */
+    void (*quantPackB)(const float *const &B, const int &ldb, const int &K, const int &nr, const float &inv, const int &zeroPoint,
+                       uint8_t *const &panel);
+    void (*quantGemm4x16)(const int &k4, const int8_t *a, const uint8_t *b, const QuantTile &t);
+
+    /* u8 x . s8 a over stride bytes, stride a multiple of 32 and both 32 byte aligned */
+    int32_t (*quantDot)(const int &stride, const uint8_t *const &x, const int8_t *const &a);
+
+    /* 3x3 stride 1 padding 1 im2col of an image of the same output size, rows [rowBegin, rowEnd) of the
+     * channel*9 x height*width column matrix */
+    void (*im2col3x3)(const float *const &input, const int &height, const int &width, const int &rowBegin, const int &rowEnd,
+                      float *const &output);
+
+    /* max pooling of channels planes with the same stride in both directions */
+    void (*maxPool)(const float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY, const int &width, const int &height,
+                    const int &outWidth, const int &outHeight, const int &paddingX, const int &paddingY, const int &stride, const int &channels);
+
+    /* dst = scale * (src - mean) / sqrt(variance + .00001f) + bias over one plane */
+    void (*batchNorm)(const float *const &src, float *const &dst, const int &size, const float &scale, const float &mean,
+                      const float &variance, const float &bias);
+
+    /* x = activate(x) in place, false when the activation has no vector version here */
+    bool (*activate)(float *const &x, const int &num, const ActivationType &actType, const float &param);
+
+    /* one tile of NCHWc::conv (NCHWC_PACK 8): np <= 6 output pixels x the 32 output channels of two packed weight pairs.
+     * in[q] is the top left input of pixel q, out the 4 output blocks of the tile (nullptr past outChannel, w1 is nullptr
+     * when the second pair is). nullptr where the 6x16 tile of NCHWc::conv itself is as wide as the isa goes */
+    void (*nchwcConv)(const float *const *const &in, const int &np, const int &icBlocks, const size_t &inBlockStride,
+                      const int *const &kOffset, const int &kNum, const float *const &w0, const float *const &w1,
+                      const float *const &bias, const bool &accumulate, float *const *const &out);
+};
+
+class MsnhNet_API Kernels
+{
+public:
+    /* the table of the best isa of this cpu, picked on first use */
+    static const KernelTable &get();
+
+    /* picks the best table for info, the net builder does this once at startup */
+    static void init(const SimdInfo &info);
+
+    /* forces an isa (to compare them or to check a lower one on a newer cpu), false if it is not built or the cpu
+     * can't run it */
+    static bool select(const KernelIsa &isa);
+
+    /* nullptr for an isa this build has no source for */
+    static const KernelTable *getTable(const KernelIsa &isa);
+
+    static bool isSupported(const KernelIsa &isa, const SimdInfo &info);
+
+    static const KernelTable *genericTable();
+    static const KernelTable *sse4Table();
+    static const KernelTable *avx2Table();
+    static const KernelTable *avx512Table();
+    static const KernelTable *avx512VnniTable();
+    static const KernelTable *neonTable();
+
+private:
+    static std::atomic<const KernelTable *> current;
+    static SimdInfo detected;
+};
+}
+
+#endif
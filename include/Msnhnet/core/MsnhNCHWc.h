@@ -0,0 +1,62 @@
+﻿#ifndef MSNHNCHWC_H
+#define MSNHNCHWC_H
+#include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+#ifdef USE_NEON
+#define NCHWC_PACK          4
+#else
+#define NCHWC_PACK          8
+#endif
+
+/* conv output pixels per micro tile and output channels per micro tile (two blocks) */
+#define NCHWC_CONV_TILE     6
+#define NCHWC_CONV_PAIR     (2*NCHWC_PACK)
+#define NCHWC_TASK_TILES    8
+#define NCHWC_WEIGHT_BLOCK  2048
+
+/* convs with more output pixels than this stay in NCHW (im2col / winograd win there) */
+#define NCHWC_MAX_SPATIAL   1024
+
+/* 1x1 stride 1 convs with more output values than this stay in NCHW, see NCHWc::isFaster */
+#define NCHWC_MAX_1X1_OUTPUT    65536
+
+namespace Msnhnet
+{
+/* Channel blocked layout NCHW[x]c: [batch][channel/NCHWC_PACK][height][width][NCHWC_PACK].
+ * Channels must be a multiple of NCHWC_PACK, so a blocked tensor has the same size as the plain one. */
+class MsnhNet_API NCHWc
+{
+public:
+
+    static bool isFaster(const int &outChannel, const int &kSize, const int &stride, const int &outHeight, const int &outWidth);
+
+    static void toBlocked(float *const &input, const int &batch, const int &channel, const int &height, const int &width, float *const &output);
+
+    static void toPlain(float *const &input, const int &batch, const int &channel, const int &height, const int &width, float *const &output);
+
+    static size_t getPackedWeightsSize(const int &outChannel, const int &inChannel, const int &kSize);
+
+    static void packWeights(float *const &weights, const int &outChannel, const int &inChannel, const int &kSize, float *const &packedWeights);
+
+    static size_t getWorkSpaceSize(const int &channel, const int &height, const int &width, const int &padding);
+
+    static void conv(float *const &input, const int &batch, const int &channel, const int &height, const int &width,
+                     const int &kSize, const int &stride, const int &padding, const int &dilation,
+                     float *const &packedWeights, float *const &biases, const int &outChannel, const int &outHeight, const int &outWidth,
+                     float *const &workspace, float *const &output);
+
+    static void maxPool(float *const &input, const int &batch, const int &channel, const int &height, const int &width,
+                        const int &kSizeX, const int &kSizeY, const int &strideX, const int &strideY, const int &offsetX, const int &offsetY,
+                        const int &outHeight, const int &outWidth, float *const &output);
+
+    static void batchNorm(float *const &input, const int &batch, const int &channel, const int &whSize, float *const &scales,
+                          float *const &biases, float *const &rollMean, float *const &rollVariance, float *const &output);
+
+    static void upSample(float *const &input, const int &batch, const int &channel, const int &height, const int &width,
+                         const int &stride, const float &scale, float *const &output);
+};
+}
+
+#endif
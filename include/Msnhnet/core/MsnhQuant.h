@@ -0,0 +1,74 @@
+﻿#ifndef MSNHQUANT_H
+#define MSNHQUANT_H
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/core/MsnhGemm.h"
+#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+/* int8 micro tile: QUANT_MR weight rows x QUANT_NR output cols, k is consumed 4 at a time */
+#define QUANT_MR            4
+#define QUANT_NR            16
+#define QUANT_NC            512
+#define QUANT_GEMV_ALIGN    32
+#define QUANT_HIST_BINS     2048
+
+namespace Msnhnet
+{
+enum QuantCalibration
+{
+    QUANT_MINMAX,
+    QUANT_PERCENTILE
+};
+
+/* activation range of one layer input, pass 1 tracks min / max, pass 2 fills a histogram of |x| over that range */
+class MsnhNet_API QuantObserver
+{
+public:
+    float               minVal      =   0.f;
+    float               maxVal      =   0.f;
+    bool                empty       =   true;
+    std::vector<double> hist;
+
+    void observe(const float *const &x, const int &n, const int &pass);
+
+    void getParams(const QuantCalibration &method, const float &percentile, float &scale, int &zeroPoint) const;
+};
+
+/* Weights are symmetric int8 per output channel: w = scale[m] * q, q in [-127, 127].
+ * Activations are 7 bit unsigned: x = scale * (q - zeroPoint), q in [0, 127], zeroPoint 0 (x >= 0) or 64.
+ * 7 bits keep the _mm256_maddubs_epi16 pair sums (2*127*127) below int16 saturation, so the avx2 and vnni
+ * kernels produce the same int32 sums. The int32 sums are dequantized in the epilogue, layers stay float.
+ * The kernels come from the isa's KernelTable, isas without an int8 gemm throw. */
+class MsnhNet_API Quant
+{
+public:
+
+    static void quantizeWeights(const float *const &weights, const int &M, const int &K, int8_t *const &q, float *const &scales);
+
+    static size_t getPackedASize(const int &M, const int &K);
+
+    static void packA(const int8_t *const &q, const int &M, const int &K, int8_t *const &packedA, int32_t *const &rowSums);
+
+    static void unpackA(const int8_t *const &packedA, const int &M, const int &K, int8_t *const &q);
+
+    /* C = epilogue(dequant(A * quant(B))), A packed by packA, B is a float M x N row major matrix (im2col output) */
+    static void gemm(const int &M, const int &N, const int &K, const int8_t *const &packedA, const float *const &wScales, const int32_t *const &rowSums,
+                     const float *const &B, const int &ldb, const float &inScale, const int &inZeroPoint,
+                     float *const &C, const int &ldc, const GemmEpilogue &epilogue);
+
+    static int getGemvStride(const int &K);
+
+    static void packGemv(const int8_t *const &q, const int &M, const int &K, int8_t *const &packedA, int32_t *const &rowSums);
+
+    /* y[m] = epilogue(dequant(A[m] . quant(x))), A packed by packGemv */
+    static void gemv(const int &M, const int &K, const int8_t *const &packedA, const float *const &wScales, const int32_t *const &rowSums,
+                     const float *const &x, const float &inScale, const int &inZeroPoint,
+                     float *const &y, const GemmEpilogue &epilogue);
+};
+}
+
+#endif
@@ -27,6 +27,23 @@
 #include <arm_neon.h>
 #endif
 
+/* The x86 build targets sse4.1, code between MSNH_AVX2_BEGIN and MSNH_AVX2_END (lambdas included) and functions
+ * marked MSNH_AVX2_TARGET are built for avx2 + fma and may only run once BaseLayer::supportAvx / supportFma were
+ * checked. msvc compiles the intrinsics without it */
+#if defined(USE_X86) && defined(__clang__)
+#define MSNH_AVX2_BEGIN     _Pragma("clang attribute push (__attribute__((target(\"avx2,fma\"))), apply_to = function)")
+#define MSNH_AVX2_END       _Pragma("clang attribute pop")
+#define MSNH_AVX2_TARGET    __attribute__((target("avx2,fma")))
+#elif defined(USE_X86) && defined(__GNUC__)
+#define MSNH_AVX2_BEGIN     _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma\")")
+#define MSNH_AVX2_END       _Pragma("GCC pop_options")
+#define MSNH_AVX2_TARGET    __attribute__((target("avx2,fma")))
+#else
+#define MSNH_AVX2_BEGIN
+#define MSNH_AVX2_END
+#define MSNH_AVX2_TARGET
+#endif
+
 namespace Msnhnet
 {
 using namespace std;
@@ -86,11 +103,26 @@ public:
         return supportAVX512;
     }
 
+   bool getSupportAVX512BW() const
+    {
+        return supportAVX512BW;
+    }
+
    bool getSupportFMA3() const
     {
         return supportFMA3;
     }
 
+   bool getSupportAVX512VNNI() const
+    {
+        return supportAVX512VNNI;
+    }
+
+   bool getSupportF16C() const
+    {
+        return supportF16C;
+    }
+
    bool checkSimd()
     {
 #ifdef linux
@@ -164,9 +196,24 @@ public:
             supportFMA3 = true;
         }
 
-       if(strResult.find("avx512") != string::npos)
+       if(strResult.find("avx512f") != string::npos)
         {
-            supportAVX2 = true;
+            supportAVX512 = true;
+        }
+
+       if(strResult.find("avx512bw") != string::npos)
+        {
+            supportAVX512BW = true;
+        }
+
+       if(strResult.find("avx512_vnni") != string::npos && strResult.find("avx512vl") != string::npos)
+        {
+            supportAVX512VNNI = true;
+        }
+
+       if(strResult.find("f16c") != string::npos)
+        {
+            supportF16C = true;
         }
 
        return true;
@@ -182,6 +229,10 @@ public:
         supportFMA3     = cpuHasFMA3();
         supportAVX      = cpuHasAVX();
         supportAVX2     = cpuHasAVX2();
+        supportAVX512   = cpuHasAVX512();
+        supportAVX512BW = cpuHasAVX512BW();
+        supportAVX512VNNI = cpuHasAVX512VNNI();
+        supportF16C     = cpuHasF16C();
         return true;
 #endif
     }
@@ -197,6 +248,9 @@ private:
     bool supportAVX    = false;
     bool supportAVX2   = false;
     bool supportAVX512 = false;
+    bool supportAVX512BW = false;
+    bool supportAVX512VNNI = false;
+    bool supportF16C   = false;
 
 #ifdef WIN32
     inline std::array<unsigned int,4> cpuid(int function_id)
@@ -217,6 +271,9 @@ private:
    inline bool cpuHasAVX()     { return 0!=(cpuid(1)[2]&(1<<28)); }
     inline bool cpuHasAVX2()    { return 0!=(cpuid(7)[1]&(1<<5));  }
     inline bool cpuHasAVX512()  { return 0!=(cpuid(7)[1]&(1<<16)); }
+    inline bool cpuHasAVX512BW() { return 0!=(cpuid(7)[1]&(1<<30)); }
+    inline bool cpuHasAVX512VNNI() { return 0!=(cpuid(7)[2]&(1<<11)) && 0!=(cpuid(7)[1]&(1u<<31)); }
+    inline bool cpuHasF16C()    { return 0!=(cpuid(1)[2]&(1<<29)); }
 #endif
 #endif
 
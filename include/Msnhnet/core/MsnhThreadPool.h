@@ -0,0 +1,141 @@
+﻿#ifndef MSNHTHREADPOOL_H
+#define MSNHTHREADPOOL_H
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+/* scalar operations a chunk should at least carry, less than that is not worth waking a thread */
+#define MSNH_PARALLEL_MIN_WORK  16384
+
+/* pause iterations an idle worker spins for the next loop before it sleeps */
+#define MSNH_POOL_SPIN          2000
+
+namespace Msnhnet
+{
+/* Persistent pool for the small element wise loops of the layers (activations, bn, bias, pooling, yolo).
+ * The loop [start, stop) is cut into one range per thread, every thread takes grain sized chunks from the front of its
+ * own range and then steals chunks from the others. The calling thread works too, so a pool of threadNum runs
+ * threadNum - 1 workers, which spin shortly and then sleep between loops.
+ * With a cpu set (linux) worker i is pinned to cpus[i % cpus.size()], and ThreadPoolScope binds the calling thread
+ * and its omp threads to the whole set, so nets on disjoint sets don't share cores.
+ * A loop runs serially on the calling thread when it has no more than grain items, the thread is already inside a pool
+ * loop or an omp region, or another thread is running a loop on the same pool. */
+class MsnhNet_API ThreadPool
+{
+public:
+    explicit ThreadPool(const int &threadNum = 1, const std::vector<int> &cpus = std::vector<int>());
+    ~ThreadPool();
+
+    /* restarts the workers, not while a loop runs on the pool. An empty cpu set lets the threads run anywhere */
+    void setThreadNum(const int &threadNum, const std::vector<int> &cpus = std::vector<int>());
+    int  getThreadNum() const;
+    const std::vector<int> &getCpus() const;
+
+    /* func(begin, end) for chunks of [start, stop), on the current pool of the calling thread */
+    template<typename Func>
+    static void parallelFor(const int &start, const int &stop, const int &grain, const Func &func)
+    {
+        ThreadPool *pool = getCurrent();
+        if(pool == nullptr || !pool->run(start, stop, grain, &ThreadPool::call<Func>, &func))
+        {
+            if(start < stop)
+            {
+                func(start, stop);
+            }
+        }
+    }
+
+    /* grain for items of workPerItem scalar operations each */
+    static inline int grainFor(const int &workPerItem)
+    {
+        return std::max(1, MSNH_PARALLEL_MIN_WORK / std::max(1, workPerItem));
+    }
+
+    /* the pool set for the calling thread, else a process wide pool of OMP_THREAD threads */
+    static ThreadPool *getCurrent();
+    /* returns the pool set before */
+    static ThreadPool *setCurrent(ThreadPool *const &pool);
+
+private:
+    typedef void (*Body)(const void *const &func, const int &begin, const int &end);
+
+    struct Range
+    {
+        std::atomic<int>    next;
+        int                 end     =   0;
+    };
+
+    template<typename Func>
+    static void call(const void *const &func, const int &begin, const int &end)
+    {
+        (*static_cast<const Func*>(func))(begin, end);
+    }
+
+    bool run(const int &start, const int &stop, const int &grain, const Body &body, const void *const &func);
+    void participate(const int &index);
+    void work(const int &index);
+    void startWorkers();
+    void stopWorkers();
+
+    friend class ThreadPoolScope;
+
+    int                         threadNum   =   1;
+    std::vector<int>            cpus;
+#ifdef __linux__
+    cpu_set_t                   cpuSet;
+#endif
+    std::thread                 *workers    =   nullptr;
+    Range                       *ranges     =   nullptr;
+
+    /* the loop being run */
+    Body                        body        =   nullptr;
+    const void                  *func       =   nullptr;
+    int                         rangeNum    =   0;
+    int                         step        =   1;
+    std::atomic<int>            remaining;
+    std::atomic<int>            active;
+    std::atomic<bool>           open;
+    std::atomic<bool>           busy;
+    std::exception_ptr          error;
+    std::mutex                  errorMutex;
+
+    /* workers wait for a new generation */
+    std::atomic<unsigned>       generation;
+    std::atomic<bool>           stopping;
+    int                         sleeping    =   0;
+    std::mutex                  mutex;
+    std::condition_variable     wake;
+};
+
+/* makes pool the current pool of the calling thread and its thread count the omp thread count, with a cpu set also
+ * binds the calling thread and its omp threads to it. Restores all of that when it goes out of scope, a null pool
+ * leaves everything as it is */
+class MsnhNet_API ThreadPoolScope
+{
+public:
+    explicit ThreadPoolScope(ThreadPool *const &pool);
+    ~ThreadPoolScope();
+
+private:
+    ThreadPoolScope(const ThreadPoolScope &);
+    ThreadPoolScope &operator=(const ThreadPoolScope &);
+
+    ThreadPool      *pool           =   nullptr;
+    ThreadPool      *previous       =   nullptr;
+    int             previousThreads =   1;
+    bool            bound           =   false;
+#ifdef __linux__
+    cpu_set_t       previousCpus;
+#endif
+};
+}
+#endif
@@ -0,0 +1,37 @@
+﻿#ifndef MSNHWINOGRAD_H
+#define MSNHWINOGRAD_H
+#include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/core/MsnhGemm.h"
+#include "Msnhnet/core/MsnhBlas.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+#define WINOGRAD_BLOCK_SIZE 262144
+#define WINOGRAD_MIN_TILES  64
+
+namespace Msnhnet
+{
+/* 3x3 stride 1 convolution with Winograd F(2x2,3x3) / F(4x4,3x3).
+ * Transformed weights are stored as (tile+2)^2 GEMM-packed (outChannel x inChannel) blocks,
+ * so every tile position is one Gemm::cpuGemmPrePacked call. */
+class MsnhNet_API Winograd
+{
+public:
+
+    static int selectOutTile(const int &outHeight, const int &outWidth);
+
+    static size_t getTransformedWeightsSize(const int &outTile, const int &outChannel, const int &inChannel);
+
+    static size_t getWorkSpaceSize(const int &outTile, const int &inChannel, const int &outChannel,
+                                   const int &outHeight, const int &outWidth);
+
+    static void transformWeights3x3(const int &outTile, float *const &weights, const int &outChannel,
+                                    const int &inChannel, float *const &transWeights);
+
+    static void conv3x3s1(const int &outTile, float *const &input, const int &inChannel, const int &height, const int &width,
+                          const int &paddingX, const int &paddingY, float *const &transWeights, const int &outChannel,
+                          const int &outHeight, const int &outWidth, float *const &workspace, float *const &output);
+};
+}
+
+#endif
@@ -0,0 +1,38 @@
+﻿#ifndef MSNHMAPPEDFILE_H
+#define MSNHMAPPEDFILE_H
+#include <string>
+#include "Msnhnet/utils/MsnhExport.h"
+
+namespace Msnhnet
+{
+/* read only, shared mapping of a whole file. The pages come from the os page cache, so processes that map the same
+ * msnhbin share one copy and nothing is read until a page is touched */
+class MsnhNet_API MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator= (const MappedFile &) = delete;
+
+    void open(const std::string &path);
+    void close();
+
+    bool isOpen() const;
+    const char *getData() const;
+    size_t getSize() const;
+
+private:
+    const char  *data       =   nullptr;
+    size_t      size        =   0;
+#ifdef _WIN32
+    void        *file       =   nullptr;
+    void        *mapping    =   nullptr;
+#else
+    int         fd          =   -1;
+#endif
+};
+}
+
+#endif
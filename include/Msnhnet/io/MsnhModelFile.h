@@ -0,0 +1,106 @@
+﻿#ifndef MSNHMODELFILE_H
+#define MSNHMODELFILE_H
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+#define MSNH_MODEL_VERSION      1
+#define MSNH_MODEL_HEADER_SIZE  64
+#define MSNH_MODEL_DATA_ALIGN   4096
+#define MSNH_MODEL_TENSOR_ALIGN 64
+#define MSNH_MODEL_HASH_SEED    0xcbf29ce484222325ULL
+#define MSNH_MODEL_MAGIC        "MSNHMODL"
+#define MSNH_PLAN_MAGIC         "MSNHPLAN"
+
+namespace Msnhnet
+{
+/* F32 / F16 / BF16 share their values with WeightStorage */
+enum ModelTensorType
+{
+    TENSOR_F32  = WEIGHT_F32,
+    TENSOR_F16  = WEIGHT_F16,
+    TENSOR_BF16 = WEIGHT_BF16,
+    TENSOR_INT8,
+    TENSOR_INT32
+};
+
+enum ModelTensorLayout
+{
+    TENSOR_PLAIN,           /* row major, the order loadAllWeigths reads */
+    TENSOR_QUANT_STREAM     /* the int8 stream NetBuilder::saveQuantWeights writes */
+};
+
+class MsnhNet_API ModelTensor
+{
+public:
+    std::string         name;
+    int                 group       =   -1;     /* index of the net layer that loads it, -1 if no layer owns it */
+    ModelTensorType     type        =   TENSOR_F32;
+    ModelTensorLayout   layout      =   TENSOR_PLAIN;
+    int                 alignment   =   4;
+    std::vector<int>    shape;
+    uint64_t            offset      =   0;      /* from the start of the data section */
+    uint64_t            bytes       =   0;
+    const void          *data       =   nullptr;
+
+    size_t getElements() const;
+};
+
+/* .msnhmodel container, all integers little endian (a .msnhplan is the same container with "MSNHPLAN"):
+ *  header  magic, u32 version, u32 header size, u64 graph offset, u64 graph size, u64 tensor table offset,
+ *          u32 tensor count, u32 data alignment, u64 data offset, u64 content hash (fnv-1a 64 of everything after the header)
+ *  graph   Parser::serializeParams
+ *  tensors u32 name length, name, u32 group, u32 type, u32 layout, u32 alignment, u32 dims, i32 shape[dims], u64 offset, u64 bytes
+ *  data    starts on a page, every tensor starts on its own alignment */
+class MsnhNet_API ModelFile
+{
+public:
+    static uint64_t hash(const char *const &data, const size_t &size, const uint64_t &seed);
+
+    /* offsets come from the tensor order and alignments, tensor.data / tensor.bytes are written */
+    static void write(const std::string &path, const std::vector<char> &graph, std::vector<ModelTensor> &tensors,
+                      const char *const &magic = MSNH_MODEL_MAGIC);
+
+    /* graph and tensor.data point into data, which must stay alive (a mapping) while they are used */
+    static void read(const char *const &data, const size_t &size, const bool &verifyHash, const char *&graph, size_t &graphSize,
+                     std::vector<ModelTensor> &tensors, uint64_t &contentHash, const char *const &magic = MSNH_MODEL_MAGIC);
+
+    /* content hash from the header only, the file is not mapped */
+    static uint64_t readContentHash(const std::string &path);
+
+    static bool isModelFile(const std::string &path);
+
+    /* a 1-d, MSNH_MODEL_TENSOR_ALIGN aligned tensor over data */
+    static ModelTensor makeTensor(const std::string &name, const int &group, const ModelTensorType &type, const void *const &data, const size_t &elements);
+
+    static const ModelTensor *findTensor(const std::vector<ModelTensor> &tensors, const std::string &name);
+
+    /* copies tensor name into dst (new[] when dst is null), false if it is not bytes long. A missing tensor leaves dst alone */
+    template<typename T>
+    static bool copyTensor(const std::vector<ModelTensor> &tensors, const std::string &name, const size_t &bytes, T *&dst)
+    {
+        const ModelTensor *t = findTensor(tensors, name);
+        if(t == nullptr)
+        {
+            return true;
+        }
+
+        if(t->bytes != bytes)
+        {
+            return false;
+        }
+
+        if(dst == nullptr)
+        {
+            dst = new T[bytes / sizeof(T)]();
+        }
+        memcpy(dst, t->data, bytes);
+        return true;
+    }
+};
+}
+
+#endif
@@ -7,6 +7,9 @@
 #include "Msnhnet/layers/MsnhActivations.h"
 #include "Msnhnet/layers/MsnhYolov3Def.h"
 #include "Msnhnet/utils/MsnhTypes.h"
+#include "Msnhnet/core/MsnhHalf.h"
+#include "Msnhnet/io/MsnhMappedFile.h"
+#include "Msnhnet/io/MsnhModelFile.h"
 #include <string>
 #include <fstream>
 #include "Msnhnet/utils/MsnhExport.h"
@@ -77,6 +80,9 @@ public:
     int             dilationX   =   -1;
     int             dilationY   =   -1;
     int             useBias     =   1; 
+    int             implicitGemm=   -1; 
+    int             binary      =   0;
+    int             xnor        =   0;
 
    ActivationType  activation  =   ActivationType::NONE;
     std::vector<float> actParams;
@@ -291,10 +297,29 @@ public:
 
    std::vector<BaseParams* >   params;
     std::vector<float>          msnhF32Weights;
+    WeightStorage               msnhWeightStorage   =   WEIGHT_F32;
+    /* weights of the last readMsnhBin, points into the mapped file (msnhF32Mapped) or at msnhF32Weights */
+    const float                 *msnhF32Data        =   nullptr;
+    size_t                      msnhF32Num          =   0;
+    bool                        msnhF32Mapped       =   false;
+    MappedFile                  msnhBinFile;
+    /* tensors of the last readMsnhModel, their data points into msnhBinFile */
+    std::vector<ModelTensor>    msnhModelTensors;
+    uint64_t                    msnhModelHash       =   0;
 
    void clearParams();
     void readCfg(const std::string &path);
+
+   /* a msnhbin is either raw little endian float32, or a typed file: "MSWB", uint32 WeightStorage, then the weights
+     * in that type. Float32 files are mapped and used in place, typed weights are widened to float32 in msnhF32Weights */
     void readMsnhBin(const std::string &path);
+    void clearMsnhBin();
+
+   /* a .msnhmodel (and a .msnhplan, read with MSNH_PLAN_MAGIC) holds the serialized params, so the yaml parser is skipped */
+    void readMsnhModel(const std::string &path, const bool &verifyHash, const char *const &magic = MSNH_MODEL_MAGIC);
+    void serializeParams(std::vector<char> &graph) const;
+    void deserializeParams(const char *const &graph, const size_t &size);
+    static void convertMsnhBin(const std::string &srcPath, const std::string &dstPath, const WeightStorage &storage);
 
    void parseConfigParams(NetConfigParams *netConfigParams, YAML::const_iterator &iter);
     void parseMaxPoolParams(MaxPoolParams *maxPoolParams, YAML::const_iterator &iter);
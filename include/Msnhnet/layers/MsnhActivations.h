@@ -3,6 +3,8 @@
 #include <math.h>
 #include "Msnhnet/config/MsnhnetCfg.h"
 #include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/core/MsnhThreadPool.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
 namespace Msnhnet
@@ -3,6 +3,8 @@
 #include "Msnhnet/config/MsnhnetCfg.h"
 #include "Msnhnet/net/MsnhNetwork.h"
 #include "Msnhnet/core/MsnhSimd.h"
+#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/core/MsnhThreadPool.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
 namespace Msnhnet
@@ -16,7 +18,10 @@ public:
 
    static bool     supportAvx;
     static bool     supportFma;
+    static bool     supportVnni;
+    static bool     supportF16c;
     static bool     isPreviewMode;
+    static bool     useConcurrentBranches;
 
    LayerType       type;                       
 
@@ -51,12 +56,23 @@ public:
 
    float           forwardTime     =  0;
 
+   int             nchwc           =  0;
+    int             ownOutput       =  1;
+
    static void setPreviewMode(const bool &isPreviewMode);
+    static void setUseConcurrentBranches(const bool &concurrentBranches);
 
    virtual void forward(NetworkState &netState);
-    virtual void loadAllWeigths(std::vector<float> &weights);
+    /* mapped: weights point into a read only msnhbin mapping that outlives the layer, it may be used in place */
+    virtual void loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped);
+    virtual bool supportNCHWc();
 
    static void initSimd();
+
+   /* runs block branches that all read netState.input. concurrent: one branch per thread at a time, each with a share of
+     * the threads by its bFlops and its own branchWorkSpace floats of the workspace */
+    static void forwardBranches(std::vector<BaseLayer*> *const *branches, const size_t &branchNum, NetworkState &netState,
+                                const bool &concurrent, const size_t &branchWorkSpace);
     inline void releaseArr(void * value)
     {
         if(value!=nullptr)
@@ -2,9 +2,11 @@
 #define MSNHBATCHNORMLAYER_H
 
 #include "Msnhnet/core/MsnhBlas.h"
+#include "Msnhnet/core/MsnhNCHWc.h"
 #include "Msnhnet/net/MsnhNetwork.h"
 #include "Msnhnet/layers/MsnhBaseLayer.h"
 #include "Msnhnet/layers/MsnhActivations.h"
+#include "Msnhnet/io/MsnhModelFile.h"
 #include <stdlib.h>
 #include "Msnhnet/utils/MsnhExport.h"
 
@@ -27,18 +29,23 @@ public:
     int         nRollVariance       =   0;
 
    virtual void forward(NetworkState &netState);
+    virtual bool supportNCHWc();
 
    static void addBias(float *const &output, float *const &biases, const int &batch, const int &channel, const int &whSize);
     static void scaleBias(float *const &output, float *const &scales, const int &batch, const int &channel, const int &whSize);
 
    void resize(int width, int height);
 
-   void loadAllWeigths(std::vector<float> &weights);
+   void loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped);
 
-   void loadScales(float *const &weights, const int& len);
-    void loadBias(float *const &bias, const int& len);
-    void loadRollMean(float *const &rollMean, const int& len);
-    void loadRollVariance(float *const &rollVariance, const int& len);
+   /* see ConvolutionalLayer::getPlanTensors, bn keeps its arrays as loaded */
+    void getPlanTensors(std::vector<ModelTensor> &tensors);
+    bool loadPlanTensors(const std::vector<ModelTensor> &tensors);
+
+   void loadScales(const float *const &weights, const int& len);
+    void loadBias(const float *const &bias, const int& len);
+    void loadRollMean(const float *const &rollMean, const int& len);
+    void loadRollVariance(const float *const &rollVariance, const int& len);
     ~BatchNormLayer();
 };
 }
@@ -30,8 +30,15 @@ public:
 
    std::vector<std::vector<BaseLayer *>> branchLayers;
     float       *activationInput    =   nullptr;
+    /* the branches as forwardBranches takes them, run at once on slices of branchWorkSpace floats */
+    std::vector<std::vector<BaseLayer *>*> branchRefs;
+    int         concurrentBranches  =   0;
+    size_t      branchWorkSpace     =   0;
+    int         branchInPlace       =   0;
 
-   void loadAllWeigths(std::vector<float> &weights);
+   void loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped);
+
+   void bindBranchOutputs();
 
    virtual void forward(NetworkState &netState);
 
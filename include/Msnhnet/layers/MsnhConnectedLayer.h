@@ -4,6 +4,7 @@
 #include "Msnhnet/layers/MsnhActivations.h"
 #include "Msnhnet/core/MsnhBlas.h"
 #include "Msnhnet/core/MsnhGemm.h"
+#include "Msnhnet/core/MsnhQuant.h"
 #include "Msnhnet/layers/MsnhConvolutionalLayer.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
@@ -14,11 +15,16 @@ class MsnhNet_API ConnectedLayer : public BaseLayer
 {
 public:
     ConnectedLayer(const int &batch, const int &steps, const int &inputNum, const int &outputNum,
-                   const ActivationType &activation, const std::vector<float> &actParams, const int &batchNorm);
+                   const ActivationType &activation, const std::vector<float> &actParams, const int &batchNorm, const NetOptions &options);
 
    ~ConnectedLayer();
 
+   /* see ConvolutionalLayer::options */
+    NetOptions  options;
+
    float       *weights            =   nullptr;
+    /* weights points into the mapped msnhbin / msnhplan or the builder's layer, it is read only and not owned */
+    int         mappedWeights       =   0;
     float       *biases             =   nullptr;
     float       *scales             =   nullptr;
     float       *rollMean           =   nullptr;
@@ -38,15 +44,41 @@ public:
     int         dilation            =   0;
     int         batchNorm           =   0;
 
+    /* int8 weights packed by Quant::packGemv */
+    int8_t      *int8Weights        =   nullptr;
+    float       *int8Scales         =   nullptr;
+    int32_t     *int8Sums           =   nullptr;
+    float       inputScale          =   1.f;
+    int         inputZeroPoint      =   0;
+    QuantObserver *inputObserver    =   nullptr;
+    /* int8 / half weights point into a mapped msnhplan or the builder's layer, they are read only and not owned */
+    int         mappedPacked        =   0;
+
+    /* fp16 / bf16 weights, outputNum x inputNum row major like weights */
+    uint16_t    *halfWeights        =   nullptr;
+    WeightStorage halfStorage       =   WEIGHT_F32;
+
    virtual void forward(NetworkState &netState);
 
-   void loadAllWeigths(std::vector<float> &weights);
+   void loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped);
+
+    bool supportInt8();
+    void quantizeInt8(const QuantCalibration &method, const float &percentile);
+    void setInt8Weights(const int8_t *const &q, const float *const &scales, const float &inScale, const int &inZeroPoint);
+    void getInt8Weights(int8_t *const &q);
+    bool supportHalfWeights();
+    void releasePacked();
+
+   /* see ConvolutionalLayer::getPlanTensors */
+    void getPlanTensors(std::vector<ModelTensor> &tensors, std::vector<int32_t> &state);
+    bool loadPlanTensors(const std::vector<ModelTensor> &tensors, const bool &mapped);
 
-   void loadScales(float *const &weights, const int& len);
-    void loadBias(float *const &bias, const int& len);
-    void loadWeights(float *const &weights, const int& len);
-    void loadRollMean(float *const &rollMean, const int& len);
-    void loadRollVariance(float *const &rollVariance, const int& len);
+   void loadScales(const float *const &weights, const int& len);
+    void loadBias(const float *const &bias, const int& len);
+    void loadWeights(const float *const &weights, const int& len);
+    void releaseWeights();
+    void loadRollMean(const float *const &rollMean, const int& len);
+    void loadRollVariance(const float *const &rollVariance, const int& len);
 };
 }
 
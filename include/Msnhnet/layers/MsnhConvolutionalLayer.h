@@ -2,11 +2,19 @@
 #define MSNHCONVOLUTIONALLAYER_H
 #include "Msnhnet/core/MsnhBlas.h"
 #include "Msnhnet/core/MsnhGemm.h"
+#include "Msnhnet/core/MsnhWinograd.h"
+#include "Msnhnet/core/MsnhDepthwiseConv.h"
+#include "Msnhnet/core/MsnhNCHWc.h"
+#include "Msnhnet/core/MsnhQuant.h"
+#include "Msnhnet/io/MsnhModelFile.h"
 #include "Msnhnet/layers/MsnhBaseLayer.h"
 #include "Msnhnet/layers/MsnhActivations.h"
 #include "Msnhnet/layers/MsnhBatchNormLayer.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
+/* batches whose total gemm N (batch * outHeight * outWidth) is at most this run as one gemm over all images */
+#define CONV_FOLD_MAX_N 2048
+
 namespace Msnhnet
 {
 class MsnhNet_API ConvolutionalLayer:public BaseLayer
@@ -16,10 +24,16 @@ public:
    ConvolutionalLayer(const int &batch, const int &steps, const int &height, const int &width, const int &channel, const int &num, const int &groups,
                       const int &kSizeX, const int &kSizeY, const int &strideX, const int &strideY, const int &dilationX, const int &dilationY, const int &paddingX, const int &paddingY, ActivationType activation, const std::vector<float> &actParams,
                       const int &batchNorm,  const int &useBias, const int &binary, const int &xnor, const int &useBinOutput, const int &groupIndex,
-                      const int &antialiasing, ConvolutionalLayer *const &shareLayer, const int &assistedExcitation, const int &deform);
+                      const int &antialiasing, ConvolutionalLayer *const &shareLayer, const int &assistedExcitation, const int &deform,
+                      const NetOptions &options, const int &implicitGemm = -1);
     ~ConvolutionalLayer();
 
+   /* the builder flags of the net this layer was built for, they pick its kernels and what loading does */
+    NetOptions  options;
+
    float       *weights            =   nullptr;
+    /* weights points into the mapped msnhbin / msnhplan or the builder's layer, it is read only and not owned */
+    int         mappedWeights       =   0;
     float       *biases             =   nullptr;
     ConvolutionalLayer* shareLayer  =   nullptr;
 
@@ -35,6 +49,37 @@ public:
     uint32_t    *binRePackedIn      =   nullptr;
     char        *tBitInput          =   nullptr;
     char        *alignBitWeights    =   nullptr;
+    int         *bitTapSums         =   nullptr;
+
+    float       *packedWeights      =   nullptr;
+    size_t      packedGroupSize     =   0;
+    /* packed / winograd / nchwc / half / int8 weights point into a mapped msnhplan or the builder's layer of an
+     * execution context, they are read only and not owned */
+    int         mappedPacked        =   0;
+
+    float       *winogradWeights    =   nullptr;
+    int         winogradOutTile     =   0;
+    int         useDepthwise3x3     =   0;
+    int         useImplicitGemm     =   0;
+    float       *nchwcWeights       =   nullptr;
+    int         bnFolded            =   0;
+
+    /* set by a fused res block: output = postActivation(output + residualInput) */
+    float       *residualInput      =   nullptr;
+    ActivationType postActivation   =   ActivationType::NONE;
+    float       postActParam        =   0.1f;
+
+    /* int8 weights packed by Quant::packA, filled by NetBuilder::calibrate or NetBuilder::loadQuantWeights */
+    int8_t      *int8Weights        =   nullptr;
+    float       *int8Scales         =   nullptr;
+    int32_t     *int8Sums           =   nullptr;
+    float       inputScale          =   1.f;
+    int         inputZeroPoint      =   0;
+    QuantObserver *inputObserver    =   nullptr;
+
+    /* fp16 / bf16 weights packed by Gemm::cpuGemmPackAHalf, used instead of packedWeights */
+    uint16_t    *halfWeights        =   nullptr;
+    WeightStorage halfStorage       =   WEIGHT_F32;
 
    int         bitAlign            =   0;
     int         ldaAlign            =   0;
@@ -75,6 +120,7 @@ public:
    int getConvWorkSpaceSize();
     int getWorkSpaceSize32();
     int getWorkSpaceSize16();
+    bool foldBatch();
 
    static void  addBias(float *const &output, float *const &biases, const int &batch, const int &num, const int &whSize);
     static void  scaleBias(float *const &output, float *const &scales, const int &batch, const int &num, const int &whSize);
@@ -82,15 +128,35 @@ public:
    void binarizeWeights(float *const &weights, const int &num, const int &wtSize, float *const &binary);
     void cpuBinarize(float *const &x, const int &xNum, float *const &binary);
     void swapBinary();
+    void packBitWeights();
 
    void forward(NetworkState &netState);
-    void loadAllWeigths(std::vector<float> &weights);
-
-   void loadScales(float *const &weights, const int& len);
-    void loadBias(float *const &bias, const int& len);
-    void loadWeights(float *const &weights, const int& len);
-    void loadRollMean(float * const &rollMean, const int &len);
-    void loadRollVariance(float * const &rollVariance, const int &len);
+    void loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped);
+    void prePackWeights();
+    void transformWinogradWeights();
+    void foldBatchNorm();
+    void packNCHWcWeights();
+    bool supportNCHWc();
+    bool supportInt8();
+    void quantizeInt8(const QuantCalibration &method, const float &percentile);
+    void setInt8Weights(const int8_t *const &q, const float *const &scales, const float &inScale, const int &inZeroPoint);
+    void getInt8Weights(int8_t *const &q);
+    bool supportHalfWeights();
+    void packHalfWeights();
+    void releasePacked();
+
+   /* the weights as they are after loading (folded, packed, transformed), appended to tensors for NetBuilder::savePlan.
+     * state keeps the scalars and must outlive tensors */
+    void getPlanTensors(std::vector<ModelTensor> &tensors, std::vector<int32_t> &state);
+    /* false if the plan was made for other kernels than this layer picked */
+    bool loadPlanTensors(const std::vector<ModelTensor> &tensors, const bool &mapped);
+
+   void loadScales(const float *const &weights, const int& len);
+    void loadBias(const float *const &bias, const int& len);
+    void loadWeights(const float *const &weights, const int& len);
+    void releaseWeights();
+    void loadRollMean(const float *const &rollMean, const int &len);
+    void loadRollVariance(const float *const &rollVariance, const int &len);
 };
 }
 
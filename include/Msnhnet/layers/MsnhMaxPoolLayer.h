@@ -1,6 +1,7 @@
 ﻿#ifndef MSNHMAXPOOLLAYER_H
 #define MSNHMAXPOOLLAYER_H
 #include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/core/MsnhNCHWc.h"
 #include "Msnhnet/layers/MsnhBaseLayer.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
@@ -26,12 +27,12 @@ public:
     int         ceilMode            =   0;
 
    virtual void forward(NetworkState &netState);
+    virtual bool supportNCHWc();
 
-#ifdef USE_X86
-    void forwardAvx(float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY, const int &width,
-                    const int &height, const int &outWidth, const int &outHeight, const int &channel, const int &paddingX,
-                    const int &paddingY, const int &stride, const int &batch);
-#endif
+    /* channel planes go to the kernel table's pooling, see Kernels */
+    void forwardSimd(float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY, const int &width,
+                     const int &height, const int &outWidth, const int &outHeight, const int &channel, const int &paddingX,
+                     const int &paddingY, const int &stride, const int &batch);
 
    ~MaxPoolLayer();
 
@@ -32,8 +32,12 @@ public:
    std::vector<BaseLayer *> baseLayers;
     std::vector<BaseLayer *> branchLayers;
     float       *activationInput    =   nullptr;
+    /* the branches as forwardBranches takes them, run at once on slices of branchWorkSpace floats */
+    std::vector<std::vector<BaseLayer *>*> branchRefs;
+    int         concurrentBranches  =   0;
+    size_t      branchWorkSpace     =   0;
 
-   void loadAllWeigths(std::vector<float> &weights);
+   void loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped);
 
    virtual void forward(NetworkState &netState);
 
@@ -27,8 +27,11 @@ class MsnhNet_API ResBlockLayer : public BaseLayer
 public:
     ResBlockLayer(const int &batch, NetBuildParams &params, std::vector<BaseParams*> &baseParams, ActivationType &activation, const std::vector<float> &actParams);
     float       *activationInput    =   nullptr;
+    int         residualFused       =   0;
 
-   void loadAllWeigths(std::vector<float> &weights);
+   void loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped);
+
+   void fuseResidual();
 
    std::vector<BaseLayer *> baseLayers;
 
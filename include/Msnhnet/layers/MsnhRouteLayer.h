@@ -17,6 +17,7 @@ public:
 
    std::vector<int>inputLayerIndexes;
     std::vector<int>inputLayerOutputs;
+    std::vector<int>inputInPlace;
     int         groups              =   0;
     int         groupIndex          =   0;
 
@@ -3,6 +3,7 @@
 
 #include "Msnhnet/config/MsnhnetCfg.h"
 #include "Msnhnet/core/MsnhBlas.h"
+#include "Msnhnet/core/MsnhNCHWc.h"
 #include "Msnhnet/layers/MsnhBaseLayer.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
@@ -17,6 +18,7 @@ public:
     float       scale       =   1.f;
 
    virtual void forward(NetworkState &netState);
+    virtual bool supportNCHWc();
     void resize(const int &width, const int &height);
 };
 }
@@ -0,0 +1,60 @@
+﻿#ifndef MSNHBATCHSERVER_H
+#define MSNHBATCHSERVER_H
+
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "Msnhnet/net/MsnhNetBuilder.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+namespace Msnhnet
+{
+/* Dynamic batching in front of a loaded net. Single image requests from any number of threads are queued, a worker
+ * takes up to maxBatch of them once maxBatch are waiting or the oldest one waited maxDelayUs, runs them as one batched
+ * forward and hands every image its own result through the future.
+ * Each worker owns execution contexts for batch 1, 2, 4 .. maxBatch (weights shared with the builder), a batch runs on
+ * the smallest context it fits and the unused images of that context are zero. The builder must outlive the server. */
+class MsnhNet_API BatchServer
+{
+public:
+    BatchServer(NetBuilder *const &builder, const int &maxBatch, const int &maxDelayUs = 2000, const int &workers = 1);
+    ~BatchServer();
+
+    std::future<std::vector<float>> submitClassify(std::vector<float> img);
+    std::future<std::vector<Yolov3Box>> submitYolov3(std::vector<float> img);
+
+    /* finishes the queued requests and joins the workers, later submits throw */
+    void stop();
+    float getMeanBatchSize();
+
+    int             maxBatch            =   1;
+    int             maxDelayUs          =   0;
+    int             inputNum            =   0;
+    bool            yolo                =   false;
+    size_t          batchCount          =   0;
+    size_t          imageCount          =   0;
+
+private:
+    struct Request
+    {
+        std::vector<float>                          img;
+        std::promise<std::vector<float>>            classify;
+        std::promise<std::vector<Yolov3Box>>        boxes;
+        std::chrono::steady_clock::time_point       time;
+    };
+
+    void submit(Request &request);
+    void work(const std::vector<ExecutionContext*> &contexts);
+
+    NetBuilder                                  *builder;
+    std::vector<std::vector<ExecutionContext*>> contexts;
+    std::vector<std::thread>                    workers;
+    std::deque<Request>                         requests;
+    std::mutex                                  mutex;
+    std::condition_variable                     wake;
+    bool                                        stopped     =   false;
+};
+}
+#endif
@@ -0,0 +1,36 @@
+﻿#ifndef MSNHEXECUTIONCONTEXT_H
+#define MSNHEXECUTIONCONTEXT_H
+
+#include "Msnhnet/net/MsnhNetwork.h"
+#include "Msnhnet/layers/MsnhYolov3OutLayer.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+namespace Msnhnet
+{
+/* Everything one inference writes: its own layers (outputs, scratch, timing), workspace, layout buffer and arena.
+ * Contexts are created by NetBuilder::createContext, their weight arrays point into the builder's layers, so any
+ * number of contexts (and the builder itself) can run at the same time from different threads. */
+class MsnhNet_API ExecutionContext
+{
+public:
+    ExecutionContext();
+    ~ExecutionContext();
+
+    std::vector<float> runClassify(std::vector<float> img);
+    std::vector<std::vector<Yolov3Box>> runYolov3(std::vector<float> img);
+    float getInferenceTime();
+
+    static std::vector<float> runClassify(Network *const &net, NetworkState *const &netState, std::vector<float> img);
+    static std::vector<std::vector<Yolov3Box>> runYolov3(Network *const &net, NetworkState *const &netState, std::vector<float> img);
+    static void  reorderInput(Network *const &net, NetworkState *const &netState, const size_t &index, int &blocked);
+    /* layers [begin, end) from netState.input, blocked is the layout of netState.input and then of the last output */
+    static void  forwardLayers(Network *const &net, NetworkState *const &netState, const size_t &begin, const size_t &end, int &blocked);
+    static std::vector<float> getOutput(Network *const &net, NetworkState *const &netState, const int &blocked);
+    static float getInferenceTime(Network *const &net);
+    static void  clearLayers(Network *const &net);
+
+    Network         *net;
+    NetworkState    *netState;
+};
+}
+#endif
@@ -2,6 +2,7 @@
 #define MSNHNETBUILDER_H
 
 #include "Msnhnet/net/MsnhNetwork.h"
+#include "Msnhnet/net/MsnhExecutionContext.h"
 #include "Msnhnet/io/MsnhParser.h"
 #include "Msnhnet/layers/MsnhActivationLayer.h"
 #include "Msnhnet/layers/MsnhBatchNormLayer.h"
@@ -24,6 +25,8 @@
 #include "Msnhnet/io/MsnhIO.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
+#define MSNH_PLAN_VERSION   1
+
 namespace Msnhnet
 {
 class NetBuildParams
@@ -34,6 +37,7 @@ public:
     int height      =   0;
     int width       =   0;
     int channels    =   0;
+    NetOptions options;
 };
 
 class MsnhNet_API NetBuilder
@@ -43,18 +47,75 @@ public:
     ~NetBuilder();
     void buildNetFromMsnhNet(const std::string &path);
     void loadWeightsFromMsnhBin(const std::string &path);
+    /* graph and weights from one .msnhmodel, without yaml parsing. Float32 weights are used in place like a mapped msnhbin.
+     * With a plan cache dir the loaded net (folded / packed / transformed weights, kernel choice, arena offsets) is kept
+     * in <dir>/<key>.msnhplan, the key hashes the model, the cpu features and the builder flags. A hit skips all of that work */
+    void buildNetFromMsnhModel(const std::string &path, const bool &verifyHash = false);
+    static void convertMsnhModel(const std::string &msnhnetPath, const std::string &msnhbinPath, const std::string &dstPath,
+                                 const WeightStorage &storage = WEIGHT_F32, const std::string &quantPath = "");
     void setPreviewMode(const bool &mode);
+    void setPrePackWeights(const bool &prePack);
+    void setUseWinograd(const bool &winograd);
+    void setUseImplicitGemm(const bool &implicitGemm);
+    void setUseNCHWc(const bool &useNCHWc);
+    void setUseMemoryPlanner(const bool &memoryPlanner);
+    void setUseConcatViews(const bool &concatViews);
+    void setUseMappedWeights(const bool &mappedWeights);
+    void setPlanCacheDir(const std::string &dir);
+    void setUseBatchNormFolding(const bool &batchNormFolding);
+    void setUseEpilogueFusion(const bool &epilogueFusion);
+    void setUseResidualFusion(const bool &residualFusion);
+    void setUseInt8(const bool &int8);
+    void setWeightStorage(const WeightStorage &storage);
+    /* threads of this net and its contexts: the pool of the layer loops and the omp threads of gemm, im2col and the
+     * layer kernels. With cpus (linux) all of them run on those cores only while the net infers, so nets hosted in one
+     * process on disjoint sets don't compete. Defaults to MSNH_DEFAULT_THREADS on any core, not while it infers */
+    void setThreadNum(const int &threadNum, const std::vector<int> &cpus = std::vector<int>());
+    int  getThreadNum();
+    std::vector<int> getCpus();
+    void calibrate(const std::vector<std::vector<float>> &images, const QuantCalibration &method = QUANT_PERCENTILE, const float &percentile = 0.9999f);
+    void saveQuantWeights(const std::string &path);
+    void loadQuantWeights(const std::string &path);
+    void loadQuantWeights(const char *const &data, const size_t &size);
     std::vector<float> runClassify(std::vector<float> img);
     std::vector<std::vector<Yolov3Box>> runYolov3(std::vector<float> img);
+    /* a context for one more concurrent inference, owned by the builder. It rebuilds the graph with its own outputs and
+     * scratch (for batch images, 0 keeps the net's batch) and shares the loaded weights, so build / load / calibrate
+     * first. It is built with the net's own flags, setters called since then only apply to the next build */
+    ExecutionContext *createContext(const int &batch = 0);
+    void releaseContext(ExecutionContext *const &context);
 
    void  clearLayers();
+    /* the net keeps a copy of options, everything built and loaded for it reads that copy */
+    void  buildNetFromParams(Network *const &net, NetworkState *const &netState, const NetOptions &options, const int &batch = 0);
+    void  loadWeightsFromMsnhModel();
+    uint64_t getPlanKey(const uint64_t &modelHash);
+    std::string getPlanPath(const uint64_t &key);
+    void  savePlan(const std::string &path, const uint64_t &key);
+    bool  loadPlan(const std::string &path, const uint64_t &key, const bool &verifyHash);
+    void  planLayout(Network *const &net);
+    void  planConcat(Network *const &net);
+    void  planMemory(Network *const &net, NetworkState *const &netState);
+    void  bindConcatViews(Network *const &net);
+    void  fuseLayers(Network *const &net);
     float getInferenceTime();
     std::string getLayerDetail();
     std::string getTimeDetail();
+    std::string getMemoryDetail();
 
    Parser          *parser;
     Network         *net;
     NetworkState    *netState;
+    std::vector<ExecutionContext*> contexts;
+    ThreadPool      *threadPool;
+
+   /* the flags the next build copies into its net, a built net keeps its own in net->options */
+    NetOptions      options;
+    bool            useMemoryPlanner    =   true;
+    bool            useConcatViews      =   true;
+    bool            useMappedWeights    =   true;
+    std::string     planCacheDir        =   "";
+    bool            planLoaded          =   false;
 };
 }
 #endif 
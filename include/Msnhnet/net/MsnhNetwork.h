@@ -1,12 +1,31 @@
 ﻿#ifndef MSNHNETWORK_H
 #define MSNHNETWORK_H
+#include "Msnhnet/config/MsnhnetCfg.h"
 #include "Msnhnet/layers/MsnhBaseLayer.h"
+#include "Msnhnet/core/MsnhThreadPool.h"
 #include "Msnhnet/utils/MsnhExport.h"
 
 namespace Msnhnet
 {
 class BaseLayer;
 class NetworkState;
+
+/* the NetBuilder flags a net is built with. The builder copies its own into the Network, the conv / connected layers
+ * keep the copy they were constructed with, so nets of one process don't share them */
+class NetOptions
+{
+public:
+    bool            usePrePackedWeights =   false;
+    bool            useWinograd         =   true;
+    bool            useImplicitGemm     =   false;
+    bool            useNCHWc            =   false;
+    bool            useBatchNormFolding =   true;
+    bool            useEpilogueFusion   =   true;
+    bool            useResidualFusion   =   true;
+    bool            useInt8             =   false;
+    WeightStorage   weightStorage       =   WEIGHT_F32;
+};
+
 class Network
 {
 public:
@@ -26,6 +45,14 @@ public:
 
    float          *output          =  nullptr; 
 
+   size_t          naiveOutputSize     =   0;
+    size_t          plannedOutputSize   =   0;
+
+   /* owned by the builder, shared with its contexts */
+    ThreadPool      *threadPool         =   nullptr;
+
+   NetOptions      options;
+
    void forward(NetworkState &netState);
 };
 
@@ -43,6 +70,13 @@ public:
 
    float           *workspace      =  nullptr; 
 
+   float           *layoutBuffer   =  nullptr; 
+
+   float           *memoryArena    =  nullptr; 
+
+   /* > 0 while NetBuilder::calibrate runs this net, the pass the int8 layers feed their observers for */
+    int             calibrationPass =  0;
+
    inline void releaseArr(float * value)
     {
         if(value!=nullptr)
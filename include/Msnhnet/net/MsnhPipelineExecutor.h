@@ -0,0 +1,98 @@
+﻿#ifndef MSNHPIPELINEEXECUTOR_H
+#define MSNHPIPELINEEXECUTOR_H
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "Msnhnet/net/MsnhNetBuilder.h"
+#include "Msnhnet/utils/MsnhExport.h"
+
+namespace Msnhnet
+{
+/* Pipeline parallel execution for streams (video), built for sustained frames per second rather than latency.
+ * net->layers is cut into stageNum stages of about equal bFlops, every stage has its own thread (pinned to its own group
+ * of threadsPerStage cores of the builder's cpu set, or of all cores, on linux) whose layers run with threadsPerStage omp
+ * and pool threads. Consecutive frames stream
+ * through the stages in submit order. Every frame in flight owns an execution context (weights shared with the builder),
+ * stageNum + 1 of them, so a stage starts the next frame while the following stage still reads its last output.
+ * A frame may be submitted as a preprocess function instead of an image, the preprocessing thread runs those in submit
+ * order while the earlier frames are in the stages, and the caller post processes the frames it got back meanwhile.
+ * With maxInFlight > 0 a submit blocks while that many frames are unfinished, so a fast source can't queue up frames.
+ * The builder must outlive the executor. */
+class MsnhNet_API PipelineExecutor
+{
+public:
+    PipelineExecutor(NetBuilder *const &builder, const int &stageNum, const int &threadsPerStage = 0, const int &maxInFlight = 0);
+    ~PipelineExecutor();
+
+    std::future<std::vector<float>> submitClassify(std::vector<float> img);
+    std::future<std::vector<Yolov3Box>> submitYolov3(std::vector<float> img);
+    /* preprocess returns the input image, it runs on the preprocessing thread */
+    std::future<std::vector<float>> submitClassify(std::function<std::vector<float>()> preprocess);
+    std::future<std::vector<Yolov3Box>> submitYolov3(std::function<std::vector<float>()> preprocess);
+
+    /* finishes the frames in flight and joins the stages, later submits throw */
+    void stop();
+
+    /* finished frames per second and the busy share of every stage, both since the first submit */
+    float getThroughput();
+    std::vector<float> getStageUtilization();
+    std::string getStageDetail();
+
+    int                 stageNum            =   1;
+    int                 threadsPerStage     =   1;
+    int                 inputNum            =   0;
+    int                 maxInFlight         =   0;
+    bool                yolo                =   false;
+    size_t              frameCount          =   0;
+
+    /* layers [stageBegin[s], stageBegin[s+1]) are stage s */
+    std::vector<size_t> stageBegin;
+    std::vector<float>  stageFlops;
+    std::vector<std::vector<int>> stageCpus;
+
+private:
+    struct Frame
+    {
+        std::vector<float>                          img;
+        std::function<std::vector<float>()>         preprocess;
+        std::promise<std::vector<float>>            classify;
+        std::promise<std::vector<Yolov3Box>>        boxes;
+        std::vector<float>                          output;
+        std::vector<Yolov3Box>                      result;
+        ExecutionContext                            *context    =   nullptr;
+        int                                         blocked     =   0;
+        std::exception_ptr                          error;
+    };
+
+    void submit(Frame *const &frame);
+    void runPreprocess();
+    void runStage(const int &stage);
+    /* collect copies the result out of the context before it is reused, deliver hands it to the future */
+    void collect(Frame *const &frame);
+    void deliver(Frame *const &frame);
+
+    NetBuilder                                  *builder;
+    std::vector<ExecutionContext*>              contexts;
+    std::deque<ExecutionContext*>               freeContexts;
+    std::deque<Frame*>                          pending;
+    std::vector<std::deque<Frame*>>             queues;
+    std::vector<int>                            stageDone;
+    std::vector<double>                         stageBusy;
+    std::thread                                 preprocessor;
+    std::vector<std::thread>                    stages;
+    std::mutex                                  mutex;
+    std::condition_variable                     wake;
+    bool                                        stopped     =   false;
+    bool                                        preDone     =   false;
+    size_t                                      inFlight    =   0;
+    size_t                                      submitCount =   0;
+    std::chrono::steady_clock::time_point       firstSubmit;
+    std::chrono::steady_clock::time_point       lastFinish;
+};
+}
+#endif
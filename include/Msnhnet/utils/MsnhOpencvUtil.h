@@ -6,6 +6,7 @@
 #include <opencv2/core.hpp>
 #include "MsnhException.h"
 #include "Msnhnet/config/MsnhnetCfg.h"
+#include "Msnhnet/core/MsnhThreadPool.h"
 #include "Msnhnet/utils/MsnhExport.h"
 #include "Msnhnet/layers/MsnhYolov3Def.h"
 #include "Msnhnet/layers/MsnhYolov3OutLayer.h"
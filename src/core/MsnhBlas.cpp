@@ -3,32 +3,32 @@
 namespace Msnhnet
 {
 
-void Blas::cpuCopy(const int &inputN, float *const &input, const int &inputStep,
+void Blas::cpuCopy(const int &inputN, const float *const &input, const int &inputStep,
                    float *const &output, const int &outputStep)
 {
 #ifdef USE_OPEN_BLAS
     cblas_scopy(inputN, input, inputStep, output, outputStep);
 #else
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for(int i=0; i < inputN ; ++i)
+    ThreadPool::parallelFor(0, inputN, ThreadPool::grainFor(1), [&](const int &iBegin, const int &iEnd)
     {
-        output[i*outputStep] = input[i*inputStep];
-    }
+        for (int i = iBegin; i < iEnd; ++i)
+        {
+            output[i*outputStep] = input[i*inputStep];
+        }
+    });
 #endif
 }
 
 void Blas::cpuFill(const int &inputN, const float &alpha, float *const &x, const int &step)
 {
 
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for(int i=0; i<inputN; i++)
+    ThreadPool::parallelFor(0, inputN, ThreadPool::grainFor(1), [&](const int &iBegin, const int &iEnd)
     {
-        x[i*step] = alpha;
-    }
+        for (int i = iBegin; i < iEnd; ++i)
+        {
+            x[i*step] = alpha;
+        }
+    });
 }
 
 void Blas::cpuAxpy(const int &inputN, const float &alpha, float *const &x,
@@ -84,13 +84,13 @@ void Blas::cpuScale(const int &inputN, const float &alpha, float *const &x, cons
 #ifdef USE_OPEN_BLAS
     cblas_sscal(inputN, alpha, x, stepX);
 #else
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for(int i=0; i<inputN; i++)
+    ThreadPool::parallelFor(0, inputN, ThreadPool::grainFor(1), [&](const int &iBegin, const int &iEnd)
     {
-        x[i*stepX] = x[i*stepX] * alpha;
-    }
+        for (int i = iBegin; i < iEnd; ++i)
+        {
+            x[i*stepX] = x[i*stepX] * alpha;
+        }
+    });
 #endif
 }
 
@@ -315,29 +315,29 @@ void Blas::cpuUpSample(float * const &in, const int &width, const int &height, c
 {
     for (int b = 0; b < batch; ++b)
     {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-        for (int k = 0; k < channel; ++k)
+        ThreadPool::parallelFor(0, channel, ThreadPool::grainFor(width*height*stride*stride), [&](const int &kBegin, const int &kEnd)
         {
-            for (int j = 0; j < height * stride; ++j)
+            for (int k = kBegin; k < kEnd; ++k)
             {
-                for (int i = 0; i < width * stride; ++i)
+                for (int j = 0; j < height * stride; ++j)
                 {
-                    int inIndex     =   b*width*height*channel + k*width*height + (j/stride)*width + i/stride;
-                    int outIndex    =   b*width*height*channel*stride*stride + k*width*height*stride*stride + j*width*stride + i;
-
-                   if(forward)
+                    for (int i = 0; i < width * stride; ++i)
                     {
-                        out[outIndex]   =   scale*in[inIndex];
-                    }
-                    else
-                    {
-                        in[inIndex]     +=  scale*out[outIndex];
+                        int inIndex     =   b*width*height*channel + k*width*height + (j/stride)*width + i/stride;
+                        int outIndex    =   b*width*height*channel*stride*stride + k*width*height*stride*stride + j*width*stride + i;
+
+                       if(forward)
+                        {
+                            out[outIndex]   =   scale*in[inIndex];
+                        }
+                        else
+                        {
+                            in[inIndex]     +=  scale*out[outIndex];
+                        }
                     }
                 }
             }
-        }
+        });
     }
 }
 
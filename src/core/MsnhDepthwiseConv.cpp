@@ -0,0 +1,274 @@
+﻿#include "Msnhnet/core/MsnhDepthwiseConv.h"
+#include "Msnhnet/layers/MsnhActivations.h"
+#include <algorithm>
+
+namespace Msnhnet
+{
+static inline float dwActivate(const float &x, const ActivationType &activation, const float &actParam)
+{
+    if(activation == ActivationType::NONE)
+    {
+        return x;
+    }
+    return Activations::activate(x, activation, actParam);
+}
+
+#ifdef USE_X86
+MSNH_AVX2_BEGIN
+static inline __m256 dwActivate(const __m256 &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return _mm256_max_ps(x, _mm256_setzero_ps());
+    case RELU6:
+        return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(6.f));
+    case LEAKY:
+        return _mm256_blendv_ps(_mm256_mul_ps(x, _mm256_set1_ps(actParam)), x, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+    default:
+        return x;
+    }
+}
+
+template<int STRIDE>
+static inline __m256 dwLoad(const float *const p);
+
+template<>
+inline __m256 dwLoad<1>(const float *const p)
+{
+    return _mm256_loadu_ps(p);
+}
+
+template<>
+inline __m256 dwLoad<2>(const float *const p)
+{
+    const __m256 lo     = _mm256_loadu_ps(p);
+    const __m256 hi     = _mm256_loadu_ps(p + 8);
+    const __m256 even   = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(even), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+/* the 8 wide part of one output row, returns the first column it left */
+template<int STRIDE>
+static int dwRowAvx2(const float *const r0, const float *const r1, const float *const r2, const float *const k, const float bias,
+                     const ActivationType activation, const float actParam, float *const outRow, int ox, const int oxVecEnd)
+{
+    const __m256 k0 = _mm256_set1_ps(k[0]);
+    const __m256 k1 = _mm256_set1_ps(k[1]);
+    const __m256 k2 = _mm256_set1_ps(k[2]);
+    const __m256 k3 = _mm256_set1_ps(k[3]);
+    const __m256 k4 = _mm256_set1_ps(k[4]);
+    const __m256 k5 = _mm256_set1_ps(k[5]);
+    const __m256 k6 = _mm256_set1_ps(k[6]);
+    const __m256 k7 = _mm256_set1_ps(k[7]);
+    const __m256 k8 = _mm256_set1_ps(k[8]);
+    const __m256 mBias = _mm256_set1_ps(bias);
+
+    for (; ox + 8 <= oxVecEnd; ox += 8)
+    {
+        const int ix    = ox * STRIDE;
+        __m256 acc      = mBias;
+
+        acc = _mm256_fmadd_ps(k0, dwLoad<STRIDE>(r0 + ix    ), acc);
+        acc = _mm256_fmadd_ps(k1, dwLoad<STRIDE>(r0 + ix + 1), acc);
+        acc = _mm256_fmadd_ps(k2, dwLoad<STRIDE>(r0 + ix + 2), acc);
+        acc = _mm256_fmadd_ps(k3, dwLoad<STRIDE>(r1 + ix    ), acc);
+        acc = _mm256_fmadd_ps(k4, dwLoad<STRIDE>(r1 + ix + 1), acc);
+        acc = _mm256_fmadd_ps(k5, dwLoad<STRIDE>(r1 + ix + 2), acc);
+        acc = _mm256_fmadd_ps(k6, dwLoad<STRIDE>(r2 + ix    ), acc);
+        acc = _mm256_fmadd_ps(k7, dwLoad<STRIDE>(r2 + ix + 1), acc);
+        acc = _mm256_fmadd_ps(k8, dwLoad<STRIDE>(r2 + ix + 2), acc);
+
+        _mm256_storeu_ps(outRow + ox, dwActivate(acc, activation, actParam));
+    }
+    return ox;
+}
+MSNH_AVX2_END
+#endif
+
+#ifdef USE_NEON
+static inline float32x4_t dwActivate(const float32x4_t &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return vmaxq_f32(x, vdupq_n_f32(0.f));
+    case RELU6:
+        return vminq_f32(vmaxq_f32(x, vdupq_n_f32(0.f)), vdupq_n_f32(6.f));
+    case LEAKY:
+        return vbslq_f32(vcgtq_f32(x, vdupq_n_f32(0.f)), x, vmulq_n_f32(x, actParam));
+    default:
+        return x;
+    }
+}
+
+template<int STRIDE>
+static inline float32x4_t dwLoad(const float *const p);
+
+template<>
+inline float32x4_t dwLoad<1>(const float *const p)
+{
+    return vld1q_f32(p);
+}
+
+template<>
+inline float32x4_t dwLoad<2>(const float *const p)
+{
+    return vld2q_f32(p).val[0];
+}
+#endif
+
+/* one output pixel with bounds checks, used on the padded border */
+static inline float dwPixel(const float *const in, const int &height, const int &width, const float *const k,
+                            const int &iy0, const int &ix0)
+{
+    float acc = 0.f;
+    for (int ky = 0; ky < 3; ++ky)
+    {
+        const int iy = iy0 + ky;
+        if(iy < 0 || iy >= height)
+        {
+            continue;
+        }
+        for (int kx = 0; kx < 3; ++kx)
+        {
+            const int ix = ix0 + kx;
+            if(ix >= 0 && ix < width)
+            {
+                acc += k[ky * 3 + kx] * in[iy * width + ix];
+            }
+        }
+    }
+    return acc;
+}
+
+template<int STRIDE>
+static void depthwiseConv3x3(float *const input, const int batch, const int channel, const int height, const int width,
+                             const int paddingX, const int paddingY, float *const weights, float *const biases,
+                             const int outHeight, const int outWidth, const ActivationType activation, const float actParam,
+                             float *const output, const bool avx2)
+{
+    /* [begin, end) of output coords whose 3x3 window lies fully inside the input */
+    const int oxBegin   = std::min((paddingX + STRIDE - 1) / STRIDE, outWidth);
+    const int oyBegin   = std::min((paddingY + STRIDE - 1) / STRIDE, outHeight);
+    const int oxEnd     = std::max(oxBegin, (width  - 3 + paddingX < 0) ? 0 : std::min((width  - 3 + paddingX) / STRIDE + 1, outWidth));
+    const int oyEnd     = std::max(oyBegin, (height - 3 + paddingY < 0) ? 0 : std::min((height - 3 + paddingY) / STRIDE + 1, outHeight));
+
+    /* stride 2 vector loads read one float past the last window */
+    const int oxVecEnd  = (STRIDE == 2) ? std::max(oxBegin, oxEnd - 1) : oxEnd;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int bc = 0; bc < batch * channel; ++bc)
+    {
+        const int c         = bc % channel;
+        const float *in     = input  + static_cast<size_t>(bc) * height * width;
+        float *out          = output + static_cast<size_t>(bc) * outHeight * outWidth;
+        const float *k      = weights + c * 9;
+        const float bias    = (biases == nullptr) ? 0.f : biases[c];
+
+        for (int oy = 0; oy < outHeight; ++oy)
+        {
+            const int iy0   = oy * STRIDE - paddingY;
+            float *outRow   = out + oy * outWidth;
+
+            if(oy < oyBegin || oy >= oyEnd)
+            {
+                for (int ox = 0; ox < outWidth; ++ox)
+                {
+                    outRow[ox] = dwActivate(dwPixel(in, height, width, k, iy0, ox * STRIDE - paddingX) + bias, activation, actParam);
+                }
+                continue;
+            }
+
+            for (int ox = 0; ox < oxBegin; ++ox)
+            {
+                outRow[ox] = dwActivate(dwPixel(in, height, width, k, iy0, ox * STRIDE - paddingX) + bias, activation, actParam);
+            }
+
+            const float *r0 = in + iy0 * width - paddingX;
+            const float *r1 = r0 + width;
+            const float *r2 = r1 + width;
+
+            int ox = oxBegin;
+#ifdef USE_X86
+            if(avx2)
+            {
+                ox = dwRowAvx2<STRIDE>(r0, r1, r2, k, bias, activation, actParam, outRow, ox, oxVecEnd);
+            }
+#endif
+
+#ifdef USE_NEON
+            {
+                const float32x4_t mBias = vdupq_n_f32(bias);
+
+                for (; ox + 4 <= oxVecEnd; ox += 4)
+                {
+                    const int ix    = ox * STRIDE;
+                    float32x4_t acc = mBias;
+
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r0 + ix    ), k[0]);
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r0 + ix + 1), k[1]);
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r0 + ix + 2), k[2]);
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r1 + ix    ), k[3]);
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r1 + ix + 1), k[4]);
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r1 + ix + 2), k[5]);
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r2 + ix    ), k[6]);
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r2 + ix + 1), k[7]);
+                    acc = vmlaq_n_f32(acc, dwLoad<STRIDE>(r2 + ix + 2), k[8]);
+
+                    vst1q_f32(outRow + ox, dwActivate(acc, activation, actParam));
+                }
+            }
+#endif
+            for (; ox < oxEnd; ++ox)
+            {
+                const int ix    = ox * STRIDE;
+                const float acc = bias +
+                        k[0] * r0[ix] + k[1] * r0[ix + 1] + k[2] * r0[ix + 2] +
+                        k[3] * r1[ix] + k[4] * r1[ix + 1] + k[5] * r1[ix + 2] +
+                        k[6] * r2[ix] + k[7] * r2[ix + 1] + k[8] * r2[ix + 2];
+                outRow[ox]      = dwActivate(acc, activation, actParam);
+            }
+
+            for (; ox < outWidth; ++ox)
+            {
+                outRow[ox] = dwActivate(dwPixel(in, height, width, k, iy0, ox * STRIDE - paddingX) + bias, activation, actParam);
+            }
+        }
+    }
+}
+
+bool DepthwiseConv::isFusedActivation(const ActivationType &activation)
+{
+    return activation == ActivationType::NONE || activation == ActivationType::LINEAR || activation == ActivationType::RELU ||
+           activation == ActivationType::RELU6 || activation == ActivationType::LEAKY;
+}
+
+void DepthwiseConv::conv3x3(const int &stride, float * const &input, const int &batch, const int &channel, const int &height, const int &width,
+                            const int &paddingX, const int &paddingY, float * const &weights, float * const &biases,
+                            const int &outHeight, const int &outWidth, const ActivationType &activation, const float &actParam,
+                            float * const &output)
+{
+    /* activations that can't be fused are left to the caller */
+    const ActivationType act = isFusedActivation(activation) ? activation : ActivationType::NONE;
+
+    /* the 8 wide rows follow the kernel table, a cpu without avx2 keeps the scalar rows */
+    const KernelIsa isa = Kernels::get().isa;
+    const bool avx2 = isa == ISA_AVX2 || isa == ISA_AVX512 || isa == ISA_AVX512_VNNI;
+
+    if(stride == 1)
+    {
+        depthwiseConv3x3<1>(input, batch, channel, height, width, paddingX, paddingY, weights, biases, outHeight, outWidth, act, actParam, output, avx2);
+    }
+    else if(stride == 2)
+    {
+        depthwiseConv3x3<2>(input, batch, channel, height, width, paddingX, paddingY, weights, biases, outHeight, outWidth, act, actParam, output, avx2);
+    }
+    else
+    {
+        throw Exception(1, "Depthwise conv3x3 only supports stride 1 and 2, given : " + std::to_string(stride), __FILE__, __LINE__);
+    }
+}
+}
@@ -1,4 +1,5 @@
 ﻿#include "Msnhnet/core/MsnhGemm.h"
+#include "Msnhnet/layers/MsnhActivations.h"
 namespace Msnhnet
 {
 uint8_t Gemm::lookup[16] = { 0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,};
@@ -20,6 +21,7 @@ void Gemm::repackInput(float * const &input, float * const &rePackedInput, const
     }
 }
 
+MSNH_AVX2_BEGIN
 void Gemm::float2Bit(float * const &input, uint8_t * const &output, size_t size)
 {
 #ifdef USE_X86
@@ -46,6 +48,7 @@ void Gemm::float2Bit(float * const &input, uint8_t * const &output, size_t size)
     throw Exception(1,"TODO: for arm",__FILE__, __LINE__);
 #endif
 }
+MSNH_AVX2_END
 
 void Gemm::cpuIm2col(float * const &input, const int &channelNum, const int &height, const int &width,
                      const int &kSize, const int &stride, const int &padding, float * const &output)
@@ -86,7 +89,7 @@ void Gemm::cpuIm2col(float * const &input, const int &channelNum, const int &hei
 void Gemm::cpuIm2colEx(float *input, const int &channelNum, const int &height, const int &width,
                        const int &kernelH, const int &kernelW, const int &padH, const int &padW,
                        const int &strideH, const int &strideW, const int &dilationH, const int &dilationW,
-                       float *output)
+                       float *output, const int &ldOutput)
 {
 
    const int outputH       =   (height + 2 * padH - (dilationH * (kernelH - 1) + 1)) / strideH + 1;
@@ -94,17 +97,16 @@ void Gemm::cpuIm2colEx(float *input, const int &channelNum, const int &height, c
 
    const int channelSize   =   height * width;
 
-   if(outputH == height && outputW == width && strideH==1 &&strideW==1 && padH==1 && padW==1)
+   /* one output row per (channel, kernelRow, kernelCol), ldOutput > outputH*outputW leaves room for other images' columns */
+    const int ld            =   (ldOutput > 0) ? ldOutput : outputH * outputW;
+
+   if(kernelH == 3 && kernelW == 3 && dilationH == 1 && dilationW == 1 && outputH == height && outputW == width &&
+            strideH==1 &&strideW==1 && padH==1 && padW==1 && ld == outputH * outputW)
     {
-#ifdef X86
         cpuIm2colWithAvx(input, channelNum, height, width, kernelH, strideH, padH, output, 1);
-#else
-       goto NEXT;
-#endif
     }
     else
     {
-NEXT:        
 
        for (int channel = 0 ; channel++<channelNum; input += channelSize) 
 
@@ -129,8 +131,7 @@ NEXT:
                             for (int outputCol = 0; outputCol < outputW; ++outputCol) 
 
                            {
-                                output[ (channel-1)*kernelH*kernelW*outputH*outputW + kernelRow *kernelW*outputH*outputW +
-                                        kernelCol*outputH*outputW + outputRow*outputW + outputCol] = 0;
+                                output[((channel-1)*kernelH*kernelW + kernelRow*kernelW + kernelCol)*ld + outputRow*outputW + outputCol] = 0;
                             }
                         }
                         else
@@ -142,16 +143,14 @@ NEXT:
                                 if (is_a_ge_zero_and_a_lt_b(inputCol + strideW*outputCol, width)) 
 
                                {
-                                    output[ (channel-1)*kernelH*kernelW*outputH*outputW + kernelRow *kernelW*outputH*outputW +
-                                            kernelCol*outputH*outputW + outputRow*outputW + outputCol]
+                                    output[((channel-1)*kernelH*kernelW + kernelRow*kernelW + kernelCol)*ld + outputRow*outputW + outputCol]
                                             = input[(inputRow + outputRow*strideH) * width + inputCol + strideW*outputCol]; 
 
                                }
                                 else    
 
                                {
-                                    output[(channel-1)*kernelH*kernelW*outputH*outputW + kernelRow *kernelW*outputH*outputW +
-                                            kernelCol*outputH*outputW + outputRow*outputW + outputCol] = 0; 
+                                    output[((channel-1)*kernelH*kernelW + kernelRow*kernelW + kernelCol)*ld + outputRow*outputW + outputCol] = 0; 
 
                                }
                             }
@@ -167,269 +166,180 @@ NEXT:
 void Gemm::cpuIm2colWithAvx(float * const &input, const int &channelNum, const int &height, const int &width, const int &kSize,
                             const int &stride, const int &padding, float * const &output, const bool &supportAvxAndFma)
 {
+    (void)supportAvxAndFma;
 
-#ifdef USE_X86
-    if(supportAvxAndFma)
+   const int heightCol  = (height + 2*padding - kSize) / stride + 1;
+    const int widthCol   = (width  + 2*padding - kSize) / stride + 1;
+
+   /* the kernel table picks the widest build this cpu runs, so the flag only remains for the old callers */
+    if(kSize == 3 && heightCol == height && widthCol == width && stride == 1 && padding == 1)
     {
-        const int heightCol  = (height + 2*padding - kSize) / stride + 1;
-        const int widthCol   = (width  + 2*padding - kSize) / stride + 1;
-        const int chCols     = channelNum * kSize * kSize;
+        const KernelTable &kernels = Kernels::get();
 
-       if(heightCol == height && widthCol == width && stride == 1 && padding == 1)
+       ThreadPool::parallelFor(0, channelNum * 9, ThreadPool::grainFor(height * width), [&](const int &rBegin, const int &rEnd)
         {
-#pragma omp parallel for num_threads(OMP_THREAD)
-            for (int ch = 0; ch < chCols; ++ch)
-            {
-                int h       = 0;
-                int w       = 0;
-                int wOffset = ch % kSize;
-                int hOffset = (ch / kSize) % kSize;
-                int chOff   = ch / kSize / kSize;
-
-               for (h = padding; h < heightCol - padding; ++h)
-                {
-                    for (w = padding; w < widthCol - padding - 8; w+=8)
-                    {
-
-                       int imRow           = hOffset + h - padding;
-                        int imCol           = wOffset + w - padding;
-
-                       int colIndex        = (ch*heightCol + h)*widthCol + w;
-
-                       __m256 src256       = _mm256_loadu_ps(static_cast<float*>((&input[imCol + width*(imRow + heightCol * chOff)])));
-
-                       _mm256_storeu_ps(&output[colIndex], src256);
-                    }
-
-                   for (; w < widthCol - padding; ++w)
-                    {
-                        int imRow           = hOffset + h - padding;
-                        int imCol           = wOffset + w - padding;
-                        int colIndex        = (ch*heightCol + h)*widthCol + w;
-
-                       output[colIndex]    = input[imCol + width*(imRow + heightCol * chOff)];
-                    }
-                }
-
-               {   
-
-                   w = 0;
-                    for (h = 0; h < heightCol; ++h)
-                    {
-
-                       int imRow           = hOffset + h*stride;
-                        int imCol           = wOffset + w*stride;
-
-                       int colIndex        = (ch*heightCol + h)*widthCol + w;
-
-                       output[colIndex]    = img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
-                    }
-                }
-
-               {   
-
-                   w = widthCol - 1;
-                    for (h = 0; h < heightCol; ++h)
-                    {
-
-                       int imRow           = hOffset + h*stride;
-                        int imCol           = wOffset + w*stride;
-
-                       int colIndex        = (ch*heightCol + h)*widthCol + w;
-
-                       output[colIndex]    = img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
-                    }
-                }
-
-               {
-
-                   h = 0;
-                    for (w = 0; w < widthCol; ++w)
-                    {
-
-                       int imRow           = hOffset + h*stride;
-                        int imCol           = wOffset + w*stride;
-
-                       int colIndex        = (ch*heightCol + h)*widthCol + w;
-
-                       output[colIndex]    = img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
-                    }
-                }
-
-               {
-
-                   h = heightCol - 1;
-                    for (w = 0; w < widthCol; ++w)
-                    {
-
-                       int imRow           = hOffset + h*stride;
-                        int imCol           = wOffset + w*stride;
-
-                       int colIndex        = (ch*heightCol + h)*widthCol + w;
-
-                       output[colIndex]    = img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
-                    }
-                }
-
-           }
-        }
+            kernels.im2col3x3(input, height, width, rBegin, rEnd, output);
+        });
     }
     else
     {
-        cpuIm2col(input,channelNum,height,width,kSize,stride,padding,output);
+        cpuIm2colEx(input, channelNum, height, width, kSize, kSize, padding, padding, stride, stride, 1, 1, output);
     }
-#endif
-
-#ifdef USE_ARM
-    (void)supportAvxAndFma;
-    cpuIm2col(input,channelNum,height,width,kSize,stride,padding,output);
-#endif
 }
 
-void Gemm::cpuIm2colBinWithAvx(float * const &input, const int &channelNum, const int &height, const int &width,
-                               const int &kSize, const int &stride, const int &padding, float * const &output,
-                               const int &bitAlign, const bool &supportAvxAndFma)
-{
 #ifdef USE_X86
-    if(supportAvxAndFma)
-    {
-        const int heightCol  = (height + 2*padding - kSize) / stride + 1;
-        const int widthCol   = (width  + 2*padding - kSize) / stride + 1;
-        const int chCols     = channelNum * kSize * kSize;
+MSNH_AVX2_BEGIN
+static void im2colBinAvx(float * const &input, const int &channelNum, const int &height, const int &width,
+                         const int &kSize, const int &stride, const int &padding, float * const &output, const int &bitAlign)
+{
+    const int heightCol  = (height + 2*padding - kSize) / stride + 1;
+    const int widthCol   = (width  + 2*padding - kSize) / stride + 1;
+    const int chCols     = channelNum * kSize * kSize;
 
-       if(heightCol == height && widthCol == width && stride == 1 && padding == 1)
-        {
+   if(heightCol == height && widthCol == width && stride == 1 && padding == 1)
+    {
 
-           __m256i all256Single1 = _mm256_set_epi32(static_cast<int>(0x80000000), static_cast<int>(0x80000000), static_cast<int>(0x80000000), static_cast<int>(0x80000000),
-                                                     static_cast<int>(0x80000000), static_cast<int>(0x80000000), static_cast<int>(0x80000000), static_cast<int>(0x80000000));
-            __m256  floatZero256  = _mm256_set1_ps(0.00);
-            int newLdb            = bitAlign;
+       __m256i all256Single1 = _mm256_set_epi32(static_cast<int>(0x80000000), static_cast<int>(0x80000000), static_cast<int>(0x80000000), static_cast<int>(0x80000000),
+                                                 static_cast<int>(0x80000000), static_cast<int>(0x80000000), static_cast<int>(0x80000000), static_cast<int>(0x80000000));
+        __m256  floatZero256  = _mm256_set1_ps(0.00);
+        int newLdb            = bitAlign;
 
 #pragma omp parallel for num_threads(OMP_THREAD)
-            for (int ch = 0; ch < chCols; ++ch)
-            {
-                int h       = 0;
-                int w       = 0;
-                int wOffset = ch % kSize;
-                int hOffset = (ch / kSize) % kSize;
-                int chOff   = ch / kSize / kSize;
+        for (int ch = 0; ch < chCols; ++ch)
+        {
+            int h       = 0;
+            int w       = 0;
+            int wOffset = ch % kSize;
+            int hOffset = (ch / kSize) % kSize;
+            int chOff   = ch / kSize / kSize;
 
-               for (h = padding; h < heightCol - padding; ++h)
+           for (h = padding; h < heightCol - padding; ++h)
+            {
+                for (w = padding; w < widthCol - padding - 8; w+=8)
                 {
-                    for (w = padding; w < widthCol - padding - 8; w+=8)
-                    {
 
-                       int imRow           = hOffset + h - padding;
-                        int imCol           = wOffset + w - padding;
+                   int imRow           = hOffset + h - padding;
+                    int imCol           = wOffset + w - padding;
 
-                       int colIndex        = ch*newLdb + h*widthCol + w;
+                   int colIndex        = ch*newLdb + h*widthCol + w;
 
-                       __m256 src256       = _mm256_loadu_ps(static_cast<float*>((&input[imCol + width*(imRow + heightCol * chOff)])));
-                        __m256 result256    = _mm256_cmp_ps(src256, floatZero256, _CMP_GT_OS);
-                        uint16_t mask       = _mm256_movemask_ps(result256); 
+                   __m256 src256       = _mm256_loadu_ps(static_cast<float*>((&input[imCol + width*(imRow + heightCol * chOff)])));
+                    __m256 result256    = _mm256_cmp_ps(src256, floatZero256, _CMP_GT_OS);
+                    uint16_t mask       = _mm256_movemask_ps(result256); 
 
-                       uint16_t* dstPtr = (uint16_t*)&((uint8_t*)output)[colIndex / 8];
-                        *dstPtr |= (mask << (colIndex % 8));
-                    }
+                   uint16_t* dstPtr = (uint16_t*)&((uint8_t*)output)[colIndex / 8];
+                    *dstPtr |= (mask << (colIndex % 8));
+                }
 
-                   for (; w < widthCol - padding; ++w)
-                    {
-                        int imRow           = hOffset + h - padding;
-                        int imCol           = wOffset + w - padding;
-                        int colIndex        = ch*newLdb + h*widthCol + w;
+               for (; w < widthCol - padding; ++w)
+                {
+                    int imRow           = hOffset + h - padding;
+                    int imCol           = wOffset + w - padding;
+                    int colIndex        = ch*newLdb + h*widthCol + w;
 
-                       float value         = input[imCol + width*(imRow + height*chOff)];
-                        if(value>0)
-                        {
+                   float value         = input[imCol + width*(imRow + height*chOff)];
+                    if(value>0)
+                    {
 
-                           setBit((uint8_t*)output,colIndex);
-                        }
+                       Gemm::setBit((uint8_t*)output,colIndex);
                     }
                 }
+            }
 
-               {   
+           {   
 
-                   w = 0;
-                    for (h = 0; h < heightCol; ++h)
-                    {
+               w = 0;
+                for (h = 0; h < heightCol; ++h)
+                {
 
-                       int imRow           = hOffset + h*stride;
-                        int imCol           = wOffset + w*stride;
+                   int imRow           = hOffset + h*stride;
+                    int imCol           = wOffset + w*stride;
 
-                       int colIndex        = ch*newLdb + h*widthCol + w;
+                   int colIndex        = ch*newLdb + h*widthCol + w;
 
-                       float value          = img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
+                   float value          = Gemm::img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
 
-                       if(value>0)
-                        {
-                            setBit((uint8_t*)output,colIndex);
-                        }
+                   if(value>0)
+                    {
+                        Gemm::setBit((uint8_t*)output,colIndex);
                     }
                 }
+            }
 
-               {   
+           {   
 
-                   w = widthCol - 1;
-                    for (h = 0; h < heightCol; ++h)
-                    {
+               w = widthCol - 1;
+                for (h = 0; h < heightCol; ++h)
+                {
 
-                       int imRow           = hOffset + h*stride;
-                        int imCol           = wOffset + w*stride;
+                   int imRow           = hOffset + h*stride;
+                    int imCol           = wOffset + w*stride;
 
-                       int colIndex        = ch*newLdb + h*widthCol + w;
+                   int colIndex        = ch*newLdb + h*widthCol + w;
 
-                       float value         = img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
+                   float value         = Gemm::img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
 
-                       if(value>0)
-                        {
-                            setBit((uint8_t*)output,colIndex);
-                        }
+                   if(value>0)
+                    {
+                        Gemm::setBit((uint8_t*)output,colIndex);
                     }
                 }
+            }
 
-               {
+           {
 
-                   h = 0;
-                    for (w = 0; w < widthCol; ++w)
-                    {
+               h = 0;
+                for (w = 0; w < widthCol; ++w)
+                {
 
-                       int imRow           = hOffset + h*stride;
-                        int imCol           = wOffset + w*stride;
+                   int imRow           = hOffset + h*stride;
+                    int imCol           = wOffset + w*stride;
 
-                       int colIndex        = ch*newLdb + h*widthCol + w;
+                   int colIndex        = ch*newLdb + h*widthCol + w;
 
-                       float value         = img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
+                   float value         = Gemm::img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
 
-                       if(value>0)
-                        {
-                            setBit((uint8_t*)output,colIndex);
-                        }
+                   if(value>0)
+                    {
+                        Gemm::setBit((uint8_t*)output,colIndex);
                     }
                 }
+            }
 
-               {
+           {
 
-                   h = heightCol - 1;
-                    for (w = 0; w < widthCol; ++w)
-                    {
+               h = heightCol - 1;
+                for (w = 0; w < widthCol; ++w)
+                {
 
-                       int imRow           = hOffset + h*stride;
-                        int imCol           = wOffset + w*stride;
+                   int imRow           = hOffset + h*stride;
+                    int imCol           = wOffset + w*stride;
 
-                       int colIndex        = ch*newLdb + h*widthCol + w;
+                   int colIndex        = ch*newLdb + h*widthCol + w;
 
-                       float value         = img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
+                   float value         = Gemm::img2ColGetPixel(input, height, width, imRow, imCol, chOff, padding);
 
-                       if(value>0)
-                        {
-                            setBit((uint8_t*)output,colIndex);
-                        }
+                   if(value>0)
+                    {
+                        Gemm::setBit((uint8_t*)output,colIndex);
                     }
                 }
             }
         }
+    }
+}
+MSNH_AVX2_END
+#endif
 
-   }
+void Gemm::cpuIm2colBinWithAvx(float * const &input, const int &channelNum, const int &height, const int &width,
+                               const int &kSize, const int &stride, const int &padding, float * const &output,
+                               const int &bitAlign, const bool &supportAvxAndFma)
+{
+#ifdef USE_X86
+    if(supportAvxAndFma)
+    {
+        im2colBinAvx(input, channelNum, height, width, kSize, stride, padding, output, bitAlign);
+    }
     else
     {
         throw Exception(1,"Error: is no non-optimized version",__FILE__, __LINE__);
@@ -490,9 +400,10 @@ void Gemm::cpuGemm(const int &TA, const int &TB, const int &M, const int &N, con
 
 #ifdef  USE_X86
 
-   if(supportAvxAndFma && TA!=1 && TB!=1)
+   /* the packed path runs on whichever kernel table this cpu got, the row loops below are the transposed cases */
+    if(TA!=1 && TB!=1)
     {
-        cpuGemmNNFast(M,N,K,ALPHA,A,lda,B,ldb,C,ldc);
+        cpuGemmPacked(M,N,K,ALPHA,A,lda,B,ldb,C,ldc);
     }
     else
     {
@@ -555,57 +466,67 @@ void Gemm::cpuGemm(const int &TA, const int &TB, const int &M, const int &N, con
 #endif
 }
 
-void Gemm::cpuGemmNN(const int &M, const int &N, const int &K, const float &ALPHA,
-                     float * const &A, const int &lda, 
-
-                    float * const &B, const int &ldb, 
-
-                    float * const &C, const int &ldc, 
-
-                    const bool &supportAvxAndFma)
-{
-
 #ifdef USE_X86
-    if(supportAvxAndFma)
-    {
+MSNH_AVX2_BEGIN
+static void gemmNNAvx(const int &M, const int &N, const int &K, const float &ALPHA, float * const &A, const int &lda,
+                      float * const &B, const int &ldb, float * const &C, const int &ldc)
+{
 #ifdef USE_OMP
 #pragma omp parallel for num_threads(OMP_THREAD)
 #endif
-        for (int i = 0; i < M; ++i)         
+    for (int i = 0; i < M; ++i)         
 
-       {
-            for (int k = 0; k < K; ++k)     
+   {
+        for (int k = 0; k < K; ++k)     
 
-           {
-                __m256 a256, b256, c256, result256;    
+       {
+            __m256 a256, b256, c256, result256;    
 
-               float A_PART =  ALPHA*A[i*lda + k];     
+           float A_PART =  ALPHA*A[i*lda + k];     
 
-               a256         =  _mm256_set1_ps(A_PART);
-                for (int j = 0; j < N - 8; j += 8)     
+           a256         =  _mm256_set1_ps(A_PART);
+            for (int j = 0; j < N - 8; j += 8)     
 
-               {
-                    b256 = _mm256_loadu_ps(&B[k*ldb + j]); 
+           {
+                b256 = _mm256_loadu_ps(&B[k*ldb + j]); 
 
-                   c256 = _mm256_loadu_ps(&C[i*ldc + j]); 
+               c256 = _mm256_loadu_ps(&C[i*ldc + j]); 
 
-                   result256 = _mm256_mul_ps(a256, b256);     
+               result256 = _mm256_mul_ps(a256, b256);     
 
-                   result256 = _mm256_add_ps(result256, c256);
+               result256 = _mm256_add_ps(result256, c256);
 
-                   _mm256_storeu_ps(&C[i*ldc + j], result256);
-                }
+               _mm256_storeu_ps(&C[i*ldc + j], result256);
+            }
 
-               int prevEnd = (N % 8 == 0) ? (N - 8) : (N / 8) * 8; 
+           int prevEnd = (N % 8 == 0) ? (N - 8) : (N / 8) * 8; 
 
-               for (int j = prevEnd; j < N; ++j)   
+           for (int j = prevEnd; j < N; ++j)   
 
-               {
-                    C[i*ldc + j] += A_PART*B[k*ldb + j];
-                }
+           {
+                C[i*ldc + j] += A_PART*B[k*ldb + j];
             }
         }
     }
+}
+MSNH_AVX2_END
+#endif
+
+void Gemm::cpuGemmNN(const int &M, const int &N, const int &K, const float &ALPHA,
+                     float * const &A, const int &lda, 
+
+                    float * const &B, const int &ldb, 
+
+                    float * const &C, const int &ldc, 
+
+                    const bool &supportAvxAndFma)
+{
+
+#ifdef USE_X86
+    if(supportAvxAndFma)
+    {
+        gemmNNAvx(M, N, K, ALPHA, A, lda, B, ldb, C, ldc);
+    }
     else
     {
 
@@ -777,6 +698,7 @@ void Gemm::cpuGemmTT(const int &M, const int &N, const int &K, const float &ALPH
     }
 }
 
+MSNH_AVX2_BEGIN
 void Gemm::cpuFastADotB(const int &n, float * const &A, float * const &B, float *const &C)
 {
 #ifdef USE_X86
@@ -806,7 +728,9 @@ void Gemm::cpuFastADotB(const int &n, float * const &A, float * const &B, float
     throw Exception(1, "TODO: for arm", __FILE__, __LINE__);
 #endif
 }
+MSNH_AVX2_END
 
+MSNH_AVX2_BEGIN
 void Gemm::cpuGemmNNFast(const int &M, const int &N, const int &K, const float &ALPHA,
                          float * const &A, const int &lda,
                          float * const &B, const int &ldb,
@@ -945,6 +869,480 @@ void Gemm::cpuGemmNNFast(const int &M, const int &N, const int &K, const float &
     throw Exception(1, "TODO: for arm", __FILE__, __LINE__);
 #endif
 }
+MSNH_AVX2_END
+
+void *Gemm::alignedMalloc(const size_t &size, const size_t &align)
+{
+    void *ptr = nullptr;
+#ifdef WIN32
+    ptr = _aligned_malloc(size, align);
+#else
+    if(posix_memalign(&ptr, align, size) != 0)
+    {
+        ptr = nullptr;
+    }
+#endif
+    if(ptr == nullptr)
+    {
+        throw Exception(1, "aligned malloc failed", __FILE__, __LINE__);
+    }
+    return ptr;
+}
+
+void Gemm::alignedFree(void * const &ptr)
+{
+    if(ptr != nullptr)
+    {
+#ifdef WIN32
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+}
+
+static inline uint16_t gemmStoreA(const float &val, const uint16_t *const &, const WeightStorage &storage)
+{
+    return Half::fromFloat(val, storage);
+}
+
+static inline float gemmStoreA(const float &val, const float *const &, const WeightStorage &)
+{
+    return val;
+}
+
+template<typename AType>
+static void gemmPackA(const int &M, const int &K, const float &ALPHA, float * const &A, const int &lda, AType * const &packedA, const WeightStorage &storage)
+{
+    const int mPanels   = (M + GEMM_MR - 1) / GEMM_MR;
+    const int mPadded   = mPanels * GEMM_MR;
+
+    for (int pc = 0; pc < K; pc += GEMM_KC)
+    {
+        const int kc    = (K - pc) < GEMM_KC ? (K - pc) : GEMM_KC;
+        AType *blockA   = packedA + pc * mPadded;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+        for (int ip = 0; ip < mPanels; ++ip)
+        {
+            const int ir    = ip * GEMM_MR;
+            const int mr    = (M - ir) < GEMM_MR ? (M - ir) : GEMM_MR;
+            AType *panel    = blockA + ir * kc;
+
+            for (int p = 0; p < kc; ++p)
+            {
+                int i = 0;
+                for (; i < mr; ++i)
+                {
+                    panel[p * GEMM_MR + i] = gemmStoreA(ALPHA * A[(ir + i) * lda + pc + p], panel, storage);
+                }
+
+                for (; i < GEMM_MR; ++i)
+                {
+                    panel[p * GEMM_MR + i] = 0;
+                }
+            }
+        }
+    }
+}
+
+void Gemm::cpuGemmPackA(const int &M, const int &K, const float &ALPHA, float * const &A, const int &lda, float * const &packedA)
+{
+    gemmPackA(M, K, ALPHA, A, lda, packedA, WEIGHT_F32);
+}
+
+void Gemm::cpuGemmPackAHalf(const int &M, const int &K, float * const &A, const int &lda, uint16_t * const &packedA, const WeightStorage &storage)
+{
+    gemmPackA(M, K, 1.f, A, lda, packedA, storage);
+    memset(packedA + getPackedASize(M, K), 0, GEMM_HALF_PAD * sizeof(uint16_t));
+}
+
+void Gemm::cpuGemmPackB(const int &K, const int &N, float * const &B, const int &ldb, float * const &packedB)
+{
+    const int nPanels   = (N + GEMM_NR - 1) / GEMM_NR;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int jp = 0; jp < nPanels; ++jp)
+    {
+        const int jr    = jp * GEMM_NR;
+        const int nr    = (N - jr) < GEMM_NR ? (N - jr) : GEMM_NR;
+        float *panel    = packedB + jr * K;
+
+        if(nr == GEMM_NR)
+        {
+            for (int p = 0; p < K; ++p)
+            {
+                memcpy(panel + p * GEMM_NR, B + p * ldb + jr, GEMM_NR * sizeof(float));
+            }
+        }
+        else
+        {
+            for (int p = 0; p < K; ++p)
+            {
+                int j = 0;
+                for (; j < nr; ++j)
+                {
+                    panel[p * GEMM_NR + j] = B[p * ldb + jr + j];
+                }
+
+                for (; j < GEMM_NR; ++j)
+                {
+                    panel[p * GEMM_NR + j] = 0.f;
+                }
+            }
+        }
+    }
+}
+
+bool Gemm::isEpilogueActivation(const ActivationType &activation)
+{
+    return activation == ActivationType::NONE || activation == ActivationType::LINEAR || activation == ActivationType::RELU ||
+           activation == ActivationType::RELU6 || activation == ActivationType::LEAKY;
+}
+
+static inline float gemmEpilogue(float x, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    if(epi->bias != nullptr)
+    {
+        x += epi->bias[row];
+    }
+    if(epi->activation != ActivationType::NONE)
+    {
+        x = Activations::activate(x, epi->activation, epi->actParam);
+    }
+    if(res != nullptr)
+    {
+        x += *res;
+    }
+    if(epi->postActivation != ActivationType::NONE)
+    {
+        x = Activations::activate(x, epi->postActivation, epi->postActParam);
+    }
+    return x;
+}
+
+/* finishes one mr x nr tile held in tile[GEMM_MR][GEMM_NR] */
+static inline void gemmStoreTile(const float *const &tile, float *const &C, const int &ldc, const int &mr, const int &nr,
+                                 const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    for (int i = 0; i < mr; ++i)
+    {
+        for (int j = 0; j < nr; ++j)
+        {
+            float x = overwrite ? tile[i * GEMM_NR + j] : (C[i * ldc + j] + tile[i * GEMM_NR + j]);
+            if(epi != nullptr)
+            {
+                x = gemmEpilogue(x, epi, row + i, (res == nullptr) ? nullptr : (res + i * ldc + j));
+            }
+            C[i * ldc + j] = x;
+        }
+    }
+}
+
+static inline void gemmKernelTile(const KernelTable &kernels, const int &kc, const uint16_t *const &a, const float *const &b, float *const &C, const int &ldc, const WeightStorage &storage,
+                                  const bool &overwrite = false, const GemmEpilogue *const &epi = nullptr,
+                                  const int &row = 0, const float *const &res = nullptr)
+{
+    kernels.gemm6x16Half(kc, a, storage, b, C, ldc, overwrite, epi, row, res);
+}
+
+static inline void gemmKernelTile(const KernelTable &kernels, const int &kc, const float *const &a, const float *const &b, float *const &C, const int &ldc, const WeightStorage &,
+                                  const bool &overwrite = false, const GemmEpilogue *const &epi = nullptr,
+                                  const int &row = 0, const float *const &res = nullptr)
+{
+    kernels.gemm6x16(kc, a, b, C, ldc, overwrite, epi, row, res);
+}
+
+/* the 6x32 tile over panels jp and jp + 1, only on isas with one */
+static inline bool gemmHasTile6x32(const KernelTable &kernels, const uint16_t *const &)
+{
+    return kernels.gemm6x32Half != nullptr;
+}
+
+static inline bool gemmHasTile6x32(const KernelTable &kernels, const float *const &)
+{
+    return kernels.gemm6x32 != nullptr;
+}
+
+static inline void gemmKernelTile6x32(const KernelTable &kernels, const int &kc, const uint16_t *const &a, const float *const &b, float *const &C, const int &ldc,
+                                      const WeightStorage &storage, const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    kernels.gemm6x32Half(kc, a, storage, b, C, ldc, overwrite, epi, row, res);
+}
+
+static inline void gemmKernelTile6x32(const KernelTable &kernels, const int &kc, const float *const &a, const float *const &b, float *const &C, const int &ldc,
+                                      const WeightStorage &, const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    kernels.gemm6x32(kc, a, b, C, ldc, overwrite, epi, row, res);
+}
+
+static inline float *gemmGrowBuffer(float *&buf, size_t &capacity, const size_t &size)
+{
+    if(size > capacity)
+    {
+        Gemm::alignedFree(buf);
+        buf         = static_cast<float *>(Gemm::alignedMalloc(size * sizeof(float)));
+        capacity    = size;
+    }
+    return buf;
+}
+
+struct GemmPackBuffer
+{
+    float   *data       =   nullptr;
+    size_t  capacity    =   0;
+    ~GemmPackBuffer()
+    {
+        Gemm::alignedFree(data);
+    }
+};
+
+size_t Gemm::getPackedASize(const int &M, const int &K)
+{
+    return static_cast<size_t>((M + GEMM_MR - 1) / GEMM_MR * GEMM_MR) * static_cast<size_t>(K);
+}
+
+void Gemm::cpuGemmPacked(const int &M, const int &N, const int &K, const float &ALPHA,
+                         float * const &A, const int &lda,
+                         float * const &B, const int &ldb,
+                         float * const &C, const int &ldc)
+{
+    static thread_local GemmPackBuffer bufA;
+
+    float *packedA      = gemmGrowBuffer(bufA.data, bufA.capacity, getPackedASize(M, K));
+
+    cpuGemmPackA(M, K, ALPHA, A, lda, packedA);
+
+    cpuGemmPrePacked(M, N, K, packedA, B, ldb, C, ldc);
+}
+
+/* packB(pc, kc, jc, nc, packedB) packs rows [pc, pc + kc) and cols [jc, jc + nc) of B into NR panels */
+template<typename AType, typename PackB>
+static void gemmPrePackedBlocked(const int &M, const int &N, const int &K, AType * const &packedA, const WeightStorage &storage,
+                                 const PackB &packB, float * const &C, const int &ldc, const GemmEpilogue *const &epilogue = nullptr)
+{
+    static thread_local GemmPackBuffer bufB;
+
+    const KernelTable &kernels  = Kernels::get();
+
+    const int mPanels   = (M + GEMM_MR - 1) / GEMM_MR;
+    const int mPadded   = mPanels * GEMM_MR;
+    const int ncMax     = N < GEMM_NC ? N : GEMM_NC;
+    const int kcMax     = K < GEMM_KC ? K : GEMM_KC;
+
+    float *packedB      = gemmGrowBuffer(bufB.data, bufB.capacity, static_cast<size_t>((ncMax + GEMM_NR - 1) / GEMM_NR * GEMM_NR) * kcMax);
+
+    const int mcPanels  = GEMM_MC / GEMM_MR;
+    const int icBlocks  = (mPanels + mcPanels - 1) / mcPanels;
+
+    /* a task covers two b panels where the isa has the 6x32 tile */
+    const int jStep     = gemmHasTile6x32(kernels, packedA) ? 2 : 1;
+
+    for (int jc = 0; jc < N; jc += GEMM_NC)
+    {
+        const int nc        = (N - jc) < GEMM_NC ? (N - jc) : GEMM_NC;
+        const int nPanels   = (nc + GEMM_NR - 1) / GEMM_NR;
+        const int jSteps    = (nPanels + jStep - 1) / jStep;
+
+        for (int pc = 0; pc < K; pc += GEMM_KC)
+        {
+            const int kc    = (K - pc) < GEMM_KC ? (K - pc) : GEMM_KC;
+            AType *blockA   = packedA + pc * mPadded;
+
+            packB(pc, kc, jc, nc, packedB);
+
+            const bool overwrite        = (epilogue != nullptr) && (pc == 0);
+            const GemmEpilogue *epi     = (pc + kc >= K) ? epilogue : nullptr;
+
+            const int tasks = icBlocks * jSteps;
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD) schedule(static)
+#endif
+            for (int t = 0; t < tasks; ++t)
+            {
+                const int icb       = t / jSteps;
+                const int jpBegin   = (t % jSteps) * jStep;
+                const int jpEnd     = (jpBegin + jStep) < nPanels ? (jpBegin + jStep) : nPanels;
+
+                /* both panels of the pair are full */
+                const bool wide     = (jpEnd - jpBegin == 2) && (nc - jpBegin * GEMM_NR >= 2 * GEMM_NR);
+
+                const int ipEnd     = ((icb + 1) * mcPanels) < mPanels ? ((icb + 1) * mcPanels) : mPanels;
+
+                for (int ip = icb * mcPanels; ip < ipEnd; ++ip)
+                {
+                    const int ir    = ip * GEMM_MR;
+                    const int mr    = (M - ir) < GEMM_MR ? (M - ir) : GEMM_MR;
+
+                    if(wide && mr == GEMM_MR)
+                    {
+                        const int jr    = jpBegin * GEMM_NR;
+                        float *tileR    = (epi == nullptr || epi->residual == nullptr) ? nullptr : (epi->residual + ir * ldc + jc + jr);
+                        gemmKernelTile6x32(kernels, kc, blockA + ir * kc, packedB + jr * kc, C + ir * ldc + jc + jr, ldc, storage,
+                                           overwrite, epi, ir, tileR);
+                        continue;
+                    }
+
+                    for (int jp = jpBegin; jp < jpEnd; ++jp)
+                    {
+                        const int jr        = jp * GEMM_NR;
+                        const int nr        = (nc - jr) < GEMM_NR ? (nc - jr) : GEMM_NR;
+                        const float *panelB = packedB + jr * kc;
+                        float *tileC        = C + ir * ldc + jc + jr;
+                        float *tileR        = (epi == nullptr || epi->residual == nullptr) ? nullptr : (epi->residual + ir * ldc + jc + jr);
+
+                        if(mr == GEMM_MR && nr == GEMM_NR)
+                        {
+                            gemmKernelTile(kernels, kc, blockA + ir * kc, panelB, tileC, ldc, storage, overwrite, epi, ir, tileR);
+                        }
+                        else
+                        {
+                            float tile[GEMM_MR * GEMM_NR];
+                            gemmKernelTile(kernels, kc, blockA + ir * kc, panelB, tile, GEMM_NR, storage, true);
+                            gemmStoreTile(tile, tileC, ldc, mr, nr, overwrite, epi, ir, tileR);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Gemm::cpuGemmPrePacked(const int &M, const int &N, const int &K, float * const &packedA,
+                            float * const &B, const int &ldb,
+                            float * const &C, const int &ldc, const GemmEpilogue *const &epilogue)
+{
+    gemmPrePackedBlocked(M, N, K, packedA, WEIGHT_F32, [&](const int &pc, const int &kc, const int &jc, const int &nc, float * const &packedB)
+    {
+        cpuGemmPackB(kc, nc, B + pc * ldb + jc, ldb, packedB);
+    }, C, ldc, epilogue);
+}
+
+void Gemm::cpuGemmPrePackedHalf(const int &M, const int &N, const int &K, uint16_t * const &packedA, const WeightStorage &storage,
+                                float * const &B, const int &ldb,
+                                float * const &C, const int &ldc, const GemmEpilogue * const &epilogue)
+{
+    gemmPrePackedBlocked(M, N, K, packedA, storage, [&](const int &pc, const int &kc, const int &jc, const int &nc, float * const &packedB)
+    {
+        cpuGemmPackB(kc, nc, B + pc * ldb + jc, ldb, packedB);
+    }, C, ldc, epilogue);
+}
+
+void Gemm::cpuGemvHalf(const int &M, const int &K, uint16_t * const &A, const WeightStorage &storage, float * const &x, float * const &y)
+{
+    const KernelTable &kernels = Kernels::get();
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int m = 0; m < M; ++m)
+    {
+        y[m] = kernels.dotHalf(K, A + static_cast<size_t>(m) * K, storage, x);
+    }
+}
+
+void Gemm::cpuImplicitGemmPackB(float * const &input, const int &channel, const int &height, const int &width,
+                                const int &kernelH, const int &kernelW, const int &padH, const int &padW,
+                                const int &strideH, const int &strideW, const int &dilationH, const int &dilationW,
+                                const int &outWidth, const int &pc, const int &kc, const int &jc, const int &nc,
+                                float * const &packedB)
+{
+    (void) channel;
+
+    const int nPanels   = (nc + GEMM_NR - 1) / GEMM_NR;
+    const int kSize     = kernelH * kernelW;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int jp = 0; jp < nPanels; ++jp)
+    {
+        const int jr    = jp * GEMM_NR;
+        const int nr    = (nc - jr) < GEMM_NR ? (nc - jr) : GEMM_NR;
+        float *panel    = packedB + jr * kc;
+
+        int iyBase[GEMM_NR];
+        int ixBase[GEMM_NR];
+
+        for (int j = 0; j < nr; ++j)
+        {
+            const int n = jc + jr + j;
+            iyBase[j]   = (n / outWidth) * strideH - padH;
+            ixBase[j]   = (n % outWidth) * strideW - padW;
+        }
+
+        /* a full panel inside one output row reads contiguous input for stride 1 */
+        const bool rowPanel = (nr == GEMM_NR) && (strideW == 1) && (iyBase[0] == iyBase[GEMM_NR - 1]);
+
+        for (int p = 0; p < kc; ++p)
+        {
+            const int k         = pc + p;
+            const int c         = k / kSize;
+            const int ky        = (k / kernelW) % kernelH;
+            const int kx        = k % kernelW;
+            const float *src    = input + c * height * width;
+            float *dst          = panel + p * GEMM_NR;
+
+            if(rowPanel)
+            {
+                const int iy    = iyBase[0] + ky * dilationH;
+                const int ix    = ixBase[0] + kx * dilationW;
+
+                if(iy < 0 || iy >= height)
+                {
+                    memset(dst, 0, GEMM_NR * sizeof(float));
+                    continue;
+                }
+
+                if(ix >= 0 && ix + GEMM_NR <= width)
+                {
+                    memcpy(dst, src + iy * width + ix, GEMM_NR * sizeof(float));
+                    continue;
+                }
+
+                for (int j = 0; j < GEMM_NR; ++j)
+                {
+                    dst[j] = (ix + j >= 0 && ix + j < width) ? src[iy * width + ix + j] : 0.f;
+                }
+                continue;
+            }
+
+            int j = 0;
+            for (; j < nr; ++j)
+            {
+                const int iy    = iyBase[j] + ky * dilationH;
+                const int ix    = ixBase[j] + kx * dilationW;
+                dst[j]          = (iy >= 0 && iy < height && ix >= 0 && ix < width) ? src[iy * width + ix] : 0.f;
+            }
+
+            for (; j < GEMM_NR; ++j)
+            {
+                dst[j] = 0.f;
+            }
+        }
+    }
+}
+
+void Gemm::cpuImplicitGemmConv(const int &M, float * const &packedA, float * const &input, const int &channel, const int &height, const int &width,
+                               const int &kernelH, const int &kernelW, const int &padH, const int &padW,
+                               const int &strideH, const int &strideW, const int &dilationH, const int &dilationW,
+                               float * const &C, const GemmEpilogue *const &epilogue)
+{
+    const int outputH   = (height + 2 * padH - (dilationH * (kernelH - 1) + 1)) / strideH + 1;
+    const int outputW   = (width  + 2 * padW - (dilationW * (kernelW - 1) + 1)) / strideW + 1;
+    const int N         = outputH * outputW;
+    const int K         = channel * kernelH * kernelW;
+
+    gemmPrePackedBlocked(M, N, K, packedA, WEIGHT_F32, [&](const int &pc, const int &kc, const int &jc, const int &nc, float * const &packedB)
+    {
+        cpuImplicitGemmPackB(input, channel, height, width, kernelH, kernelW, padH, padW, strideH, strideW,
+                             dilationH, dilationW, outputW, pc, kc, jc, nc, packedB);
+    }, C, N, epilogue);
+}
 
 void Gemm::swapVal(uint32_t &a0, uint32_t &a1, int &j, unsigned &m)
 {
@@ -1073,6 +1471,7 @@ void Gemm::transposeUint32(uint32_t * const &input, uint32_t * const &output, co
 
 #ifdef USE_X86
 
+MSNH_AVX2_BEGIN
 void Gemm::gemmNNBinMeanTrans(int M, int N, int K, float ALPHA_UNUSED, unsigned char *A, int lda, unsigned char *B, int ldb, float *C, int ldc, float *meanArr)
 {
 
@@ -1174,5 +1573,223 @@ void Gemm::gemmNNBinMeanTrans(int M, int N, int K, float ALPHA_UNUSED, unsigned
         }
     }
 }
+MSNH_AVX2_END
+
+void Gemm::cpuXnorPackWeights(float * const &weights, const int &num, const int &channel, const int &kernelH, const int &kernelW,
+                              uint32_t * const &packed, float * const &meanArr, int * const &tapSums)
+{
+    const int taps      = kernelH * kernelW;
+    const int words     = getXnorWords(channel);
+    const int ld        = getXnorLd(channel, kernelH, kernelW);
+    const int wtSize    = channel * taps;
+
+   memset(packed, 0, static_cast<size_t>(num) * ld * sizeof(uint32_t));
+
+   for (int m = 0; m < num; ++m)
+    {
+        const float *w  = weights + static_cast<size_t>(m) * wtSize;
+        uint32_t *row   = packed + static_cast<size_t>(m) * ld;
+        float mean      = 0.f;
+
+       for (int t = 0; t < taps; ++t)
+        {
+            int sum = 0;
+            for (int c = 0; c < channel; ++c)
+            {
+                const float val = w[c * taps + t];
+                mean           += fabsf(val);
+                if(val > 0)
+                {
+                    row[t * words + c / 32] |= (1u << (c % 32));
+                    sum++;
+                }
+                else
+                {
+                    sum--;
+                }
+            }
+            tapSums[m * taps + t] = sum;
+        }
+
+       meanArr[m]      = mean / wtSize;
+    }
+}
+
+MSNH_AVX2_BEGIN
+/* pixel major sign bits: output[p * words + c / 32] bit c % 32 = input[c][p] > 0 */
+static void xnorPackInput(const float * const &input, const int &channel, const int &size, uint32_t * const &output)
+{
+    const int words = Gemm::getXnorWords(channel);
+
+   for (int w = 0; w < words; ++w)
+    {
+        const int chEnd = (w * 32 + 32) < channel ? (w * 32 + 32) : channel;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
 #endif
+        for (int p = 0; p < size / 8 * 8; p += 8)
+        {
+            __m256i acc = _mm256_setzero_si256();
+            for (int c = w * 32; c < chEnd; ++c)
+            {
+                const __m256i gt = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(input + static_cast<size_t>(c) * size + p), _mm256_setzero_ps(), _CMP_GT_OS));
+                acc = _mm256_or_si256(acc, _mm256_and_si256(gt, _mm256_set1_epi32(static_cast<int>(1u << (c % 32)))));
+            }
+
+           uint32_t bits[8];
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(bits), acc);
+            for (int i = 0; i < 8; ++i)
+            {
+                output[static_cast<size_t>(p + i) * words + w] = bits[i];
+            }
+        }
+
+       for (int p = size / 8 * 8; p < size; ++p)
+        {
+            uint32_t bits = 0;
+            for (int c = w * 32; c < chEnd; ++c)
+            {
+                if(input[static_cast<size_t>(c) * size + p] > 0)
+                {
+                    bits |= (1u << (c % 32));
+                }
+            }
+            output[static_cast<size_t>(p) * words + w] = bits;
+        }
+    }
+}
+MSNH_AVX2_END
+
+void Gemm::cpuXnorConv(float * const &input, const int &channel, const int &height, const int &width,
+                       const int &kernelH, const int &kernelW, const int &padH, const int &padW,
+                       const int &strideH, const int &strideW, const int &dilationH, const int &dilationW,
+                       uint32_t * const &packedWeights, const int &num, float * const &meanArr, const int * const &tapSums,
+                       uint32_t * const &workspace, float * const &output)
+{
+    const int outH      = (height + 2 * padH - (dilationH * (kernelH - 1) + 1)) / strideH + 1;
+    const int outW      = (width  + 2 * padW - (dilationW * (kernelW - 1) + 1)) / strideW + 1;
+    const int N         = outH * outW;
+    const int taps      = kernelH * kernelW;
+    const int words     = getXnorWords(channel);
+    const int ld        = getXnorLd(channel, kernelH, kernelW);
+
+   uint32_t *bitInput  = workspace;
+    uint32_t *bitCols   = workspace + static_cast<size_t>(height) * width * words;
+
+   xnorPackInput(input, channel, height * width, bitInput);
+
+   /* bit im2col, one row of taps * words per output pixel, padded taps stay 0 */
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int oy = 0; oy < outH; ++oy)
+    {
+        for (int ox = 0; ox < outW; ++ox)
+        {
+            uint32_t *row = bitCols + static_cast<size_t>(oy * outW + ox) * ld;
+            memset(row, 0, static_cast<size_t>(ld) * sizeof(uint32_t));
+
+           for (int ky = 0; ky < kernelH; ++ky)
+            {
+                const int iy = oy * strideH - padH + ky * dilationH;
+                if(iy < 0 || iy >= height)
+                {
+                    continue;
+                }
+
+               for (int kx = 0; kx < kernelW; ++kx)
+                {
+                    const int ix = ox * strideW - padW + kx * dilationW;
+                    if(ix >= 0 && ix < width)
+                    {
+                        memcpy(row + (ky * kernelW + kx) * words, bitInput + static_cast<size_t>(iy * width + ix) * words, words * sizeof(uint32_t));
+                    }
+                }
+            }
+        }
+    }
+
+   gemmNNBinMeanTrans(num, N, taps * words * 32, 1.f, reinterpret_cast<unsigned char *>(packedWeights), ld * 32,
+                       reinterpret_cast<unsigned char *>(bitCols), ld * 32, output, N, meanArr);
+
+   /* unused channel bits are 0 in both operands and count as matches, padded taps match wherever the weight is -1.
+     * The padded taps of the border pixels are listed once, then each filter adds its tap sums for them */
+    const int chPad = (words * 32 - channel) * taps;
+
+   std::vector<int> borderPix;
+    std::vector<int> borderTaps;
+    std::vector<int> borderStart(1, 0);
+    for (int oy = 0; oy < outH; ++oy)
+    {
+        for (int ox = 0; ox < outW; ++ox)
+        {
+            for (int ky = 0; ky < kernelH; ++ky)
+            {
+                const int iy = oy * strideH - padH + ky * dilationH;
+                for (int kx = 0; kx < kernelW; ++kx)
+                {
+                    const int ix = ox * strideW - padW + kx * dilationW;
+                    if(iy < 0 || iy >= height || ix < 0 || ix >= width)
+                    {
+                        borderTaps.push_back(ky * kernelW + kx);
+                    }
+                }
+            }
+
+           if(static_cast<int>(borderTaps.size()) != borderStart.back())
+            {
+                borderPix.push_back(oy * outW + ox);
+                borderStart.push_back(static_cast<int>(borderTaps.size()));
+            }
+        }
+    }
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int m = 0; m < num; ++m)
+    {
+        const int *sums     = tapSums + m * taps;
+        float *out          = output + static_cast<size_t>(m) * N;
+        const float mean    = meanArr[m];
+        const float shift   = -chPad * mean;
+
+       if(chPad != 0)
+        {
+            for (int n = 0; n < N; ++n)
+            {
+                out[n] += shift;
+            }
+        }
+
+       for (size_t b = 0; b < borderPix.size(); ++b)
+        {
+            int corr = 0;
+            for (int t = borderStart[b]; t < borderStart[b + 1]; ++t)
+            {
+                corr += sums[borderTaps[t]];
+            }
+            out[borderPix[b]] += corr * mean;
+        }
+    }
+}
+#endif
+
+int Gemm::getXnorWords(const int &channel)
+{
+    return (channel + 31) / 32;
+}
+
+int Gemm::getXnorLd(const int &channel, const int &kernelH, const int &kernelW)
+{
+    return (kernelH * kernelW * getXnorWords(channel) + 7) / 8 * 8;
+}
+
+size_t Gemm::getXnorWorkSpaceSize(const int &channel, const int &height, const int &width, const int &kernelH, const int &kernelW,
+                                  const int &outHeight, const int &outWidth)
+{
+    return static_cast<size_t>(height) * width * getXnorWords(channel) +
+           static_cast<size_t>(outHeight) * outWidth * getXnorLd(channel, kernelH, kernelW);
+}
 }
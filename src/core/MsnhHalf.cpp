@@ -0,0 +1,132 @@
+﻿#include "Msnhnet/core/MsnhHalf.h"
+#include <string.h>
+
+namespace Msnhnet
+{
+uint16_t Half::floatToHalf(const float &val)
+{
+    uint32_t x = 0;
+    memcpy(&x, &val, sizeof(x));
+
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const uint32_t absx = x & 0x7fffffff;
+
+    if(absx > 0x7f800000)
+    {
+        return static_cast<uint16_t>(sign | 0x7e00);
+    }
+
+    /* 65520 and up round to inf */
+    if(absx >= 0x477ff000)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+
+    /* below 2^-14 the result is subnormal */
+    if(absx < 0x38800000)
+    {
+        if(absx < 0x33000000)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+
+        const uint32_t mant     = (absx & 0x7fffff) | 0x800000;
+        const uint32_t shift    = 126 - (absx >> 23);
+        const uint32_t rem      = mant & ((1u << shift) - 1);
+        const uint32_t half     = 1u << (shift - 1);
+        uint32_t h              = mant >> shift;
+
+        if(rem > half || (rem == half && (h & 1)))
+        {
+            h++;
+        }
+        return static_cast<uint16_t>(sign | h);
+    }
+
+    uint32_t h          = (absx - 0x38000000) >> 13;
+    const uint32_t rem  = absx & 0x1fff;
+
+    if(rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+    {
+        h++;
+    }
+    return static_cast<uint16_t>(sign | h);
+}
+
+float Half::halfToFloat(const uint16_t &val)
+{
+    const uint32_t sign = static_cast<uint32_t>(val & 0x8000) << 16;
+    int32_t  exp        = (val >> 10) & 0x1f;
+    uint32_t mant       = val & 0x3ff;
+    uint32_t x          = 0;
+
+    if(exp == 0)
+    {
+        if(mant == 0)
+        {
+            x = sign;
+        }
+        else
+        {
+            exp = 1;
+            while((mant & 0x400) == 0)
+            {
+                mant <<= 1;
+                exp--;
+            }
+            x = sign | (static_cast<uint32_t>(exp + 112) << 23) | ((mant & 0x3ff) << 13);
+        }
+    }
+    else if(exp == 31)
+    {
+        x = sign | 0x7f800000 | (mant << 13);
+    }
+    else
+    {
+        x = sign | (static_cast<uint32_t>(exp + 112) << 23) | (mant << 13);
+    }
+
+    float out = 0;
+    memcpy(&out, &x, sizeof(out));
+    return out;
+}
+
+uint16_t Half::floatToBFloat16(const float &val)
+{
+    uint32_t x = 0;
+    memcpy(&x, &val, sizeof(x));
+
+    if((x & 0x7fffffff) > 0x7f800000)
+    {
+        return static_cast<uint16_t>((x >> 16) | 0x40);
+    }
+
+    return static_cast<uint16_t>((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+float Half::bFloat16ToFloat(const uint16_t &val)
+{
+    const uint32_t x = static_cast<uint32_t>(val) << 16;
+    float out = 0;
+    memcpy(&out, &x, sizeof(out));
+    return out;
+}
+
+uint16_t Half::fromFloat(const float &val, const WeightStorage &storage)
+{
+    return (storage == WEIGHT_BF16) ? floatToBFloat16(val) : floatToHalf(val);
+}
+
+float Half::toFloat(const uint16_t &val, const WeightStorage &storage)
+{
+    return (storage == WEIGHT_BF16) ? bFloat16ToFloat(val) : halfToFloat(val);
+}
+
+void Half::fromFloat(const float * const &src, const size_t &n, const WeightStorage &storage, uint16_t * const &dst)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        dst[i] = fromFloat(src[i], storage);
+    }
+}
+}
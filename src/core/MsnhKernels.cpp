@@ -0,0 +1,96 @@
+﻿#include "Msnhnet/core/MsnhKernels.h"
+
+namespace Msnhnet
+{
+std::atomic<const KernelTable *> Kernels::current(nullptr);
+SimdInfo Kernels::detected;
+
+const KernelTable &Kernels::get()
+{
+    const KernelTable *table = current.load(std::memory_order_acquire);
+    if(table == nullptr)
+    {
+        SimdInfo info;
+#ifdef USE_X86
+        info.checkSimd();
+#endif
+        init(info);
+        table = current.load(std::memory_order_acquire);
+    }
+    return *table;
+}
+
+void Kernels::init(const SimdInfo &info)
+{
+    detected = info;
+
+    const KernelIsa order[6] = {ISA_AVX512_VNNI, ISA_AVX512, ISA_AVX2, ISA_SSE4, ISA_NEON, ISA_GENERIC};
+    for (int i = 0; i < 6; ++i)
+    {
+        const KernelTable *table = getTable(order[i]);
+        if(table != nullptr && isSupported(order[i], info))
+        {
+            current.store(table, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+bool Kernels::select(const KernelIsa &isa)
+{
+    get();
+
+    const KernelTable *table = getTable(isa);
+    if(table == nullptr || !isSupported(isa, detected))
+    {
+        return false;
+    }
+
+    current.store(table, std::memory_order_release);
+    return true;
+}
+
+const KernelTable *Kernels::getTable(const KernelIsa &isa)
+{
+    switch (isa)
+    {
+    case ISA_SSE4:
+        return sse4Table();
+    case ISA_AVX2:
+        return avx2Table();
+    case ISA_AVX512:
+        return avx512Table();
+    case ISA_AVX512_VNNI:
+        return avx512VnniTable();
+    case ISA_NEON:
+        return neonTable();
+    default:
+        return genericTable();
+    }
+}
+
+bool Kernels::isSupported(const KernelIsa &isa, const SimdInfo &info)
+{
+#ifdef USE_X86
+    switch (isa)
+    {
+    case ISA_SSE4:
+        return info.getSupportSSE4_1();
+    case ISA_AVX2:
+        return info.getSupportAVX2() && info.getSupportFMA3() && info.getSupportF16C();
+    case ISA_AVX512:
+        /* the int8 tile needs the byte / word ops of avx512bw */
+        return info.getSupportAVX512() && info.getSupportAVX512BW() && isSupported(ISA_AVX2, info);
+    case ISA_AVX512_VNNI:
+        return info.getSupportAVX512VNNI() && isSupported(ISA_AVX512, info);
+    case ISA_NEON:
+        return false;
+    default:
+        return true;
+    }
+#else
+    (void)info;
+    return isa == ISA_GENERIC || isa == ISA_NEON;
+#endif
+}
+}
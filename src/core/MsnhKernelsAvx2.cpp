@@ -0,0 +1,689 @@
+﻿#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/core/MsnhHalf.h"
+
+#ifdef USE_X86
+#include <math.h>
+#include <immintrin.h>
+
+namespace Msnhnet
+{
+static inline __m256 avx2EpilogueActivate(const __m256 &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return _mm256_max_ps(x, _mm256_setzero_ps());
+    case RELU6:
+        return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(6.f));
+    case LEAKY:
+        return _mm256_blendv_ps(_mm256_mul_ps(x, _mm256_set1_ps(actParam)), x, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+    default:
+        return x;
+    }
+}
+
+static inline void avx2StoreRow(float *const &c, const __m256 &c0, const __m256 &c1, const bool &overwrite,
+                                const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    __m256 v0 = overwrite ? c0 : _mm256_add_ps(_mm256_loadu_ps(c), c0);
+    __m256 v1 = overwrite ? c1 : _mm256_add_ps(_mm256_loadu_ps(c + 8), c1);
+
+    if(epi != nullptr)
+    {
+        if(epi->bias != nullptr)
+        {
+            const __m256 bias = _mm256_set1_ps(epi->bias[row]);
+            v0 = _mm256_add_ps(v0, bias);
+            v1 = _mm256_add_ps(v1, bias);
+        }
+
+        v0 = avx2EpilogueActivate(v0, epi->activation, epi->actParam);
+        v1 = avx2EpilogueActivate(v1, epi->activation, epi->actParam);
+
+        if(res != nullptr)
+        {
+            v0 = _mm256_add_ps(v0, _mm256_loadu_ps(res));
+            v1 = _mm256_add_ps(v1, _mm256_loadu_ps(res + 8));
+        }
+
+        v0 = avx2EpilogueActivate(v0, epi->postActivation, epi->postActParam);
+        v1 = avx2EpilogueActivate(v1, epi->postActivation, epi->postActParam);
+    }
+
+    _mm256_storeu_ps(c, v0);
+    _mm256_storeu_ps(c + 8, v1);
+}
+
+static void avx2Gemm6x16(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                         const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    __m256 c00 = _mm256_setzero_ps();
+    __m256 c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps();
+    __m256 c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps();
+    __m256 c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps();
+    __m256 c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps();
+    __m256 c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps();
+    __m256 c51 = _mm256_setzero_ps();
+
+    for (int p = 0; p < kc; ++p)
+    {
+        const __m256 b0 = _mm256_load_ps(b);
+        const __m256 b1 = _mm256_load_ps(b + 8);
+        __m256 a0;
+
+        a0  = _mm256_broadcast_ss(a + 0);
+        c00 = _mm256_fmadd_ps(a0, b0, c00);
+        c01 = _mm256_fmadd_ps(a0, b1, c01);
+
+        a0  = _mm256_broadcast_ss(a + 1);
+        c10 = _mm256_fmadd_ps(a0, b0, c10);
+        c11 = _mm256_fmadd_ps(a0, b1, c11);
+
+        a0  = _mm256_broadcast_ss(a + 2);
+        c20 = _mm256_fmadd_ps(a0, b0, c20);
+        c21 = _mm256_fmadd_ps(a0, b1, c21);
+
+        a0  = _mm256_broadcast_ss(a + 3);
+        c30 = _mm256_fmadd_ps(a0, b0, c30);
+        c31 = _mm256_fmadd_ps(a0, b1, c31);
+
+        a0  = _mm256_broadcast_ss(a + 4);
+        c40 = _mm256_fmadd_ps(a0, b0, c40);
+        c41 = _mm256_fmadd_ps(a0, b1, c41);
+
+        a0  = _mm256_broadcast_ss(a + 5);
+        c50 = _mm256_fmadd_ps(a0, b0, c50);
+        c51 = _mm256_fmadd_ps(a0, b1, c51);
+
+        a  += 6;
+        b  += 16;
+    }
+
+    avx2StoreRow(C          , c00, c01, overwrite, epi, row    , (res == nullptr) ? nullptr : res);
+    avx2StoreRow(C +     ldc, c10, c11, overwrite, epi, row + 1, (res == nullptr) ? nullptr : res +     ldc);
+    avx2StoreRow(C + 2 * ldc, c20, c21, overwrite, epi, row + 2, (res == nullptr) ? nullptr : res + 2 * ldc);
+    avx2StoreRow(C + 3 * ldc, c30, c31, overwrite, epi, row + 3, (res == nullptr) ? nullptr : res + 3 * ldc);
+    avx2StoreRow(C + 4 * ldc, c40, c41, overwrite, epi, row + 4, (res == nullptr) ? nullptr : res + 4 * ldc);
+    avx2StoreRow(C + 5 * ldc, c50, c51, overwrite, epi, row + 5, (res == nullptr) ? nullptr : res + 5 * ldc);
+}
+
+/* the 6x16 tile with fp16 / bf16 a. The 6 weights of one k step are widened with a single 8 lane load (hence
+ * GEMM_HALF_PAD) and broadcast per row with a lane permute */
+template<bool BF16>
+static void avx2Kernel6x16Half(const int &kc, const uint16_t *a, const float *b, float *const &C, const int &ldc,
+                               const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    __m256 c00 = _mm256_setzero_ps();
+    __m256 c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps();
+    __m256 c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps();
+    __m256 c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps();
+    __m256 c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps();
+    __m256 c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps();
+    __m256 c51 = _mm256_setzero_ps();
+
+    const __m256i r0 = _mm256_set1_epi32(0);
+    const __m256i r1 = _mm256_set1_epi32(1);
+    const __m256i r2 = _mm256_set1_epi32(2);
+    const __m256i r3 = _mm256_set1_epi32(3);
+    const __m256i r4 = _mm256_set1_epi32(4);
+    const __m256i r5 = _mm256_set1_epi32(5);
+
+    for (int p = 0; p < kc; ++p)
+    {
+        const __m256 b0 = _mm256_load_ps(b);
+        const __m256 b1 = _mm256_load_ps(b + 8);
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+        __m256 aw;
+        __m256 a0;
+
+        if(BF16)
+        {
+            aw = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+        }
+        else
+        {
+            aw = _mm256_cvtph_ps(h);
+        }
+
+        a0  = _mm256_permutevar8x32_ps(aw, r0);
+        c00 = _mm256_fmadd_ps(a0, b0, c00);
+        c01 = _mm256_fmadd_ps(a0, b1, c01);
+
+        a0  = _mm256_permutevar8x32_ps(aw, r1);
+        c10 = _mm256_fmadd_ps(a0, b0, c10);
+        c11 = _mm256_fmadd_ps(a0, b1, c11);
+
+        a0  = _mm256_permutevar8x32_ps(aw, r2);
+        c20 = _mm256_fmadd_ps(a0, b0, c20);
+        c21 = _mm256_fmadd_ps(a0, b1, c21);
+
+        a0  = _mm256_permutevar8x32_ps(aw, r3);
+        c30 = _mm256_fmadd_ps(a0, b0, c30);
+        c31 = _mm256_fmadd_ps(a0, b1, c31);
+
+        a0  = _mm256_permutevar8x32_ps(aw, r4);
+        c40 = _mm256_fmadd_ps(a0, b0, c40);
+        c41 = _mm256_fmadd_ps(a0, b1, c41);
+
+        a0  = _mm256_permutevar8x32_ps(aw, r5);
+        c50 = _mm256_fmadd_ps(a0, b0, c50);
+        c51 = _mm256_fmadd_ps(a0, b1, c51);
+
+        a  += 6;
+        b  += 16;
+    }
+
+    avx2StoreRow(C          , c00, c01, overwrite, epi, row    , (res == nullptr) ? nullptr : res);
+    avx2StoreRow(C +     ldc, c10, c11, overwrite, epi, row + 1, (res == nullptr) ? nullptr : res +     ldc);
+    avx2StoreRow(C + 2 * ldc, c20, c21, overwrite, epi, row + 2, (res == nullptr) ? nullptr : res + 2 * ldc);
+    avx2StoreRow(C + 3 * ldc, c30, c31, overwrite, epi, row + 3, (res == nullptr) ? nullptr : res + 3 * ldc);
+    avx2StoreRow(C + 4 * ldc, c40, c41, overwrite, epi, row + 4, (res == nullptr) ? nullptr : res + 4 * ldc);
+    avx2StoreRow(C + 5 * ldc, c50, c51, overwrite, epi, row + 5, (res == nullptr) ? nullptr : res + 5 * ldc);
+}
+
+static void avx2Gemm6x16Half(const int &kc, const uint16_t *a, const WeightStorage &storage, const float *b, float *const &C, const int &ldc,
+                             const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    if(storage == WEIGHT_BF16)
+    {
+        avx2Kernel6x16Half<true>(kc, a, b, C, ldc, overwrite, epi, row, res);
+    }
+    else
+    {
+        avx2Kernel6x16Half<false>(kc, a, b, C, ldc, overwrite, epi, row, res);
+    }
+}
+
+static inline __m256 avx2WidenHalf(const uint16_t *const &a, const bool &bf16)
+{
+    const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+    return bf16 ? _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16)) : _mm256_cvtph_ps(h);
+}
+
+static float avx2DotHalf(const int &K, const uint16_t *const &a, const WeightStorage &storage, const float *const &x)
+{
+    const bool bf16 = (storage == WEIGHT_BF16);
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+
+    int k = 0;
+    for (; k + 16 <= K; k += 16)
+    {
+        s0 = _mm256_fmadd_ps(avx2WidenHalf(a + k, bf16), _mm256_loadu_ps(x + k), s0);
+        s1 = _mm256_fmadd_ps(avx2WidenHalf(a + k + 8, bf16), _mm256_loadu_ps(x + k + 8), s1);
+    }
+
+    s0 = _mm256_add_ps(s0, s1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+
+    float sum = _mm_cvtss_f32(s);
+    for (; k < K; ++k)
+    {
+        sum += Half::toFloat(a[k], storage) * x[k];
+    }
+    return sum;
+}
+
+static inline float avx2ScalarActivate(const float &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return (x > 0) ? x : 0;
+    case RELU6:
+        return (x > 0) ? ((x > 6) ? 6 : x) : 0;
+    case LEAKY:
+        return (x > 0) ? x : actParam*x;
+    default:
+        return x;
+    }
+}
+
+static inline void avx2QuantStoreRow(float *const &c, const __m256i &acc0, const __m256i &acc1, const QuantTile &t, const int &row,
+                                     const float *const &res)
+{
+    const __m256i zp    = _mm256_set1_epi32(t.inZeroPoint * t.rowSums[row]);
+    const __m256 scale  = _mm256_set1_ps(t.wScales[row] * t.inScale);
+
+    __m256 v0 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(acc0, zp)), scale);
+    __m256 v1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(acc1, zp)), scale);
+
+    if(t.epi->bias != nullptr)
+    {
+        const __m256 bias = _mm256_set1_ps(t.epi->bias[row]);
+        v0 = _mm256_add_ps(v0, bias);
+        v1 = _mm256_add_ps(v1, bias);
+    }
+
+    v0 = avx2EpilogueActivate(v0, t.epi->activation, t.epi->actParam);
+    v1 = avx2EpilogueActivate(v1, t.epi->activation, t.epi->actParam);
+
+    if(res != nullptr)
+    {
+        v0 = _mm256_add_ps(v0, _mm256_loadu_ps(res));
+        v1 = _mm256_add_ps(v1, _mm256_loadu_ps(res + 8));
+    }
+
+    v0 = avx2EpilogueActivate(v0, t.epi->postActivation, t.epi->postActParam);
+    v1 = avx2EpilogueActivate(v1, t.epi->postActivation, t.epi->postActParam);
+
+    _mm256_storeu_ps(c, v0);
+    _mm256_storeu_ps(c + 8, v1);
+}
+
+static inline void avx2QuantStoreTile(const __m256i &c00, const __m256i &c01, const __m256i &c10, const __m256i &c11,
+                                      const __m256i &c20, const __m256i &c21, const __m256i &c30, const __m256i &c31, const QuantTile &t)
+{
+    if(t.mr == 4 && t.nr == 16)
+    {
+        avx2QuantStoreRow(t.C,             c00, c01, t, t.row,     t.res);
+        avx2QuantStoreRow(t.C + t.ldc,     c10, c11, t, t.row + 1, (t.res == nullptr) ? nullptr : (t.res + t.ldc));
+        avx2QuantStoreRow(t.C + 2 * t.ldc, c20, c21, t, t.row + 2, (t.res == nullptr) ? nullptr : (t.res + 2 * t.ldc));
+        avx2QuantStoreRow(t.C + 3 * t.ldc, c30, c31, t, t.row + 3, (t.res == nullptr) ? nullptr : (t.res + 3 * t.ldc));
+        return;
+    }
+
+    int32_t tile[4 * 16];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile),      c00);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile + 8),  c01);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile + 16), c10);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile + 24), c11);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile + 32), c20);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile + 40), c21);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile + 48), c30);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile + 56), c31);
+
+    for (int i = 0; i < t.mr; ++i)
+    {
+        const int row       = t.row + i;
+        const float scale   = t.wScales[row] * t.inScale;
+        const int32_t zp    = t.inZeroPoint * t.rowSums[row];
+
+        for (int j = 0; j < t.nr; ++j)
+        {
+            float x = static_cast<float>(tile[i * 16 + j] - zp) * scale;
+            if(t.epi->bias != nullptr)
+            {
+                x += t.epi->bias[row];
+            }
+            x = avx2ScalarActivate(x, t.epi->activation, t.epi->actParam);
+            if(t.res != nullptr)
+            {
+                x += t.res[i * t.ldc + j];
+            }
+            t.C[i * t.ldc + j] = avx2ScalarActivate(x, t.epi->postActivation, t.epi->postActParam);
+        }
+    }
+}
+
+/* b holds 8 cols x 4 k of u8 per 32 bytes, a is 4 k of s8 of one row broadcast to every col */
+static inline __m256i avx2QuantDot(const __m256i &acc, const __m256i &b, const __m256i &a)
+{
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(b, a), _mm256_set1_epi16(1)));
+}
+
+static void avx2QuantGemm4x16(const int &k4, const int8_t *a, const uint8_t *b, const QuantTile &t)
+{
+    __m256i c00 = _mm256_setzero_si256();
+    __m256i c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256();
+    __m256i c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256();
+    __m256i c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256();
+    __m256i c31 = _mm256_setzero_si256();
+
+    for (int p = 0; p < k4; ++p)
+    {
+        const __m256i b0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(b));
+        const __m256i b1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(b + 32));
+
+        __m256i a0  = _mm256_set1_epi32(*reinterpret_cast<const int32_t *>(a));
+        c00         = avx2QuantDot(c00, b0, a0);
+        c01         = avx2QuantDot(c01, b1, a0);
+        a0          = _mm256_set1_epi32(*reinterpret_cast<const int32_t *>(a + 4));
+        c10         = avx2QuantDot(c10, b0, a0);
+        c11         = avx2QuantDot(c11, b1, a0);
+        a0          = _mm256_set1_epi32(*reinterpret_cast<const int32_t *>(a + 8));
+        c20         = avx2QuantDot(c20, b0, a0);
+        c21         = avx2QuantDot(c21, b1, a0);
+        a0          = _mm256_set1_epi32(*reinterpret_cast<const int32_t *>(a + 12));
+        c30         = avx2QuantDot(c30, b0, a0);
+        c31         = avx2QuantDot(c31, b1, a0);
+
+        a          += 16;
+        b          += 64;
+    }
+
+    avx2QuantStoreTile(c00, c01, c10, c11, c20, c21, c30, c31, t);
+}
+
+static inline uint8_t avx2QuantActivation(const float &x, const float &inv, const int &zeroPoint)
+{
+    float v = x * inv;
+    v       = (v < -zeroPoint) ? -zeroPoint : ((v > 127 - zeroPoint) ? 127 - zeroPoint : v);
+    return static_cast<uint8_t>(static_cast<int>(nearbyintf(v)) + zeroPoint);
+}
+
+static inline __m256i avx2QuantActivation8(const float *const &x, const __m256 &inv, const __m256 &lo, const __m256 &hi, const __m256i &zp)
+{
+    const __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(x), inv), lo), hi);
+    return _mm256_add_epi32(_mm256_cvtps_epi32(v), zp);
+}
+
+static void avx2QuantPackB(const float *const &B, const int &ldb, const int &K, const int &nr, const float &inv, const int &zeroPoint,
+                           uint8_t *const &panel)
+{
+    const int K4        = (K + 3) / 4;
+    const __m256 mInv   = _mm256_set1_ps(inv);
+    const __m256 lo     = _mm256_set1_ps(static_cast<float>(-zeroPoint));
+    const __m256 hi     = _mm256_set1_ps(static_cast<float>(127 - zeroPoint));
+    const __m256i zp    = _mm256_set1_epi32(zeroPoint);
+
+    for (int k4 = 0; k4 < K4; ++k4)
+    {
+        uint8_t *dst    = panel + k4 * 64;
+        const int k     = k4 * 4;
+
+        if(nr == 16 && k + 3 < K)
+        {
+            for (int h = 0; h < 16; h += 8)
+            {
+                const __m256i r0 = avx2QuantActivation8(B + static_cast<size_t>(k) * ldb + h, mInv, lo, hi, zp);
+                const __m256i r1 = avx2QuantActivation8(B + static_cast<size_t>(k + 1) * ldb + h, mInv, lo, hi, zp);
+                const __m256i r2 = avx2QuantActivation8(B + static_cast<size_t>(k + 2) * ldb + h, mInv, lo, hi, zp);
+                const __m256i r3 = avx2QuantActivation8(B + static_cast<size_t>(k + 3) * ldb + h, mInv, lo, hi, zp);
+
+                const __m256i w  = _mm256_or_si256(_mm256_or_si256(r0, _mm256_slli_epi32(r1, 8)),
+                                                   _mm256_or_si256(_mm256_slli_epi32(r2, 16), _mm256_slli_epi32(r3, 24)));
+                _mm256_store_si256(reinterpret_cast<__m256i *>(dst + h * 4), w);
+            }
+            continue;
+        }
+
+        for (int j = 0; j < 16; ++j)
+        {
+            for (int s = 0; s < 4; ++s)
+            {
+                dst[j * 4 + s] = (j < nr && k + s < K) ? avx2QuantActivation(B[static_cast<size_t>(k + s) * ldb + j], inv, zeroPoint) : 0;
+            }
+        }
+    }
+}
+
+static inline int32_t avx2Hsum(const __m256i &v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s         = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s         = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+static int32_t avx2QuantDotRow(const int &stride, const uint8_t *const &x, const int8_t *const &a)
+{
+    __m256i acc = _mm256_setzero_si256();
+    for (int k = 0; k < stride; k += 32)
+    {
+        acc = avx2QuantDot(acc, _mm256_load_si256(reinterpret_cast<const __m256i *>(x + k)),
+                           _mm256_load_si256(reinterpret_cast<const __m256i *>(a + k)));
+    }
+    return avx2Hsum(acc);
+}
+
+static inline float avx2Im2colPixel(const float *const &input, const int &height, const int &width, int row, int col, const int &channel)
+{
+    row -= 1;
+    col -= 1;
+    if(row < 0 || col < 0 || row >= height || col >= width)
+    {
+        return 0;
+    }
+    return input[col + width*(row + height*channel)];
+}
+
+static void avx2Im2col3x3(const float *const &input, const int &height, const int &width, const int &rowBegin, const int &rowEnd,
+                          float *const &output)
+{
+    for (int ch = rowBegin; ch < rowEnd; ++ch)
+    {
+        const int wOffset   = ch % 3;
+        const int hOffset   = (ch / 3) % 3;
+        const int chOff     = ch / 9;
+        float *out          = output + static_cast<size_t>(ch) * height * width;
+
+        for (int h = 1; h < height - 1; ++h)
+        {
+            const float *in = input + wOffset - 1 + width*(hOffset + h - 1 + height * chOff);
+            int w = 1;
+            for (; w < width - 1 - 8; w += 8)
+            {
+                _mm256_storeu_ps(out + h * width + w, _mm256_loadu_ps(in + w));
+            }
+            for (; w < width - 1; ++w)
+            {
+                out[h * width + w] = in[w];
+            }
+        }
+
+        for (int h = 0; h < height; ++h)
+        {
+            out[h * width]              = avx2Im2colPixel(input, height, width, hOffset + h, wOffset, chOff);
+            out[h * width + width - 1]  = avx2Im2colPixel(input, height, width, hOffset + h, wOffset + width - 1, chOff);
+        }
+
+        for (int w = 0; w < width; ++w)
+        {
+            out[w]                          = avx2Im2colPixel(input, height, width, hOffset, wOffset + w, chOff);
+            out[(height - 1) * width + w]   = avx2Im2colPixel(input, height, width, hOffset + height - 1, wOffset + w, chOff);
+        }
+    }
+}
+
+static inline float avx2PoolPixel(const float *const &src, const int &kSizeX, const int &kSizeY, const int &width, const int &height,
+                                 const int &widthOffset, const int &y, const int &x, const int &k)
+{
+    float max = -FLT_MAX;
+    for (int n = 0; n < kSizeY; ++n)
+    {
+        for (int m = 0; m < kSizeX; ++m)
+        {
+            const int curHeight = y + n;
+            const int curWidth  = widthOffset + x + m;
+            const bool valid    = (curHeight >= 0 && curHeight < height && curWidth >= 0 && curWidth < width);
+            const float value   = valid ? src[curWidth + width*(curHeight + height*k)] : -FLT_MAX;
+
+            max = (value > max) ? value : max;
+        }
+    }
+    return max;
+}
+
+static void avx2MaxPool(const float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY, const int &width, const int &height,
+                        const int &outWidth, const int &outHeight, const int &paddingX, const int &paddingY, const int &stride, const int &channels)
+{
+    const int widthOffset  = -(paddingX + 1)/2;
+    const int heightOffset = -(paddingY + 1)/2;
+    const int jLeft        = (widthOffset < 0) ? (-widthOffset + stride - 1) / stride : 0;
+    const int jBegin       = (jLeft < outWidth) ? jLeft : outWidth;
+
+    for (int k = 0; k < channels; ++k)
+    {
+        for (int i = 0; i < outHeight; ++i)
+        {
+            /* the vector loops only take columns whose window rows lie inside the image, the borders are scalar */
+            int j = 0;
+            for (; j < jBegin; ++j)
+            {
+                dst[j + outWidth*(i + outHeight*k)] = avx2PoolPixel(src, kSizeX, kSizeY, width, height, widthOffset, heightOffset + i*stride, j*stride, k);
+            }
+
+            if(stride == 1)
+            {
+                for (; j + 8 <= outWidth && widthOffset + j + 8 + kSizeX - 1 <= width; j += 8)
+                {
+                    __m256 max256 = _mm256_set1_ps(-FLT_MAX);
+                    for (int n = 0; n < kSizeY; ++n)
+                    {
+                        for (int m = 0; m < kSizeX; ++m)
+                        {
+                            const int curHeight = heightOffset + i*stride + n;
+                            const int curWidth  = widthOffset  + j*stride + m;
+                            if(curHeight < 0 || curHeight >= height)
+                            {
+                                continue;
+                            }
+                            max256 = _mm256_max_ps(_mm256_loadu_ps(&src[curWidth + width*(curHeight + height*k)]), max256);
+                        }
+                    }
+                    _mm256_storeu_ps(&dst[j + outWidth*(i + outHeight*k)], max256);
+                }
+            }
+            else if(kSizeX == 2 && kSizeY == 2 && stride == 2)
+            {
+                for (; j + 4 <= outWidth && widthOffset + j*stride + 8 <= width; j += 4)
+                {
+                    __m128 max128 = _mm_set1_ps(-FLT_MAX);
+                    for (int n = 0; n < kSizeY; ++n)
+                    {
+                        const int curHeight = heightOffset + i*stride + n;
+                        const int curWidth  = widthOffset  + j*stride;
+                        if(curHeight < 0 || curHeight >= height)
+                        {
+                            continue;
+                        }
+
+                        /* max of neighbour pairs, then the even lanes of both halves */
+                        const __m256 src256 = _mm256_loadu_ps(&src[curWidth + width*(curHeight + height*k)]);
+                        const __m256 max256 = _mm256_max_ps(src256, _mm256_permute_ps(src256, 0b10110001));
+                        const __m128 src128 = _mm_shuffle_ps(_mm256_extractf128_ps(max256, 0), _mm256_extractf128_ps(max256, 1), 0b10001000);
+
+                        max128 = _mm_max_ps(src128, max128);
+                    }
+                    _mm_storeu_ps(&dst[j + outWidth*(i + outHeight*k)], max128);
+                }
+            }
+
+            for (; j < outWidth; ++j)
+            {
+                dst[j + outWidth*(i + outHeight*k)] = avx2PoolPixel(src, kSizeX, kSizeY, width, height, widthOffset, heightOffset + i*stride, j*stride, k);
+            }
+        }
+    }
+}
+
+static void avx2BatchNorm(const float *const &src, float *const &dst, const int &size, const float &scale, const float &mean,
+                          const float &variance, const float &bias)
+{
+    const __m256 mScale = _mm256_set1_ps(scale);
+    const __m256 mMean  = _mm256_set1_ps(mean);
+    const __m256 mBias  = _mm256_set1_ps(bias);
+    const __m256 mStd   = _mm256_sqrt_ps(_mm256_add_ps(_mm256_set1_ps(variance), _mm256_set1_ps(0.00001f)));
+
+    int i = 0;
+    for (; i < size - 7; i += 8)
+    {
+        const __m256 x = _mm256_mul_ps(mScale, _mm256_sub_ps(_mm256_loadu_ps(src + i), mMean));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_div_ps(x, mStd), mBias));
+    }
+
+    for (; i < size; ++i)
+    {
+        dst[i] = scale*(src[i] - mean)/sqrtf(variance + 0.00001f) + bias;
+    }
+}
+
+static bool avx2Activate(float *const &x, const int &num, const ActivationType &actType, const float &param)
+{
+    const __m256 zero   = _mm256_setzero_ps();
+    const __m256 one    = _mm256_set1_ps(1.f);
+    int i = 0;
+
+    switch (actType)
+    {
+    case LINEAR:
+        return true;
+    case RELU:
+        for (; i < num - 7; i += 8)
+        {
+            const __m256 v = _mm256_loadu_ps(x + i);
+            _mm256_storeu_ps(x + i, _mm256_mul_ps(v, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GT_OQ), one)));
+        }
+        for (; i < num; ++i)
+        {
+            x[i] = x[i]*(x[i]>0);
+        }
+        return true;
+    case RELU6:
+        for (; i < num - 7; i += 8)
+        {
+            const __m256 v = _mm256_loadu_ps(x + i);
+            const __m256 r = _mm256_blendv_ps(zero, v, _mm256_cmp_ps(v, zero, _CMP_GT_OQ));
+            _mm256_storeu_ps(x + i, _mm256_blendv_ps(r, _mm256_set1_ps(6.f), _mm256_cmp_ps(r, _mm256_set1_ps(6.f), _CMP_GT_OQ)));
+        }
+        for (; i < num; ++i)
+        {
+            x[i] = (x[i]>0?x[i]:0)>6?6:(x[i]>0?x[i]:0);
+        }
+        return true;
+    case LEAKY:
+    case RELIE:
+    {
+        const float a   = (actType == LEAKY) ? param : .01f;
+        const __m256 k  = _mm256_set1_ps(a);
+        for (; i < num - 7; i += 8)
+        {
+            const __m256 v = _mm256_loadu_ps(x + i);
+            _mm256_storeu_ps(x + i, _mm256_blendv_ps(_mm256_mul_ps(k, v), v, _mm256_cmp_ps(v, zero, _CMP_GT_OQ)));
+        }
+        for (; i < num; ++i)
+        {
+            x[i] = (x[i]>0) ? x[i] : a*x[i];
+        }
+        return true;
+    }
+    case HARDTAN:
+        for (; i < num - 7; i += 8)
+        {
+            const __m256 v = _mm256_loadu_ps(x + i);
+            const __m256 t = _mm256_blendv_ps(v, _mm256_set1_ps(-1.f), _mm256_cmp_ps(v, _mm256_set1_ps(-1.f), _CMP_LT_OQ));
+            _mm256_storeu_ps(x + i, _mm256_blendv_ps(t, one, _mm256_cmp_ps(v, one, _CMP_GT_OQ)));
+        }
+        for (; i < num; ++i)
+        {
+            x[i] = (x[i] < -1) ? -1 : ((x[i] > 1) ? 1 : x[i]);
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+const KernelTable *Kernels::avx2Table()
+{
+    /* the 12 accumulators of the 6x16 tile already take most of the 16 ymm, no 6x32 */
+    static const KernelTable table = {ISA_AVX2, "avx2", avx2Gemm6x16, avx2Gemm6x16Half, nullptr, nullptr, avx2DotHalf, avx2QuantPackB,
+                                      avx2QuantGemm4x16, avx2QuantDotRow, avx2Im2col3x3, avx2MaxPool, avx2BatchNorm, avx2Activate, nullptr};
+    return &table;
+}
+}
+#else
+namespace Msnhnet
+{
+const KernelTable *Kernels::avx2Table()
+{
+    return nullptr;
+}
+}
+#endif
@@ -0,0 +1,717 @@
+﻿#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/core/MsnhHalf.h"
+
+#ifdef USE_X86
+#include <math.h>
+#include <immintrin.h>
+
+namespace Msnhnet
+{
+/* lanes [0, n) of a 16 float vector, the tails load and store through it instead of falling back to scalar loops.
+ * Masked out lanes are never touched in memory, so a tail may end right at the end of an array. */
+static inline __mmask16 avx512Mask(const int &n)
+{
+    return (n >= 16) ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << n) - 1);
+}
+
+static inline __m512 avx512Activate(const __m512 &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_GT_OQ), x);
+    case RELU6:
+        return _mm512_min_ps(_mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_GT_OQ), x), _mm512_set1_ps(6.f));
+    case LEAKY:
+    case RELIE:
+        return _mm512_mask_mul_ps(x, _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LE_OQ), x, _mm512_set1_ps(actParam));
+    case HARDTAN:
+        return _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-1.f)), _mm512_set1_ps(1.f));
+    default:
+        return x;
+    }
+}
+
+static inline void avx512StoreRow(float *const &c, const __m512 &c0, const bool &overwrite,
+                                  const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    __m512 v = overwrite ? c0 : _mm512_add_ps(_mm512_loadu_ps(c), c0);
+
+    if(epi != nullptr)
+    {
+        if(epi->bias != nullptr)
+        {
+            v = _mm512_add_ps(v, _mm512_set1_ps(epi->bias[row]));
+        }
+
+        v = avx512Activate(v, epi->activation, epi->actParam);
+
+        if(res != nullptr)
+        {
+            v = _mm512_add_ps(v, _mm512_loadu_ps(res));
+        }
+
+        v = avx512Activate(v, epi->postActivation, epi->postActParam);
+    }
+
+    _mm512_storeu_ps(c, v);
+}
+
+/* one zmm per row of the tile: 6 accumulators, the b row and one broadcast. Only the edge panels run it, a pair of
+ * full panels goes through avx512Gemm6x32 */
+static void avx512Gemm6x16(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                           const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    __m512 c0 = _mm512_setzero_ps();
+    __m512 c1 = _mm512_setzero_ps();
+    __m512 c2 = _mm512_setzero_ps();
+    __m512 c3 = _mm512_setzero_ps();
+    __m512 c4 = _mm512_setzero_ps();
+    __m512 c5 = _mm512_setzero_ps();
+
+    for (int p = 0; p < kc; ++p)
+    {
+        /* packed b is only 32 byte aligned */
+        const __m512 b0 = _mm512_loadu_ps(b);
+
+        c0  = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b0, c0);
+        c1  = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), b0, c1);
+        c2  = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), b0, c2);
+        c3  = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), b0, c3);
+        c4  = _mm512_fmadd_ps(_mm512_set1_ps(a[4]), b0, c4);
+        c5  = _mm512_fmadd_ps(_mm512_set1_ps(a[5]), b0, c5);
+
+        a  += 6;
+        b  += 16;
+    }
+
+    avx512StoreRow(C          , c0, overwrite, epi, row    , (res == nullptr) ? nullptr : res);
+    avx512StoreRow(C +     ldc, c1, overwrite, epi, row + 1, (res == nullptr) ? nullptr : res +     ldc);
+    avx512StoreRow(C + 2 * ldc, c2, overwrite, epi, row + 2, (res == nullptr) ? nullptr : res + 2 * ldc);
+    avx512StoreRow(C + 3 * ldc, c3, overwrite, epi, row + 3, (res == nullptr) ? nullptr : res + 3 * ldc);
+    avx512StoreRow(C + 4 * ldc, c4, overwrite, epi, row + 4, (res == nullptr) ? nullptr : res + 4 * ldc);
+    avx512StoreRow(C + 5 * ldc, c5, overwrite, epi, row + 5, (res == nullptr) ? nullptr : res + 5 * ldc);
+}
+
+/* two b panels side by side: 12 accumulators hide the fma latency and each broadcast of a feeds two fmas, the 6x16
+ * tile has 6 chains and one broadcast per fma */
+static void avx512Kernel6x32(const int &kc, const float *a, const float *b0, const float *b1, float *const &C, const int &ldc,
+                             const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    __m512 c00 = _mm512_setzero_ps();
+    __m512 c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps();
+    __m512 c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps();
+    __m512 c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps();
+    __m512 c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps();
+    __m512 c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps();
+    __m512 c51 = _mm512_setzero_ps();
+
+    for (int p = 0; p < kc; ++p)
+    {
+        const __m512 v0 = _mm512_loadu_ps(b0);
+        const __m512 v1 = _mm512_loadu_ps(b1);
+        __m512 a0;
+
+        a0  = _mm512_set1_ps(a[0]);
+        c00 = _mm512_fmadd_ps(a0, v0, c00);
+        c01 = _mm512_fmadd_ps(a0, v1, c01);
+
+        a0  = _mm512_set1_ps(a[1]);
+        c10 = _mm512_fmadd_ps(a0, v0, c10);
+        c11 = _mm512_fmadd_ps(a0, v1, c11);
+
+        a0  = _mm512_set1_ps(a[2]);
+        c20 = _mm512_fmadd_ps(a0, v0, c20);
+        c21 = _mm512_fmadd_ps(a0, v1, c21);
+
+        a0  = _mm512_set1_ps(a[3]);
+        c30 = _mm512_fmadd_ps(a0, v0, c30);
+        c31 = _mm512_fmadd_ps(a0, v1, c31);
+
+        a0  = _mm512_set1_ps(a[4]);
+        c40 = _mm512_fmadd_ps(a0, v0, c40);
+        c41 = _mm512_fmadd_ps(a0, v1, c41);
+
+        a0  = _mm512_set1_ps(a[5]);
+        c50 = _mm512_fmadd_ps(a0, v0, c50);
+        c51 = _mm512_fmadd_ps(a0, v1, c51);
+
+        a  += 6;
+        b0 += 16;
+        b1 += 16;
+    }
+
+    const __m512 acc[12] = {c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51};
+    for (int i = 0; i < 6; ++i)
+    {
+        const float *r = (res == nullptr) ? nullptr : res + i * ldc;
+        avx512StoreRow(C + i * ldc     , acc[2 * i]    , overwrite, epi, row + i, r);
+        avx512StoreRow(C + i * ldc + 16, acc[2 * i + 1], overwrite, epi, row + i, (r == nullptr) ? nullptr : r + 16);
+    }
+}
+
+static void avx512Gemm6x32(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                           const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    avx512Kernel6x32(kc, a, b, b + 16 * kc, C, ldc, overwrite, epi, row, res);
+}
+
+static inline __m512 avx512WidenHalf(const uint16_t *const &a, const bool &bf16)
+{
+    const __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a));
+    return bf16 ? _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16)) : _mm512_cvtph_ps(h);
+}
+
+/* steps k steps of a 6 row panel of fp16 / bf16 a widened 16 lanes at a time */
+static inline void avx512WidenPanel(const int &steps, const uint16_t *const &a, const WeightStorage &storage, float *const &wide)
+{
+    const bool bf16 = (storage == WEIGHT_BF16);
+
+    int i = 0;
+    for (; i + 16 <= steps * 6; i += 16)
+    {
+        _mm512_storeu_ps(wide + i, avx512WidenHalf(a + i, bf16));
+    }
+    for (; i < steps * 6; ++i)
+    {
+        wide[i] = Half::toFloat(a[i], storage);
+    }
+}
+
+/* the float tiles with fp16 / bf16 a. 64 k steps of a are widened at a time and the float tile broadcasts from them,
+ * a lane permute per row like the avx2 kernel would take the port of the second fma unit */
+static void avx512Gemm6x16Half(const int &kc, const uint16_t *a, const WeightStorage &storage, const float *b, float *const &C, const int &ldc,
+                               const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    float wide[64 * 6];
+
+    for (int pc = 0; pc < kc; pc += 64)
+    {
+        const int steps = (kc - pc < 64) ? (kc - pc) : 64;
+        const bool last = (pc + steps >= kc);
+
+        avx512WidenPanel(steps, a + pc * 6, storage, wide);
+        avx512Gemm6x16(steps, wide, b + pc * 16, C, ldc, overwrite && pc == 0, last ? epi : nullptr, row, last ? res : nullptr);
+    }
+}
+
+static void avx512Gemm6x32Half(const int &kc, const uint16_t *a, const WeightStorage &storage, const float *b, float *const &C, const int &ldc,
+                               const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    float wide[64 * 6];
+
+    for (int pc = 0; pc < kc; pc += 64)
+    {
+        const int steps = (kc - pc < 64) ? (kc - pc) : 64;
+        const bool last = (pc + steps >= kc);
+
+        avx512WidenPanel(steps, a + pc * 6, storage, wide);
+        avx512Kernel6x32(steps, wide, b + pc * 16, b + 16 * kc + pc * 16, C, ldc, overwrite && pc == 0, last ? epi : nullptr, row,
+                         last ? res : nullptr);
+    }
+}
+
+static float avx512DotHalf(const int &K, const uint16_t *const &a, const WeightStorage &storage, const float *const &x)
+{
+    const bool bf16 = (storage == WEIGHT_BF16);
+    __m512 s0 = _mm512_setzero_ps();
+    __m512 s1 = _mm512_setzero_ps();
+
+    int k = 0;
+    for (; k + 32 <= K; k += 32)
+    {
+        s0 = _mm512_fmadd_ps(avx512WidenHalf(a + k, bf16), _mm512_loadu_ps(x + k), s0);
+        s1 = _mm512_fmadd_ps(avx512WidenHalf(a + k + 16, bf16), _mm512_loadu_ps(x + k + 16), s1);
+    }
+    if(k + 16 <= K)
+    {
+        s0 = _mm512_fmadd_ps(avx512WidenHalf(a + k, bf16), _mm512_loadu_ps(x + k), s0);
+        k += 16;
+    }
+
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+    for (; k < K; ++k)
+    {
+        sum += Half::toFloat(a[k], storage) * x[k];
+    }
+    return sum;
+}
+
+/* one row of an int8 tile, cols past t.nr are masked off */
+static inline void avx512QuantStoreRow(float *const &c, const __m512i &acc, const QuantTile &t, const int &row, const float *const &res,
+                                       const __mmask16 &mask)
+{
+    const __m512i zp    = _mm512_set1_epi32(t.inZeroPoint * t.rowSums[row]);
+    __m512 v            = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_sub_epi32(acc, zp)), _mm512_set1_ps(t.wScales[row] * t.inScale));
+
+    if(t.epi->bias != nullptr)
+    {
+        v = _mm512_add_ps(v, _mm512_set1_ps(t.epi->bias[row]));
+    }
+
+    v = avx512Activate(v, t.epi->activation, t.epi->actParam);
+
+    if(res != nullptr)
+    {
+        v = _mm512_add_ps(v, _mm512_maskz_loadu_ps(mask, res));
+    }
+
+    v = avx512Activate(v, t.epi->postActivation, t.epi->postActParam);
+
+    _mm512_mask_storeu_ps(c, mask, v);
+}
+
+static inline void avx512QuantStoreTile(const __m512i &c0, const __m512i &c1, const __m512i &c2, const __m512i &c3, const QuantTile &t)
+{
+    const __m512i acc[4]    = {c0, c1, c2, c3};
+    const __mmask16 mask    = avx512Mask(t.nr);
+
+    for (int i = 0; i < t.mr; ++i)
+    {
+        avx512QuantStoreRow(t.C + i * t.ldc, acc[i], t, t.row + i, (t.res == nullptr) ? nullptr : (t.res + i * t.ldc), mask);
+    }
+}
+
+/* b holds 16 cols x 4 k of u8 per 64 bytes, a is 4 k of s8 of one row broadcast to every col */
+static inline __m512i avx512QuantDot(const __m512i &acc, const __m512i &b, const __m512i &a)
+{
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(_mm512_maddubs_epi16(b, a), _mm512_set1_epi16(1)));
+}
+
+static inline __m512i avx512QuantRow(const int8_t *const &a)
+{
+    return _mm512_set1_epi32(*reinterpret_cast<const int32_t *>(a));
+}
+
+/* one zmm per row and a whole k4 step of the b panel per load. Even and odd k4 steps sum into separate
+ * accumulators, 4 rows alone would leave the maddubs + madd chain latency bound */
+static void avx512QuantGemm4x16(const int &k4, const int8_t *a, const uint8_t *b, const QuantTile &t)
+{
+    __m512i c0 = _mm512_setzero_si512();
+    __m512i c1 = _mm512_setzero_si512();
+    __m512i c2 = _mm512_setzero_si512();
+    __m512i c3 = _mm512_setzero_si512();
+    __m512i d0 = _mm512_setzero_si512();
+    __m512i d1 = _mm512_setzero_si512();
+    __m512i d2 = _mm512_setzero_si512();
+    __m512i d3 = _mm512_setzero_si512();
+
+    int p = 0;
+    for (; p + 2 <= k4; p += 2)
+    {
+        const __m512i b0 = _mm512_loadu_si512(b);
+        const __m512i b1 = _mm512_loadu_si512(b + 64);
+
+        c0  = avx512QuantDot(c0, b0, avx512QuantRow(a));
+        c1  = avx512QuantDot(c1, b0, avx512QuantRow(a + 4));
+        c2  = avx512QuantDot(c2, b0, avx512QuantRow(a + 8));
+        c3  = avx512QuantDot(c3, b0, avx512QuantRow(a + 12));
+        d0  = avx512QuantDot(d0, b1, avx512QuantRow(a + 16));
+        d1  = avx512QuantDot(d1, b1, avx512QuantRow(a + 20));
+        d2  = avx512QuantDot(d2, b1, avx512QuantRow(a + 24));
+        d3  = avx512QuantDot(d3, b1, avx512QuantRow(a + 28));
+
+        a  += 32;
+        b  += 128;
+    }
+
+    if(p < k4)
+    {
+        const __m512i b0 = _mm512_loadu_si512(b);
+
+        c0  = avx512QuantDot(c0, b0, avx512QuantRow(a));
+        c1  = avx512QuantDot(c1, b0, avx512QuantRow(a + 4));
+        c2  = avx512QuantDot(c2, b0, avx512QuantRow(a + 8));
+        c3  = avx512QuantDot(c3, b0, avx512QuantRow(a + 12));
+    }
+
+    avx512QuantStoreTile(_mm512_add_epi32(c0, d0), _mm512_add_epi32(c1, d1), _mm512_add_epi32(c2, d2), _mm512_add_epi32(c3, d3), t);
+}
+
+static inline __m512i avx512QuantActivation16(const float *const &x, const __mmask16 &mask, const __m512 &inv, const __m512 &lo, const __m512 &hi,
+                                               const __m512i &zp)
+{
+    const __m512 v = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_maskz_loadu_ps(mask, x), inv), lo), hi);
+    return _mm512_maskz_add_epi32(mask, _mm512_cvtps_epi32(v), zp);
+}
+
+/* a k4 step of all 16 cols at once, the k rows past K and the cols past nr are masked to zero */
+static void avx512QuantPackB(const float *const &B, const int &ldb, const int &K, const int &nr, const float &inv, const int &zeroPoint,
+                             uint8_t *const &panel)
+{
+    const int K4            = (K + 3) / 4;
+    const __mmask16 mask    = avx512Mask(nr);
+    const __m512 mInv       = _mm512_set1_ps(inv);
+    const __m512 lo         = _mm512_set1_ps(static_cast<float>(-zeroPoint));
+    const __m512 hi         = _mm512_set1_ps(static_cast<float>(127 - zeroPoint));
+    const __m512i zp        = _mm512_set1_epi32(zeroPoint);
+
+    for (int k4 = 0; k4 < K4; ++k4)
+    {
+        const int k         = k4 * 4;
+        __m512i w           = _mm512_setzero_si512();
+
+        for (int s = 0; s < 4 && k + s < K; ++s)
+        {
+            const __m512i q = avx512QuantActivation16(B + static_cast<size_t>(k + s) * ldb, mask, mInv, lo, hi, zp);
+            w               = _mm512_or_si512(w, _mm512_sll_epi32(q, _mm_cvtsi32_si128(8 * s)));
+        }
+
+        _mm512_storeu_si512(panel + k4 * 64, w);
+    }
+}
+
+static int32_t avx512QuantDotRow(const int &stride, const uint8_t *const &x, const int8_t *const &a)
+{
+    __m512i acc = _mm512_setzero_si512();
+
+    int k = 0;
+    for (; k + 64 <= stride; k += 64)
+    {
+        acc = avx512QuantDot(acc, _mm512_loadu_si512(x + k), _mm512_loadu_si512(a + k));
+    }
+    if(k < stride)
+    {
+        /* stride is a multiple of 32, the last 32 bytes go through the low half */
+        acc = avx512QuantDot(acc, _mm512_zextsi256_si512(_mm256_load_si256(reinterpret_cast<const __m256i *>(x + k))),
+                             _mm512_zextsi256_si512(_mm256_load_si256(reinterpret_cast<const __m256i *>(a + k))));
+    }
+    return _mm512_reduce_add_epi32(acc);
+}
+
+static inline float avx512Im2colPixel(const float *const &input, const int &height, const int &width, int row, int col, const int &channel)
+{
+    row -= 1;
+    col -= 1;
+    if(row < 0 || col < 0 || row >= height || col >= width)
+    {
+        return 0;
+    }
+    return input[col + width*(row + height*channel)];
+}
+
+static void avx512Im2col3x3(const float *const &input, const int &height, const int &width, const int &rowBegin, const int &rowEnd,
+                            float *const &output)
+{
+    for (int ch = rowBegin; ch < rowEnd; ++ch)
+    {
+        const int wOffset   = ch % 3;
+        const int hOffset   = (ch / 3) % 3;
+        const int chOff     = ch / 9;
+        float *out          = output + static_cast<size_t>(ch) * height * width;
+
+        for (int h = 1; h < height - 1; ++h)
+        {
+            const float *in = input + wOffset - 1 + width*(hOffset + h - 1 + height * chOff);
+            for (int w = 1; w < width - 1; w += 16)
+            {
+                const __mmask16 mask = avx512Mask(width - 1 - w);
+                _mm512_mask_storeu_ps(out + h * width + w, mask, _mm512_maskz_loadu_ps(mask, in + w));
+            }
+        }
+
+        for (int h = 0; h < height; ++h)
+        {
+            out[h * width]              = avx512Im2colPixel(input, height, width, hOffset + h, wOffset, chOff);
+            out[h * width + width - 1]  = avx512Im2colPixel(input, height, width, hOffset + h, wOffset + width - 1, chOff);
+        }
+
+        for (int w = 0; w < width; ++w)
+        {
+            out[w]                          = avx512Im2colPixel(input, height, width, hOffset, wOffset + w, chOff);
+            out[(height - 1) * width + w]   = avx512Im2colPixel(input, height, width, hOffset + height - 1, wOffset + w, chOff);
+        }
+    }
+}
+
+static inline float avx512PoolPixel(const float *const &src, const int &kSizeX, const int &kSizeY, const int &width, const int &height,
+                                    const int &widthOffset, const int &y, const int &x, const int &k)
+{
+    float max = -FLT_MAX;
+    for (int n = 0; n < kSizeY; ++n)
+    {
+        for (int m = 0; m < kSizeX; ++m)
+        {
+            const int curHeight = y + n;
+            const int curWidth  = widthOffset + x + m;
+            const bool valid    = (curHeight >= 0 && curHeight < height && curWidth >= 0 && curWidth < width);
+            const float value   = valid ? src[curWidth + width*(curHeight + height*k)] : -FLT_MAX;
+
+            max = (value > max) ? value : max;
+        }
+    }
+    return max;
+}
+
+static void avx512MaxPool(const float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY, const int &width, const int &height,
+                          const int &outWidth, const int &outHeight, const int &paddingX, const int &paddingY, const int &stride, const int &channels)
+{
+    const int widthOffset  = -(paddingX + 1)/2;
+    const int heightOffset = -(paddingY + 1)/2;
+    const int jLeft        = (widthOffset < 0) ? (-widthOffset + stride - 1) / stride : 0;
+    const int jBegin       = (jLeft < outWidth) ? jLeft : outWidth;
+
+    /* columns [jBegin, jEnd) have their whole window row inside the image, a masked vector covers the last few of them */
+    const int lastX        = width - kSizeX - widthOffset;
+    const int jRight       = (lastX < 0) ? 0 : lastX / stride + 1;
+    const int jFit         = (jRight < outWidth) ? jRight : outWidth;
+    const int jEnd         = (jFit > jBegin) ? jFit : jBegin;
+
+    /* 2x2 stride 2: the even lanes after the max of neighbour pairs */
+    const __m512i evens    = _mm512_set_epi32(15, 13, 11, 9, 7, 5, 3, 1, 14, 12, 10, 8, 6, 4, 2, 0);
+
+    for (int k = 0; k < channels; ++k)
+    {
+        for (int i = 0; i < outHeight; ++i)
+        {
+            float *const dstRow = dst + outWidth*(i + outHeight*k);
+
+            int j = 0;
+            for (; j < jBegin; ++j)
+            {
+                dstRow[j] = avx512PoolPixel(src, kSizeX, kSizeY, width, height, widthOffset, heightOffset + i*stride, j*stride, k);
+            }
+
+            if(stride == 1)
+            {
+                for (int outNum = 0; j < jEnd; j += outNum)
+                {
+                    outNum               = (jEnd - j < 16) ? jEnd - j : 16;
+                    const __mmask16 mask = avx512Mask(outNum);
+                    __m512 max512 = _mm512_set1_ps(-FLT_MAX);
+                    for (int n = 0; n < kSizeY; ++n)
+                    {
+                        const int curHeight = heightOffset + i + n;
+                        if(curHeight < 0 || curHeight >= height)
+                        {
+                            continue;
+                        }
+
+                        const float *const srcRow = src + width*(curHeight + height*k) + widthOffset + j;
+                        for (int m = 0; m < kSizeX; ++m)
+                        {
+                            max512 = _mm512_max_ps(_mm512_maskz_loadu_ps(mask, srcRow + m), max512);
+                        }
+                    }
+                    _mm512_mask_storeu_ps(dstRow + j, mask, max512);
+                }
+            }
+            else if(kSizeX == 2 && kSizeY == 2 && stride == 2)
+            {
+                for (int outNum = 0; j < jEnd; j += outNum)
+                {
+                    outNum                = (jEnd - j < 8) ? jEnd - j : 8;
+                    const __mmask16 load  = avx512Mask(2 * outNum);
+                    __m512 max512 = _mm512_set1_ps(-FLT_MAX);
+                    for (int n = 0; n < kSizeY; ++n)
+                    {
+                        const int curHeight = heightOffset + i*stride + n;
+                        if(curHeight < 0 || curHeight >= height)
+                        {
+                            continue;
+                        }
+
+                        const __m512 src512 = _mm512_maskz_loadu_ps(load, src + width*(curHeight + height*k) + widthOffset + j*stride);
+                        max512 = _mm512_max_ps(_mm512_max_ps(src512, _mm512_permute_ps(src512, 0b10110001)), max512);
+                    }
+                    _mm512_mask_storeu_ps(dstRow + j, avx512Mask(outNum), _mm512_permutexvar_ps(evens, max512));
+                }
+            }
+
+            for (; j < outWidth; ++j)
+            {
+                dstRow[j] = avx512PoolPixel(src, kSizeX, kSizeY, width, height, widthOffset, heightOffset + i*stride, j*stride, k);
+            }
+        }
+    }
+}
+
+static void avx512BatchNorm(const float *const &src, float *const &dst, const int &size, const float &scale, const float &mean,
+                            const float &variance, const float &bias)
+{
+    const __m512 mScale = _mm512_set1_ps(scale);
+    const __m512 mMean  = _mm512_set1_ps(mean);
+    const __m512 mBias  = _mm512_set1_ps(bias);
+    const __m512 mStd   = _mm512_sqrt_ps(_mm512_add_ps(_mm512_set1_ps(variance), _mm512_set1_ps(0.00001f)));
+
+    for (int i = 0; i < size; i += 16)
+    {
+        const __mmask16 mask = avx512Mask(size - i);
+        const __m512 x = _mm512_mul_ps(mScale, _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, src + i), mMean));
+        _mm512_mask_storeu_ps(dst + i, mask, _mm512_add_ps(_mm512_div_ps(x, mStd), mBias));
+    }
+}
+
+static bool avx512ActivateArray(float *const &x, const int &num, const ActivationType &actType, const float &param)
+{
+    switch (actType)
+    {
+    case LINEAR:
+        return true;
+    case RELU:
+    case RELU6:
+    case LEAKY:
+    case RELIE:
+    case HARDTAN:
+    {
+        const float a = (actType == RELIE) ? .01f : param;
+        for (int i = 0; i < num; i += 16)
+        {
+            const __mmask16 mask = avx512Mask(num - i);
+            _mm512_mask_storeu_ps(x + i, mask, avx512Activate(_mm512_maskz_loadu_ps(mask, x + i), actType, a));
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/* pixel q of two nchwc output blocks as one vector, lo in lanes [0, 8) and hi (zero when nullptr) in [8, 16) */
+static inline __m512 avx512NchwcLoad(float *const &lo, float *const &hi, const int &q)
+{
+    const __m256 h = (hi == nullptr) ? _mm256_setzero_ps() : _mm256_loadu_ps(hi + q * 8);
+    return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(_mm256_loadu_ps(lo + q * 8))), _mm256_castps_pd(h), 1));
+}
+
+static inline void avx512NchwcStore(float *const &lo, float *const &hi, const int &q, const __m512 &x)
+{
+    _mm256_storeu_ps(lo + q * 8, _mm512_castps512_ps256(x));
+    if(hi != nullptr)
+    {
+        _mm256_storeu_ps(hi + q * 8, _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(x), 1)));
+    }
+}
+
+/* a packed pair is 16 output channels per input channel, one zmm. NP pixels x (1 or 2) pairs, written out per pixel
+ * like the avx2 tile so the 12 accumulators stay in registers */
+template<int NP, bool TWO>
+static inline void avx512NchwcTile(const float *const *const &in, const int &icBlocks, const size_t &inBlockStride, const int *const &kOffset,
+                                   const int &kNum, const float *w0, const float *w1, const float *const &bias, const bool &accumulate,
+                                   float *const *const &out)
+{
+    const __m512 b0 = (bias == nullptr) ? _mm512_setzero_ps() : _mm512_maskz_loadu_ps((out[1] == nullptr) ? 0x00FF : 0xFFFF, bias);
+    const __m512 b1 = (bias == nullptr || !TWO) ? _mm512_setzero_ps() : _mm512_maskz_loadu_ps((out[3] == nullptr) ? 0x00FF : 0xFFFF, bias + 16);
+
+    __m512 c00 = b0, c01 = b0, c02 = b0, c03 = b0, c04 = b0, c05 = b0;
+    __m512 c10 = b1, c11 = b1, c12 = b1, c13 = b1, c14 = b1, c15 = b1;
+
+    if(accumulate)
+    {
+        c00 = avx512NchwcLoad(out[0], out[1], 0);
+        if(NP > 1) c01 = avx512NchwcLoad(out[0], out[1], 1);
+        if(NP > 2) c02 = avx512NchwcLoad(out[0], out[1], 2);
+        if(NP > 3) c03 = avx512NchwcLoad(out[0], out[1], 3);
+        if(NP > 4) c04 = avx512NchwcLoad(out[0], out[1], 4);
+        if(NP > 5) c05 = avx512NchwcLoad(out[0], out[1], 5);
+        if(TWO)
+        {
+            c10 = avx512NchwcLoad(out[2], out[3], 0);
+            if(NP > 1) c11 = avx512NchwcLoad(out[2], out[3], 1);
+            if(NP > 2) c12 = avx512NchwcLoad(out[2], out[3], 2);
+            if(NP > 3) c13 = avx512NchwcLoad(out[2], out[3], 3);
+            if(NP > 4) c14 = avx512NchwcLoad(out[2], out[3], 4);
+            if(NP > 5) c15 = avx512NchwcLoad(out[2], out[3], 5);
+        }
+    }
+
+    for (int icb = 0; icb < icBlocks; ++icb)
+    {
+        const size_t blockOffset = icb * inBlockStride;
+        for (int k = 0; k < kNum; ++k)
+        {
+            const size_t offset = blockOffset + kOffset[k];
+            const float *i0     = in[0] + offset;
+            const float *i1     = (NP > 1) ? in[1] + offset : i0;
+            const float *i2     = (NP > 2) ? in[2] + offset : i0;
+            const float *i3     = (NP > 3) ? in[3] + offset : i0;
+            const float *i4     = (NP > 4) ? in[4] + offset : i0;
+            const float *i5     = (NP > 5) ? in[5] + offset : i0;
+
+            for (int l = 0; l < 8; ++l)
+            {
+                const __m512 v0 = _mm512_load_ps(w0);
+                const __m512 v1 = TWO ? _mm512_load_ps(w1) : v0;
+                w0 += 16;
+                w1 += TWO ? 16 : 0;
+
+                __m512 v;
+                v = _mm512_set1_ps(i0[l]); c00 = _mm512_fmadd_ps(v, v0, c00); if(TWO) c10 = _mm512_fmadd_ps(v, v1, c10);
+                if(NP > 1) { v = _mm512_set1_ps(i1[l]); c01 = _mm512_fmadd_ps(v, v0, c01); if(TWO) c11 = _mm512_fmadd_ps(v, v1, c11); }
+                if(NP > 2) { v = _mm512_set1_ps(i2[l]); c02 = _mm512_fmadd_ps(v, v0, c02); if(TWO) c12 = _mm512_fmadd_ps(v, v1, c12); }
+                if(NP > 3) { v = _mm512_set1_ps(i3[l]); c03 = _mm512_fmadd_ps(v, v0, c03); if(TWO) c13 = _mm512_fmadd_ps(v, v1, c13); }
+                if(NP > 4) { v = _mm512_set1_ps(i4[l]); c04 = _mm512_fmadd_ps(v, v0, c04); if(TWO) c14 = _mm512_fmadd_ps(v, v1, c14); }
+                if(NP > 5) { v = _mm512_set1_ps(i5[l]); c05 = _mm512_fmadd_ps(v, v0, c05); if(TWO) c15 = _mm512_fmadd_ps(v, v1, c15); }
+            }
+        }
+    }
+
+    avx512NchwcStore(out[0], out[1], 0, c00);
+    if(NP > 1) avx512NchwcStore(out[0], out[1], 1, c01);
+    if(NP > 2) avx512NchwcStore(out[0], out[1], 2, c02);
+    if(NP > 3) avx512NchwcStore(out[0], out[1], 3, c03);
+    if(NP > 4) avx512NchwcStore(out[0], out[1], 4, c04);
+    if(NP > 5) avx512NchwcStore(out[0], out[1], 5, c05);
+    if(TWO)
+    {
+        avx512NchwcStore(out[2], out[3], 0, c10);
+        if(NP > 1) avx512NchwcStore(out[2], out[3], 1, c11);
+        if(NP > 2) avx512NchwcStore(out[2], out[3], 2, c12);
+        if(NP > 3) avx512NchwcStore(out[2], out[3], 3, c13);
+        if(NP > 4) avx512NchwcStore(out[2], out[3], 4, c14);
+        if(NP > 5) avx512NchwcStore(out[2], out[3], 5, c15);
+    }
+}
+
+template<bool TWO>
+static inline void avx512NchwcPixels(const float *const *const &in, const int &np, const int &icBlocks, const size_t &inBlockStride,
+                                     const int *const &kOffset, const int &kNum, const float *const &w0, const float *const &w1,
+                                     const float *const &bias, const bool &accumulate, float *const *const &out)
+{
+    switch (np)
+    {
+    case 6: avx512NchwcTile<6, TWO>(in, icBlocks, inBlockStride, kOffset, kNum, w0, w1, bias, accumulate, out); break;
+    case 5: avx512NchwcTile<5, TWO>(in, icBlocks, inBlockStride, kOffset, kNum, w0, w1, bias, accumulate, out); break;
+    case 4: avx512NchwcTile<4, TWO>(in, icBlocks, inBlockStride, kOffset, kNum, w0, w1, bias, accumulate, out); break;
+    case 3: avx512NchwcTile<3, TWO>(in, icBlocks, inBlockStride, kOffset, kNum, w0, w1, bias, accumulate, out); break;
+    case 2: avx512NchwcTile<2, TWO>(in, icBlocks, inBlockStride, kOffset, kNum, w0, w1, bias, accumulate, out); break;
+    default: avx512NchwcTile<1, TWO>(in, icBlocks, inBlockStride, kOffset, kNum, w0, w1, bias, accumulate, out); break;
+    }
+}
+
+static void avx512NchwcConv(const float *const *const &in, const int &np, const int &icBlocks, const size_t &inBlockStride,
+                            const int *const &kOffset, const int &kNum, const float *const &w0, const float *const &w1,
+                            const float *const &bias, const bool &accumulate, float *const *const &out)
+{
+    if(w1 == nullptr)
+    {
+        avx512NchwcPixels<false>(in, np, icBlocks, inBlockStride, kOffset, kNum, w0, w0, bias, accumulate, out);
+    }
+    else
+    {
+        avx512NchwcPixels<true>(in, np, icBlocks, inBlockStride, kOffset, kNum, w0, w1, bias, accumulate, out);
+    }
+}
+
+const KernelTable *Kernels::avx512Table()
+{
+    static const KernelTable table = {ISA_AVX512, "avx512", avx512Gemm6x16, avx512Gemm6x16Half, avx512Gemm6x32, avx512Gemm6x32Half,
+                                      avx512DotHalf, avx512QuantPackB, avx512QuantGemm4x16, avx512QuantDotRow, avx512Im2col3x3,
+                                      avx512MaxPool, avx512BatchNorm, avx512ActivateArray, avx512NchwcConv};
+    return &table;
+}
+}
+#else
+namespace Msnhnet
+{
+const KernelTable *Kernels::avx512Table()
+{
+    return nullptr;
+}
+}
+#endif
@@ -0,0 +1,145 @@
+﻿#include "Msnhnet/core/MsnhKernels.h"
+
+#ifdef USE_X86
+#include <math.h>
+#include <immintrin.h>
+
+namespace Msnhnet
+{
+static inline __m512 vnniEpilogueActivate(const __m512 &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return _mm512_max_ps(x, _mm512_setzero_ps());
+    case RELU6:
+        return _mm512_min_ps(_mm512_max_ps(x, _mm512_setzero_ps()), _mm512_set1_ps(6.f));
+    case LEAKY:
+        return _mm512_mask_mul_ps(x, _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LE_OQ), x, _mm512_set1_ps(actParam));
+    default:
+        return x;
+    }
+}
+
+/* one row of an int8 tile, cols past t.nr are masked off */
+static inline void vnniQuantStoreRow(float *const &c, const __m512i &acc, const QuantTile &t, const int &row, const float *const &res,
+                                     const __mmask16 &mask)
+{
+    const __m512i zp    = _mm512_set1_epi32(t.inZeroPoint * t.rowSums[row]);
+    __m512 v            = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_sub_epi32(acc, zp)), _mm512_set1_ps(t.wScales[row] * t.inScale));
+
+    if(t.epi->bias != nullptr)
+    {
+        v = _mm512_add_ps(v, _mm512_set1_ps(t.epi->bias[row]));
+    }
+
+    v = vnniEpilogueActivate(v, t.epi->activation, t.epi->actParam);
+
+    if(res != nullptr)
+    {
+        v = _mm512_add_ps(v, _mm512_maskz_loadu_ps(mask, res));
+    }
+
+    v = vnniEpilogueActivate(v, t.epi->postActivation, t.epi->postActParam);
+
+    _mm512_mask_storeu_ps(c, mask, v);
+}
+
+static inline void vnniQuantStoreTile(const __m512i &c0, const __m512i &c1, const __m512i &c2, const __m512i &c3, const QuantTile &t)
+{
+    const __m512i acc[4]    = {c0, c1, c2, c3};
+    const __mmask16 mask    = (t.nr >= 16) ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << t.nr) - 1);
+
+    for (int i = 0; i < t.mr; ++i)
+    {
+        vnniQuantStoreRow(t.C + i * t.ldc, acc[i], t, t.row + i, (t.res == nullptr) ? nullptr : (t.res + i * t.ldc), mask);
+    }
+}
+
+static inline __m512i vnniQuantRow(const int8_t *const &a)
+{
+    return _mm512_set1_epi32(*reinterpret_cast<const int32_t *>(a));
+}
+
+/* the avx512 int8 tile with one vpdpbusd for its maddubs + madd + add, even and odd k4 steps still sum apart to
+ * keep 8 chains in flight */
+static void vnniQuantGemm4x16(const int &k4, const int8_t *a, const uint8_t *b, const QuantTile &t)
+{
+    __m512i c0 = _mm512_setzero_si512();
+    __m512i c1 = _mm512_setzero_si512();
+    __m512i c2 = _mm512_setzero_si512();
+    __m512i c3 = _mm512_setzero_si512();
+    __m512i d0 = _mm512_setzero_si512();
+    __m512i d1 = _mm512_setzero_si512();
+    __m512i d2 = _mm512_setzero_si512();
+    __m512i d3 = _mm512_setzero_si512();
+
+    int p = 0;
+    for (; p + 2 <= k4; p += 2)
+    {
+        const __m512i b0 = _mm512_loadu_si512(b);
+        const __m512i b1 = _mm512_loadu_si512(b + 64);
+
+        c0  = _mm512_dpbusd_epi32(c0, b0, vnniQuantRow(a));
+        c1  = _mm512_dpbusd_epi32(c1, b0, vnniQuantRow(a + 4));
+        c2  = _mm512_dpbusd_epi32(c2, b0, vnniQuantRow(a + 8));
+        c3  = _mm512_dpbusd_epi32(c3, b0, vnniQuantRow(a + 12));
+        d0  = _mm512_dpbusd_epi32(d0, b1, vnniQuantRow(a + 16));
+        d1  = _mm512_dpbusd_epi32(d1, b1, vnniQuantRow(a + 20));
+        d2  = _mm512_dpbusd_epi32(d2, b1, vnniQuantRow(a + 24));
+        d3  = _mm512_dpbusd_epi32(d3, b1, vnniQuantRow(a + 28));
+
+        a  += 32;
+        b  += 128;
+    }
+
+    if(p < k4)
+    {
+        const __m512i b0 = _mm512_loadu_si512(b);
+
+        c0  = _mm512_dpbusd_epi32(c0, b0, vnniQuantRow(a));
+        c1  = _mm512_dpbusd_epi32(c1, b0, vnniQuantRow(a + 4));
+        c2  = _mm512_dpbusd_epi32(c2, b0, vnniQuantRow(a + 8));
+        c3  = _mm512_dpbusd_epi32(c3, b0, vnniQuantRow(a + 12));
+    }
+
+    vnniQuantStoreTile(_mm512_add_epi32(c0, d0), _mm512_add_epi32(c1, d1), _mm512_add_epi32(c2, d2), _mm512_add_epi32(c3, d3), t);
+}
+
+static int32_t vnniQuantDotRow(const int &stride, const uint8_t *const &x, const int8_t *const &a)
+{
+    __m512i acc = _mm512_setzero_si512();
+
+    int k = 0;
+    for (; k + 64 <= stride; k += 64)
+    {
+        acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(x + k), _mm512_loadu_si512(a + k));
+    }
+    if(k < stride)
+    {
+        /* stride is a multiple of 32, the last 32 bytes go through the low half */
+        acc = _mm512_dpbusd_epi32(acc, _mm512_zextsi256_si512(_mm256_load_si256(reinterpret_cast<const __m256i *>(x + k))),
+                                  _mm512_zextsi256_si512(_mm256_load_si256(reinterpret_cast<const __m256i *>(a + k))));
+    }
+    return _mm512_reduce_add_epi32(acc);
+}
+
+const KernelTable *Kernels::avx512VnniTable()
+{
+    /* the avx512 table with the vnni int8 gemm */
+    const KernelTable *avx512 = avx512Table();
+    static const KernelTable table = {ISA_AVX512_VNNI, "avx512vnni", avx512->gemm6x16, avx512->gemm6x16Half, avx512->gemm6x32,
+                                      avx512->gemm6x32Half, avx512->dotHalf, avx512->quantPackB, vnniQuantGemm4x16, vnniQuantDotRow, avx512->im2col3x3, avx512->maxPool,
+                                      avx512->batchNorm, avx512->activate, avx512->nchwcConv};
+    return &table;
+}
+}
+#else
+namespace Msnhnet
+{
+const KernelTable *Kernels::avx512VnniTable()
+{
+    return nullptr;
+}
+}
+#endif
@@ -0,0 +1,191 @@
+﻿#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/core/MsnhHalf.h"
+#include <math.h>
+
+namespace Msnhnet
+{
+static inline float genericEpilogueActivate(const float &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return x*(x>0);
+    case RELU6:
+        return (x>0?x:0)>6?6:(x>0?x:0);
+    case LEAKY:
+        return (x>0) ? x : actParam*x;
+    default:
+        return x;
+    }
+}
+
+static void genericGemm6x16(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                            const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    float tile[6 * 16] = {0};
+
+    for (int p = 0; p < kc; ++p)
+    {
+        for (int i = 0; i < 6; ++i)
+        {
+            const float aVal = a[i];
+            for (int j = 0; j < 16; ++j)
+            {
+                tile[i * 16 + j] += aVal * b[j];
+            }
+        }
+        a  += 6;
+        b  += 16;
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = 0; j < 16; ++j)
+        {
+            float x = overwrite ? tile[i * 16 + j] : (C[i * ldc + j] + tile[i * 16 + j]);
+            if(epi != nullptr)
+            {
+                if(epi->bias != nullptr)
+                {
+                    x += epi->bias[row + i];
+                }
+                x = genericEpilogueActivate(x, epi->activation, epi->actParam);
+                if(res != nullptr)
+                {
+                    x += res[i * ldc + j];
+                }
+                x = genericEpilogueActivate(x, epi->postActivation, epi->postActParam);
+            }
+            C[i * ldc + j] = x;
+        }
+    }
+}
+
+/* widens 64 k steps of a at a time and runs them through the float tile, the first block keeps overwrite and only the
+ * last one gets the epilogue */
+static void genericGemm6x16Half(const int &kc, const uint16_t *a, const WeightStorage &storage, const float *b, float *const &C, const int &ldc,
+                                const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    float wide[64 * 6];
+
+    for (int pc = 0; pc < kc; pc += 64)
+    {
+        const int steps = (kc - pc < 64) ? (kc - pc) : 64;
+        const bool last = (pc + steps >= kc);
+
+        for (int i = 0; i < steps * 6; ++i)
+        {
+            wide[i] = Half::toFloat(a[pc * 6 + i], storage);
+        }
+
+        genericGemm6x16(steps, wide, b + pc * 16, C, ldc, overwrite && pc == 0, last ? epi : nullptr, row, last ? res : nullptr);
+    }
+}
+
+static float genericDotHalf(const int &K, const uint16_t *const &a, const WeightStorage &storage, const float *const &x)
+{
+    float sum = 0.f;
+    for (int k = 0; k < K; ++k)
+    {
+        sum += Half::toFloat(a[k], storage) * x[k];
+    }
+    return sum;
+}
+
+static inline float genericIm2colPixel(const float *const &input, const int &height, const int &width, int row, int col, const int &channel)
+{
+    row -= 1;
+    col -= 1;
+    if(row < 0 || col < 0 || row >= height || col >= width)
+    {
+        return 0;
+    }
+    return input[col + width*(row + height*channel)];
+}
+
+static void genericIm2col3x3(const float *const &input, const int &height, const int &width, const int &rowBegin, const int &rowEnd,
+                             float *const &output)
+{
+    for (int ch = rowBegin; ch < rowEnd; ++ch)
+    {
+        const int wOffset   = ch % 3;
+        const int hOffset   = (ch / 3) % 3;
+        const int chOff     = ch / 9;
+        float *out          = output + static_cast<size_t>(ch) * height * width;
+
+        for (int h = 1; h < height - 1; ++h)
+        {
+            const float *in = input + wOffset - 1 + width*(hOffset + h - 1 + height * chOff);
+            for (int w = 1; w < width - 1; ++w)
+            {
+                out[h * width + w] = in[w];
+            }
+        }
+
+        for (int h = 0; h < height; ++h)
+        {
+            out[h * width]              = genericIm2colPixel(input, height, width, hOffset + h, wOffset, chOff);
+            out[h * width + width - 1]  = genericIm2colPixel(input, height, width, hOffset + h, wOffset + width - 1, chOff);
+        }
+
+        for (int w = 0; w < width; ++w)
+        {
+            out[w]                          = genericIm2colPixel(input, height, width, hOffset, wOffset + w, chOff);
+            out[(height - 1) * width + w]   = genericIm2colPixel(input, height, width, hOffset + height - 1, wOffset + w, chOff);
+        }
+    }
+}
+
+static void genericMaxPool(const float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY, const int &width, const int &height,
+                           const int &outWidth, const int &outHeight, const int &paddingX, const int &paddingY, const int &stride, const int &channels)
+{
+    const int widthOffset  = -(paddingX + 1)/2;
+    const int heightOffset = -(paddingY + 1)/2;
+
+    for (int k = 0; k < channels; ++k)
+    {
+        for (int i = 0; i < outHeight; ++i)
+        {
+            for (int j = 0; j < outWidth; ++j)
+            {
+                float max = -FLT_MAX;
+                for (int n = 0; n < kSizeY; ++n)
+                {
+                    for (int m = 0; m < kSizeX; ++m)
+                    {
+                        const int curHeight = heightOffset + i*stride + n;
+                        const int curWidth  = widthOffset  + j*stride + m;
+                        const bool valid    = (curHeight >= 0 && curHeight < height && curWidth >= 0 && curWidth < width);
+                        const float value   = valid ? src[curWidth + width*(curHeight + height*k)] : -FLT_MAX;
+
+                        max = (value > max) ? value : max;
+                    }
+                }
+                dst[j + outWidth*(i + outHeight*k)] = max;
+            }
+        }
+    }
+}
+
+static void genericBatchNorm(const float *const &src, float *const &dst, const int &size, const float &scale, const float &mean,
+                             const float &variance, const float &bias)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        dst[i] = scale*(src[i] - mean)/sqrtf(variance + 0.00001f) + bias;
+    }
+}
+
+static bool genericActivate(float *const &, const int &, const ActivationType &, const float &)
+{
+    return false;
+}
+
+const KernelTable *Kernels::genericTable()
+{
+    /* no int8 gemm, int8 layers need avx2 */
+    static const KernelTable table = {ISA_GENERIC, "generic", genericGemm6x16, genericGemm6x16Half, nullptr, nullptr, genericDotHalf, nullptr, nullptr, nullptr,
+                                      genericIm2col3x3, genericMaxPool, genericBatchNorm, genericActivate, nullptr};
+    return &table;
+}
+}
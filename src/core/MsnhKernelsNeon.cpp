@@ -0,0 +1,182 @@
+﻿#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/core/MsnhHalf.h"
+
+#ifdef USE_NEON
+#include <math.h>
+#include <arm_neon.h>
+
+namespace Msnhnet
+{
+static inline float32x4_t neonMla(const float32x4_t &c, const float32x4_t &a, const float32x4_t &b)
+{
+#ifdef __aarch64__
+    return vfmaq_f32(c, a, b);
+#else
+    return vmlaq_f32(c, a, b);
+#endif
+}
+
+static inline float32x4_t neonEpilogueActivate(const float32x4_t &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return vmaxq_f32(x, vdupq_n_f32(0.f));
+    case RELU6:
+        return vminq_f32(vmaxq_f32(x, vdupq_n_f32(0.f)), vdupq_n_f32(6.f));
+    case LEAKY:
+        return vbslq_f32(vcgtq_f32(x, vdupq_n_f32(0.f)), x, vmulq_n_f32(x, actParam));
+    default:
+        return x;
+    }
+}
+
+/* 6 x 8 half of the tile, two of them keep armv7's 16 q registers from spilling */
+static inline void neonKernel6x8(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                                 const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    float32x4_t c[6][2];
+    for (int i = 0; i < 6; ++i)
+    {
+        c[i][0] = vdupq_n_f32(0.f);
+        c[i][1] = vdupq_n_f32(0.f);
+    }
+
+    for (int p = 0; p < kc; ++p)
+    {
+        const float32x4_t b0 = vld1q_f32(b);
+        const float32x4_t b1 = vld1q_f32(b + 4);
+        for (int i = 0; i < 6; ++i)
+        {
+            const float32x4_t a0 = vdupq_n_f32(a[i]);
+            c[i][0] = neonMla(c[i][0], a0, b0);
+            c[i][1] = neonMla(c[i][1], a0, b1);
+        }
+        a  += 6;
+        b  += 16;
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        float *const ci = C + i * ldc;
+        float32x4_t v0  = overwrite ? c[i][0] : vaddq_f32(vld1q_f32(ci), c[i][0]);
+        float32x4_t v1  = overwrite ? c[i][1] : vaddq_f32(vld1q_f32(ci + 4), c[i][1]);
+
+        if(epi != nullptr)
+        {
+            if(epi->bias != nullptr)
+            {
+                v0 = vaddq_f32(v0, vdupq_n_f32(epi->bias[row + i]));
+                v1 = vaddq_f32(v1, vdupq_n_f32(epi->bias[row + i]));
+            }
+
+            v0 = neonEpilogueActivate(v0, epi->activation, epi->actParam);
+            v1 = neonEpilogueActivate(v1, epi->activation, epi->actParam);
+
+            if(res != nullptr)
+            {
+                v0 = vaddq_f32(v0, vld1q_f32(res + i * ldc));
+                v1 = vaddq_f32(v1, vld1q_f32(res + i * ldc + 4));
+            }
+
+            v0 = neonEpilogueActivate(v0, epi->postActivation, epi->postActParam);
+            v1 = neonEpilogueActivate(v1, epi->postActivation, epi->postActParam);
+        }
+
+        vst1q_f32(ci, v0);
+        vst1q_f32(ci + 4, v1);
+    }
+}
+
+static void neonGemm6x16(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                         const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    neonKernel6x8(kc, a, b    , C    , ldc, overwrite, epi, row, res);
+    neonKernel6x8(kc, a, b + 8, C + 8, ldc, overwrite, epi, row, (res == nullptr) ? nullptr : res + 8);
+}
+
+/* widens 64 k steps of a at a time and runs them through the float tile, the first block keeps overwrite and only the
+ * last one gets the epilogue */
+static void neonGemm6x16Half(const int &kc, const uint16_t *a, const WeightStorage &storage, const float *b, float *const &C, const int &ldc,
+                          const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    float wide[64 * 6];
+
+    for (int pc = 0; pc < kc; pc += 64)
+    {
+        const int steps = (kc - pc < 64) ? (kc - pc) : 64;
+        const bool last = (pc + steps >= kc);
+
+        for (int i = 0; i < steps * 6; ++i)
+        {
+            wide[i] = Half::toFloat(a[pc * 6 + i], storage);
+        }
+
+        neonGemm6x16(steps, wide, b + pc * 16, C, ldc, overwrite && pc == 0, last ? epi : nullptr, row, last ? res : nullptr);
+    }
+}
+
+/* armv7 has no vector sqrt / div, the plane's factor is computed once */
+static void neonBatchNorm(const float *const &src, float *const &dst, const int &size, const float &scale, const float &mean,
+                          const float &variance, const float &bias)
+{
+    const float k           = scale / sqrtf(variance + 0.00001f);
+    const float32x4_t mK    = vdupq_n_f32(k);
+    const float32x4_t mMean = vdupq_n_f32(mean);
+    const float32x4_t mBias = vdupq_n_f32(bias);
+
+    int i = 0;
+    for (; i < size - 3; i += 4)
+    {
+        vst1q_f32(dst + i, neonMla(mBias, vsubq_f32(vld1q_f32(src + i), mMean), mK));
+    }
+
+    for (; i < size; ++i)
+    {
+        dst[i] = (src[i] - mean) * k + bias;
+    }
+}
+
+static bool neonActivate(float *const &x, const int &num, const ActivationType &actType, const float &param)
+{
+    int i = 0;
+
+    switch (actType)
+    {
+    case LINEAR:
+        return true;
+    case RELU:
+    case RELU6:
+    case LEAKY:
+        for (; i < num - 3; i += 4)
+        {
+            vst1q_f32(x + i, neonEpilogueActivate(vld1q_f32(x + i), actType, param));
+        }
+        for (; i < num; ++i)
+        {
+            const float v = x[i];
+            x[i] = (actType == LEAKY) ? ((v > 0) ? v : param*v) : ((actType == RELU6 && v > 6) ? 6 : ((v > 0) ? v : 0));
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+const KernelTable *Kernels::neonTable()
+{
+    /* pooling, im2col and the half gemv are load / store bound, the generic loops vectorize well enough there */
+    static const KernelTable table = {ISA_NEON, "neon", neonGemm6x16, neonGemm6x16Half, nullptr, nullptr, genericTable()->dotHalf,
+                                      nullptr, nullptr, nullptr, genericTable()->im2col3x3, genericTable()->maxPool, neonBatchNorm, neonActivate, nullptr};
+    return &table;
+}
+}
+#else
+namespace Msnhnet
+{
+const KernelTable *Kernels::neonTable()
+{
+    return nullptr;
+}
+}
+#endif
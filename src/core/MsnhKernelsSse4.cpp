@@ -0,0 +1,394 @@
+﻿#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/core/MsnhHalf.h"
+
+#ifdef USE_X86
+#include <math.h>
+#include <smmintrin.h>
+
+namespace Msnhnet
+{
+static inline __m128 sse4EpilogueActivate(const __m128 &x, const ActivationType &activation, const float &actParam)
+{
+    switch (activation)
+    {
+    case RELU:
+        return _mm_max_ps(x, _mm_setzero_ps());
+    case RELU6:
+        return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(6.f));
+    case LEAKY:
+        return _mm_blendv_ps(_mm_mul_ps(x, _mm_set1_ps(actParam)), x, _mm_cmpgt_ps(x, _mm_setzero_ps()));
+    default:
+        return x;
+    }
+}
+
+static inline void sse4StoreRow(float *const &c, const __m128 &c0, const __m128 &c1, const bool &overwrite,
+                                const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    __m128 v0 = overwrite ? c0 : _mm_add_ps(_mm_loadu_ps(c), c0);
+    __m128 v1 = overwrite ? c1 : _mm_add_ps(_mm_loadu_ps(c + 4), c1);
+
+    if(epi != nullptr)
+    {
+        if(epi->bias != nullptr)
+        {
+            const __m128 bias = _mm_set1_ps(epi->bias[row]);
+            v0 = _mm_add_ps(v0, bias);
+            v1 = _mm_add_ps(v1, bias);
+        }
+
+        v0 = sse4EpilogueActivate(v0, epi->activation, epi->actParam);
+        v1 = sse4EpilogueActivate(v1, epi->activation, epi->actParam);
+
+        if(res != nullptr)
+        {
+            v0 = _mm_add_ps(v0, _mm_loadu_ps(res));
+            v1 = _mm_add_ps(v1, _mm_loadu_ps(res + 4));
+        }
+
+        v0 = sse4EpilogueActivate(v0, epi->postActivation, epi->postActParam);
+        v1 = sse4EpilogueActivate(v1, epi->postActivation, epi->postActParam);
+    }
+
+    _mm_storeu_ps(c, v0);
+    _mm_storeu_ps(c + 4, v1);
+}
+
+/* 6 x 8 half of the tile, 12 accumulators fit the 16 xmm registers with the two b vectors and a */
+static inline void sse4Kernel6x8(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                                 const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    __m128 c00 = _mm_setzero_ps();
+    __m128 c01 = _mm_setzero_ps();
+    __m128 c10 = _mm_setzero_ps();
+    __m128 c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps();
+    __m128 c21 = _mm_setzero_ps();
+    __m128 c30 = _mm_setzero_ps();
+    __m128 c31 = _mm_setzero_ps();
+    __m128 c40 = _mm_setzero_ps();
+    __m128 c41 = _mm_setzero_ps();
+    __m128 c50 = _mm_setzero_ps();
+    __m128 c51 = _mm_setzero_ps();
+
+    for (int p = 0; p < kc; ++p)
+    {
+        const __m128 b0 = _mm_load_ps(b);
+        const __m128 b1 = _mm_load_ps(b + 4);
+        __m128 a0;
+
+        a0  = _mm_set1_ps(a[0]);
+        c00 = _mm_add_ps(_mm_mul_ps(a0, b0), c00);
+        c01 = _mm_add_ps(_mm_mul_ps(a0, b1), c01);
+
+        a0  = _mm_set1_ps(a[1]);
+        c10 = _mm_add_ps(_mm_mul_ps(a0, b0), c10);
+        c11 = _mm_add_ps(_mm_mul_ps(a0, b1), c11);
+
+        a0  = _mm_set1_ps(a[2]);
+        c20 = _mm_add_ps(_mm_mul_ps(a0, b0), c20);
+        c21 = _mm_add_ps(_mm_mul_ps(a0, b1), c21);
+
+        a0  = _mm_set1_ps(a[3]);
+        c30 = _mm_add_ps(_mm_mul_ps(a0, b0), c30);
+        c31 = _mm_add_ps(_mm_mul_ps(a0, b1), c31);
+
+        a0  = _mm_set1_ps(a[4]);
+        c40 = _mm_add_ps(_mm_mul_ps(a0, b0), c40);
+        c41 = _mm_add_ps(_mm_mul_ps(a0, b1), c41);
+
+        a0  = _mm_set1_ps(a[5]);
+        c50 = _mm_add_ps(_mm_mul_ps(a0, b0), c50);
+        c51 = _mm_add_ps(_mm_mul_ps(a0, b1), c51);
+
+        a  += 6;
+        b  += 16;
+    }
+
+    sse4StoreRow(C          , c00, c01, overwrite, epi, row    , (res == nullptr) ? nullptr : res);
+    sse4StoreRow(C +     ldc, c10, c11, overwrite, epi, row + 1, (res == nullptr) ? nullptr : res +     ldc);
+    sse4StoreRow(C + 2 * ldc, c20, c21, overwrite, epi, row + 2, (res == nullptr) ? nullptr : res + 2 * ldc);
+    sse4StoreRow(C + 3 * ldc, c30, c31, overwrite, epi, row + 3, (res == nullptr) ? nullptr : res + 3 * ldc);
+    sse4StoreRow(C + 4 * ldc, c40, c41, overwrite, epi, row + 4, (res == nullptr) ? nullptr : res + 4 * ldc);
+    sse4StoreRow(C + 5 * ldc, c50, c51, overwrite, epi, row + 5, (res == nullptr) ? nullptr : res + 5 * ldc);
+}
+
+static void sse4Gemm6x16(const int &kc, const float *a, const float *b, float *const &C, const int &ldc,
+                         const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    sse4Kernel6x8(kc, a, b    , C    , ldc, overwrite, epi, row, res);
+    sse4Kernel6x8(kc, a, b + 8, C + 8, ldc, overwrite, epi, row, (res == nullptr) ? nullptr : res + 8);
+}
+
+/* there is no f16c below avx2: widens 64 k steps of a at a time and runs them through the float tile, the first block keeps overwrite and only the
+ * last one gets the epilogue */
+static void sse4Gemm6x16Half(const int &kc, const uint16_t *a, const WeightStorage &storage, const float *b, float *const &C, const int &ldc,
+                          const bool &overwrite, const GemmEpilogue *const &epi, const int &row, const float *const &res)
+{
+    float wide[64 * 6];
+
+    for (int pc = 0; pc < kc; pc += 64)
+    {
+        const int steps = (kc - pc < 64) ? (kc - pc) : 64;
+        const bool last = (pc + steps >= kc);
+
+        for (int i = 0; i < steps * 6; ++i)
+        {
+            wide[i] = Half::toFloat(a[pc * 6 + i], storage);
+        }
+
+        sse4Gemm6x16(steps, wide, b + pc * 16, C, ldc, overwrite && pc == 0, last ? epi : nullptr, row, last ? res : nullptr);
+    }
+}
+
+static float sse4DotHalf(const int &K, const uint16_t *const &a, const WeightStorage &storage, const float *const &x)
+{
+    float sum = 0.f;
+    for (int k = 0; k < K; ++k)
+    {
+        sum += Half::toFloat(a[k], storage) * x[k];
+    }
+    return sum;
+}
+
+static inline float sse4Im2colPixel(const float *const &input, const int &height, const int &width, int row, int col, const int &channel)
+{
+    row -= 1;
+    col -= 1;
+    if(row < 0 || col < 0 || row >= height || col >= width)
+    {
+        return 0;
+    }
+    return input[col + width*(row + height*channel)];
+}
+
+static void sse4Im2col3x3(const float *const &input, const int &height, const int &width, const int &rowBegin, const int &rowEnd,
+                          float *const &output)
+{
+    for (int ch = rowBegin; ch < rowEnd; ++ch)
+    {
+        const int wOffset   = ch % 3;
+        const int hOffset   = (ch / 3) % 3;
+        const int chOff     = ch / 9;
+        float *out          = output + static_cast<size_t>(ch) * height * width;
+
+        for (int h = 1; h < height - 1; ++h)
+        {
+            const float *in = input + wOffset - 1 + width*(hOffset + h - 1 + height * chOff);
+            int w = 1;
+            for (; w < width - 1 - 4; w += 4)
+            {
+                _mm_storeu_ps(out + h * width + w, _mm_loadu_ps(in + w));
+            }
+            for (; w < width - 1; ++w)
+            {
+                out[h * width + w] = in[w];
+            }
+        }
+
+        for (int h = 0; h < height; ++h)
+        {
+            out[h * width]              = sse4Im2colPixel(input, height, width, hOffset + h, wOffset, chOff);
+            out[h * width + width - 1]  = sse4Im2colPixel(input, height, width, hOffset + h, wOffset + width - 1, chOff);
+        }
+
+        for (int w = 0; w < width; ++w)
+        {
+            out[w]                          = sse4Im2colPixel(input, height, width, hOffset, wOffset + w, chOff);
+            out[(height - 1) * width + w]   = sse4Im2colPixel(input, height, width, hOffset + height - 1, wOffset + w, chOff);
+        }
+    }
+}
+
+static inline float sse4PoolPixel(const float *const &src, const int &kSizeX, const int &kSizeY, const int &width, const int &height,
+                                 const int &widthOffset, const int &y, const int &x, const int &k)
+{
+    float max = -FLT_MAX;
+    for (int n = 0; n < kSizeY; ++n)
+    {
+        for (int m = 0; m < kSizeX; ++m)
+        {
+            const int curHeight = y + n;
+            const int curWidth  = widthOffset + x + m;
+            const bool valid    = (curHeight >= 0 && curHeight < height && curWidth >= 0 && curWidth < width);
+            const float value   = valid ? src[curWidth + width*(curHeight + height*k)] : -FLT_MAX;
+
+            max = (value > max) ? value : max;
+        }
+    }
+    return max;
+}
+
+static void sse4MaxPool(const float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY, const int &width, const int &height,
+                        const int &outWidth, const int &outHeight, const int &paddingX, const int &paddingY, const int &stride, const int &channels)
+{
+    const int widthOffset  = -(paddingX + 1)/2;
+    const int heightOffset = -(paddingY + 1)/2;
+    const int jLeft        = (widthOffset < 0) ? (-widthOffset + stride - 1) / stride : 0;
+    const int jBegin       = (jLeft < outWidth) ? jLeft : outWidth;
+
+    for (int k = 0; k < channels; ++k)
+    {
+        for (int i = 0; i < outHeight; ++i)
+        {
+            /* the vector loops only take columns whose window rows lie inside the image, the borders are scalar */
+            int j = 0;
+            for (; j < jBegin; ++j)
+            {
+                dst[j + outWidth*(i + outHeight*k)] = sse4PoolPixel(src, kSizeX, kSizeY, width, height, widthOffset, heightOffset + i*stride, j*stride, k);
+            }
+
+            if(stride == 1)
+            {
+                for (; j + 4 <= outWidth && widthOffset + j + 4 + kSizeX - 1 <= width; j += 4)
+                {
+                    __m128 max128 = _mm_set1_ps(-FLT_MAX);
+                    for (int n = 0; n < kSizeY; ++n)
+                    {
+                        for (int m = 0; m < kSizeX; ++m)
+                        {
+                            const int curHeight = heightOffset + i*stride + n;
+                            const int curWidth  = widthOffset  + j*stride + m;
+                            if(curHeight < 0 || curHeight >= height)
+                            {
+                                continue;
+                            }
+                            max128 = _mm_max_ps(_mm_loadu_ps(&src[curWidth + width*(curHeight + height*k)]), max128);
+                        }
+                    }
+                    _mm_storeu_ps(&dst[j + outWidth*(i + outHeight*k)], max128);
+                }
+            }
+            else if(kSizeX == 2 && kSizeY == 2 && stride == 2)
+            {
+                for (; j + 4 <= outWidth && widthOffset + j*stride + 8 <= width; j += 4)
+                {
+                    __m128 max128 = _mm_set1_ps(-FLT_MAX);
+                    for (int n = 0; n < kSizeY; ++n)
+                    {
+                        const int curHeight = heightOffset + i*stride + n;
+                        const int curWidth  = widthOffset  + j*stride;
+                        if(curHeight < 0 || curHeight >= height)
+                        {
+                            continue;
+                        }
+                        const float *p  = &src[curWidth + width*(curHeight + height*k)];
+                        const __m128 lo = _mm_loadu_ps(p);
+                        const __m128 hi = _mm_loadu_ps(p + 4);
+                        max128 = _mm_max_ps(_mm_max_ps(_mm_shuffle_ps(lo, hi, 0x88), _mm_shuffle_ps(lo, hi, 0xDD)), max128);
+                    }
+                    _mm_storeu_ps(&dst[j + outWidth*(i + outHeight*k)], max128);
+                }
+            }
+
+            for (; j < outWidth; ++j)
+            {
+                dst[j + outWidth*(i + outHeight*k)] = sse4PoolPixel(src, kSizeX, kSizeY, width, height, widthOffset, heightOffset + i*stride, j*stride, k);
+            }
+        }
+    }
+}
+
+static void sse4BatchNorm(const float *const &src, float *const &dst, const int &size, const float &scale, const float &mean,
+                          const float &variance, const float &bias)
+{
+    const __m128 mScale = _mm_set1_ps(scale);
+    const __m128 mMean  = _mm_set1_ps(mean);
+    const __m128 mBias  = _mm_set1_ps(bias);
+    const __m128 mStd   = _mm_sqrt_ps(_mm_add_ps(_mm_set1_ps(variance), _mm_set1_ps(0.00001f)));
+
+    int i = 0;
+    for (; i < size - 3; i += 4)
+    {
+        const __m128 x = _mm_mul_ps(mScale, _mm_sub_ps(_mm_loadu_ps(src + i), mMean));
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_div_ps(x, mStd), mBias));
+    }
+
+    for (; i < size; ++i)
+    {
+        dst[i] = scale*(src[i] - mean)/sqrtf(variance + 0.00001f) + bias;
+    }
+}
+
+static bool sse4Activate(float *const &x, const int &num, const ActivationType &actType, const float &param)
+{
+    const __m128 zero   = _mm_setzero_ps();
+    const __m128 one    = _mm_set1_ps(1.f);
+    int i = 0;
+
+    switch (actType)
+    {
+    case LINEAR:
+        return true;
+    case RELU:
+        for (; i < num - 3; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(x + i);
+            _mm_storeu_ps(x + i, _mm_mul_ps(v, _mm_and_ps(_mm_cmpgt_ps(v, zero), one)));
+        }
+        for (; i < num; ++i)
+        {
+            x[i] = x[i]*(x[i]>0);
+        }
+        return true;
+    case RELU6:
+        for (; i < num - 3; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(x + i);
+            const __m128 r = _mm_blendv_ps(zero, v, _mm_cmpgt_ps(v, zero));
+            _mm_storeu_ps(x + i, _mm_blendv_ps(r, _mm_set1_ps(6.f), _mm_cmpgt_ps(r, _mm_set1_ps(6.f))));
+        }
+        for (; i < num; ++i)
+        {
+            x[i] = (x[i]>0?x[i]:0)>6?6:(x[i]>0?x[i]:0);
+        }
+        return true;
+    case LEAKY:
+    case RELIE:
+    {
+        const float a   = (actType == LEAKY) ? param : .01f;
+        const __m128 k  = _mm_set1_ps(a);
+        for (; i < num - 3; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(x + i);
+            _mm_storeu_ps(x + i, _mm_blendv_ps(_mm_mul_ps(k, v), v, _mm_cmpgt_ps(v, zero)));
+        }
+        for (; i < num; ++i)
+        {
+            x[i] = (x[i]>0) ? x[i] : a*x[i];
+        }
+        return true;
+    }
+    case HARDTAN:
+        for (; i < num - 3; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(x + i);
+            const __m128 t = _mm_blendv_ps(v, _mm_set1_ps(-1.f), _mm_cmplt_ps(v, _mm_set1_ps(-1.f)));
+            _mm_storeu_ps(x + i, _mm_blendv_ps(t, one, _mm_cmpgt_ps(v, one)));
+        }
+        for (; i < num; ++i)
+        {
+            x[i] = (x[i] < -1) ? -1 : ((x[i] > 1) ? 1 : x[i]);
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+const KernelTable *Kernels::sse4Table()
+{
+    static const KernelTable table = {ISA_SSE4, "sse4.1", sse4Gemm6x16, sse4Gemm6x16Half, nullptr, nullptr, sse4DotHalf, nullptr, nullptr, nullptr,
+                                      sse4Im2col3x3, sse4MaxPool, sse4BatchNorm, sse4Activate, nullptr};
+    return &table;
+}
+}
+#else
+namespace Msnhnet
+{
+const KernelTable *Kernels::sse4Table()
+{
+    return nullptr;
+}
+}
+#endif
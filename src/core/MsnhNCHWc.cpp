@@ -0,0 +1,550 @@
+﻿#include "Msnhnet/core/MsnhNCHWc.h"
+#include "Msnhnet/core/MsnhKernels.h"
+#include "Msnhnet/core/MsnhGemm.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Msnhnet
+{
+bool NCHWc::isFaster(const int &outChannel, const int &kSize, const int &stride, const int &outHeight, const int &outWidth)
+{
+    /* the blocked conv skips the im2col, which is what wins it every conv that needs one. A 1x1 stride 1 conv hands its input
+     * to the packed gemm as is, the blocked tile only wins there while the gemm is small or its 2 * GEMM_NR column tiles
+     * waste more than a fifth of their columns (7x7 outputs) */
+    if(kSize != 1 || stride != 1)
+    {
+        return true;
+    }
+
+    const int pixels    = outHeight * outWidth;
+    const int columns   = (pixels + 2 * GEMM_NR - 1) / (2 * GEMM_NR) * (2 * GEMM_NR);
+    return outChannel * pixels <= NCHWC_MAX_1X1_OUTPUT || columns * 4 > pixels * 5;
+}
+
+void NCHWc::toBlocked(float *const &input, const int &batch, const int &channel, const int &height, const int &width, float *const &output)
+{
+    const int blocks    = channel / NCHWC_PACK;
+    const int whSize    = height * width;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int bc = 0; bc < batch * blocks; ++bc)
+    {
+        const float *in = input  + static_cast<size_t>(bc) * NCHWC_PACK * whSize;
+        float *out      = output + static_cast<size_t>(bc) * NCHWC_PACK * whSize;
+
+        for (int i = 0; i < whSize; ++i)
+        {
+            for (int l = 0; l < NCHWC_PACK; ++l)
+            {
+                out[i * NCHWC_PACK + l] = in[l * whSize + i];
+            }
+        }
+    }
+}
+
+void NCHWc::toPlain(float *const &input, const int &batch, const int &channel, const int &height, const int &width, float *const &output)
+{
+    const int blocks    = channel / NCHWC_PACK;
+    const int whSize    = height * width;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int bc = 0; bc < batch * blocks; ++bc)
+    {
+        const float *in = input  + static_cast<size_t>(bc) * NCHWC_PACK * whSize;
+        float *out      = output + static_cast<size_t>(bc) * NCHWC_PACK * whSize;
+
+        for (int l = 0; l < NCHWC_PACK; ++l)
+        {
+            for (int i = 0; i < whSize; ++i)
+            {
+                out[l * whSize + i] = in[i * NCHWC_PACK + l];
+            }
+        }
+    }
+}
+
+size_t NCHWc::getPackedWeightsSize(const int &outChannel, const int &inChannel, const int &kSize)
+{
+    const size_t pairs = static_cast<size_t>((outChannel + NCHWC_CONV_PAIR - 1) / NCHWC_CONV_PAIR);
+    return pairs * NCHWC_CONV_PAIR * inChannel * kSize * kSize;
+}
+
+/* [outChannel/PAIR][inChannel/PACK][kSize*kSize][PACK][PAIR], zero filled past outChannel */
+void NCHWc::packWeights(float *const &weights, const int &outChannel, const int &inChannel, const int &kSize, float *const &packedWeights)
+{
+    const int kNum      = kSize * kSize;
+    const int icBlocks  = inChannel / NCHWC_PACK;
+    const int pairs     = (outChannel + NCHWC_CONV_PAIR - 1) / NCHWC_CONV_PAIR;
+
+    for (int p = 0; p < pairs; ++p)
+    {
+        for (int icb = 0; icb < icBlocks; ++icb)
+        {
+            for (int k = 0; k < kNum; ++k)
+            {
+                for (int l = 0; l < NCHWC_PACK; ++l)
+                {
+                    float *dst  = packedWeights + ((static_cast<size_t>(p * icBlocks + icb) * kNum + k) * NCHWC_PACK + l) * NCHWC_CONV_PAIR;
+                    const int c = icb * NCHWC_PACK + l;
+                    for (int o = 0; o < NCHWC_CONV_PAIR; ++o)
+                    {
+                        const int oc = p * NCHWC_CONV_PAIR + o;
+                        dst[o]       = (oc < outChannel) ? weights[(static_cast<size_t>(oc) * inChannel + c) * kNum + k] : 0.f;
+                    }
+                }
+            }
+        }
+    }
+}
+
+size_t NCHWc::getWorkSpaceSize(const int &channel, const int &height, const int &width, const int &padding)
+{
+    if(padding == 0)
+    {
+        return 0;
+    }
+    return static_cast<size_t>(channel) * (height + 2 * padding) * (width + 2 * padding);
+}
+
+/* the x86 conv is built for avx2 + fma, a layer only goes nchwc when the cpu has both (ConvolutionalLayer::supportNCHWc) */
+MSNH_AVX2_BEGIN
+/* NP output pixels x (1 or 2) output channel blocks. in[q] points at the top left input of pixel q,
+ * the packed weights of one pair are walked linearly. */
+template<int NP>
+static inline void nchwcConvTile(const float *const *const in, const int icBlocks, const size_t inBlockStride,
+                                 const int *const kOffset, const int kNum, const float *weights, const float *const bias,
+                                 const bool accumulate, float *const out0, float *const out1)
+{
+#ifdef USE_X86
+    /* written out per pixel so the 12 accumulators stay in registers without relying on loop unrolling */
+    const __m256 b0 = (bias == nullptr) ? _mm256_setzero_ps() : _mm256_loadu_ps(bias);
+    const __m256 b1 = (bias == nullptr || out1 == nullptr) ? _mm256_setzero_ps() : _mm256_loadu_ps(bias + 8);
+
+    __m256 c00 = b0, c01 = b0, c02 = b0, c03 = b0, c04 = b0, c05 = b0;
+    __m256 c10 = b1, c11 = b1, c12 = b1, c13 = b1, c14 = b1, c15 = b1;
+
+    if(accumulate)
+    {
+        c00 = _mm256_loadu_ps(out0);
+        if(NP > 1) c01 = _mm256_loadu_ps(out0 + 8);
+        if(NP > 2) c02 = _mm256_loadu_ps(out0 + 16);
+        if(NP > 3) c03 = _mm256_loadu_ps(out0 + 24);
+        if(NP > 4) c04 = _mm256_loadu_ps(out0 + 32);
+        if(NP > 5) c05 = _mm256_loadu_ps(out0 + 40);
+        if(out1 != nullptr)
+        {
+            c10 = _mm256_loadu_ps(out1);
+            if(NP > 1) c11 = _mm256_loadu_ps(out1 + 8);
+            if(NP > 2) c12 = _mm256_loadu_ps(out1 + 16);
+            if(NP > 3) c13 = _mm256_loadu_ps(out1 + 24);
+            if(NP > 4) c14 = _mm256_loadu_ps(out1 + 32);
+            if(NP > 5) c15 = _mm256_loadu_ps(out1 + 40);
+        }
+    }
+
+    for (int icb = 0; icb < icBlocks; ++icb)
+    {
+        const size_t blockOffset = icb * inBlockStride;
+        for (int k = 0; k < kNum; ++k)
+        {
+            const size_t offset = blockOffset + kOffset[k];
+            const float *i0     = in[0] + offset;
+            const float *i1     = (NP > 1) ? in[1] + offset : i0;
+            const float *i2     = (NP > 2) ? in[2] + offset : i0;
+            const float *i3     = (NP > 3) ? in[3] + offset : i0;
+            const float *i4     = (NP > 4) ? in[4] + offset : i0;
+            const float *i5     = (NP > 5) ? in[5] + offset : i0;
+
+            for (int l = 0; l < 8; ++l)
+            {
+                const __m256 w0 = _mm256_load_ps(weights);
+                const __m256 w1 = _mm256_load_ps(weights + 8);
+                weights += 16;
+
+                __m256 v;
+                v = _mm256_broadcast_ss(i0 + l); c00 = _mm256_fmadd_ps(v, w0, c00); c10 = _mm256_fmadd_ps(v, w1, c10);
+                if(NP > 1) { v = _mm256_broadcast_ss(i1 + l); c01 = _mm256_fmadd_ps(v, w0, c01); c11 = _mm256_fmadd_ps(v, w1, c11); }
+                if(NP > 2) { v = _mm256_broadcast_ss(i2 + l); c02 = _mm256_fmadd_ps(v, w0, c02); c12 = _mm256_fmadd_ps(v, w1, c12); }
+                if(NP > 3) { v = _mm256_broadcast_ss(i3 + l); c03 = _mm256_fmadd_ps(v, w0, c03); c13 = _mm256_fmadd_ps(v, w1, c13); }
+                if(NP > 4) { v = _mm256_broadcast_ss(i4 + l); c04 = _mm256_fmadd_ps(v, w0, c04); c14 = _mm256_fmadd_ps(v, w1, c14); }
+                if(NP > 5) { v = _mm256_broadcast_ss(i5 + l); c05 = _mm256_fmadd_ps(v, w0, c05); c15 = _mm256_fmadd_ps(v, w1, c15); }
+            }
+        }
+    }
+
+    _mm256_storeu_ps(out0, c00);
+    if(NP > 1) _mm256_storeu_ps(out0 + 8,  c01);
+    if(NP > 2) _mm256_storeu_ps(out0 + 16, c02);
+    if(NP > 3) _mm256_storeu_ps(out0 + 24, c03);
+    if(NP > 4) _mm256_storeu_ps(out0 + 32, c04);
+    if(NP > 5) _mm256_storeu_ps(out0 + 40, c05);
+    if(out1 != nullptr)
+    {
+        _mm256_storeu_ps(out1, c10);
+        if(NP > 1) _mm256_storeu_ps(out1 + 8,  c11);
+        if(NP > 2) _mm256_storeu_ps(out1 + 16, c12);
+        if(NP > 3) _mm256_storeu_ps(out1 + 24, c13);
+        if(NP > 4) _mm256_storeu_ps(out1 + 32, c14);
+        if(NP > 5) _mm256_storeu_ps(out1 + 40, c15);
+    }
+#elif defined(USE_NEON)
+    float32x4_t acc0[NP];
+    float32x4_t acc1[NP];
+    const float32x4_t b0 = (bias == nullptr) ? vdupq_n_f32(0.f) : vld1q_f32(bias);
+    const float32x4_t b1 = (bias == nullptr || out1 == nullptr) ? vdupq_n_f32(0.f) : vld1q_f32(bias + 4);
+    for (int q = 0; q < NP; ++q)
+    {
+        acc0[q] = accumulate ? vld1q_f32(out0 + q * 4) : b0;
+        acc1[q] = (accumulate && out1 != nullptr) ? vld1q_f32(out1 + q * 4) : b1;
+    }
+
+    for (int icb = 0; icb < icBlocks; ++icb)
+    {
+        const size_t blockOffset = icb * inBlockStride;
+        for (int k = 0; k < kNum; ++k)
+        {
+            const size_t offset = blockOffset + kOffset[k];
+            for (int l = 0; l < 4; ++l)
+            {
+                const float32x4_t w0 = vld1q_f32(weights);
+                const float32x4_t w1 = vld1q_f32(weights + 4);
+                weights += 8;
+                for (int q = 0; q < NP; ++q)
+                {
+                    const float v = in[q][offset + l];
+                    acc0[q] = vmlaq_n_f32(acc0[q], w0, v);
+                    acc1[q] = vmlaq_n_f32(acc1[q], w1, v);
+                }
+            }
+        }
+    }
+
+    for (int q = 0; q < NP; ++q)
+    {
+        vst1q_f32(out0 + q * 4, acc0[q]);
+    }
+    if(out1 != nullptr)
+    {
+        for (int q = 0; q < NP; ++q)
+        {
+            vst1q_f32(out1 + q * 4, acc1[q]);
+        }
+    }
+#else
+    float acc[NP][NCHWC_CONV_PAIR];
+    for (int q = 0; q < NP; ++q)
+    {
+        for (int o = 0; o < NCHWC_CONV_PAIR; ++o)
+        {
+            if(accumulate)
+            {
+                acc[q][o] = (o < NCHWC_PACK) ? out0[q * NCHWC_PACK + o] : ((out1 == nullptr) ? 0.f : out1[q * NCHWC_PACK + o - NCHWC_PACK]);
+            }
+            else
+            {
+                acc[q][o] = (bias == nullptr || (out1 == nullptr && o >= NCHWC_PACK)) ? 0.f : bias[o];
+            }
+        }
+    }
+
+    for (int icb = 0; icb < icBlocks; ++icb)
+    {
+        const size_t blockOffset = icb * inBlockStride;
+        for (int k = 0; k < kNum; ++k)
+        {
+            const size_t offset = blockOffset + kOffset[k];
+            for (int l = 0; l < NCHWC_PACK; ++l)
+            {
+                for (int q = 0; q < NP; ++q)
+                {
+                    const float v = in[q][offset + l];
+                    for (int o = 0; o < NCHWC_CONV_PAIR; ++o)
+                    {
+                        acc[q][o] += v * weights[o];
+                    }
+                }
+                weights += NCHWC_CONV_PAIR;
+            }
+        }
+    }
+
+    for (int q = 0; q < NP; ++q)
+    {
+        for (int o = 0; o < NCHWC_PACK; ++o)
+        {
+            out0[q * NCHWC_PACK + o] = acc[q][o];
+            if(out1 != nullptr)
+            {
+                out1[q * NCHWC_PACK + o] = acc[q][NCHWC_PACK + o];
+            }
+        }
+    }
+#endif
+}
+
+void NCHWc::conv(float *const &input, const int &batch, const int &channel, const int &height, const int &width,
+                 const int &kSize, const int &stride, const int &padding, const int &dilation,
+                 float *const &packedWeights, float *const &biases, const int &outChannel, const int &outHeight, const int &outWidth,
+                 float *const &workspace, float *const &output)
+{
+    const int icBlocks      = channel / NCHWC_PACK;
+    const int ocBlocks      = outChannel / NCHWC_PACK;
+    const int pairs         = (ocBlocks + 1) / 2;
+    const int kNum          = kSize * kSize;
+
+    const int paddedH       = height + 2 * padding;
+    const int paddedW       = width  + 2 * padding;
+    const size_t inStride   = static_cast<size_t>(paddedH) * paddedW * NCHWC_PACK;
+
+    /* an isa with a wider tile (KernelTable::nchwcConv) runs two weight pairs per task */
+    const KernelTable &kernels  = Kernels::get();
+    const int pairStep      = (kernels.nchwcConv != nullptr) ? 2 : 1;
+    const int pairGroups    = (pairs + pairStep - 1) / pairStep;
+
+    const int pixels        = outHeight * outWidth;
+    const size_t outStride  = static_cast<size_t>(pixels) * NCHWC_PACK;
+    const int tiles         = (pixels + NCHWC_CONV_TILE - 1) / NCHWC_CONV_TILE;
+    const int chunks        = (tiles + NCHWC_TASK_TILES - 1) / NCHWC_TASK_TILES;
+    const size_t pairSize   = static_cast<size_t>(icBlocks) * kNum * NCHWC_PACK * NCHWC_CONV_PAIR;
+
+    /* input channel blocks per pass, so the weights of one pass stay in L1 across the tiles of a task */
+    const int icStep        = std::max(1, NCHWC_WEIGHT_BLOCK / (kNum * NCHWC_PACK * NCHWC_CONV_PAIR));
+
+    std::vector<int> kOffset(static_cast<size_t>(kNum));
+    for (int ky = 0; ky < kSize; ++ky)
+    {
+        for (int kx = 0; kx < kSize; ++kx)
+        {
+            kOffset[static_cast<size_t>(ky * kSize + kx)] = (ky * dilation * paddedW + kx * dilation) * NCHWC_PACK;
+        }
+    }
+
+    for (int b = 0; b < batch; ++b)
+    {
+        float *in   = input  + static_cast<size_t>(b) * channel * height * width;
+        float *out  = output + static_cast<size_t>(b) * outChannel * pixels;
+
+        if(padding > 0)
+        {
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+            for (int r = 0; r < icBlocks * paddedH; ++r)
+            {
+                const int icb   = r / paddedH;
+                const int y     = r % paddedH - padding;
+                float *dst      = workspace + static_cast<size_t>(r) * paddedW * NCHWC_PACK;
+
+                if(y < 0 || y >= height)
+                {
+                    memset(dst, 0, sizeof(float) * paddedW * NCHWC_PACK);
+                    continue;
+                }
+
+                memset(dst, 0, sizeof(float) * padding * NCHWC_PACK);
+                memcpy(dst + padding * NCHWC_PACK, in + (static_cast<size_t>(icb) * height + y) * width * NCHWC_PACK, sizeof(float) * width * NCHWC_PACK);
+                memset(dst + (padding + width) * NCHWC_PACK, 0, sizeof(float) * padding * NCHWC_PACK);
+            }
+            in = workspace;
+        }
+
+        /* consecutive tasks share their weight pairs, so they stay in cache across the pixel chunks */
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+        for (int t = 0; t < pairGroups * chunks; ++t)
+        {
+            const int p         = (t / chunks) * pairStep;
+            const int tileBegin = (t % chunks) * NCHWC_TASK_TILES;
+            const int tileEnd   = std::min(tileBegin + NCHWC_TASK_TILES, tiles);
+
+            const float *w      = packedWeights + p * pairSize;
+            const bool twoPairs = (pairStep == 2 && p + 1 < pairs);
+            const float *bias   = (biases == nullptr) ? nullptr : biases + p * NCHWC_CONV_PAIR;
+
+            /* the output blocks of this task, nullptr past outChannel */
+            float *outBlocks[4] = {nullptr, nullptr, nullptr, nullptr};
+            for (int j = 0; j < 2 * pairStep && 2 * p + j < ocBlocks; ++j)
+            {
+                outBlocks[j]    = out + static_cast<size_t>(2 * p + j) * outStride;
+            }
+
+            for (int icb = 0; icb < icBlocks; icb += icStep)
+            {
+                const int icNum         = std::min(icStep, icBlocks - icb);
+                const float *wBlock     = w + static_cast<size_t>(icb) * kNum * NCHWC_PACK * NCHWC_CONV_PAIR;
+                const size_t inOffset   = icb * inStride;
+                const bool accumulate   = (icb > 0);
+
+                for (int tile = tileBegin; tile < tileEnd; ++tile)
+                {
+                    const int p0    = tile * NCHWC_CONV_TILE;
+                    const int np    = std::min(NCHWC_CONV_TILE, pixels - p0);
+
+                    const float *pix[NCHWC_CONV_TILE];
+                    for (int q = 0; q < np; ++q)
+                    {
+                        const int oy    = (p0 + q) / outWidth;
+                        const int ox    = (p0 + q) % outWidth;
+                        pix[q]          = in + inOffset + (static_cast<size_t>(oy) * stride * paddedW + ox * stride) * NCHWC_PACK;
+                    }
+
+                    float *o[4];
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        o[j] = (outBlocks[j] == nullptr) ? nullptr : outBlocks[j] + static_cast<size_t>(p0) * NCHWC_PACK;
+                    }
+
+                    if(kernels.nchwcConv != nullptr)
+                    {
+                        kernels.nchwcConv(pix, np, icNum, inStride, kOffset.data(), kNum, wBlock, twoPairs ? wBlock + pairSize : nullptr,
+                                          bias, accumulate, o);
+                    }
+                    else
+                    {
+                        switch (np)
+                        {
+                        case 6: nchwcConvTile<6>(pix, icNum, inStride, kOffset.data(), kNum, wBlock, bias, accumulate, o[0], o[1]); break;
+                        case 5: nchwcConvTile<5>(pix, icNum, inStride, kOffset.data(), kNum, wBlock, bias, accumulate, o[0], o[1]); break;
+                        case 4: nchwcConvTile<4>(pix, icNum, inStride, kOffset.data(), kNum, wBlock, bias, accumulate, o[0], o[1]); break;
+                        case 3: nchwcConvTile<3>(pix, icNum, inStride, kOffset.data(), kNum, wBlock, bias, accumulate, o[0], o[1]); break;
+                        case 2: nchwcConvTile<2>(pix, icNum, inStride, kOffset.data(), kNum, wBlock, bias, accumulate, o[0], o[1]); break;
+                        default: nchwcConvTile<1>(pix, icNum, inStride, kOffset.data(), kNum, wBlock, bias, accumulate, o[0], o[1]); break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+MSNH_AVX2_END
+
+void NCHWc::maxPool(float *const &input, const int &batch, const int &channel, const int &height, const int &width,
+                    const int &kSizeX, const int &kSizeY, const int &strideX, const int &strideY, const int &offsetX, const int &offsetY,
+                    const int &outHeight, const int &outWidth, float *const &output)
+{
+    const int blocks = channel / NCHWC_PACK;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int bc = 0; bc < batch * blocks; ++bc)
+    {
+        const float *in = input  + static_cast<size_t>(bc) * height * width * NCHWC_PACK;
+        float *out      = output + static_cast<size_t>(bc) * outHeight * outWidth * NCHWC_PACK;
+
+        for (int i = 0; i < outHeight; ++i)
+        {
+            for (int j = 0; j < outWidth; ++j)
+            {
+                float max[NCHWC_PACK];
+                for (int l = 0; l < NCHWC_PACK; ++l)
+                {
+                    max[l] = -FLT_MAX;
+                }
+
+                for (int n = 0; n < kSizeY; ++n)
+                {
+                    const int curHeight = offsetY + i * strideY + n;
+                    if(curHeight < 0 || curHeight >= height)
+                    {
+                        continue;
+                    }
+
+                    for (int m = 0; m < kSizeX; ++m)
+                    {
+                        const int curWidth = offsetX + j * strideX + m;
+                        if(curWidth < 0 || curWidth >= width)
+                        {
+                            continue;
+                        }
+
+                        const float *src = in + (curHeight * width + curWidth) * NCHWC_PACK;
+                        for (int l = 0; l < NCHWC_PACK; ++l)
+                        {
+                            max[l] = (src[l] > max[l]) ? src[l] : max[l];
+                        }
+                    }
+                }
+
+                float *dst = out + (i * outWidth + j) * NCHWC_PACK;
+                for (int l = 0; l < NCHWC_PACK; ++l)
+                {
+                    dst[l] = max[l];
+                }
+            }
+        }
+    }
+}
+
+void NCHWc::batchNorm(float *const &input, const int &batch, const int &channel, const int &whSize, float *const &scales,
+                      float *const &biases, float *const &rollMean, float *const &rollVariance, float *const &output)
+{
+    const int blocks = channel / NCHWC_PACK;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int bc = 0; bc < batch * blocks; ++bc)
+    {
+        const int c     = (bc % blocks) * NCHWC_PACK;
+        const float *in = input  + static_cast<size_t>(bc) * whSize * NCHWC_PACK;
+        float *out      = output + static_cast<size_t>(bc) * whSize * NCHWC_PACK;
+
+        float scale[NCHWC_PACK];
+        float mean[NCHWC_PACK];
+        float stdDev[NCHWC_PACK];
+        float bias[NCHWC_PACK];
+        for (int l = 0; l < NCHWC_PACK; ++l)
+        {
+            scale[l]    = scales[c + l];
+            mean[l]     = rollMean[c + l];
+            stdDev[l]   = sqrtf(rollVariance[c + l] + 0.00001f);
+            bias[l]     = biases[c + l];
+        }
+
+        for (int i = 0; i < whSize; ++i)
+        {
+            for (int l = 0; l < NCHWC_PACK; ++l)
+            {
+                out[i * NCHWC_PACK + l] = scale[l] * (in[i * NCHWC_PACK + l] - mean[l]) / stdDev[l] + bias[l];
+            }
+        }
+    }
+}
+
+void NCHWc::upSample(float *const &input, const int &batch, const int &channel, const int &height, const int &width,
+                     const int &stride, const float &scale, float *const &output)
+{
+    const int blocks    = channel / NCHWC_PACK;
+    const int outHeight = height * stride;
+    const int outWidth  = width  * stride;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int bc = 0; bc < batch * blocks; ++bc)
+    {
+        const float *in = input  + static_cast<size_t>(bc) * height * width * NCHWC_PACK;
+        float *out      = output + static_cast<size_t>(bc) * outHeight * outWidth * NCHWC_PACK;
+
+        for (int j = 0; j < outHeight; ++j)
+        {
+            for (int i = 0; i < outWidth; ++i)
+            {
+                const float *src    = in  + ((j / stride) * width + i / stride) * NCHWC_PACK;
+                float *dst          = out + (j * outWidth + i) * NCHWC_PACK;
+                for (int l = 0; l < NCHWC_PACK; ++l)
+                {
+                    dst[l] = scale * src[l];
+                }
+            }
+        }
+    }
+}
+}
@@ -0,0 +1,335 @@
+﻿#include "Msnhnet/core/MsnhQuant.h"
+#include "Msnhnet/layers/MsnhActivations.h"
+
+namespace Msnhnet
+{
+void QuantObserver::observe(const float * const &x, const int &n, const int &pass)
+{
+    if(pass == 1)
+    {
+        float mn = this->empty ? x[0] : this->minVal;
+        float mx = this->empty ? x[0] : this->maxVal;
+
+        for (int i = 0; i < n; ++i)
+        {
+            mn = x[i] < mn ? x[i] : mn;
+            mx = x[i] > mx ? x[i] : mx;
+        }
+
+        this->minVal    = mn;
+        this->maxVal    = mx;
+        this->empty     = false;
+        return;
+    }
+
+    const bool  sign    = this->minVal < 0.f;
+    const float range   = sign ? std::max(-this->minVal, this->maxVal) : this->maxVal;
+
+    if(this->empty || range <= 0.f)
+    {
+        return;
+    }
+
+    if(this->hist.empty())
+    {
+        this->hist.resize(QUANT_HIST_BINS, 0.0);
+    }
+
+    const float binScale = QUANT_HIST_BINS / range;
+
+    for (int i = 0; i < n; ++i)
+    {
+        const float v   = sign ? fabsf(x[i]) : x[i];
+        int bin         = static_cast<int>(v * binScale);
+        bin             = bin < 0 ? 0 : (bin >= QUANT_HIST_BINS ? QUANT_HIST_BINS - 1 : bin);
+        this->hist[static_cast<size_t>(bin)] += 1.0;
+    }
+}
+
+void QuantObserver::getParams(const QuantCalibration &method, const float &percentile, float &scale, int &zeroPoint) const
+{
+    const bool  sign    = this->minVal < 0.f;
+    float       range   = sign ? std::max(-this->minVal, this->maxVal) : this->maxVal;
+
+    if(method == QUANT_PERCENTILE && !this->hist.empty())
+    {
+        double total    = 0;
+        for (size_t i = 0; i < this->hist.size(); ++i)
+        {
+            total      += this->hist[i];
+        }
+
+        const double target = total * static_cast<double>(percentile);
+        double cum      = 0;
+        for (size_t i = 0; i < this->hist.size(); ++i)
+        {
+            cum        += this->hist[i];
+            if(cum >= target)
+            {
+                range   = range * (i + 1) / QUANT_HIST_BINS;
+                break;
+            }
+        }
+    }
+
+    if(range <= 0.f)
+    {
+        range       = 1.f;
+    }
+
+    zeroPoint       = sign ? 64 : 0;
+    scale           = range / (sign ? 63.f : 127.f);
+}
+
+void Quant::quantizeWeights(const float * const &weights, const int &M, const int &K, int8_t * const &q, float * const &scales)
+{
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int m = 0; m < M; ++m)
+    {
+        const float *w  = weights + static_cast<size_t>(m) * K;
+        float absMax    = 0.f;
+
+        for (int k = 0; k < K; ++k)
+        {
+            absMax      = fabsf(w[k]) > absMax ? fabsf(w[k]) : absMax;
+        }
+
+        const float scale   = absMax > 0.f ? absMax / 127.f : 1.f;
+        scales[m]           = scale;
+
+        for (int k = 0; k < K; ++k)
+        {
+            int v       = static_cast<int>(std::nearbyint(w[k] / scale));
+            v           = v < -127 ? -127 : (v > 127 ? 127 : v);
+            q[static_cast<size_t>(m) * K + k] = static_cast<int8_t>(v);
+        }
+    }
+}
+
+size_t Quant::getPackedASize(const int &M, const int &K)
+{
+    return static_cast<size_t>((M + QUANT_MR - 1) / QUANT_MR * QUANT_MR) * static_cast<size_t>((K + 3) / 4 * 4);
+}
+
+/* panels of QUANT_MR rows, each k4 step holds 4 consecutive k of every row: [panel][k4][QUANT_MR][4] */
+void Quant::packA(const int8_t * const &q, const int &M, const int &K, int8_t * const &packedA, int32_t * const &rowSums)
+{
+    const int K4        = (K + 3) / 4;
+    const int mPanels   = (M + QUANT_MR - 1) / QUANT_MR;
+
+    for (int ip = 0; ip < mPanels; ++ip)
+    {
+        int8_t *panel   = packedA + static_cast<size_t>(ip) * QUANT_MR * K4 * 4;
+
+        for (int k4 = 0; k4 < K4; ++k4)
+        {
+            for (int r = 0; r < QUANT_MR; ++r)
+            {
+                const int m = ip * QUANT_MR + r;
+                for (int t = 0; t < 4; ++t)
+                {
+                    const int k = k4 * 4 + t;
+                    panel[(k4 * QUANT_MR + r) * 4 + t] = (m < M && k < K) ? q[static_cast<size_t>(m) * K + k] : 0;
+                }
+            }
+        }
+    }
+
+    for (int m = 0; m < M; ++m)
+    {
+        int32_t sum     = 0;
+        for (int k = 0; k < K; ++k)
+        {
+            sum        += q[static_cast<size_t>(m) * K + k];
+        }
+        rowSums[m]      = sum;
+    }
+}
+
+void Quant::unpackA(const int8_t * const &packedA, const int &M, const int &K, int8_t * const &q)
+{
+    const int K4        = (K + 3) / 4;
+
+    for (int m = 0; m < M; ++m)
+    {
+        const int8_t *panel = packedA + static_cast<size_t>(m / QUANT_MR) * QUANT_MR * K4 * 4;
+        const int r         = m % QUANT_MR;
+
+        for (int k = 0; k < K; ++k)
+        {
+            q[static_cast<size_t>(m) * K + k] = panel[((k / 4) * QUANT_MR + r) * 4 + k % 4];
+        }
+    }
+}
+
+int Quant::getGemvStride(const int &K)
+{
+    return (K + QUANT_GEMV_ALIGN - 1) / QUANT_GEMV_ALIGN * QUANT_GEMV_ALIGN;
+}
+
+void Quant::packGemv(const int8_t * const &q, const int &M, const int &K, int8_t * const &packedA, int32_t * const &rowSums)
+{
+    const int stride    = getGemvStride(K);
+
+    for (int m = 0; m < M; ++m)
+    {
+        int32_t sum     = 0;
+        for (int k = 0; k < stride; ++k)
+        {
+            const int8_t v  = k < K ? q[static_cast<size_t>(m) * K + k] : 0;
+            packedA[static_cast<size_t>(m) * stride + k] = v;
+            sum            += v;
+        }
+        rowSums[m]      = sum;
+    }
+}
+
+static inline uint8_t quantActivation(const float &x, const float &inv, const int &zeroPoint)
+{
+    float v = x * inv;
+    v       = v < -zeroPoint ? -zeroPoint : (v > 127 - zeroPoint ? 127 - zeroPoint : v);
+    return static_cast<uint8_t>(static_cast<int>(std::nearbyint(v)) + zeroPoint);
+}
+
+static inline float quantEpilogue(float x, const GemmEpilogue &epi, const int &row, const float *const &res)
+{
+    if(epi.bias != nullptr)
+    {
+        x += epi.bias[row];
+    }
+    if(epi.activation != ActivationType::NONE)
+    {
+        x = Activations::activate(x, epi.activation, epi.actParam);
+    }
+    if(res != nullptr)
+    {
+        x += *res;
+    }
+    if(epi.postActivation != ActivationType::NONE)
+    {
+        x = Activations::activate(x, epi.postActivation, epi.postActParam);
+    }
+    return x;
+}
+
+struct QuantBuffer
+{
+    uint8_t *data       =   nullptr;
+    size_t  capacity    =   0;
+    ~QuantBuffer()
+    {
+        Gemm::alignedFree(data);
+    }
+};
+
+static inline uint8_t *quantGrowBuffer(QuantBuffer &buf, const size_t &size)
+{
+    if(size > buf.capacity)
+    {
+        Gemm::alignedFree(buf.data);
+        buf.data        = static_cast<uint8_t *>(Gemm::alignedMalloc(size));
+        buf.capacity    = size;
+    }
+    return buf.data;
+}
+
+void Quant::gemm(const int &M, const int &N, const int &K, const int8_t * const &packedA, const float * const &wScales, const int32_t * const &rowSums,
+                 const float * const &B, const int &ldb, const float &inScale, const int &inZeroPoint,
+                 float * const &C, const int &ldc, const GemmEpilogue &epilogue)
+{
+    static thread_local QuantBuffer bufB;
+
+    const KernelTable &kernels  = Kernels::get();
+    if(kernels.quantGemm4x16 == nullptr)
+    {
+        throw Exception(1, std::string("int8 gemm needs avx2, the kernels are ") + kernels.name, __FILE__, __LINE__);
+    }
+
+    const int K4            = (K + 3) / 4;
+    const int mPanels       = (M + QUANT_MR - 1) / QUANT_MR;
+    const size_t panelSize  = static_cast<size_t>(K4) * QUANT_NR * 4;
+    const int ncMax         = N < QUANT_NC ? N : QUANT_NC;
+    const float inv         = 1.f / inScale;
+
+    uint8_t *packedB        = quantGrowBuffer(bufB, static_cast<size_t>((ncMax + QUANT_NR - 1) / QUANT_NR) * panelSize);
+
+    for (int jc = 0; jc < N; jc += QUANT_NC)
+    {
+        const int nc        = (N - jc) < QUANT_NC ? (N - jc) : QUANT_NC;
+        const int nPanels   = (nc + QUANT_NR - 1) / QUANT_NR;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+        for (int jp = 0; jp < nPanels; ++jp)
+        {
+            const int jr    = jp * QUANT_NR;
+            const int nr    = (nc - jr) < QUANT_NR ? (nc - jr) : QUANT_NR;
+            kernels.quantPackB(B + jc + jr, ldb, K, nr, inv, inZeroPoint, packedB + jp * panelSize);
+        }
+
+        /* consecutive tasks share a B panel, A streams from cache */
+        const int tasks     = mPanels * nPanels;
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD) schedule(static)
+#endif
+        for (int task = 0; task < tasks; ++task)
+        {
+            const int ip    = task % mPanels;
+            const int jp    = task / mPanels;
+            const int ir    = ip * QUANT_MR;
+            const int jr    = jp * QUANT_NR;
+
+            QuantTile t;
+            t.C             = C + static_cast<size_t>(ir) * ldc + jc + jr;
+            t.ldc           = ldc;
+            t.mr            = (M - ir) < QUANT_MR ? (M - ir) : QUANT_MR;
+            t.nr            = (nc - jr) < QUANT_NR ? (nc - jr) : QUANT_NR;
+            t.row           = ir;
+            t.res           = (epilogue.residual == nullptr) ? nullptr : (epilogue.residual + static_cast<size_t>(ir) * ldc + jc + jr);
+            t.wScales       = wScales;
+            t.rowSums       = rowSums;
+            t.inScale       = inScale;
+            t.inZeroPoint   = inZeroPoint;
+            t.epi           = &epilogue;
+
+            kernels.quantGemm4x16(K4, packedA + static_cast<size_t>(ir) * K4 * 4, packedB + jp * panelSize, t);
+        }
+    }
+}
+
+void Quant::gemv(const int &M, const int &K, const int8_t * const &packedA, const float * const &wScales, const int32_t * const &rowSums,
+                 const float * const &x, const float &inScale, const int &inZeroPoint,
+                 float * const &y, const GemmEpilogue &epilogue)
+{
+    static thread_local QuantBuffer bufX;
+
+    const KernelTable &kernels  = Kernels::get();
+    if(kernels.quantDot == nullptr)
+    {
+        throw Exception(1, std::string("int8 gemv needs avx2, the kernels are ") + kernels.name, __FILE__, __LINE__);
+    }
+
+    const int stride    = getGemvStride(K);
+    const float inv     = 1.f / inScale;
+    uint8_t *xq         = quantGrowBuffer(bufX, static_cast<size_t>(stride));
+
+    for (int k = 0; k < stride; ++k)
+    {
+        xq[k]           = k < K ? quantActivation(x[k], inv, inZeroPoint) : 0;
+    }
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int m = 0; m < M; ++m)
+    {
+        const int32_t acc   = kernels.quantDot(stride, xq, packedA + static_cast<size_t>(m) * stride);
+        const float v       = static_cast<float>(acc - inZeroPoint * rowSums[m]) * wScales[m] * inScale;
+
+        y[m]                = quantEpilogue(v, epilogue, m, (epilogue.residual == nullptr) ? nullptr : (epilogue.residual + m));
+    }
+}
+}
@@ -0,0 +1,371 @@
+﻿#include "Msnhnet/core/MsnhThreadPool.h"
+#ifdef USE_X86
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+namespace Msnhnet
+{
+static thread_local ThreadPool *currentPool = nullptr;
+/* set on the pool workers and on a caller inside its loop, their loops run serially */
+static thread_local bool        insideLoop  = false;
+
+static inline void spinPause()
+{
+#ifdef USE_X86
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+#ifdef __linux__
+static void bindOmpThreads(const int &threads, const cpu_set_t &cpus)
+{
+#ifdef USE_OMP
+    /* the omp threads of a thread are kept between its regions, so later regions of up to threads run on cpus */
+    if(omp_in_parallel())
+    {
+        return;
+    }
+
+#pragma omp parallel num_threads(threads)
+    {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+    }
+#else
+    (void)threads;
+    (void)cpus;
+#endif
+}
+#endif
+
+ThreadPool::ThreadPool(const int &threadNum, const std::vector<int> &cpus)
+{
+    this->remaining     =   0;
+    this->active        =   0;
+    this->open          =   false;
+    this->busy          =   false;
+    this->generation    =   0;
+    this->stopping      =   false;
+
+    setThreadNum(threadNum, cpus);
+}
+
+ThreadPool::~ThreadPool()
+{
+    stopWorkers();
+}
+
+void ThreadPool::setThreadNum(const int &threadNum, const std::vector<int> &cpus)
+{
+    if(threadNum < 1)
+    {
+        throw Exception(1, "Thread pool needs threadNum > 0 !",__FILE__, __LINE__);
+    }
+
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(getpid(), sizeof(cpu_set_t), &allowed);
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        if(cpus[i] < 0 || cpus[i] >= CPU_SETSIZE || !CPU_ISSET(cpus[i], &allowed))
+        {
+            throw Exception(1, "cpu " + std::to_string(cpus[i]) + " is not available to this process !",__FILE__, __LINE__);
+        }
+        CPU_SET(cpus[i], &cpuSet);
+    }
+#endif
+
+    stopWorkers();
+
+    this->threadNum =   threadNum;
+    this->cpus      =   cpus;
+#ifdef __linux__
+    this->cpuSet    =   cpuSet;
+#endif
+    this->ranges    =   new Range[threadNum];
+    startWorkers();
+}
+
+int ThreadPool::getThreadNum() const
+{
+    return this->threadNum;
+}
+
+const std::vector<int> &ThreadPool::getCpus() const
+{
+    return this->cpus;
+}
+
+ThreadPool *ThreadPool::getCurrent()
+{
+    if(insideLoop)
+    {
+        return nullptr;
+    }
+
+    if(currentPool != nullptr)
+    {
+        return currentPool;
+    }
+
+    /* created on first use, so MSNH_DEFAULT_THREADS is read after the app set the omp threads */
+    static ThreadPool defaultPool(MSNH_DEFAULT_THREADS);
+    return &defaultPool;
+}
+
+ThreadPool *ThreadPool::setCurrent(ThreadPool *const &pool)
+{
+    ThreadPool *previous = currentPool;
+    currentPool = pool;
+    return previous;
+}
+
+bool ThreadPool::run(const int &start, const int &stop, const int &grain, const Body &body, const void *const &func)
+{
+    const int total =   stop - start;
+    const int chunk =   std::max(1, grain);
+
+    if(this->threadNum < 2 || total <= chunk)
+    {
+        return false;
+    }
+
+#ifdef USE_OMP
+    /* the omp threads of the region already use the cores */
+    if(omp_in_parallel())
+    {
+        return false;
+    }
+#endif
+
+    bool idle = false;
+    if(!this->busy.compare_exchange_strong(idle, true))
+    {
+        return false;
+    }
+
+    const int parts = std::min(this->threadNum, (total + chunk - 1) / chunk);
+    for (int p = 0; p < parts; ++p)
+    {
+        this->ranges[p].next.store(start + static_cast<int>(1LL * total * p / parts), std::memory_order_relaxed);
+        this->ranges[p].end  =   start + static_cast<int>(1LL * total * (p + 1) / parts);
+    }
+
+    this->body      =   body;
+    this->func      =   func;
+    this->rangeNum  =   parts;
+    this->step      =   chunk;
+    this->error     =   nullptr;
+    this->remaining.store(total, std::memory_order_relaxed);
+    this->open.store(true);
+
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->generation.fetch_add(1);
+        notify = this->sleeping > 0;
+    }
+
+    if(notify)
+    {
+        this->wake.notify_all();
+    }
+
+    insideLoop = true;
+    participate(0);
+    insideLoop = false;
+
+    /* chunks still running on the workers, then no worker may touch the ranges once the loop is closed */
+    while (this->remaining.load(std::memory_order_acquire) > 0)
+    {
+        spinPause();
+    }
+
+    this->open.store(false);
+    while (this->active.load() > 0)
+    {
+        spinPause();
+    }
+
+    std::exception_ptr error = this->error;
+    this->error = nullptr;
+    this->busy.store(false, std::memory_order_release);
+
+    if(error)
+    {
+        std::rethrow_exception(error);
+    }
+    return true;
+}
+
+void ThreadPool::participate(const int &index)
+{
+    /* own range first, then steal from the next ones */
+    for (int r = 0; r < this->rangeNum; ++r)
+    {
+        Range &range = this->ranges[(index + r) % this->rangeNum];
+
+        while (true)
+        {
+            const int begin = range.next.fetch_add(this->step, std::memory_order_relaxed);
+            if(begin >= range.end)
+            {
+                break;
+            }
+
+            const int end   = std::min(begin + this->step, range.end);
+            try
+            {
+                this->body(this->func, begin, end);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(this->errorMutex);
+                if(!this->error)
+                {
+                    this->error = std::current_exception();
+                }
+            }
+
+            this->remaining.fetch_sub(end - begin, std::memory_order_acq_rel);
+        }
+    }
+}
+
+void ThreadPool::work(const int &index)
+{
+#ifdef __linux__
+    if(!this->cpus.empty())
+    {
+        cpu_set_t cpu;
+        CPU_ZERO(&cpu);
+        CPU_SET(this->cpus[static_cast<size_t>(index) % this->cpus.size()], &cpu);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu);
+    }
+#endif
+
+    insideLoop    = true;
+    unsigned seen = this->generation.load();
+
+    while (true)
+    {
+        for (int spin = 0; spin < MSNH_POOL_SPIN && this->generation.load(std::memory_order_acquire) == seen && !this->stopping.load(std::memory_order_relaxed); ++spin)
+        {
+            spinPause();
+        }
+
+        if(this->generation.load() == seen && !this->stopping.load())
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->sleeping++;
+            this->wake.wait(lock, [this, seen]{ return this->generation.load() != seen || this->stopping.load(); });
+            this->sleeping--;
+        }
+
+        if(this->stopping.load())
+        {
+            return;
+        }
+        seen = this->generation.load();
+
+        /* a worker late for a loop that is closed already backs out */
+        this->active.fetch_add(1);
+        if(this->open.load())
+        {
+            participate(index);
+        }
+        this->active.fetch_sub(1);
+    }
+}
+
+void ThreadPool::startWorkers()
+{
+    this->stopping = false;
+
+    if(this->threadNum > 1)
+    {
+        this->workers = new std::thread[this->threadNum - 1];
+        for (int i = 1; i < this->threadNum; ++i)
+        {
+            this->workers[i - 1] = std::thread(&ThreadPool::work, this, i);
+        }
+    }
+}
+
+void ThreadPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+
+    for (int i = 0; i < this->threadNum - 1 && this->workers != nullptr; ++i)
+    {
+        this->workers[i].join();
+    }
+
+    delete[] this->workers;
+    this->workers   =   nullptr;
+
+    delete[] this->ranges;
+    this->ranges    =   nullptr;
+}
+
+ThreadPoolScope::ThreadPoolScope(ThreadPool *const &pool)
+{
+    this->pool = pool;
+    if(pool == nullptr)
+    {
+        return;
+    }
+
+    this->previous = ThreadPool::setCurrent(pool);
+
+#ifdef USE_OMP
+    this->previousThreads = omp_get_max_threads();
+    omp_set_num_threads(pool->getThreadNum());
+#endif
+
+#ifdef __linux__
+    if(!pool->cpus.empty())
+    {
+        pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &this->previousCpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &pool->cpuSet);
+        bindOmpThreads(pool->threadNum, pool->cpuSet);
+        this->bound = true;
+    }
+#endif
+}
+
+ThreadPoolScope::~ThreadPoolScope()
+{
+    if(this->pool == nullptr)
+    {
+        return;
+    }
+
+    ThreadPool::setCurrent(this->previous);
+
+#ifdef __linux__
+    if(this->bound)
+    {
+        bindOmpThreads(this->pool->threadNum, this->previousCpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &this->previousCpus);
+    }
+#endif
+
+#ifdef USE_OMP
+    omp_set_num_threads(this->previousThreads);
+#endif
+}
+}
@@ -0,0 +1,460 @@
+﻿#include "Msnhnet/core/MsnhWinograd.h"
+
+namespace Msnhnet
+{
+/* F(2x2,3x3) */
+static const float wgG2[12] =
+{
+    1.f,   0.f,   0.f,
+    0.5f,  0.5f,  0.5f,
+    0.5f, -0.5f,  0.5f,
+    0.f,   0.f,   1.f
+};
+
+/* F(4x4,3x3) */
+static const float wgG4[18] =
+{
+    1.f/4,    0.f,      0.f,
+   -1.f/6,   -1.f/6,   -1.f/6,
+   -1.f/6,    1.f/6,   -1.f/6,
+    1.f/24,   1.f/12,   1.f/6,
+    1.f/24,  -1.f/12,   1.f/6,
+    0.f,      0.f,      1.f
+};
+
+static inline float wgAdd(const float &a, const float &b) { return a + b; }
+static inline float wgSub(const float &a, const float &b) { return a - b; }
+static inline float wgFma(const float &a, const float &c, const float &b) { return a * c + b; }
+
+/* the transforms are built for avx2, a layer only picks winograd when the cpu has avx2 + fma */
+MSNH_AVX2_BEGIN
+#ifdef USE_X86
+static inline __m256 wgAdd(const __m256 &a, const __m256 &b) { return _mm256_add_ps(a, b); }
+static inline __m256 wgSub(const __m256 &a, const __m256 &b) { return _mm256_sub_ps(a, b); }
+static inline __m256 wgFma(const __m256 &a, const float &c, const __m256 &b) { return _mm256_fmadd_ps(a, _mm256_set1_ps(c), b); }
+#endif
+
+/* 1D B^T (input) and A^T (output) transforms, applied once along rows and once along columns. */
+template<int TILE>
+struct WinogradTransform;
+
+template<>
+struct WinogradTransform<2>
+{
+    template<typename T>
+    static inline void input(const T *d, T *r)
+    {
+        r[0] = wgSub(d[0], d[2]);
+        r[1] = wgAdd(d[1], d[2]);
+        r[2] = wgSub(d[2], d[1]);
+        r[3] = wgSub(d[1], d[3]);
+    }
+
+    template<typename T>
+    static inline void output(const T *m, T *o)
+    {
+        o[0] = wgAdd(wgAdd(m[0], m[1]), m[2]);
+        o[1] = wgSub(wgSub(m[1], m[2]), m[3]);
+    }
+};
+
+template<>
+struct WinogradTransform<4>
+{
+    template<typename T>
+    static inline void input(const T *d, T *r)
+    {
+        r[0] = wgFma(d[0], 4.f, wgFma(d[2], -5.f, d[4]));
+        r[1] = wgFma(wgAdd(d[1], d[2]), -4.f, wgAdd(d[3], d[4]));
+        r[2] = wgFma(wgSub(d[1], d[2]),  4.f, wgSub(d[4], d[3]));
+        r[3] = wgFma(wgSub(d[3], d[1]),  2.f, wgSub(d[4], d[2]));
+        r[4] = wgFma(wgSub(d[1], d[3]),  2.f, wgSub(d[4], d[2]));
+        r[5] = wgFma(d[1], 4.f, wgFma(d[3], -5.f, d[5]));
+    }
+
+    template<typename T>
+    static inline void output(const T *m, T *o)
+    {
+        const T a = wgAdd(m[1], m[2]);
+        const T b = wgSub(m[1], m[2]);
+        const T c = wgAdd(m[3], m[4]);
+        const T d = wgSub(m[3], m[4]);
+
+        o[0] = wgAdd(wgAdd(m[0], a), c);
+        o[1] = wgFma(d, 2.f, b);
+        o[2] = wgFma(c, 4.f, a);
+        o[3] = wgAdd(wgFma(d, 8.f, b), m[5]);
+    }
+};
+
+/* transforms tiles [tileBegin, tileEnd) of every input channel into transInput laid out as [alpha*alpha][inChannel][tileEnd - tileBegin] */
+template<int TILE>
+static void winogradInputTransform(float *const input, const int inChannel, const int height, const int width, const int paddingX, const int paddingY,
+                                   const int tilesW, const int tileBegin, const int tileEnd, float *const transInput)
+{
+    const int alpha     = TILE + 2;
+    const int nTiles    = tileEnd - tileBegin;
+    const int xiStep    = inChannel * nTiles;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int ic = 0; ic < inChannel; ++ic)
+    {
+        static thread_local std::vector<float> buf;
+
+        const float *in = input + ic * height * width;
+        float *out      = transInput + ic * nTiles;
+
+        for (int t = tileBegin; t < tileEnd;)
+        {
+            const int ty        = t / tilesW;
+            const int txBegin   = t % tilesW;
+            const int txEnd     = (tileEnd - ty * tilesW) < tilesW ? (tileEnd - ty * tilesW) : tilesW;
+            const int x0        = txBegin * TILE - paddingX;
+            const int rowW      = (txEnd - txBegin) * TILE + 2;
+
+            if(buf.size() < static_cast<size_t>(2 * alpha * rowW))
+            {
+                buf.resize(static_cast<size_t>(2 * alpha * rowW));
+            }
+
+            float *rows = buf.data();
+            float *vt   = rows + alpha * rowW;
+
+            for (int r = 0; r < alpha; ++r)
+            {
+                const int y     = ty * TILE - paddingY + r;
+                float *row      = rows + r * rowW;
+
+                for (int x = 0; x < rowW; ++x)
+                {
+                    const int ix    = x0 + x;
+                    row[x]          = (y >= 0 && y < height && ix >= 0 && ix < width) ? in[y * width + ix] : 0.f;
+                }
+            }
+
+            int x = 0;
+#ifdef USE_X86
+            for (; x + 8 <= rowW; x += 8)
+            {
+                __m256 d[alpha];
+                __m256 r[alpha];
+                for (int k = 0; k < alpha; ++k)
+                {
+                    d[k] = _mm256_loadu_ps(rows + k * rowW + x);
+                }
+                WinogradTransform<TILE>::input(d, r);
+                for (int k = 0; k < alpha; ++k)
+                {
+                    _mm256_storeu_ps(vt + k * rowW + x, r[k]);
+                }
+            }
+#endif
+            for (; x < rowW; ++x)
+            {
+                float d[alpha];
+                float r[alpha];
+                for (int k = 0; k < alpha; ++k)
+                {
+                    d[k] = rows[k * rowW + x];
+                }
+                WinogradTransform<TILE>::input(d, r);
+                for (int k = 0; k < alpha; ++k)
+                {
+                    vt[k * rowW + x] = r[k];
+                }
+            }
+
+            float *dst  = out + (t - tileBegin);
+            int tx      = 0;
+#ifdef USE_X86
+            const __m256i idx = _mm256_setr_epi32(0, TILE, 2 * TILE, 3 * TILE, 4 * TILE, 5 * TILE, 6 * TILE, 7 * TILE);
+            for (; tx + 8 <= txEnd - txBegin; tx += 8)
+            {
+                for (int i = 0; i < alpha; ++i)
+                {
+                    __m256 u[alpha];
+                    __m256 v[alpha];
+                    for (int k = 0; k < alpha; ++k)
+                    {
+                        u[k] = _mm256_i32gather_ps(vt + i * rowW + tx * TILE + k, idx, 4);
+                    }
+                    WinogradTransform<TILE>::input(u, v);
+                    for (int j = 0; j < alpha; ++j)
+                    {
+                        _mm256_storeu_ps(dst + (i * alpha + j) * xiStep + tx, v[j]);
+                    }
+                }
+            }
+#endif
+            for (; tx < txEnd - txBegin; ++tx)
+            {
+                for (int i = 0; i < alpha; ++i)
+                {
+                    float v[alpha];
+                    WinogradTransform<TILE>::input(vt + i * rowW + tx * TILE, v);
+                    for (int j = 0; j < alpha; ++j)
+                    {
+                        dst[(i * alpha + j) * xiStep + tx] = v[j];
+                    }
+                }
+            }
+
+            t = ty * tilesW + txEnd;
+        }
+    }
+}
+
+/* inverse of winogradInputTransform, transOutput is laid out as [alpha*alpha][outChannel][tileEnd - tileBegin] */
+template<int TILE>
+static void winogradOutputTransform(float *const transOutput, const int outChannel, const int tilesW, const int tileBegin, const int tileEnd,
+                                    const int outHeight, const int outWidth, float *const output)
+{
+    const int alpha     = TILE + 2;
+    const int nTiles    = tileEnd - tileBegin;
+    const int xiStep    = outChannel * nTiles;
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int oc = 0; oc < outChannel; ++oc)
+    {
+        const float *src    = transOutput + oc * nTiles;
+        float *out          = output + oc * outHeight * outWidth;
+
+        int i = 0;
+#ifdef USE_X86
+        for (; i + 8 <= nTiles; i += 8)
+        {
+            __m256 s[TILE][alpha];
+            float  y[TILE * TILE * 8];
+
+            for (int k = 0; k < alpha; ++k)
+            {
+                __m256 m[alpha];
+                __m256 o[TILE];
+                for (int r = 0; r < alpha; ++r)
+                {
+                    m[r] = _mm256_loadu_ps(src + (r * alpha + k) * xiStep + i);
+                }
+                WinogradTransform<TILE>::output(m, o);
+                for (int r = 0; r < TILE; ++r)
+                {
+                    s[r][k] = o[r];
+                }
+            }
+
+            for (int r = 0; r < TILE; ++r)
+            {
+                __m256 o[TILE];
+                WinogradTransform<TILE>::output(s[r], o);
+                for (int c = 0; c < TILE; ++c)
+                {
+                    _mm256_storeu_ps(y + (r * TILE + c) * 8, o[c]);
+                }
+            }
+
+            for (int l = 0; l < 8; ++l)
+            {
+                const int t     = tileBegin + i + l;
+                const int oy0   = (t / tilesW) * TILE;
+                const int ox0   = (t % tilesW) * TILE;
+
+                for (int r = 0; r < TILE && oy0 + r < outHeight; ++r)
+                {
+                    for (int c = 0; c < TILE && ox0 + c < outWidth; ++c)
+                    {
+                        out[(oy0 + r) * outWidth + ox0 + c] = y[(r * TILE + c) * 8 + l];
+                    }
+                }
+            }
+        }
+#endif
+        for (; i < nTiles; ++i)
+        {
+            float s[TILE][alpha];
+
+            for (int k = 0; k < alpha; ++k)
+            {
+                float m[alpha];
+                float o[TILE];
+                for (int r = 0; r < alpha; ++r)
+                {
+                    m[r] = src[(r * alpha + k) * xiStep + i];
+                }
+                WinogradTransform<TILE>::output(m, o);
+                for (int r = 0; r < TILE; ++r)
+                {
+                    s[r][k] = o[r];
+                }
+            }
+
+            const int t     = tileBegin + i;
+            const int oy0   = (t / tilesW) * TILE;
+            const int ox0   = (t % tilesW) * TILE;
+
+            for (int r = 0; r < TILE && oy0 + r < outHeight; ++r)
+            {
+                float o[TILE];
+                WinogradTransform<TILE>::output(s[r], o);
+                for (int c = 0; c < TILE && ox0 + c < outWidth; ++c)
+                {
+                    out[(oy0 + r) * outWidth + ox0 + c] = o[c];
+                }
+            }
+        }
+    }
+}
+MSNH_AVX2_END
+
+/* number of tiles transformed per pass, so the transformed input and output of one pass stay in cache */
+static int winogradTileBlock(const int &outTile, const int &inChannel, const int &outChannel, const int &tiles)
+{
+    const int alpha     = outTile + 2;
+    const int perTile   = alpha * alpha * (inChannel + outChannel);
+    int block           = WINOGRAD_BLOCK_SIZE / perTile / GEMM_NR * GEMM_NR;
+
+    if(block < WINOGRAD_MIN_TILES)
+    {
+        block = WINOGRAD_MIN_TILES;
+    }
+
+    return block < tiles ? block : tiles;
+}
+
+int Winograd::selectOutTile(const int &outHeight, const int &outWidth)
+{
+    /* cost is counted in gemm columns, which the packed gemm rounds up to GEMM_NR.
+     * Winograd is only chosen when it saves at least 30% over im2col, transforms are not free. */
+    const size_t im2colCost = 9 * static_cast<size_t>((outHeight * outWidth + GEMM_NR - 1) / GEMM_NR * GEMM_NR);
+
+    size_t bestCost     = im2colCost * 7 / 10;
+    int    bestTile     = 0;
+
+    for (int outTile = 4; outTile >= 2; outTile -= 2)
+    {
+        const int tiles     = ((outHeight + outTile - 1) / outTile) * ((outWidth + outTile - 1) / outTile);
+        const size_t cost   = static_cast<size_t>((outTile + 2) * (outTile + 2)) * static_cast<size_t>((tiles + GEMM_NR - 1) / GEMM_NR * GEMM_NR);
+
+        if(cost < bestCost)
+        {
+            bestCost    = cost;
+            bestTile    = outTile;
+        }
+    }
+
+    return bestTile;
+}
+
+size_t Winograd::getTransformedWeightsSize(const int &outTile, const int &outChannel, const int &inChannel)
+{
+    const size_t alpha  = static_cast<size_t>(outTile + 2);
+    return alpha * alpha * Gemm::getPackedASize(outChannel, inChannel);
+}
+
+size_t Winograd::getWorkSpaceSize(const int &outTile, const int &inChannel, const int &outChannel, const int &outHeight, const int &outWidth)
+{
+    const size_t alpha  = static_cast<size_t>(outTile + 2);
+    const int tiles     = ((outHeight + outTile - 1) / outTile) * ((outWidth + outTile - 1) / outTile);
+    const size_t block  = static_cast<size_t>(winogradTileBlock(outTile, inChannel, outChannel, tiles));
+    return alpha * alpha * static_cast<size_t>(inChannel + outChannel) * block;
+}
+
+void Winograd::transformWeights3x3(const int &outTile, float * const &weights, const int &outChannel, const int &inChannel, float * const &transWeights)
+{
+    if(outTile != 2 && outTile != 4)
+    {
+        throw Exception(1, "Winograd out tile must be 2 or 4, given : " + std::to_string(outTile), __FILE__, __LINE__);
+    }
+
+    const int alpha         = outTile + 2;
+    const float *G          = (outTile == 2) ? wgG2 : wgG4;
+    const size_t blockSize  = static_cast<size_t>(outChannel) * static_cast<size_t>(inChannel);
+
+    std::vector<float> trans(static_cast<size_t>(alpha * alpha) * blockSize);
+
+#ifdef USE_OMP
+#pragma omp parallel for num_threads(OMP_THREAD)
+#endif
+    for (int oc = 0; oc < outChannel; ++oc)
+    {
+        for (int ic = 0; ic < inChannel; ++ic)
+        {
+            const float *g  = weights + (oc * inChannel + ic) * 9;
+            float tmp[6][3];
+
+            for (int i = 0; i < alpha; ++i)
+            {
+                for (int j = 0; j < 3; ++j)
+                {
+                    tmp[i][j] = G[i * 3 + 0] * g[0 * 3 + j] + G[i * 3 + 1] * g[1 * 3 + j] + G[i * 3 + 2] * g[2 * 3 + j];
+                }
+            }
+
+            for (int i = 0; i < alpha; ++i)
+            {
+                for (int j = 0; j < alpha; ++j)
+                {
+                    trans[(i * alpha + j) * blockSize + static_cast<size_t>(oc * inChannel + ic)] =
+                            tmp[i][0] * G[j * 3 + 0] + tmp[i][1] * G[j * 3 + 1] + tmp[i][2] * G[j * 3 + 2];
+                }
+            }
+        }
+    }
+
+    const size_t packedSize = Gemm::getPackedASize(outChannel, inChannel);
+
+    for (int xi = 0; xi < alpha * alpha; ++xi)
+    {
+        Gemm::cpuGemmPackA(outChannel, inChannel, 1.f, trans.data() + xi * blockSize, inChannel, transWeights + xi * packedSize);
+    }
+}
+
+void Winograd::conv3x3s1(const int &outTile, float * const &input, const int &inChannel, const int &height, const int &width,
+                         const int &paddingX, const int &paddingY, float * const &transWeights, const int &outChannel,
+                         const int &outHeight, const int &outWidth, float * const &workspace, float * const &output)
+{
+    const int alpha         = outTile + 2;
+    const int tilesW        = (outWidth + outTile - 1) / outTile;
+    const int tiles         = ((outHeight + outTile - 1) / outTile) * tilesW;
+    const int block         = winogradTileBlock(outTile, inChannel, outChannel, tiles);
+    const size_t packedSize = Gemm::getPackedASize(outChannel, inChannel);
+
+    float *transInput       = workspace;
+    float *transOutput      = workspace + static_cast<size_t>(alpha * alpha) * inChannel * block;
+
+    for (int tileBegin = 0; tileBegin < tiles; tileBegin += block)
+    {
+        const int tileEnd   = (tileBegin + block) < tiles ? (tileBegin + block) : tiles;
+        const int nTiles    = tileEnd - tileBegin;
+
+        if(outTile == 2)
+        {
+            winogradInputTransform<2>(input, inChannel, height, width, paddingX, paddingY, tilesW, tileBegin, tileEnd, transInput);
+        }
+        else
+        {
+            winogradInputTransform<4>(input, inChannel, height, width, paddingX, paddingY, tilesW, tileBegin, tileEnd, transInput);
+        }
+
+        Blas::cpuFill(alpha * alpha * outChannel * nTiles, 0, transOutput, 1);
+
+        for (int xi = 0; xi < alpha * alpha; ++xi)
+        {
+            Gemm::cpuGemmPrePacked(outChannel, nTiles, inChannel, transWeights + xi * packedSize,
+                                   transInput + static_cast<size_t>(xi) * inChannel * nTiles, nTiles,
+                                   transOutput + static_cast<size_t>(xi) * outChannel * nTiles, nTiles);
+        }
+
+        if(outTile == 2)
+        {
+            winogradOutputTransform<2>(transOutput, outChannel, tilesW, tileBegin, tileEnd, outHeight, outWidth, output);
+        }
+        else
+        {
+            winogradOutputTransform<4>(transOutput, outChannel, tilesW, tileBegin, tileEnd, outHeight, outWidth, output);
+        }
+    }
+}
+}
@@ -0,0 +1,135 @@
+﻿#include "Msnhnet/io/MsnhMappedFile.h"
+#include "Msnhnet/utils/MsnhException.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace Msnhnet
+{
+MappedFile::MappedFile()
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::open(const std::string &path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        throw Exception(0,std::string(path) + " open filed!", __FILE__, __LINE__);
+    }
+
+    LARGE_INTEGER fsize;
+    if(!GetFileSizeEx(hFile, &fsize) || fsize.QuadPart < 1)
+    {
+        CloseHandle(hFile);
+        throw Exception(0,std::string(path) + " read filed!", __FILE__, __LINE__);
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(hMapping == nullptr)
+    {
+        CloseHandle(hFile);
+        throw Exception(0,std::string(path) + " map filed!", __FILE__, __LINE__);
+    }
+
+    void *view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if(view == nullptr)
+    {
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        throw Exception(0,std::string(path) + " map filed!", __FILE__, __LINE__);
+    }
+
+    this->file      =   hFile;
+    this->mapping   =   hMapping;
+    this->data      =   static_cast<const char*>(view);
+    this->size      =   static_cast<size_t>(fsize.QuadPart);
+#else
+    int handle = ::open(path.c_str(), O_RDONLY);
+    if(handle < 0)
+    {
+        throw Exception(0,std::string(path) + " open filed!", __FILE__, __LINE__);
+    }
+
+    struct stat st;
+    if(fstat(handle, &st) != 0 || st.st_size < 1)
+    {
+        ::close(handle);
+        throw Exception(0,std::string(path) + " read filed!", __FILE__, __LINE__);
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, handle, 0);
+    if(view == MAP_FAILED)
+    {
+        ::close(handle);
+        throw Exception(0,std::string(path) + " map filed!", __FILE__, __LINE__);
+    }
+
+    this->fd        =   handle;
+    this->data      =   static_cast<const char*>(view);
+    this->size      =   static_cast<size_t>(st.st_size);
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if(this->data != nullptr)
+    {
+        UnmapViewOfFile(this->data);
+    }
+    if(this->mapping != nullptr)
+    {
+        CloseHandle(this->mapping);
+    }
+    if(this->file != nullptr)
+    {
+        CloseHandle(this->file);
+    }
+    this->mapping   =   nullptr;
+    this->file      =   nullptr;
+#else
+    if(this->data != nullptr)
+    {
+        munmap(const_cast<char*>(this->data), this->size);
+    }
+    if(this->fd >= 0)
+    {
+        ::close(this->fd);
+    }
+    this->fd        =   -1;
+#endif
+    this->data      =   nullptr;
+    this->size      =   0;
+}
+
+bool MappedFile::isOpen() const
+{
+    return this->data != nullptr;
+}
+
+const char *MappedFile::getData() const
+{
+    return this->data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return this->size;
+}
+}
@@ -0,0 +1,281 @@
+﻿#include "Msnhnet/io/MsnhModelFile.h"
+#include "Msnhnet/utils/MsnhException.h"
+#include <fstream>
+#include <string.h>
+
+namespace Msnhnet
+{
+static void putU32(std::vector<char> &buf, const uint32_t &val)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        buf.push_back(static_cast<char>((val >> (8 * i)) & 0xff));
+    }
+}
+
+static void putU64(std::vector<char> &buf, const uint64_t &val)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        buf.push_back(static_cast<char>((val >> (8 * i)) & 0xff));
+    }
+}
+
+static uint64_t getU(const char *const &p, const int &bytes)
+{
+    uint64_t val = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+        val |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+    }
+    return val;
+}
+
+static uint64_t alignUp(const uint64_t &val, const uint64_t &align)
+{
+    return (val + align - 1) / align * align;
+}
+
+static size_t getElementSize(const ModelTensorType &type)
+{
+    return (type == TENSOR_F32 || type == TENSOR_INT32) ? 4 : ((type == TENSOR_INT8) ? 1 : 2);
+}
+
+size_t ModelTensor::getElements() const
+{
+    size_t n = 1;
+    for (size_t i = 0; i < shape.size(); ++i)
+    {
+        n *= static_cast<size_t>(shape[i]);
+    }
+    return n;
+}
+
+uint64_t ModelFile::hash(const char * const &data, const size_t &size, const uint64_t &seed)
+{
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void ModelFile::write(const std::string &path, const std::vector<char> &graph, std::vector<ModelTensor> &tensors, const char * const &magic)
+{
+    uint64_t dataSize = 0;
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        dataSize            = alignUp(dataSize, static_cast<uint64_t>(tensors[i].alignment));
+        tensors[i].offset   = dataSize;
+        dataSize            = dataSize + tensors[i].bytes;
+    }
+
+    std::vector<char> table;
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        const ModelTensor &t = tensors[i];
+        putU32(table, static_cast<uint32_t>(t.name.size()));
+        table.insert(table.end(), t.name.begin(), t.name.end());
+        putU32(table, static_cast<uint32_t>(t.group));
+        putU32(table, static_cast<uint32_t>(t.type));
+        putU32(table, static_cast<uint32_t>(t.layout));
+        putU32(table, static_cast<uint32_t>(t.alignment));
+        putU32(table, static_cast<uint32_t>(t.shape.size()));
+        for (size_t j = 0; j < t.shape.size(); ++j)
+        {
+            putU32(table, static_cast<uint32_t>(t.shape[j]));
+        }
+        putU64(table, t.offset);
+        putU64(table, t.bytes);
+    }
+
+    const uint64_t graphOffset  = MSNH_MODEL_HEADER_SIZE;
+    const uint64_t tableOffset  = graphOffset + graph.size();
+    const uint64_t dataOffset   = alignUp(tableOffset + table.size(), MSNH_MODEL_DATA_ALIGN);
+
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if(!file.is_open())
+    {
+        throw Exception(1, path + " open filed!",__FILE__, __LINE__);
+    }
+
+    uint64_t contentHash = MSNH_MODEL_HASH_SEED;
+    const std::vector<char> zeros(MSNH_MODEL_DATA_ALIGN, 0);
+
+    auto emit = [&](const char *data, const size_t &size)
+    {
+        file.write(data, static_cast<std::streamsize>(size));
+        contentHash = hash(data, size, contentHash);
+    };
+
+    file.write(zeros.data(), MSNH_MODEL_HEADER_SIZE);
+    emit(graph.data(), graph.size());
+    emit(table.data(), table.size());
+    emit(zeros.data(), static_cast<size_t>(dataOffset - tableOffset - table.size()));
+
+    uint64_t pos = 0;
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        emit(zeros.data(), static_cast<size_t>(tensors[i].offset - pos));
+        emit(static_cast<const char*>(tensors[i].data), static_cast<size_t>(tensors[i].bytes));
+        pos = tensors[i].offset + tensors[i].bytes;
+    }
+
+    std::vector<char> header(magic, magic + 8);
+    putU32(header, MSNH_MODEL_VERSION);
+    putU32(header, MSNH_MODEL_HEADER_SIZE);
+    putU64(header, graphOffset);
+    putU64(header, graph.size());
+    putU64(header, tableOffset);
+    putU32(header, static_cast<uint32_t>(tensors.size()));
+    putU32(header, MSNH_MODEL_DATA_ALIGN);
+    putU64(header, dataOffset);
+    putU64(header, contentHash);
+
+    file.seekp(0);
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    if(!file.good())
+    {
+        throw Exception(1, path + " write filed!",__FILE__, __LINE__);
+    }
+}
+
+void ModelFile::read(const char * const &data, const size_t &size, const bool &verifyHash, const char *&graph, size_t &graphSize,
+                     std::vector<ModelTensor> &tensors, uint64_t &contentHash, const char * const &magic)
+{
+    if(size < MSNH_MODEL_HEADER_SIZE || memcmp(data, magic, 8) != 0)
+    {
+        throw Exception(1, (memcmp(magic, MSNH_PLAN_MAGIC, 8) == 0) ? "Not a msnhplan file !" : "Not a msnhmodel file !",__FILE__, __LINE__);
+    }
+
+    const uint32_t version      = static_cast<uint32_t>(getU(data + 8, 4));
+    const uint32_t headerSize   = static_cast<uint32_t>(getU(data + 12, 4));
+    const uint64_t graphOffset  = getU(data + 16, 8);
+    graphSize                   = static_cast<size_t>(getU(data + 24, 8));
+    const uint64_t tableOffset  = getU(data + 32, 8);
+    const uint32_t tensorCount  = static_cast<uint32_t>(getU(data + 40, 4));
+    const uint64_t dataOffset   = getU(data + 48, 8);
+    contentHash                 = getU(data + 56, 8);
+
+    if(version > MSNH_MODEL_VERSION)
+    {
+        throw Exception(1, "msnhmodel version " + std::to_string(version) + " is newer than this library (" +
+                        std::to_string(MSNH_MODEL_VERSION) + ") !",__FILE__, __LINE__);
+    }
+
+    if(headerSize != MSNH_MODEL_HEADER_SIZE || graphOffset < headerSize || graphOffset + graphSize > tableOffset ||
+            tableOffset > dataOffset || dataOffset > size || dataOffset % MSNH_MODEL_DATA_ALIGN != 0)
+    {
+        throw Exception(1, "msnhmodel header error !",__FILE__, __LINE__);
+    }
+
+    if(verifyHash && hash(data + headerSize, size - headerSize, MSNH_MODEL_HASH_SEED) != contentHash)
+    {
+        throw Exception(1, "msnhmodel content hash mismatch, the file is damaged !",__FILE__, __LINE__);
+    }
+
+    graph = data + graphOffset;
+
+    tensors.clear();
+    tensors.resize(tensorCount);
+
+    const char *p   = data + tableOffset;
+    const char *end = data + dataOffset;
+    auto need = [&](const uint64_t &bytes)
+    {
+        if(static_cast<uint64_t>(end - p) < bytes)
+        {
+            throw Exception(1, "msnhmodel tensor table error !",__FILE__, __LINE__);
+        }
+    };
+
+    for (uint32_t i = 0; i < tensorCount; ++i)
+    {
+        ModelTensor &t = tensors[i];
+
+        need(4);
+        const uint32_t nameLen = static_cast<uint32_t>(getU(p, 4));
+        p += 4;
+        need(nameLen + 20);
+        t.name.assign(p, nameLen);
+        p += nameLen;
+
+        t.group     = static_cast<int>(static_cast<int32_t>(getU(p, 4)));
+        t.type      = static_cast<ModelTensorType>(getU(p + 4, 4));
+        t.layout    = static_cast<ModelTensorLayout>(getU(p + 8, 4));
+        t.alignment = static_cast<int>(getU(p + 12, 4));
+        const uint32_t dims = static_cast<uint32_t>(getU(p + 16, 4));
+        p += 20;
+
+        need(static_cast<uint64_t>(dims) * 4 + 16);
+        t.shape.resize(dims);
+        for (uint32_t j = 0; j < dims; ++j)
+        {
+            t.shape[j] = static_cast<int>(static_cast<int32_t>(getU(p + 4 * j, 4)));
+        }
+        p += dims * 4;
+
+        t.offset    = getU(p, 8);
+        t.bytes     = getU(p + 8, 8);
+        p += 16;
+
+        if(t.type > TENSOR_INT32 || t.layout > TENSOR_QUANT_STREAM || t.alignment < 1 ||
+                t.offset + t.bytes > size - dataOffset || (dataOffset + t.offset) % static_cast<uint64_t>(t.alignment) != 0 ||
+                (t.layout == TENSOR_PLAIN && t.bytes != t.getElements() * getElementSize(t.type)))
+        {
+            throw Exception(1, "msnhmodel tensor " + t.name + " error !",__FILE__, __LINE__);
+        }
+
+        t.data = data + dataOffset + t.offset;
+    }
+}
+
+uint64_t ModelFile::readContentHash(const std::string &path)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    char header[MSNH_MODEL_HEADER_SIZE] = {0};
+    file.read(header, MSNH_MODEL_HEADER_SIZE);
+
+    if(!file.good() || memcmp(header, MSNH_MODEL_MAGIC, 8) != 0)
+    {
+        throw Exception(1, "Not a msnhmodel file !",__FILE__, __LINE__);
+    }
+    return getU(header + 56, 8);
+}
+
+bool ModelFile::isModelFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    char magic[8] = {0};
+    file.read(magic, 8);
+    return file.good() && memcmp(magic, MSNH_MODEL_MAGIC, 8) == 0;
+}
+
+ModelTensor ModelFile::makeTensor(const std::string &name, const int &group, const ModelTensorType &type, const void * const &data, const size_t &elements)
+{
+    ModelTensor tensor;
+    tensor.name         = name;
+    tensor.group        = group;
+    tensor.type         = type;
+    tensor.alignment    = MSNH_MODEL_TENSOR_ALIGN;
+    tensor.shape        = {static_cast<int>(elements)};
+    tensor.data         = data;
+    tensor.bytes        = elements * getElementSize(type);
+    return tensor;
+}
+
+const ModelTensor *ModelFile::findTensor(const std::vector<ModelTensor> &tensors, const std::string &name)
+{
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        if(tensors[i].name == name)
+        {
+            return &tensors[i];
+        }
+    }
+    return nullptr;
+}
+}
@@ -1,4 +1,5 @@
 ﻿#include "Msnhnet/io/MsnhParser.h"
+#include <string.h>
 namespace Msnhnet
 {
 int BaseParams::index  = -1;
@@ -11,6 +12,7 @@ Parser::Parser()
 Parser::~Parser()
 {
     clearParams();
+    clearMsnhBin();
 }
 
 void Parser::clearParams()
@@ -509,46 +511,503 @@ void Parser::readCfg(const std::string &path)
 
 void Parser::readMsnhBin(const std::string &path)
 {
-    std::ifstream readFile;
-    readFile.open(path,std::ios::in|std::ios::binary);
+    clearMsnhBin();
+    msnhBinFile.open(path);
 
-   if(!readFile.is_open())
+   const char *data    = msnhBinFile.getData();
+    const size_t fsize  = msnhBinFile.getSize();
+    size_t offset       = 0;
+    msnhWeightStorage   = WEIGHT_F32;
+
+   if(fsize >= 8 && data[0] == 'M' && data[1] == 'S' && data[2] == 'W' && data[3] == 'B')
     {
-        throw Exception(0,std::string(path) + " open filed!", __FILE__, __LINE__);
+        uint32_t storage = static_cast<uint8_t>(data[4]) | (static_cast<uint8_t>(data[5]) << 8) |
+                           (static_cast<uint8_t>(data[6]) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(data[7])) << 24);
+
+       if(storage > WEIGHT_BF16)
+        {
+            clearMsnhBin();
+            throw Exception(0,std::string(path) + " unknown weight storage : " + std::to_string(storage), __FILE__, __LINE__);
+        }
+
+       msnhWeightStorage   = static_cast<WeightStorage>(storage);
+        offset              = 8;
     }
 
-   readFile.seekg(0, std::ios::end);
-    auto fsize = readFile.tellg();
-    readFile.seekg(0, std::ios::beg);
+   const size_t elemSize = (msnhWeightStorage == WEIGHT_F32) ? 4 : 2;
+    const size_t dataSize = fsize - offset;
 
-   if (fsize < 1)
+   if (dataSize % elemSize != 0)
     {
-        throw Exception(0,std::string(path) + " read filed!", __FILE__, __LINE__);
+        clearMsnhBin();
+        throw Exception(0,std::string(path) + " file error!", __FILE__, __LINE__);
     }
 
-   if (fsize % 4 != 0)
+   msnhF32Num = dataSize / elemSize;
+
+   const uint16_t endian = 1;
+    const bool littleEndian = (*reinterpret_cast<const uint8_t*>(&endian) == 1);
+
+   /* the mapping is page aligned and the float32 layout has no header, use the file as is */
+    if(msnhWeightStorage == WEIGHT_F32 && littleEndian)
     {
-        throw Exception(0,std::string(path) + " file error!", __FILE__, __LINE__);
+        msnhF32Data     = reinterpret_cast<const float*>(data + offset);
+        msnhF32Mapped   = true;
+        return;
+    }
+
+   msnhF32Weights.resize(msnhF32Num);
+
+   if(msnhWeightStorage == WEIGHT_F32)
+    {
+        Float32 float32;
+        for (size_t i = 0; i < msnhF32Num; ++i)
+        {
+            const char *p    = data + offset + i * 4;
+            float32.bytes[0] = static_cast<uint8_t>(p[0]);
+            float32.bytes[1] = static_cast<uint8_t>(p[1]);
+            float32.bytes[2] = static_cast<uint8_t>(p[2]);
+            float32.bytes[3] = static_cast<uint8_t>(p[3]);
+            msnhF32Weights[i] = float32.val;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < msnhF32Num; ++i)
+        {
+            const char *p    = data + offset + i * 2;
+            const uint16_t h = static_cast<uint16_t>(static_cast<uint8_t>(p[0]) | (static_cast<uint8_t>(p[1]) << 8));
+            msnhF32Weights[i] = Half::toFloat(h, msnhWeightStorage);
+        }
+    }
+
+   /* the widened copy is all that is needed */
+    msnhBinFile.close();
+    msnhF32Data = msnhF32Weights.data();
+}
+
+void Parser::clearMsnhBin()
+{
+    msnhBinFile.close();
+    std::vector<float>().swap(msnhF32Weights);
+    std::vector<ModelTensor>().swap(msnhModelTensors);
+    msnhModelHash   = 0;
+    msnhF32Data     = nullptr;
+    msnhF32Num      = 0;
+    msnhF32Mapped   = false;
+}
+
+void Parser::convertMsnhBin(const std::string &srcPath, const std::string &dstPath, const WeightStorage &storage)
+{
+    Parser parser;
+    parser.readMsnhBin(srcPath);
+
+   /* dstPath may be srcPath, don't truncate a file that is still mapped */
+    if(parser.msnhF32Mapped)
+    {
+        parser.msnhF32Weights.assign(parser.msnhF32Data, parser.msnhF32Data + parser.msnhF32Num);
+        parser.msnhBinFile.close();
+        parser.msnhF32Data      = parser.msnhF32Weights.data();
+        parser.msnhF32Mapped    = false;
+    }
+
+   std::ofstream writeFile(dstPath, std::ios::out|std::ios::binary);
+    if(!writeFile.is_open())
+    {
+        throw Exception(0,std::string(dstPath) + " open filed!", __FILE__, __LINE__);
+    }
+
+   if(storage == WEIGHT_F32)
+    {
+        /* float32 is written in the legacy raw layout */
+        writeFile.write(reinterpret_cast<const char*>(parser.msnhF32Data), parser.msnhF32Num * sizeof(float));
+        return;
+    }
+
+   const uint32_t type = static_cast<uint32_t>(storage);
+    const char header[8] = {'M', 'S', 'W', 'B', static_cast<char>(type & 0xff), static_cast<char>((type >> 8) & 0xff),
+                            static_cast<char>((type >> 16) & 0xff), static_cast<char>((type >> 24) & 0xff)};
+    writeFile.write(header, 8);
+
+   std::vector<uint16_t> half(parser.msnhF32Num);
+    Half::fromFloat(parser.msnhF32Data, half.size(), storage, half.data());
+
+   std::vector<char> bytes(half.size() * 2);
+    for (size_t i = 0; i < half.size(); ++i)
+    {
+        bytes[i * 2 + 0] = static_cast<char>(half[i] & 0xff);
+        bytes[i * 2 + 1] = static_cast<char>(half[i] >> 8);
+    }
+    writeFile.write(bytes.data(), bytes.size());
+
+   if(!writeFile.good())
+    {
+        throw Exception(0,std::string(dstPath) + " write filed!", __FILE__, __LINE__);
+    }
+}
+
+/* graph section of a msnhmodel. Each params class lists its fields once, the same list writes and reads them */
+class ParamsWriter
+{
+public:
+    explicit ParamsWriter(std::vector<char> &buf) : buf(buf) {}
+
+    void operator()(const int &val)
+    {
+        const uint32_t u = static_cast<uint32_t>(val);
+        for (int i = 0; i < 4; ++i)
+        {
+            buf.push_back(static_cast<char>((u >> (8 * i)) & 0xff));
+        }
+    }
+
+    void operator()(const float &val)
+    {
+        uint32_t u = 0;
+        memcpy(&u, &val, sizeof(u));
+        (*this)(static_cast<int>(u));
+    }
+
+    void operator()(const ActivationType &val)
+    {
+        (*this)(static_cast<int>(val));
+    }
+
+    template<typename T>
+    void operator()(const std::vector<T> &vals)
+    {
+        (*this)(static_cast<int>(vals.size()));
+        for (size_t i = 0; i < vals.size(); ++i)
+        {
+            (*this)(vals[i]);
+        }
+    }
+
+    std::vector<char> &buf;
+};
+
+class ParamsReader
+{
+public:
+    ParamsReader(const char *const &data, const size_t &size) : p(data), end(data + size) {}
+
+    void operator()(int &val)
+    {
+        if(end - p < 4)
+        {
+            throw Exception(1, "msnhmodel graph is truncated !", __FILE__, __LINE__);
+        }
+        uint32_t u = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            u |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+        }
+        p  += 4;
+        val = static_cast<int>(u);
+    }
+
+    void operator()(float &val)
+    {
+        int u = 0;
+        (*this)(u);
+        memcpy(&val, &u, sizeof(val));
+    }
+
+    void operator()(ActivationType &val)
+    {
+        int u = 0;
+        (*this)(u);
+        val = static_cast<ActivationType>(u);
+    }
+
+    template<typename T>
+    void operator()(std::vector<T> &vals)
+    {
+        int n = 0;
+        (*this)(n);
+        if(n < 0 || n > (end - p) / 4)
+        {
+            throw Exception(1, "msnhmodel graph is truncated !", __FILE__, __LINE__);
+        }
+        vals.resize(static_cast<size_t>(n));
+        for (size_t i = 0; i < vals.size(); ++i)
+        {
+            (*this)(vals[i]);
+        }
+    }
+
+    const char *p;
+    const char *end;
+};
+
+template<typename IO, typename P>
+static void kernelFields(IO &io, P *params)
+{
+    io(params->kSize); io(params->kSizeX); io(params->kSizeY);
+    io(params->stride); io(params->strideX); io(params->strideY);
+    io(params->padding); io(params->paddingX); io(params->paddingY);
+}
+
+template<typename IO> static void paramsFields(IO &io, NetConfigParams *p)
+{
+    io(p->batch); io(p->width); io(p->height); io(p->channels);
+}
+
+template<typename IO> static void paramsFields(IO &io, ConvParams *p)
+{
+    io(p->batchNorm); io(p->filters); io(p->groups);
+    kernelFields(io, p);
+    io(p->antialiasing); io(p->dilation); io(p->dilationX); io(p->dilationY);
+    io(p->useBias); io(p->implicitGemm); io(p->binary); io(p->xnor);
+    io(p->activation); io(p->actParams);
+}
+
+template<typename IO> static void paramsFields(IO &io, MaxPoolParams *p)
+{
+    kernelFields(io, p);
+    io(p->maxPoolDepth); io(p->outChannels); io(p->ceilMode);
+}
+
+template<typename IO> static void paramsFields(IO &io, LocalAvgPoolParams *p)
+{
+    kernelFields(io, p);
+    io(p->ceilMode);
+}
+
+template<typename IO> static void paramsFields(IO &io, ConnectParams *p)
+{
+    io(p->output); io(p->batchNorm); io(p->activation); io(p->actParams);
+}
+
+template<typename IO> static void paramsFields(IO &io, PaddingParams *p)
+{
+    io(p->top); io(p->down); io(p->left); io(p->right); io(p->paddingVal);
+}
+
+template<typename IO> static void paramsFields(IO &io, RouteParams *p)
+{
+    io(p->layerIndexes); io(p->groups); io(p->groupsId);
+}
+
+template<typename IO> static void paramsFields(IO &io, UpSampleParams *p)
+{
+    io(p->stride); io(p->scale);
+}
+
+template<typename IO> static void paramsFields(IO &io, Yolov3Params *p)
+{
+    io(p->orgWidth); io(p->orgHeight); io(p->classNum); io(p->anchors);
+}
+
+template<typename IO> static void paramsFields(IO &io, Yolov3OutParams *p)
+{
+    io(p->orgWidth); io(p->orgHeight); io(p->confThresh); io(p->nmsThresh); io(p->useSoftNms); io(p->layerIndexes);
+}
+
+/* batch norm and the blocks only carry an activation of their own */
+template<typename IO, typename P> static void activationFields(IO &io, P *p)
+{
+    io(p->activation); io(p->actParams);
+}
+
+static void writeParamsList(ParamsWriter &w, const std::vector<BaseParams*> &list);
+static void readParamsList(ParamsReader &r, std::vector<BaseParams*> &list, const bool &incIndex);
+
+static void writeParams(ParamsWriter &w, BaseParams *const &params)
+{
+    w(static_cast<int>(params->type));
+
+   switch (params->type)
+    {
+    case LayerType::CONFIG:         paramsFields(w, reinterpret_cast<NetConfigParams*>(params)); break;
+    case LayerType::EMPTY:          break;
+    case LayerType::CONVOLUTIONAL:  paramsFields(w, reinterpret_cast<ConvParams*>(params)); break;
+    case LayerType::MAXPOOL:        paramsFields(w, reinterpret_cast<MaxPoolParams*>(params)); break;
+    case LayerType::LOCAL_AVGPOOL:  paramsFields(w, reinterpret_cast<LocalAvgPoolParams*>(params)); break;
+    case LayerType::CONNECTED:      paramsFields(w, reinterpret_cast<ConnectParams*>(params)); break;
+    case LayerType::BATCHNORM:      activationFields(w, reinterpret_cast<BatchNormParams*>(params)); break;
+    case LayerType::PADDING:        paramsFields(w, reinterpret_cast<PaddingParams*>(params)); break;
+    case LayerType::ROUTE:          paramsFields(w, reinterpret_cast<RouteParams*>(params)); break;
+    case LayerType::UPSAMPLE:       paramsFields(w, reinterpret_cast<UpSampleParams*>(params)); break;
+    case LayerType::YOLOV3:         paramsFields(w, reinterpret_cast<Yolov3Params*>(params)); break;
+    case LayerType::YOLOV3_OUT:     paramsFields(w, reinterpret_cast<Yolov3OutParams*>(params)); break;
+    case LayerType::RES_BLOCK:
+    {
+        ResBlockParams *p = reinterpret_cast<ResBlockParams*>(params);
+        activationFields(w, p);
+        writeParamsList(w, p->baseParams);
+        break;
+    }
+    case LayerType::RES_2_BLOCK:
+    {
+        Res2BlockParams *p = reinterpret_cast<Res2BlockParams*>(params);
+        activationFields(w, p);
+        writeParamsList(w, p->baseParams);
+        writeParamsList(w, p->branchParams);
+        break;
     }
+    case LayerType::ADD_BLOCK:
+    case LayerType::CONCAT_BLOCK:
+    {
+        std::vector<std::vector<BaseParams*>> &branches = (params->type == LayerType::ADD_BLOCK) ?
+                    reinterpret_cast<AddBlockParams*>(params)->branchParams : reinterpret_cast<ConcatBlockParams*>(params)->branchParams;
+        if(params->type == LayerType::ADD_BLOCK)
+        {
+            activationFields(w, reinterpret_cast<AddBlockParams*>(params));
+        }
+        else
+        {
+            activationFields(w, reinterpret_cast<ConcatBlockParams*>(params));
+        }
+        w(static_cast<int>(branches.size()));
+        for (size_t i = 0; i < branches.size(); ++i)
+        {
+            writeParamsList(w, branches[i]);
+        }
+        break;
+    }
+    default:
+        throw Exception(1, "Layer type " + std::to_string(static_cast<int>(params->type)) + " can not be serialized !", __FILE__, __LINE__);
+    }
+}
 
-   char *data = new char[static_cast<size_t>(fsize)]();
-    readFile.read(data, fsize);
+static void writeParamsList(ParamsWriter &w, const std::vector<BaseParams*> &list)
+{
+    w(static_cast<int>(list.size()));
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        writeParams(w, list[i]);
+    }
+}
 
-   Float32 float32;
+template<typename P>
+static P *readFields(ParamsReader &r, const bool &incIndex)
+{
+    P *p = new P(incIndex);
+    paramsFields(r, p);
+    return p;
+}
 
-   msnhF32Weights.clear();
+static BaseParams *readParams(ParamsReader &r, const bool &incIndex)
+{
+    int type = 0;
+    r(type);
 
-   for (int i = 0;  i < fsize; i+=4)
+   switch (static_cast<LayerType>(type))
     {
-        float32.bytes[0] = static_cast<uint8_t>(data[i + 0]);
-        float32.bytes[1] = static_cast<uint8_t>(data[i + 1]);
-        float32.bytes[2] = static_cast<uint8_t>(data[i + 2]);
-        float32.bytes[3] = static_cast<uint8_t>(data[i + 3]);
-        msnhF32Weights.push_back(float32.val);
+    case LayerType::CONFIG:         return readFields<NetConfigParams>(r, false);
+    case LayerType::EMPTY:          return new EmptyParams(incIndex);
+    case LayerType::CONVOLUTIONAL:  return readFields<ConvParams>(r, incIndex);
+    case LayerType::MAXPOOL:        return readFields<MaxPoolParams>(r, incIndex);
+    case LayerType::LOCAL_AVGPOOL:  return readFields<LocalAvgPoolParams>(r, incIndex);
+    case LayerType::CONNECTED:      return readFields<ConnectParams>(r, incIndex);
+    case LayerType::PADDING:        return readFields<PaddingParams>(r, incIndex);
+    case LayerType::ROUTE:          return readFields<RouteParams>(r, incIndex);
+    case LayerType::UPSAMPLE:       return readFields<UpSampleParams>(r, incIndex);
+    case LayerType::YOLOV3:         return readFields<Yolov3Params>(r, incIndex);
+    case LayerType::YOLOV3_OUT:     return readFields<Yolov3OutParams>(r, incIndex);
+    case LayerType::BATCHNORM:
+    {
+        BatchNormParams *p = new BatchNormParams(incIndex);
+        activationFields(r, p);
+        return p;
+    }
+    case LayerType::RES_BLOCK:
+    {
+        ResBlockParams *p = new ResBlockParams(incIndex);
+        activationFields(r, p);
+        readParamsList(r, p->baseParams, false);
+        return p;
     }
+    case LayerType::RES_2_BLOCK:
+    {
+        Res2BlockParams *p = new Res2BlockParams(incIndex);
+        activationFields(r, p);
+        readParamsList(r, p->baseParams, false);
+        readParamsList(r, p->branchParams, false);
+        return p;
+    }
+    case LayerType::ADD_BLOCK:
+    case LayerType::CONCAT_BLOCK:
+    {
+        BaseParams *params = nullptr;
+        std::vector<std::vector<BaseParams*>> *branches = nullptr;
+        if(static_cast<LayerType>(type) == LayerType::ADD_BLOCK)
+        {
+            AddBlockParams *p = new AddBlockParams(incIndex);
+            activationFields(r, p);
+            params   = p;
+            branches = &p->branchParams;
+        }
+        else
+        {
+            ConcatBlockParams *p = new ConcatBlockParams(incIndex);
+            activationFields(r, p);
+            params   = p;
+            branches = &p->branchParams;
+        }
 
-   delete[] data;
-    data = nullptr;
+       int n = 0;
+        r(n);
+        if(n < 0 || n > (r.end - r.p) / 4)
+        {
+            throw Exception(1, "msnhmodel graph is truncated !", __FILE__, __LINE__);
+        }
+        branches->resize(static_cast<size_t>(n));
+        for (size_t i = 0; i < branches->size(); ++i)
+        {
+            readParamsList(r, (*branches)[i], false);
+        }
+        return params;
+    }
+    default:
+        throw Exception(1, "msnhmodel graph has an unknown layer type " + std::to_string(type), __FILE__, __LINE__);
+    }
+}
+
+static void readParamsList(ParamsReader &r, std::vector<BaseParams*> &list, const bool &incIndex)
+{
+    int n = 0;
+    r(n);
+    if(n < 0 || n > (r.end - r.p) / 4)
+    {
+        throw Exception(1, "msnhmodel graph is truncated !", __FILE__, __LINE__);
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        list.push_back(readParams(r, incIndex));
+    }
+}
+
+void Parser::serializeParams(std::vector<char> &graph) const
+{
+    graph.clear();
+    ParamsWriter w(graph);
+    writeParamsList(w, params);
+}
+
+void Parser::deserializeParams(const char * const &graph, const size_t &size)
+{
+    clearParams();
+    ParamsReader r(graph, size);
+    readParamsList(r, params, true);
+
+   if(params.empty() || params[0]->type != LayerType::CONFIG)
+    {
+        throw Exception(1,"first node must be [config]", __FILE__, __LINE__);
+    }
+}
+
+void Parser::readMsnhModel(const std::string &path, const bool &verifyHash, const char * const &magic)
+{
+    clearMsnhBin();
+    msnhBinFile.open(path);
+
+   const char *graph    = nullptr;
+    size_t graphSize    = 0;
+    ModelFile::read(msnhBinFile.getData(), msnhBinFile.getSize(), verifyHash, graph, graphSize, msnhModelTensors, msnhModelHash, magic);
+    deserializeParams(graph, graphSize);
+    msnhF32Mapped       = true;
 }
 
 void Parser::parseConfigParams(NetConfigParams *netConfigParams, YAML::const_iterator &iter)
@@ -952,6 +1411,27 @@ void Parser::parseConvParams(ConvParams *convParams, YAML::const_iterator &iter)
                 throw Exception(1,"[conv] antialiasing can't convert to int", __FILE__, __LINE__);
             }
         }
+        else if(key == "implicitGemm")
+        {
+            if(!ExString::strToInt(value, convParams->implicitGemm))
+            {
+                throw Exception(1,"[conv] implicitGemm can't convert to int", __FILE__, __LINE__);
+            }
+        }
+        else if(key == "binary")
+        {
+            if(!ExString::strToInt(value, convParams->binary))
+            {
+                throw Exception(1,"[conv] binary can't convert to int", __FILE__, __LINE__);
+            }
+        }
+        else if(key == "xnor")
+        {
+            if(!ExString::strToInt(value, convParams->xnor))
+            {
+                throw Exception(1,"[conv] xnor can't convert to int", __FILE__, __LINE__);
+            }
+        }
         else if(key == "padding")
         {
             if(!ExString::strToInt(value, convParams->padding))
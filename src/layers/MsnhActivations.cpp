@@ -102,43 +102,43 @@ void Activations::activateArrayNormCh(float * const &x, const int &numX, const i
 {
     (void) batch;
     int size = numX/channels;
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int i = 0; i < size; ++i)
+    ThreadPool::parallelFor(0, size, ThreadPool::grainFor(2*channels), [&](const int &iBegin, const int &iEnd)
     {
-        int whIndex = i % whStep;
-        int b       = i / whStep;
-
-       const float eps = 0.0001f;
-        if(i<size)
+        for (int i = iBegin; i < iEnd; ++i)
         {
-            float sum = eps;
+            int whIndex = i % whStep;
+            int b       = i / whStep;
 
-           for (int k = 0; k < channels; ++k)
+           const float eps = 0.0001f;
+            if(i<size)
             {
-                float val = x[whIndex + k*whStep + b*whStep*channels];
-                if(val > 0)
-                {
-                    sum+=val;
-                }
-            }
+                float sum = eps;
 
-           for (int k = 0; k < channels; ++k)
-            {
-                float val = x[whIndex + k*whStep + b*whStep*channels];
-                if(val >0)
+               for (int k = 0; k < channels; ++k)
                 {
-                    val = val/sum;
+                    float val = x[whIndex + k*whStep + b*whStep*channels];
+                    if(val > 0)
+                    {
+                        sum+=val;
+                    }
                 }
-                else
+
+               for (int k = 0; k < channels; ++k)
                 {
-                    val = 0;
+                    float val = x[whIndex + k*whStep + b*whStep*channels];
+                    if(val >0)
+                    {
+                        val = val/sum;
+                    }
+                    else
+                    {
+                        val = 0;
+                    }
+                    output[whIndex + k*whStep + b*whStep*channels] = val;
                 }
-                output[whIndex + k*whStep + b*whStep*channels] = val;
             }
         }
-    }
+    });
 
 }
 
@@ -146,62 +146,68 @@ void Activations::activateArrayNormChSoftMax(float * const &x, const int &numX,
 {
     (void) batch;
     int size = numX/channels;
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int i = 0; i < size; ++i)
+    ThreadPool::parallelFor(0, size, ThreadPool::grainFor(16*channels), [&](const int &iBegin, const int &iEnd)
     {
-        int whIndex = i % whStep;
-        int b       = i / whStep;
-
-       const float eps = 0.0001f;
-        if(i<size)
+        for (int i = iBegin; i < iEnd; ++i)
         {
-            float sum    = eps;
-            float maxVal = -FLT_MAX;
+            int whIndex = i % whStep;
+            int b       = i / whStep;
 
-           if(useMaxVal)
+           const float eps = 0.0001f;
+            if(i<size)
             {
-                for (int k = 0; k < channels; ++k)
+                float sum    = eps;
+                float maxVal = -FLT_MAX;
+
+               if(useMaxVal)
                 {
-                    float val = x[whIndex + k*whStep + b*whStep*channels];
-                    if(val > maxVal)
+                    for (int k = 0; k < channels; ++k)
                     {
-                        maxVal = val;
+                        float val = x[whIndex + k*whStep + b*whStep*channels];
+                        if(val > maxVal)
+                        {
+                            maxVal = val;
+                        }
                     }
                 }
-            }
-            else
-            {
-                maxVal = 0;
-            }
+                else
+                {
+                    maxVal = 0;
+                }
 
-           for (int k = 0; k < channels; ++k)
-            {
-                float val = x[whIndex + k*whStep + b*whStep*channels];
-                sum += expf(val - maxVal);
-            }
+               for (int k = 0; k < channels; ++k)
+                {
+                    float val = x[whIndex + k*whStep + b*whStep*channels];
+                    sum += expf(val - maxVal);
+                }
 
-           for (int k = 0; k < channels; ++k)
-            {
-                float val = x[whIndex + k*whStep + b*whStep*channels];
-                val = expf(val - maxVal) / sum;
-                output[whIndex + k*whStep + b*whStep*channels] = val;
+               for (int k = 0; k < channels; ++k)
+                {
+                    float val = x[whIndex + k*whStep + b*whStep*channels];
+                    val = expf(val - maxVal) / sum;
+                    output[whIndex + k*whStep + b*whStep*channels] = val;
+                }
             }
         }
-    }
+    });
 }
 
 void Activations::activateArray(float *const &x, const int &numX, const ActivationType &actType, const float &param)
 {
+    const KernelTable &kernels = Kernels::get();
 
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for(int i=0; i<numX;++i)
+    ThreadPool::parallelFor(0, numX, ThreadPool::grainFor((actType == LEAKY || actType == RELU || actType == LINEAR) ? 1 : 16), [&](const int &iBegin, const int &iEnd)
     {
-        x[i] = activate(x[i],actType, param);
-    }
+        if(kernels.activate(x + iBegin, iEnd - iBegin, actType, param))
+        {
+            return;
+        }
+
+        for (int i = iBegin; i < iEnd; ++i)
+        {
+            x[i] = activate(x[i],actType, param);
+        }
+    });
 }
 
 }
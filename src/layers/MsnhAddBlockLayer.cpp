@@ -38,7 +38,7 @@ AddBlockLayer::AddBlockLayer(const int &batch, NetBuildParams &params, std::vect
                 layer                       =   new ConvolutionalLayer(branchBuildParams.batch, 1, branchBuildParams.height, branchBuildParams.width, branchBuildParams.channels,
                                                                        convParams->filters,convParams->groups,convParams->kSizeX, convParams->kSizeY,convParams->strideX, convParams->strideY,
                                                                        convParams->dilationX,convParams->dilationY,convParams->paddingX, convParams->paddingY, convParams->activation, convParams->actParams, convParams->batchNorm, convParams->useBias,
-                                                                       0,0,0,0,convParams->antialiasing, nullptr, 0,0);
+                                                                       convParams->binary,convParams->xnor,0,0,convParams->antialiasing, nullptr, 0,0, branchBuildParams.options, convParams->implicitGemm);
                 if(i == 0 && j == 0)
                 {
                     this->inputNum = layer->inputNum;
@@ -59,7 +59,7 @@ AddBlockLayer::AddBlockLayer(const int &batch, NetBuildParams &params, std::vect
             {
                 ConnectParams *connectParams=   reinterpret_cast<ConnectParams*>(branchParams[i][j]);
                 layer                       =   new ConnectedLayer(branchBuildParams.batch, 1, branchBuildParams.inputNums, connectParams->output, connectParams->activation, connectParams->actParams,
-                                                                   connectParams->batchNorm);
+                                                                   connectParams->batchNorm, branchBuildParams.options);
                 if(i == 0 && j == 0)
                 {
                     this->inputNum = layer->inputNum;
@@ -138,6 +138,7 @@ AddBlockLayer::AddBlockLayer(const int &batch, NetBuildParams &params, std::vect
             }
 
            this->numWeights    =   this->numWeights + layer->numWeights;
+            this->bFlops        =   this->bFlops + layer->bFlops;
             this->layerDetail   =   this->layerDetail.append(layer->layerDetail);
 
            tmpLayers.push_back(layer);
@@ -148,6 +149,19 @@ AddBlockLayer::AddBlockLayer(const int &batch, NetBuildParams &params, std::vect
 
    }
 
+   for (size_t i = 0; i < branchLayers.size(); ++i)
+    {
+        branchRefs.push_back(&branchLayers[i]);
+    }
+
+   /* every branch may run at the same time, each on its own workspace slice */
+    this->branchWorkSpace       =   (this->workSpaceSize + sizeof(float) - 1) / sizeof(float);
+    this->concurrentBranches    =   BaseLayer::useConcurrentBranches && branchRefs.size() > 1;
+    if(this->concurrentBranches)
+    {
+        this->workSpaceSize     =   this->branchWorkSpace * sizeof(float) * branchRefs.size();
+    }
+
    for (size_t i = 1; i < branchLayers.size(); ++i)
     {
         if(branchLayers[i][branchLayers[i].size()-1]->height     != branchLayers[i-1][branchLayers[i-1].size()-1]->height||
@@ -172,16 +186,14 @@ AddBlockLayer::AddBlockLayer(const int &batch, NetBuildParams &params, std::vect
    this->layerDetail.append("========================================================================\n");
 }
 
-void AddBlockLayer::loadAllWeigths(std::vector<float> &weights)
+void AddBlockLayer::loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped)
 {
-    if(weights.size() != this->numWeights)
+    if(len != this->numWeights)
     {
-        throw Exception(1,"AddBlockLayer weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(weights.size()), __FILE__, __LINE__);
+        throw Exception(1,"AddBlockLayer weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(len), __FILE__, __LINE__);
     }
 
    size_t ptr = 0;
-    std::vector<float>::const_iterator first = weights.begin();
-
    for (size_t i = 0; i < branchLayers.size(); ++i)
     {
         for (size_t j = 0; j < branchLayers[i].size(); ++j)
@@ -191,9 +203,7 @@ void AddBlockLayer::loadAllWeigths(std::vector<float> &weights)
             {
                 size_t nums = branchLayers[i][j]->numWeights;
 
-               std::vector<float> weights(first + static_cast<long long>(ptr), first + static_cast<long long>(ptr + nums));
-
-               branchLayers[i][j]->loadAllWeigths(weights);
+               branchLayers[i][j]->loadAllWeigths(weights + ptr, nums, mapped);
 
                ptr         =   ptr + nums;
             }
@@ -204,32 +214,17 @@ void AddBlockLayer::loadAllWeigths(std::vector<float> &weights)
 void AddBlockLayer::forward(NetworkState &netState)
 {
 
-   /* TODO: batch */
-    std::vector<float> inputX{netState.input, netState.input + netState.inputNum};
-
-   for (size_t i = 0; i < branchLayers.size(); ++i)
-    {
-        netState.input         =    inputX.data();
-        netState.inputNum      =    static_cast<int>(inputX.size());
-
-       for (size_t j = 0; j < branchLayers[i].size(); ++j)
-        {
-            branchLayers[i][j]->forward(netState);
-
-           netState.input     =   branchLayers[i][j]->output;
-            netState.inputNum  =   branchLayers[i][j]->outputNum;
-        }
-
-   }
+   /* the block input stays untouched until the block returns, every branch reads it in place */
+    forwardBranches(branchRefs.data(), branchRefs.size(), netState, this->concurrentBranches, this->branchWorkSpace);
 
    for (size_t i = 1; i < branchLayers.size(); ++i)
     {
 
-       Blas::cpuAxpy(netState.inputNum, 1.f, branchLayers[i-1][branchLayers[i-1].size()-1]->output,
+       Blas::cpuAxpy(this->outputNum*this->batch, 1.f, branchLayers[i-1][branchLayers[i-1].size()-1]->output,
                 1, branchLayers[i][branchLayers[i].size()-1]->output, 1);
 
    }
-    Blas::cpuCopy(netState.inputNum, branchLayers[branchLayers.size()-1][branchLayers[branchLayers.size()-1].size()-1]->output, 1, this->output, 1);
+    Blas::cpuCopy(this->outputNum*this->batch, branchLayers[branchLayers.size()-1][branchLayers[branchLayers.size()-1].size()-1]->output, 1, this->output, 1);
 
    if(this->activation == ActivationType::NORM_CHAN)
     {
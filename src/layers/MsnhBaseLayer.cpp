@@ -1,20 +1,27 @@
 ﻿#include "Msnhnet/layers/MsnhBaseLayer.h"
+#include <exception>
+#include <mutex>
 
 namespace Msnhnet
 {
 
 bool BaseLayer::supportAvx      = false;
 bool BaseLayer::supportFma      = false;
+bool BaseLayer::supportVnni     = false;
+bool BaseLayer::supportF16c     = false;
 bool BaseLayer::isPreviewMode   = false;
+bool BaseLayer::useConcurrentBranches   = true;
 
 void BaseLayer::initSimd()
 {
-#ifdef USE_X86
     SimdInfo info;
+#ifdef USE_X86
     info.checkSimd();
 
     supportAvx = info.getSupportAVX2();
     supportFma = info.getSupportFMA3();
+    supportVnni = info.getSupportAVX512VNNI();
+    supportF16c = info.getSupportF16C();
 
     std::cout<<"checking simd."<<std::endl;
 
@@ -22,7 +29,15 @@ void BaseLayer::initSimd()
     {
         std::cout<<"avx2 speed up"<<std::endl<<std::endl;
     }
+
+    if(supportVnni)
+    {
+        std::cout<<"avx512 vnni int8 speed up"<<std::endl<<std::endl;
+    }
 #endif
+
+   Kernels::init(info);
+    std::cout<<"kernels: "<<Kernels::get().name<<std::endl<<std::endl;
 }
 
 BaseLayer::BaseLayer()
@@ -32,7 +47,10 @@ BaseLayer::BaseLayer()
 
 BaseLayer::~BaseLayer()
 {
-    releaseArr(output);
+    if(ownOutput)
+    {
+        releaseArr(output);
+    }
 }
 
 void BaseLayer::setPreviewMode(const bool &previewMode)
@@ -40,13 +58,155 @@ void BaseLayer::setPreviewMode(const bool &previewMode)
     BaseLayer::isPreviewMode = previewMode;
 }
 
+void BaseLayer::setUseConcurrentBranches(const bool &concurrentBranches)
+{
+    BaseLayer::useConcurrentBranches = concurrentBranches;
+}
+
+#ifdef USE_OMP
+/* max active levels is process wide while contexts and pipeline stages run blocks at the same time. the first branch
+ * region to start raises it, the last one to finish puts the old value back, nothing restores under a nested one */
+static std::mutex nestedBranchMutex;
+static int nestedBranchUsers    = 0;
+static int nestedBranchSaved    = 1;
+
+static void enterNestedBranches(const int &levels)
+{
+    std::lock_guard<std::mutex> lock(nestedBranchMutex);
+    if(nestedBranchUsers++ == 0)
+    {
+        nestedBranchSaved = omp_get_max_active_levels();
+    }
+
+   if(omp_get_max_active_levels() < levels)
+    {
+        omp_set_max_active_levels(levels);
+    }
+}
+
+static void leaveNestedBranches()
+{
+    std::lock_guard<std::mutex> lock(nestedBranchMutex);
+    if(--nestedBranchUsers == 0)
+    {
+        omp_set_max_active_levels(nestedBranchSaved);
+    }
+}
+#endif
+
+static void forwardBranch(const std::vector<BaseLayer*> &layers, NetworkState &netState)
+{
+    for (size_t j = 0; j < layers.size(); ++j)
+    {
+        layers[j]->forward(netState);
+
+       netState.input     =   layers[j]->output;
+        netState.inputNum  =   layers[j]->outputNum;
+    }
+}
+
+void BaseLayer::forwardBranches(std::vector<BaseLayer *> *const *branches, const size_t &branchNum, NetworkState &netState,
+                                const bool &concurrent, const size_t &branchWorkSpace)
+{
+    float *const inputX     =   netState.input;
+    const int inputXNum     =   netState.inputNum;
+
+#ifdef USE_OMP
+    const int threads       =   OMP_THREAD;
+
+   if(concurrent && BaseLayer::useConcurrentBranches && branchNum > 1 && threads > 1)
+    {
+        float flops         =   0;
+        for (size_t i = 0; i < branchNum; ++i)
+        {
+            for (size_t j = 0; j < branches[i]->size(); ++j)
+            {
+                flops      +=  (*branches[i])[j]->bFlops;
+            }
+        }
+
+       /* the layers' own parallel regions nest inside the branch region */
+        std::exception_ptr error;
+        enterNestedBranches(omp_get_active_level() + 2);
+
+#pragma omp parallel for num_threads(std::min(threads, static_cast<int>(branchNum))) schedule(dynamic, 1)
+        for (int i = 0; i < static_cast<int>(branchNum); ++i)
+        {
+            float branchFlops = 0;
+            for (size_t j = 0; j < branches[i]->size(); ++j)
+            {
+                branchFlops += (*branches[i])[j]->bFlops;
+            }
+
+           /* the nested regions are sized by the branch's share */
+            const int share = (flops > 0) ? static_cast<int>(threads * branchFlops / flops + 0.5f) : 1;
+            omp_set_num_threads(std::max(1, std::min(share, threads)));
+
+           /* a stack state, its destructor must not free the shared buffers */
+            NetworkState branchState;
+            branchState.net             =   netState.net;
+            branchState.input           =   inputX;
+            branchState.inputNum        =   inputXNum;
+            branchState.workspace       =   netState.workspace + static_cast<size_t>(omp_get_thread_num()) * branchWorkSpace;
+            branchState.layoutBuffer    =   netState.layoutBuffer;
+            branchState.calibrationPass =   netState.calibrationPass;
+
+           try
+            {
+                forwardBranch(*branches[i], branchState);
+            }
+            catch(...)
+            {
+#pragma omp critical
+                error = std::current_exception();
+            }
+
+           branchState.workspace       =   nullptr;
+            branchState.layoutBuffer    =   nullptr;
+        }
+
+       leaveNestedBranches();
+
+       if(error)
+        {
+            std::rethrow_exception(error);
+        }
+
+       netState.input      =   inputX;
+        netState.inputNum   =   inputXNum;
+        return;
+    }
+#else
+    (void)concurrent;
+    (void)branchWorkSpace;
+#endif
+
+   for (size_t i = 0; i < branchNum; ++i)
+    {
+        netState.input      =   inputX;
+        netState.inputNum   =   inputXNum;
+
+       forwardBranch(*branches[i], netState);
+    }
+
+   netState.input          =   inputX;
+    netState.inputNum       =   inputXNum;
+}
+
 void BaseLayer::forward(NetworkState &netState)
 {
     (void)netState;
 }
 
-void BaseLayer::loadAllWeigths(std::vector<float> &weights)
+void BaseLayer::loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped)
 {
     (void)weights;
+    (void)len;
+    (void)mapped;
+}
+
+bool BaseLayer::supportNCHWc()
+{
+    return false;
 }
 }
@@ -62,74 +62,25 @@ void BatchNormLayer::forward(NetworkState &netState)
 {
     auto st = std::chrono::system_clock::now();
 
-   for (int b = 0; b < this->batch; ++b)
+   if(this->nchwc)
     {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-        for (int c = 0; c < this->channel; ++c)
-        {
-#ifdef USE_ARM
-            for (int i = 0; i < this->outHeight*this->outWidth; ++i)
-            {
-                int index = b*this->channel*this->outHeight*this->outWidth + c*this->outHeight*this->outWidth + i;
+        NCHWc::batchNorm(netState.input, this->batch, this->channel, this->outHeight*this->outWidth, this->scales, this->biases,
+                         this->rollMean, this->rollVariance, this->output);
+    }
 
-               this->output[index]  = this->scales[c]*(netState.input[index] - this->rollMean[c])/sqrt(this->rollVariance[c] + 0.00001f) + this->biases[c];
-            }
-#endif
+   const KernelTable &kernels = Kernels::get();
 
-#ifdef USE_X86
-            if(this->supportAvx)
-            {
-                int i = 0;
-                for (; i < (this->outHeight*this->outWidth)/8; ++i)
-                {
-
-                   int index = b*this->channel*this->outHeight*this->outWidth + c*this->outHeight*this->outWidth + i*8;
-
-                   __m256 mScale;
-                    __m256 mInput;
-                    __m256 mMean;
-                    __m256 mVariance;
-                    __m256 mEsp;
-                    __m256 mBias;
-                    __m256 mResult1;
-                    __m256 mResult2;
-
-                   mScale      =   _mm256_set1_ps(this->scales[c]);
-                    mInput      =   _mm256_loadu_ps(netState.input+index);
-                    mMean       =   _mm256_set1_ps(this->rollMean[c]);
-                    mVariance   =   _mm256_set1_ps(this->rollVariance[c]);
-                    mEsp        =   _mm256_set1_ps(0.00001f);
-                    mBias       =   _mm256_set1_ps(this->biases[c]);
-                    mResult1    =   _mm256_sub_ps(mInput, mMean);
-                    mResult1    =   _mm256_mul_ps(mScale, mResult1);
-                    mResult2    =   _mm256_add_ps(mVariance,mEsp);
-                    mResult2    =   _mm256_sqrt_ps(mResult2);
-
-                   mResult2    =   _mm256_div_ps(mResult1,mResult2);
-                    mResult2    =   _mm256_add_ps(mResult2,mBias);
-
-                   _mm256_storeu_ps(this->output+index, mResult2);
-
-               }
-
-               for (int j = i*8; j < this->outHeight*this->outWidth; ++j)
-                {
-                    int index = b*this->channel*this->outHeight*this->outWidth + c*this->outHeight*this->outWidth + j;
-                    this->output[index]  = this->scales[c]*(netState.input[index] - this->rollMean[c])/sqrt(this->rollVariance[c] + 0.00001f) + this->biases[c];
-                }
-            }
-            else
+   for (int b = 0; b < this->batch && !this->nchwc; ++b)
+    {
+        ThreadPool::parallelFor(0, this->channel, ThreadPool::grainFor(this->outHeight*this->outWidth), [&](const int &cBegin, const int &cEnd)
+        {
+            for (int c = cBegin; c < cEnd; ++c)
             {
-                for (int i = 0; i < this->outHeight*this->outWidth; ++i)
-                {
-                    int index = b*this->channel*this->outHeight*this->outWidth + c*this->outHeight*this->outWidth + i;
-                    this->output[index]  = this->scales[c]*(netState.input[index] - this->rollMean[c])/sqrt(this->rollVariance[c] + 0.00001f) + this->biases[c];
-                }
+                const int plane = this->outHeight*this->outWidth;
+                const int off   = (b*this->channel + c)*plane;
+                kernels.batchNorm(netState.input + off, this->output + off, plane, this->scales[c], this->rollMean[c], this->rollVariance[c], this->biases[c]);
             }
-#endif
-        }
+        });
 
    }
 
@@ -222,21 +173,22 @@ void BatchNormLayer::resize(int width, int height)
 
 }
 
-void BatchNormLayer::loadAllWeigths(std::vector<float> &weights)
+void BatchNormLayer::loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped)
 {
+    (void)mapped;
 
-   if(weights.size() != this->numWeights)
+   if(len != this->numWeights)
     {
-        throw Exception(1,"BatcnNorm weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(weights.size()), __FILE__, __LINE__);
+        throw Exception(1,"BatcnNorm weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(len), __FILE__, __LINE__);
     }
 
-   loadScales(weights.data(), nScales);
-    loadBias(weights.data() + nScales , nBiases);
-    loadRollMean(weights.data() + nScales + nBiases, nRollMean);
-    loadRollVariance(weights.data() + nScales + nBiases + nRollVariance, nRollMean);
+   loadScales(weights, nScales);
+    loadBias(weights + nScales , nBiases);
+    loadRollMean(weights + nScales + nBiases, nRollMean);
+    loadRollVariance(weights + nScales + nBiases + nRollVariance, nRollMean);
 }
 
-void BatchNormLayer::loadBias(float * const &bias, const int &len)
+void BatchNormLayer::loadBias(const float *const &bias, const int &len)
 {
     if(len != this->nBiases)
     {
@@ -245,7 +197,23 @@ void BatchNormLayer::loadBias(float * const &bias, const int &len)
     Blas::cpuCopy(len, bias, 1, this->biases,1);
 }
 
-void BatchNormLayer::loadScales(float * const &weights, const int &len)
+void BatchNormLayer::getPlanTensors(std::vector<ModelTensor> &tensors)
+{
+    tensors.push_back(ModelFile::makeTensor("scales", -1, TENSOR_F32, this->scales, static_cast<size_t>(this->nScales)));
+    tensors.push_back(ModelFile::makeTensor("biases", -1, TENSOR_F32, this->biases, static_cast<size_t>(this->nBiases)));
+    tensors.push_back(ModelFile::makeTensor("rollMean", -1, TENSOR_F32, this->rollMean, static_cast<size_t>(this->nRollMean)));
+    tensors.push_back(ModelFile::makeTensor("rollVariance", -1, TENSOR_F32, this->rollVariance, static_cast<size_t>(this->nRollVariance)));
+}
+
+bool BatchNormLayer::loadPlanTensors(const std::vector<ModelTensor> &tensors)
+{
+    return  ModelFile::copyTensor(tensors, "scales", static_cast<size_t>(this->nScales) * sizeof(float), this->scales) &&
+            ModelFile::copyTensor(tensors, "biases", static_cast<size_t>(this->nBiases) * sizeof(float), this->biases) &&
+            ModelFile::copyTensor(tensors, "rollMean", static_cast<size_t>(this->nRollMean) * sizeof(float), this->rollMean) &&
+            ModelFile::copyTensor(tensors, "rollVariance", static_cast<size_t>(this->nRollVariance) * sizeof(float), this->rollVariance);
+}
+
+void BatchNormLayer::loadScales(const float *const &weights, const int &len)
 {
     if(len != this->nScales)
     {
@@ -254,7 +222,7 @@ void BatchNormLayer::loadScales(float * const &weights, const int &len)
     Blas::cpuCopy(len, weights, 1, this->scales,1);
 }
 
-void BatchNormLayer::loadRollMean(float * const &rollMean, const int &len)
+void BatchNormLayer::loadRollMean(const float *const &rollMean, const int &len)
 {
     if(len != this->channel)
     {
@@ -264,7 +232,7 @@ void BatchNormLayer::loadRollMean(float * const &rollMean, const int &len)
    Blas::cpuCopy(len, rollMean, 1, this->rollMean,1);
 }
 
-void BatchNormLayer::loadRollVariance(float * const &rollVariance, const int &len)
+void BatchNormLayer::loadRollVariance(const float *const &rollVariance, const int &len)
 {
     if(len != this->channel)
     {
@@ -273,6 +241,12 @@ void BatchNormLayer::loadRollVariance(float * const &rollVariance, const int &le
     Blas::cpuCopy(len, rollVariance, 1, this->rollVariance,1);
 }
 
+bool BatchNormLayer::supportNCHWc()
+{
+    return this->channel % NCHWC_PACK == 0 && this->activation != ActivationType::NORM_CHAN &&
+           this->activation != ActivationType::NORM_CHAN_SOFTMAX && this->activation != ActivationType::NORM_CHAN_SOFTMAX_MAXVAL;
+}
+
 BatchNormLayer::~BatchNormLayer()
 {
     releaseArr(scales);
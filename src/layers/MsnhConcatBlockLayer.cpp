@@ -38,7 +38,7 @@ ConcatBlockLayer::ConcatBlockLayer(const int &batch, NetBuildParams &params, std
                 layer                       =   new ConvolutionalLayer(branchBuildParams.batch, 1, branchBuildParams.height, branchBuildParams.width, branchBuildParams.channels,
                                                                        convParams->filters,convParams->groups,convParams->kSizeX, convParams->kSizeY,convParams->strideX, convParams->strideY,
                                                                        convParams->dilationX,convParams->dilationY,convParams->paddingX, convParams->paddingY, convParams->activation, convParams->actParams, convParams->batchNorm, convParams->useBias,
-                                                                       0,0,0,0,convParams->antialiasing, nullptr, 0,0);
+                                                                       convParams->binary,convParams->xnor,0,0,convParams->antialiasing, nullptr, 0,0, branchBuildParams.options, convParams->implicitGemm);
                 if(i == 0 && j == 0)
                 {
                     this->inputNum = layer->inputNum;
@@ -58,7 +58,7 @@ ConcatBlockLayer::ConcatBlockLayer(const int &batch, NetBuildParams &params, std
             {
                 ConnectParams *connectParams=   reinterpret_cast<ConnectParams*>(branchParams[i][j]);
                 layer                       =   new ConnectedLayer(branchBuildParams.batch, 1, branchBuildParams.inputNums, connectParams->output, connectParams->activation, connectParams->actParams,
-                                                                   connectParams->batchNorm);
+                                                                   connectParams->batchNorm, branchBuildParams.options);
                 if(i == 0 && j == 0)
                 {
                     this->inputNum = layer->inputNum;
@@ -138,6 +138,7 @@ ConcatBlockLayer::ConcatBlockLayer(const int &batch, NetBuildParams &params, std
             }
 
             this->numWeights    =   this->numWeights + layer->numWeights;
+            this->bFlops        =   this->bFlops + layer->bFlops;
             this->layerDetail   =   this->layerDetail.append(layer->layerDetail);
 
             this->layerDetail.append("nweights  :" + to_string(layer->numWeights) + "\n");
@@ -165,6 +166,19 @@ ConcatBlockLayer::ConcatBlockLayer(const int &batch, NetBuildParams &params, std
     this->outHeight         =   branchBuildParams.height;
     this->outWidth          =   branchBuildParams.width;
 
+    for (size_t i = 0; i < branchLayers.size(); ++i)
+    {
+        branchRefs.push_back(&branchLayers[i]);
+    }
+
+    /* every branch may run at the same time, each on its own workspace slice */
+    this->branchWorkSpace       =   (this->workSpaceSize + sizeof(float) - 1) / sizeof(float);
+    this->concurrentBranches    =   BaseLayer::useConcurrentBranches && branchRefs.size() > 1;
+    if(this->concurrentBranches)
+    {
+        this->workSpaceSize     =   this->branchWorkSpace * sizeof(float) * branchRefs.size();
+    }
+
     if(!BaseLayer::isPreviewMode)
     {
         this->output            =   new float[static_cast<size_t>(outputNum * this->batch)]();
@@ -173,16 +187,14 @@ ConcatBlockLayer::ConcatBlockLayer(const int &batch, NetBuildParams &params, std
     this->layerDetail.append("===========================================================================\n");
 }
 
-void ConcatBlockLayer::loadAllWeigths(std::vector<float> &weights)
+void ConcatBlockLayer::loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped)
 {
-    if(weights.size() != this->numWeights)
+    if(len != this->numWeights)
     {
-        throw Exception(1,"ConcatBlockLayer weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(weights.size()), __FILE__, __LINE__);
+        throw Exception(1,"ConcatBlockLayer weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(len), __FILE__, __LINE__);
     }
 
     size_t ptr = 0;
-    std::vector<float>::const_iterator first = weights.begin();
-
     for (size_t i = 0; i < branchLayers.size(); ++i)
     {
         for (size_t j = 0; j < branchLayers[i].size(); ++j)
@@ -192,9 +204,7 @@ void ConcatBlockLayer::loadAllWeigths(std::vector<float> &weights)
             {
                 size_t nums = branchLayers[i][j]->numWeights;
 
-                std::vector<float> weights(first + static_cast<long long>(ptr), first + static_cast<long long>(ptr + nums));
-
-                branchLayers[i][j]->loadAllWeigths(weights);
+                branchLayers[i][j]->loadAllWeigths(weights + ptr, nums, mapped);
 
                 ptr         =   ptr + nums;
             }
@@ -204,33 +214,22 @@ void ConcatBlockLayer::loadAllWeigths(std::vector<float> &weights)
 
 void ConcatBlockLayer::forward(NetworkState &netState)
 {
-    /* TODO: batch; */
+    /* the block input stays untouched until the block returns, every branch reads it in place */
+    forwardBranches(branchRefs.data(), branchRefs.size(), netState, this->concurrentBranches, this->branchWorkSpace);
 
-    std::vector<float> inputX{netState.input, netState.input + netState.inputNum};
-
-    for (size_t i = 0; i < branchLayers.size(); ++i)
+    /* every image is the branch outputs back to back */
+    for (int b = 0; b < this->batch && !this->branchInPlace; ++b)
     {
-        for (size_t j = 0; j < branchLayers[i].size(); ++j)
-        {
-            branchLayers[i][j]->forward(netState);
-
-            netState.input     =   branchLayers[i][j]->output;
-            netState.inputNum  =   branchLayers[i][j]->outputNum;
-        }
-
-        netState.input         =    inputX.data();
-        netState.inputNum      =    static_cast<int>(inputX.size());
-    }
+        int  branchOutNum   =    0;
 
-    int  branchOutNum       =    0;
-
-    for (size_t i = 0; i < branchLayers.size(); ++i)
-    {
-        int tmpOutNum       =    branchLayers[i][branchLayers[i].size()-1]->outputNum;
+        for (size_t i = 0; i < branchLayers.size(); ++i)
+        {
+            int tmpOutNum   =    branchLayers[i][branchLayers[i].size()-1]->outputNum;
 
-        Blas::cpuCopy(tmpOutNum, branchLayers[i][branchLayers[i].size()-1]->output, 1, this->output+branchOutNum, 1);
+            Blas::cpuCopy(tmpOutNum, branchLayers[i][branchLayers[i].size()-1]->output + b*tmpOutNum, 1, this->output + b*this->outputNum + branchOutNum, 1);
 
-        branchOutNum           +=   tmpOutNum;
+            branchOutNum       +=   tmpOutNum;
+        }
     }
 
     if(this->activation == ActivationType::NORM_CHAN)
@@ -275,6 +274,44 @@ void ConcatBlockLayer::forward(NetworkState &netState)
     }
 }
 
+void ConcatBlockLayer::bindBranchOutputs()
+{
+    /* forward copies whole branch outputs without a batch stride, so only batch 1 can write in place */
+    if(BaseLayer::isPreviewMode || this->output == nullptr || this->batch != 1)
+    {
+        return;
+    }
+
+   int  branchOutNum       =    0;
+
+   for (size_t i = 0; i < branchLayers.size(); ++i)
+    {
+        BaseLayer *last     =    branchLayers[i][branchLayers[i].size()-1];
+
+       if(last->ownOutput)
+        {
+            releaseArr(last->output);
+        }
+
+       last->output        =    this->output + branchOutNum;
+        last->ownOutput     =    0;
+        branchOutNum       +=    last->outputNum;
+    }
+
+   this->branchInPlace     =    1;
+
+   for (size_t i = 0; i < branchLayers.size(); ++i)
+    {
+        for (size_t j = 0; j < branchLayers[i].size(); ++j)
+        {
+            if(branchLayers[i][j]->type == LayerType::CONCAT_BLOCK)
+            {
+                reinterpret_cast<ConcatBlockLayer*>(branchLayers[i][j])->bindBranchOutputs();
+            }
+        }
+    }
+}
+
 ConcatBlockLayer::~ConcatBlockLayer()
 {
     for (size_t i = 0; i < branchLayers.size(); ++i)
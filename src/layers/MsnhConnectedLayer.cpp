@@ -2,9 +2,11 @@
 namespace Msnhnet
 {
 ConnectedLayer::ConnectedLayer(const int &batch, const int &steps, const int &inputNum,
-                               const int &outputNum, const ActivationType &activation, const std::vector<float> &actParams, const int &batchNorm)
+                               const int &outputNum, const ActivationType &activation, const std::vector<float> &actParams, const int &batchNorm,
+                               const NetOptions &options)
 {
     int totalBatch      =   batch*steps;
+    this->options       =   options;
     this->type          =   LayerType::CONNECTED;
     this->layerName     =  "Connected       ";
 
@@ -72,28 +74,82 @@ ConnectedLayer::ConnectedLayer(const int &batch, const int &steps, const int &in
 
 ConnectedLayer::~ConnectedLayer()
 {
-    releaseArr(weights);
+    releaseWeights();
     releaseArr(biases);
     releaseArr(scales);
     releaseArr(rollMean);
     releaseArr(rollVariance);
+    releasePacked();
+    releaseArr(int8Scales);
+    releaseArr(int8Sums);
 
+    if(inputObserver != nullptr)
+    {
+        delete inputObserver;
+        inputObserver = nullptr;
+    }
 }
 
 void ConnectedLayer::forward(NetworkState &netState)
 {
     auto st = std::chrono::system_clock::now();
 
-    Blas::cpuFill(this->outputNum * this->batch, 0, this->output, 1);
-    int m       =   this->batch;
-    int k       =   this->inputNum;
-    int n       =   this->outputNum;
+    if(netState.calibrationPass > 0 && this->options.useInt8 && supportInt8())
+    {
+        if(this->inputObserver == nullptr)
+        {
+            this->inputObserver = new QuantObserver();
+        }
+        this->inputObserver->observe(netState.input, this->inputNum * this->batch, netState.calibrationPass);
+    }
+
+    if(this->int8Weights != nullptr)
+    {
+        const bool epilogueAct  =   Gemm::isEpilogueActivation(this->activation);
+
+        GemmEpilogue epi;
+        epi.bias                =   this->biases;
+        epi.activation          =   epilogueAct ? this->activation : ActivationType::NONE;
+        epi.actParam            =   (actParams.size() > 0) ? actParams[0] : 0.1f;
 
-    float *a    =   netState.input;
-    float *b    =   this->weights;
-    float *c    =   this->output;
+        for (int i = 0; i < this->batch; ++i)
+        {
+            Quant::gemv(this->outputNum, this->inputNum, this->int8Weights, this->int8Scales, this->int8Sums, netState.input + i * this->inputNum,
+                        this->inputScale, this->inputZeroPoint, this->output + i * this->outputNum, epi);
+        }
 
-    Gemm::cpuGemm(0,1,m,n,k,1,a,k,b,k,1,c,n,this->supportAvx&&this->supportFma);
+        if(!epilogueAct && this->activation != ActivationType::NORM_CHAN && this->activation != ActivationType::NORM_CHAN_SOFTMAX &&
+                this->activation != ActivationType::NORM_CHAN_SOFTMAX_MAXVAL)
+        {
+            Activations::activateArray(this->output, this->outputNum*this->batch, this->activation, (actParams.size() > 0) ? actParams[0] : 0.1f);
+        }
+
+        auto so = std::chrono::system_clock::now();
+        this->forwardTime =   1.f * (std::chrono::duration_cast<std::chrono::microseconds>(so - st)).count()* std::chrono::microseconds::period::num / std::chrono::microseconds::period::den;
+        return;
+    }
+
+    if(this->halfWeights != nullptr)
+    {
+        for (int i = 0; i < this->batch; ++i)
+        {
+            Gemm::cpuGemvHalf(this->outputNum, this->inputNum, this->halfWeights, this->halfStorage, netState.input + i * this->inputNum,
+                              this->output + i * this->outputNum);
+        }
+    }
+    else
+    {
+        Blas::cpuFill(this->outputNum * this->batch, 0, this->output, 1);
+        int m       =   this->batch;
+        int k       =   this->inputNum;
+        int n       =   this->outputNum;
+
+        float *a    =   netState.input;
+        float *b    =   this->weights;
+        float *c    =   this->output;
+
+        Gemm::cpuGemm(0,1,m,n,k,1,a,k,b,k,1,c,n,this->supportAvx&&this->supportFma);
+    }
 
     if(this->batchNorm == 1)
     {
@@ -132,30 +188,252 @@ void ConnectedLayer::forward(NetworkState &netState)
 
 }
 
-void ConnectedLayer::loadAllWeigths(std::vector<float> &weights)
+void ConnectedLayer::loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped)
 {
 
-    if(weights.size() != this->numWeights)
+    if(len != this->numWeights)
     {
-        throw Exception(1,"Connect weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(weights.size()), __FILE__, __LINE__);
+        throw Exception(1,"Connect weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(len), __FILE__, __LINE__);
     }
 
-    loadWeights(weights.data(), nWeights);
+    /* bn is applied to the outputs, the weights are only read */
+    if(mapped)
+    {
+        releaseWeights();
+        this->weights       =   const_cast<float*>(weights);
+        this->mappedWeights =   1;
+    }
+    else
+    {
+        if(this->mappedWeights)
+        {
+            releaseWeights();
+            this->weights   =   new float[static_cast<size_t>(this->nWeights)]();
+        }
+        loadWeights(weights, nWeights);
+    }
 
     if(this->batchNorm)
     {
-        loadScales(weights.data() + nWeights, nScales);
-        loadRollMean(weights.data() + nWeights + nScales, nRollMean);
-        loadRollVariance(weights.data() + nWeights + nScales + nRollMean, nRollVariance);
-        loadBias(weights.data() + nWeights + nScales + nRollMean + nRollVariance, nBiases);
+        loadScales(weights + nWeights, nScales);
+        loadRollMean(weights + nWeights + nScales, nRollMean);
+        loadRollVariance(weights + nWeights + nScales + nRollMean, nRollVariance);
+        loadBias(weights + nWeights + nScales + nRollMean + nRollVariance, nBiases);
     }
     else
     {
-        loadBias(weights.data() + nWeights, nBiases);
+        loadBias(weights + nWeights, nBiases);
+    }
+
+    if(supportHalfWeights())
+    {
+        this->halfStorage   =   this->options.weightStorage;
+        this->halfWeights   =   new uint16_t[static_cast<size_t>(this->nWeights)]();
+        Half::fromFloat(this->weights, static_cast<size_t>(this->nWeights), this->halfStorage, this->halfWeights);
+        releaseWeights();
     }
 }
 
-void ConnectedLayer::loadScales(float * const &weights, const int &len)
+bool ConnectedLayer::supportHalfWeights()
+{
+#ifdef USE_X86
+    if(this->options.weightStorage == WEIGHT_F32)
+    {
+        return false;
+    }
+
+    return this->supportAvx && this->supportFma && !(this->options.useInt8 && supportInt8());
+#else
+    return false;
+#endif
+}
+
+bool ConnectedLayer::supportInt8()
+{
+#ifdef USE_X86
+    return Kernels::get().quantDot != nullptr && !this->batchNorm;
+#else
+    return false;
+#endif
+}
+
+void ConnectedLayer::quantizeInt8(const QuantCalibration &method, const float &percentile)
+{
+    if(this->weights == nullptr || this->inputObserver == nullptr || this->inputObserver->empty)
+    {
+        return;
+    }
+
+    std::vector<int8_t> q(static_cast<size_t>(this->nWeights));
+    std::vector<float>  scales(static_cast<size_t>(this->outputNum));
+
+    Quant::quantizeWeights(this->weights, this->outputNum, this->inputNum, q.data(), scales.data());
+
+    float inScale   = 1.f;
+    int   inZero    = 0;
+    this->inputObserver->getParams(method, percentile, inScale, inZero);
+
+    setInt8Weights(q.data(), scales.data(), inScale, inZero);
+}
+
+void ConnectedLayer::setInt8Weights(const int8_t * const &q, const float * const &scales, const float &inScale, const int &inZeroPoint)
+{
+    releasePacked();
+    releaseArr(this->int8Scales);
+    releaseArr(this->int8Sums);
+
+    this->int8Weights       =  static_cast<int8_t *>(Gemm::alignedMalloc(static_cast<size_t>(this->outputNum) * Quant::getGemvStride(this->inputNum)));
+    this->int8Scales        =  new float[static_cast<size_t>(this->outputNum)]();
+    this->int8Sums          =  new int32_t[static_cast<size_t>(this->outputNum)]();
+
+    Quant::packGemv(q, this->outputNum, this->inputNum, this->int8Weights, this->int8Sums);
+    memcpy(this->int8Scales, scales, sizeof(float) * static_cast<size_t>(this->outputNum));
+
+    this->inputScale        =  inScale;
+    this->inputZeroPoint    =  inZeroPoint;
+
+    releaseWeights();
+}
+
+void ConnectedLayer::getInt8Weights(int8_t * const &q)
+{
+    const int stride = Quant::getGemvStride(this->inputNum);
+
+    for (int m = 0; m < this->outputNum; ++m)
+    {
+        memcpy(q + static_cast<size_t>(m) * this->inputNum, this->int8Weights + static_cast<size_t>(m) * stride, static_cast<size_t>(this->inputNum));
+    }
+}
+
+void ConnectedLayer::getPlanTensors(std::vector<ModelTensor> &tensors, std::vector<int32_t> &state)
+{
+    int32_t scaleBits = 0;
+    memcpy(&scaleBits, &this->inputScale, sizeof(float));
+    state = {static_cast<int32_t>(this->halfStorage), scaleBits, this->inputZeroPoint};
+
+   const size_t n = static_cast<size_t>(this->outputNum);
+    tensors.push_back(ModelFile::makeTensor("state", -1, TENSOR_INT32, state.data(), state.size()));
+
+   if(this->weights != nullptr)
+    {
+        tensors.push_back(ModelFile::makeTensor("weights", -1, TENSOR_F32, this->weights, static_cast<size_t>(this->nWeights)));
+    }
+
+   tensors.push_back(ModelFile::makeTensor("biases", -1, TENSOR_F32, this->biases, static_cast<size_t>(this->nBiases)));
+
+   if(this->batchNorm)
+    {
+        tensors.push_back(ModelFile::makeTensor("scales", -1, TENSOR_F32, this->scales, static_cast<size_t>(this->nScales)));
+        tensors.push_back(ModelFile::makeTensor("rollMean", -1, TENSOR_F32, this->rollMean, static_cast<size_t>(this->nRollMean)));
+        tensors.push_back(ModelFile::makeTensor("rollVariance", -1, TENSOR_F32, this->rollVariance, static_cast<size_t>(this->nRollVariance)));
+    }
+
+   if(this->halfWeights != nullptr)
+    {
+        tensors.push_back(ModelFile::makeTensor("half", -1, static_cast<ModelTensorType>(this->halfStorage), this->halfWeights, static_cast<size_t>(this->nWeights)));
+    }
+
+   if(this->int8Weights != nullptr)
+    {
+        tensors.push_back(ModelFile::makeTensor("int8", -1, TENSOR_INT8, this->int8Weights, n * Quant::getGemvStride(this->inputNum)));
+        tensors.push_back(ModelFile::makeTensor("int8Scales", -1, TENSOR_F32, this->int8Scales, n));
+        tensors.push_back(ModelFile::makeTensor("int8Sums", -1, TENSOR_INT32, this->int8Sums, n));
+    }
+}
+
+bool ConnectedLayer::loadPlanTensors(const std::vector<ModelTensor> &tensors, const bool &mapped)
+{
+    const ModelTensor *state = ModelFile::findTensor(tensors, "state");
+    if(state == nullptr || state->type != TENSOR_INT32 || state->getElements() != 3)
+    {
+        return false;
+    }
+
+   const int32_t *s = static_cast<const int32_t*>(state->data);
+    this->halfStorage       = static_cast<WeightStorage>(s[0]);
+    memcpy(&this->inputScale, s + 1, sizeof(float));
+    this->inputZeroPoint    = s[2];
+
+   const size_t n          = static_cast<size_t>(this->outputNum);
+    const size_t nWeights   = static_cast<size_t>(this->nWeights);
+
+   releasePacked();
+    releaseArr(this->int8Scales);
+    releaseArr(this->int8Sums);
+    this->int8Scales        = nullptr;
+    this->int8Sums          = nullptr;
+
+   const ModelTensor *weights = ModelFile::findTensor(tensors, "weights");
+    if(weights == nullptr)
+    {
+        releaseWeights();
+    }
+    else if(weights->bytes != nWeights * sizeof(float))
+    {
+        return false;
+    }
+    else if(mapped)
+    {
+        releaseWeights();
+        this->weights       = static_cast<float*>(const_cast<void*>(weights->data));
+        this->mappedWeights = 1;
+    }
+    else
+    {
+        if(this->mappedWeights)
+        {
+            releaseWeights();
+        }
+        ModelFile::copyTensor(tensors, "weights", nWeights * sizeof(float), this->weights);
+    }
+
+   const ModelTensor *int8 = ModelFile::findTensor(tensors, "int8");
+    if(int8 != nullptr)
+    {
+        if(int8->bytes != n * Quant::getGemvStride(this->inputNum))
+        {
+            return false;
+        }
+        if(mapped)
+        {
+            this->int8Weights   = static_cast<int8_t *>(const_cast<void*>(int8->data));
+            this->mappedPacked  = 1;
+        }
+        else
+        {
+            this->int8Weights   = static_cast<int8_t *>(Gemm::alignedMalloc(static_cast<size_t>(int8->bytes)));
+            memcpy(this->int8Weights, int8->data, static_cast<size_t>(int8->bytes));
+        }
+    }
+
+   const ModelTensor *half = ModelFile::findTensor(tensors, "half");
+    if(half != nullptr)
+    {
+        if(half->bytes != nWeights * sizeof(uint16_t))
+        {
+            return false;
+        }
+
+       if(mapped)
+        {
+            this->halfWeights   = static_cast<uint16_t *>(const_cast<void*>(half->data));
+            this->mappedPacked  = 1;
+        }
+        else
+        {
+            ModelFile::copyTensor(tensors, "half", nWeights * sizeof(uint16_t), this->halfWeights);
+        }
+    }
+
+   return  ModelFile::copyTensor(tensors, "biases", static_cast<size_t>(this->nBiases) * sizeof(float), this->biases) &&
+            ModelFile::copyTensor(tensors, "scales", static_cast<size_t>(this->nScales) * sizeof(float), this->scales) &&
+            ModelFile::copyTensor(tensors, "rollMean", static_cast<size_t>(this->nRollMean) * sizeof(float), this->rollMean) &&
+            ModelFile::copyTensor(tensors, "rollVariance", static_cast<size_t>(this->nRollVariance) * sizeof(float), this->rollVariance) &&
+            ModelFile::copyTensor(tensors, "int8Scales", n * sizeof(float), this->int8Scales) &&
+            ModelFile::copyTensor(tensors, "int8Sums", n * sizeof(int32_t), this->int8Sums);
+}
+
+void ConnectedLayer::loadScales(const float *const &weights, const int &len)
 {
     if(len != this->nScales)
     {
@@ -164,7 +442,7 @@ void ConnectedLayer::loadScales(float * const &weights, const int &len)
     Blas::cpuCopy(len, weights, 1, this->scales,1);
 }
 
-void ConnectedLayer::loadBias(float * const &bias, const int &len)
+void ConnectedLayer::loadBias(const float *const &bias, const int &len)
 {
     if(len != this->nBiases)
     {
@@ -173,7 +451,7 @@ void ConnectedLayer::loadBias(float * const &bias, const int &len)
     Blas::cpuCopy(len, bias, 1, this->biases,1);
 }
 
-void ConnectedLayer::loadWeights(float * const &weights, const int &len)
+void ConnectedLayer::loadWeights(const float *const &weights, const int &len)
 {
     if(len != this->nWeights)
     {
@@ -182,7 +460,29 @@ void ConnectedLayer::loadWeights(float * const &weights, const int &len)
     Blas::cpuCopy(len, weights, 1, this->weights,1);
 }
 
-void ConnectedLayer::loadRollMean(float * const &rollMean, const int &len)
+void ConnectedLayer::releaseWeights()
+{
+    if(!this->mappedWeights)
+    {
+        releaseArr(this->weights);
+    }
+    this->weights           =  nullptr;
+    this->mappedWeights     =  0;
+}
+
+void ConnectedLayer::releasePacked()
+{
+    if(!this->mappedPacked)
+    {
+        Gemm::alignedFree(this->int8Weights);
+        releaseArr(this->halfWeights);
+    }
+    this->int8Weights       =  nullptr;
+    this->halfWeights       =  nullptr;
+    this->mappedPacked      =  0;
+}
+
+void ConnectedLayer::loadRollMean(const float *const &rollMean, const int &len)
 {
     if(len != this->nRollMean)
     {
@@ -191,7 +491,7 @@ void ConnectedLayer::loadRollMean(float * const &rollMean, const int &len)
     Blas::cpuCopy(len, rollMean, 1, this->rollMean,1);
 }
 
-void ConnectedLayer::loadRollVariance(float * const &rollVariance, const int &len)
+void ConnectedLayer::loadRollVariance(const float *const &rollVariance, const int &len)
 {
     if(len != this->nRollVariance)
     {
@@ -5,10 +5,12 @@ namespace Msnhnet
 ConvolutionalLayer::ConvolutionalLayer(const int &batch, const int &steps, const int &height, const int &width, const int &channel, const int &num,
                                        const int &groups, const int &kSizeX, const int &kSizeY, const int &strideX, const int &strideY, const int &dilationX, const int &dilationY,
                                        const int &paddingX, const int &paddingY, ActivationType activation, const std::vector<float> &actParams, const int &batchNorm, const int &useBias, const int &binary, const int &xnor, const int &useBinOutput, const int &groupIndex, const int &antialiasing,
-                                       ConvolutionalLayer * const &shareLayer, const int &assistedExcitation, const int &deform)
+                                       ConvolutionalLayer * const &shareLayer, const int &assistedExcitation, const int &deform,
+                                       const NetOptions &options, const int &implicitGemm)
 {
 
    (void) deform;
+    this->options           = options;
     int totalBatch          = batch * steps;
     this->type              = LayerType::CONVOLUTIONAL;
 
@@ -135,15 +137,6 @@ ConvolutionalLayer::ConvolutionalLayer(const int &batch, const int &steps, const
             this->binaryWeights = new float[static_cast<size_t>(this->nWeights)]();
             this->binaryInputs  = new float[static_cast<size_t>(this->inputNum * this->batch)]();
             this->meanArr       = new float[static_cast<size_t>(this->num)]();
-
-           const int newCh     = this->channel / 32;
-            int rePackedISize   = newCh * this->width * this->height + 1;
-            this->binRePackedIn = new uint32_t[static_cast<size_t>(rePackedISize)]();
-
-           int k               = this->kSizeX * this->kSizeY * this->channel;
-            int kAligned        = k + (this->ldaAlign - k%this->ldaAlign);
-            int tBitInSize      = kAligned * this->bitAlign / 8;
-            this->tBitInput     = new char[static_cast<size_t>(tBitInSize)]();
         }
     }
 
@@ -179,6 +172,52 @@ ConvolutionalLayer::ConvolutionalLayer(const int &batch, const int &steps, const
     }
 #endif
 
+    if(this->groups == this->num && this->channel == this->num && this->kSizeX == 3 && this->kSizeY == 3 &&
+            this->strideX == this->strideY && (this->strideX == 1 || this->strideX == 2) && this->dilationX == 1 && this->dilationY == 1 &&
+            !this->xnor && !this->binary && !this->antialiasing && this->shareLayer == nullptr)
+    {
+        this->useDepthwise3x3 = 1;
+    }
+
+#ifdef USE_X86
+    if(this->kSizeX == 3 && this->kSizeY == 3 && this->strideX == 1 && this->strideY == 1 && this->dilationX == 1 && this->dilationY == 1 &&
+            this->paddingX == this->paddingY && this->groups == 1 && !this->xnor && !this->binary && !this->antialiasing &&
+            this->shareLayer == nullptr && this->channel >= 8 && this->num >= 8 && this->supportAvx && this->supportFma && this->options.useWinograd)
+    {
+        this->winogradOutTile = Winograd::selectOutTile(this->outHeight, this->outWidth);
+    }
+
+    /* implicitGemm: 1 forces it on for this layer, 0 off, -1 follows NetBuilder::setUseImplicitGemm (winograd layers keep winograd).
+     * it runs on the prepacked weights, which an open blas build does not have */
+#ifndef USE_OPEN_BLAS
+    if(!this->useDepthwise3x3 && !this->xnor && !this->binary && this->shareLayer == nullptr && this->supportAvx && this->supportFma &&
+            !(this->kSizeX == 1 && this->kSizeY == 1 && this->strideX == 1 && this->strideY == 1 && this->paddingX == 0 && this->paddingY == 0))
+    {
+        if(implicitGemm == 1 || (implicitGemm < 0 && this->options.useImplicitGemm && !(this->winogradOutTile > 0 && this->options.useWinograd)))
+        {
+            this->useImplicitGemm = 1;
+            this->winogradOutTile = 0;
+        }
+    }
+#else
+    (void)implicitGemm;
+#endif
+
+    /* int8 layers run im2col + Quant::gemm, and the float gemm path until they are calibrated */
+    if(this->options.useInt8 && supportInt8())
+    {
+        this->useImplicitGemm = 0;
+        this->winogradOutTile = 0;
+    }
+
+    /* fp16 / bf16 layers only have the im2col + packed gemm kernel */
+    if(supportHalfWeights())
+    {
+        this->useImplicitGemm = 0;
+        this->winogradOutTile = 0;
+    }
+#endif
+
    this->workSpaceSize = getConvWorkSpaceSize();
 
    this->bFlops        = (2.0f * this->nWeights * this->outHeight * this->outWidth) / 1000000000.f;
@@ -288,7 +327,7 @@ ConvolutionalLayer::ConvolutionalLayer(const int &batch, const int &steps, const
 
 ConvolutionalLayer::~ConvolutionalLayer()
 {
-    releaseArr(weights);
+    releaseWeights();
     releaseArr(biases);
     releaseArr(scales);
     releaseArr(rollMean);
@@ -301,6 +340,18 @@ ConvolutionalLayer::~ConvolutionalLayer()
     releaseArr(binRePackedIn);
     releaseArr(tBitInput);
     releaseArr(alignBitWeights);
+    releaseArr(bitTapSums);
+
+   releasePacked();
+
+   releaseArr(int8Scales);
+    releaseArr(int8Sums);
+
+   if(inputObserver != nullptr)
+    {
+        delete inputObserver;
+        inputObserver = nullptr;
+    }
 }
 
 int ConvolutionalLayer::convOutHeight()
@@ -315,18 +366,46 @@ int ConvolutionalLayer::convOutWidth()
 
 int ConvolutionalLayer::getWorkSpaceSize32()
 {
+    /* bit packed input + bit im2col, the float im2col below is the fallback without avx2 */
+    int xnorSize = 0;
+#ifdef USE_X86
     if(this->xnor)
     {
-        int  rePackInSize   = this->channel * this->width * this->height * static_cast<int>(sizeof(float));
-        int  workSpaceSize  = this->bitAlign * this->kSizeX * this->kSizeY * this->channel * static_cast<int>(sizeof(float));
-        if(workSpaceSize < rePackInSize)
+        xnorSize = static_cast<int>(Gemm::getXnorWorkSpaceSize(this->channel, this->height, this->width, this->kSizeY, this->kSizeX,
+                                                               this->outHeight, this->outWidth) * sizeof(uint32_t));
+    }
+#endif
+
+   if(this->useDepthwise3x3 || this->useImplicitGemm)
+    {
+        return 0;
+    }
+
+   if(this->nchwc)
+    {
+        return static_cast<int>(NCHWc::getWorkSpaceSize(this->channel, this->height, this->width, this->paddingX)*sizeof(float));
+    }
+
+   int workSpaceSize = this->outHeight * this->outWidth * this->kSizeX * this->kSizeY * (this->channel / this->groups)*static_cast<int>(sizeof(float));
+
+   /* folded batch: im2col of every image side by side, followed by the gemm output before it is scattered to NCHW */
+    if(foldBatch())
+    {
+        int foldSize = this->batch * this->outHeight * this->outWidth * (this->kSizeX * this->kSizeY * this->channel + this->num) / this->groups *
+                       static_cast<int>(sizeof(float));
+        workSpaceSize = (foldSize > workSpaceSize) ? foldSize : workSpaceSize;
+    }
+
+   if(this->winogradOutTile > 0 && this->options.useWinograd)
+    {
+        int winogradSize = static_cast<int>(Winograd::getWorkSpaceSize(this->winogradOutTile, this->channel, this->num, this->outHeight, this->outWidth)*sizeof(float));
+        if(winogradSize > workSpaceSize)
         {
-            workSpaceSize = rePackInSize;
-            return workSpaceSize;
+            workSpaceSize = winogradSize;
         }
     }
 
-   return this->outHeight * this->outWidth * this->kSizeX * this->kSizeY * (this->channel / this->groups)*static_cast<int>(sizeof(float));
+   return (xnorSize > workSpaceSize) ? xnorSize : workSpaceSize;
 }
 
 int ConvolutionalLayer::getWorkSpaceSize16()
@@ -334,20 +413,26 @@ int ConvolutionalLayer::getWorkSpaceSize16()
     return 0;
 }
 
+bool ConvolutionalLayer::foldBatch()
+{
+    return this->batch > 1 && this->batch * this->outHeight * this->outWidth <= CONV_FOLD_MAX_N &&
+           !this->xnor && !this->useDepthwise3x3 && !this->useImplicitGemm && !this->nchwc;
+}
+
 void ConvolutionalLayer::addBias(float *const &output, float *const &biases, const int &batch, const int &num, const int &whSize)
 {
     for (int b = 0; b < batch; ++b)
     {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-        for (int i = 0; i < num; ++i)
+        ThreadPool::parallelFor(0, num, ThreadPool::grainFor(whSize), [&](const int &iBegin, const int &iEnd)
         {
-            for (int j = 0; j < whSize; ++j)
+            for (int i = iBegin; i < iEnd; ++i)
             {
-                output[(b*num + i)*whSize + j] += biases[i];
+                for (int j = 0; j < whSize; ++j)
+                {
+                    output[(b*num + i)*whSize + j] += biases[i];
+                }
             }
-        }
+        });
     }
 }
 
@@ -355,16 +440,16 @@ void ConvolutionalLayer::scaleBias(float *const &output, float *const &scales, c
 {
     for (int b = 0; b < batch; ++b)
     {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-        for (int i = 0; i < num; ++i)
+        ThreadPool::parallelFor(0, num, ThreadPool::grainFor(whSize), [&](const int &iBegin, const int &iEnd)
         {
-            for (int j = 0; j < whSize; ++j)
+            for (int i = iBegin; i < iEnd; ++i)
             {
-                output[(b*num + i)*whSize + j] *= scales[i];
+                for (int j = 0; j < whSize; ++j)
+                {
+                    output[(b*num + i)*whSize + j] *= scales[i];
+                }
             }
-        }
+        });
     }
 }
 
@@ -423,48 +508,161 @@ void ConvolutionalLayer::forward(NetworkState &netState)
    int mOutHeight      = convOutHeight();
     int mOutWidth       = convOutWidth();
 
-   Blas::cpuFill(this->outputNum * this->batch, 0, this->output, 1);
-
-   if(this->xnor && (!this->alignBitWeights))
+   if(netState.calibrationPass > 0 && this->options.useInt8 && supportInt8())
     {
-        if(!this->alignBitWeights)
+        if(this->inputObserver == nullptr)
         {
-            binarizeWeights(this->weights,this->num, this->nWeights,this->binaryWeights);
+            this->inputObserver = new QuantObserver();
         }
-        swapBinary(); 
+        this->inputObserver->observe(netState.input, this->inputNum * this->batch, netState.calibrationPass);
+    }
+
+   /* bias, activation and the residual add are done on the packed gemm tiles, which then overwrite the output.
+     * the int8 gemm always dequantizes in its epilogue */
+    const bool int8         =   this->int8Weights != nullptr;
+    const bool half         =   this->halfWeights != nullptr;
+    const bool epilogue     =   int8 || half || (this->options.useEpilogueFusion && this->packedWeights != nullptr && !this->useDepthwise3x3 && !this->nchwc &&
+                                         this->winogradWeights == nullptr && !(this->batchNorm && !this->bnFolded));
+    const bool epilogueAct  =   epilogue && Gemm::isEpilogueActivation(this->activation);
+    const bool fold         =   foldBatch() && this->winogradWeights == nullptr;
+
+   if(!epilogue)
+    {
+        Blas::cpuFill(this->outputNum * this->batch, 0, this->output, 1);
+    }
 
-       cpuBinarize(netState.input, this->channel * this->height * this->width * this->batch, this->binaryInputs);
+   /* weights are binarized at load, without the bit packed path the inputs are binarized to +-1 floats here */
+    if(this->xnor && (!this->alignBitWeights))
+    {
+        cpuBinarize(netState.input, this->channel * this->height * this->width * this->batch, this->binaryInputs);
         netState.input = this->binaryInputs;
     }
 
+   if(this->useDepthwise3x3)
+    {
+        DepthwiseConv::conv3x3(this->strideX, netState.input, this->batch, this->channel, this->height, this->width, this->paddingX, this->paddingY,
+                               this->weights, (this->batchNorm || this->useBias) ? this->biases : nullptr, mOutHeight, mOutWidth,
+                               this->activation, (actParams.size() > 0) ? actParams[0] : 0.1f, this->output);
+    }
+    else if(this->nchwc)
+    {
+        NCHWc::conv(netState.input, this->batch, this->channel, this->height, this->width, this->kSizeX, this->strideX, this->paddingX,
+                    this->dilationX, this->nchwcWeights, (this->batchNorm || this->useBias) ? this->biases : nullptr,
+                    this->num, mOutHeight, mOutWidth, netState.workspace, this->output);
+    }
+
    int m       =  this->num / this->groups; 
 
    int k       =  this->kSizeX * this->kSizeY *this->channel / this->groups; 
 
    int n       =  mOutHeight * mOutWidth; 
 
-   for (int i = 0; i < this->batch; ++i)
+   /* small late layers get a wider gemm: B holds the im2col columns of all images (N = batch*n), C goes to the workspace
+     * behind B and is scattered to each image's output. the residual add is left to the tail, C is not in NCHW order */
+    for (int j = 0; j < this->groups && fold; ++j)
+    {
+        const int bn    =  this->batch * n;
+        float *b        =  netState.workspace;
+        float *c        =  netState.workspace + static_cast<size_t>(k) * bn;
+
+       for (int i = 0; i < this->batch; ++i)
+        {
+            float *im = netState.input + (i*this->groups + j)*(this->channel / this->groups)*this->height*this->width;
+            Gemm::cpuIm2colEx(im, this->channel/this->groups, this->height, this->width, this->kSizeX, this->kSizeY,
+                              this->paddingX, this->paddingY, this->strideX, this->strideY, this->dilationX, this->dilationY,
+                              b + i*n, bn);
+        }
+
+       GemmEpilogue epi;
+        epi.bias            =   (this->batchNorm || this->useBias) ? (this->biases + j*m) : nullptr;
+        epi.activation      =   epilogueAct ? this->activation : ActivationType::NONE;
+        epi.actParam        =   (actParams.size() > 0) ? actParams[0] : 0.1f;
+
+       if(int8)
+        {
+            Quant::gemm(m, bn, k, this->int8Weights, this->int8Scales, this->int8Sums, b, bn, this->inputScale, this->inputZeroPoint,
+                        c, bn, epi);
+        }
+        else if(half)
+        {
+            Gemm::cpuGemmPrePackedHalf(m, bn, k, this->halfWeights + j*this->packedGroupSize, this->halfStorage, b, bn, c, bn, &epi);
+        }
+        else if(this->packedWeights != nullptr)
+        {
+            /* without an epilogue the packed gemm accumulates, c is workspace and has to start at zero */
+            if(!epilogue)
+            {
+                Blas::cpuFill(m * bn, 0, c, 1);
+            }
+            Gemm::cpuGemmPrePacked(m, bn, k, this->packedWeights + j*this->packedGroupSize, b, bn, c, bn, epilogue ? &epi : nullptr);
+        }
+        else
+        {
+            Blas::cpuFill(m * bn, 0, c, 1);
+            Gemm::cpuGemm(0, 0, m, bn, k, 1, this->weights + j*this->nWeights/this->groups, k, b, bn, 1, c, bn, this->supportAvx&&this->supportFma);
+        }
+
+        ThreadPool::parallelFor(0, m, ThreadPool::grainFor(this->batch*n), [&](const int &rBegin, const int &rEnd)
+        {
+            for (int r = rBegin; r < rEnd; ++r)
+            {
+                for (int i = 0; i < this->batch; ++i)
+                {
+                    memcpy(this->output + i*this->outputNum + (j*m + r)*n, c + r*bn + i*n, n*sizeof(float));
+                }
+            }
+        });
+    }
+
+   for (int i = 0; i < this->batch && !this->useDepthwise3x3 && !this->nchwc && !fold; ++i)
     {
+        if(this->winogradWeights != nullptr)
+        {
+            Winograd::conv3x3s1(this->winogradOutTile, netState.input + i*this->inputNum, this->channel, this->height, this->width,
+                                this->paddingX, this->paddingY, this->winogradWeights, this->num, mOutHeight, mOutWidth,
+                                netState.workspace, this->output + i*this->outputNum);
+            continue;
+        }
 
        for (int j = 0; j < this->groups; ++j)
         {
 
-           float *a    =  this->weights + j*this->nWeights /this->groups;
+           float *a    =  (this->weights == nullptr) ? nullptr : (this->weights + j*this->nWeights /this->groups);
 
            float *b    =  netState.workspace;
 
            float *c    =  this->output + (i*this->groups +j)*n*m;
 
-           if(this->xnor && this->alignBitWeights && this->strideX == this->strideY)
+           if(this->xnor && this->alignBitWeights)
             {
-                /* TODO: */
-
-           }
+#ifdef USE_X86
+                Gemm::cpuXnorConv(netState.input + i*this->inputNum, this->channel, this->height, this->width, this->kSizeY, this->kSizeX,
+                                  this->paddingY, this->paddingX, this->strideY, this->strideX, this->dilationY, this->dilationX,
+                                  reinterpret_cast<uint32_t *>(this->alignBitWeights), this->num, this->meanArr, this->bitTapSums,
+                                  reinterpret_cast<uint32_t *>(netState.workspace), c);
+#endif
+            }
             else
             {
 
                float *im = netState.input + (i*this->groups + j)*(this->channel / this->groups)*this->height*this->width;
 
+               GemmEpilogue epi;
+                epi.bias            =   (this->batchNorm || this->useBias) ? (this->biases + j*m) : nullptr;
+                epi.activation      =   epilogueAct ? this->activation : ActivationType::NONE;
+                epi.actParam        =   (actParams.size() > 0) ? actParams[0] : 0.1f;
+                epi.residual        =   (epilogueAct && this->residualInput != nullptr) ? (this->residualInput + (i*this->groups + j)*n*m) : nullptr;
+                epi.postActivation  =   (epilogueAct && this->residualInput != nullptr) ? this->postActivation : ActivationType::NONE;
+                epi.postActParam    =   this->postActParam;
+
+               if(this->useImplicitGemm)
+                {
+                    Gemm::cpuImplicitGemmConv(m, this->packedWeights + j*this->packedGroupSize, im, this->channel/this->groups, this->height, this->width,
+                                              this->kSizeX, this->kSizeY, this->paddingX, this->paddingY, this->strideX, this->strideY,
+                                              this->dilationX, this->dilationY, c, epilogue ? &epi : nullptr);
+                    continue;
+                }
+
                if(this->kSizeX == 1 && this->kSizeY == 1 &&  this->strideX == 1  &&  this->strideY == 1&& this->paddingX == 0 && this->paddingY == 0)
                 {
                     b = im;
@@ -479,95 +677,62 @@ void ConvolutionalLayer::forward(NetworkState &netState)
 
                }
 
-               Gemm::cpuGemm(0, 0, m, n, k, 1, a, k, b, n, 1, c, n, this->supportAvx&&this->supportFma);
+               if(int8)
+                {
+                    Quant::gemm(m, n, k, this->int8Weights, this->int8Scales, this->int8Sums, b, n, this->inputScale, this->inputZeroPoint,
+                                c, n, epi);
+                }
+                else if(half)
+                {
+                    Gemm::cpuGemmPrePackedHalf(m, n, k, this->halfWeights + j*this->packedGroupSize, this->halfStorage, b, n, c, n, &epi);
+                }
+                else if(this->packedWeights != nullptr)
+                {
+                    Gemm::cpuGemmPrePacked(m, n, k, this->packedWeights + j*this->packedGroupSize, b, n, c, n, epilogue ? &epi : nullptr);
+                }
+                else
+                {
+                    Gemm::cpuGemm(0, 0, m, n, k, 1, a, k, b, n, 1, c, n, this->supportAvx&&this->supportFma);
+                }
             }
 
        }
 
    }
 
-   if(this->batchNorm==1)
+   if(this->useDepthwise3x3 || this->nchwc || epilogue)
+    {
+        /* bn is folded and bias is added in the depthwise / nchwc kernel or the gemm epilogue */
+    }
+    else if(this->batchNorm==1 && !this->bnFolded)
     {
+        const KernelTable &kernels = Kernels::get();
 
        for (int b = 0; b < this->batch; ++b)
         {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-            for (int c = 0; c < this->outChannel; ++c)
+            ThreadPool::parallelFor(0, this->outChannel, ThreadPool::grainFor(this->outHeight*this->outWidth), [&](const int &cBegin, const int &cEnd)
             {
-#ifdef USE_ARM
-                for (int i = 0; i < this->outHeight*this->outWidth; ++i)
-                {
-                    int index = b*this->outChannel*this->outHeight*this->outWidth + c*this->outHeight*this->outWidth + i;
-
-                   this->output[index]  = this->scales[c]*(this->output[index] - this->rollMean[c])/sqrt(this->rollVariance[c] + 0.00001f) + this->biases[c];
-                }
-#endif
-
-#ifdef USE_X86
-                if(this->supportAvx)
-                {
-                    int i = 0;
-                    for (; i < (this->outHeight*this->outWidth)/8; ++i)
-                    {
-
-                       int index = b*this->outChannel*this->outHeight*this->outWidth + c*this->outHeight*this->outWidth + i*8;
-
-                       __m256 mScale;
-                        __m256 mInput;
-                        __m256 mMean;
-                        __m256 mVariance;
-                        __m256 mEsp;
-                        __m256 mBias;
-                        __m256 mResult1;
-                        __m256 mResult2;
-
-                       mScale      =   _mm256_set1_ps(this->scales[c]);
-                        mInput      =   _mm256_loadu_ps(this->output+index);
-                        mMean       =   _mm256_set1_ps(this->rollMean[c]);
-                        mVariance   =   _mm256_set1_ps(this->rollVariance[c]);
-                        mEsp        =   _mm256_set1_ps(0.00001f);
-                        mBias       =   _mm256_set1_ps(this->biases[c]);
-                        mResult1    =   _mm256_sub_ps(mInput, mMean);
-                        mResult1    =   _mm256_mul_ps(mScale, mResult1);
-                        mResult2    =   _mm256_add_ps(mVariance,mEsp);
-                        mResult2    =   _mm256_sqrt_ps(mResult2);
-
-                       mResult2    =   _mm256_div_ps(mResult1,mResult2);
-                        mResult2    =   _mm256_add_ps(mResult2,mBias);
-
-                       _mm256_storeu_ps(this->output+index, mResult2);
-
-                   }
-
-                   for (int j = i*8; j < this->outHeight*this->outWidth; ++j)
-                    {
-                        int index = b*this->outChannel*this->outHeight*this->outWidth + c*this->outHeight*this->outWidth + j;
-                        this->output[index]  = this->scales[c]*(this->output[index] - this->rollMean[c])/sqrt(this->rollVariance[c] + 0.00001f) + this->biases[c];
-                    }
-                }
-                else
+                for (int c = cBegin; c < cEnd; ++c)
                 {
-                    for (int i = 0; i < this->outHeight*this->outWidth; ++i)
-                    {
-                        int index = b*this->outChannel*this->outHeight*this->outWidth + c*this->outHeight*this->outWidth + i;
-
-                       this->output[index]  = this->scales[c]*(this->output[index] - this->rollMean[c])/sqrt(this->rollVariance[c] + 0.00001f) + this->biases[c];
-                    }
+                    const int plane = this->outHeight*this->outWidth;
+                    float *out      = this->output + (b*this->outChannel + c)*plane;
+                    kernels.batchNorm(out, out, plane, this->scales[c], this->rollMean[c], this->rollVariance[c], this->biases[c]);
                 }
-#endif
-            }
+            });
         }
 
    }
     else
     {
-        if(useBias == 1)
+        if(useBias == 1 || this->bnFolded)
             addBias(this->output, this->biases, this->batch, this->num, mOutHeight*mOutWidth);
     }
 
-   if(this->activation == ActivationType::NORM_CHAN)
+   if((this->useDepthwise3x3 && DepthwiseConv::isFusedActivation(this->activation)) || epilogueAct)
+    {
+
+   }
+    else if(this->activation == ActivationType::NORM_CHAN)
     {
         Activations::activateArrayNormCh(this->output, this->outputNum*this->batch, this->batch, this->outChannel,
                                          this->outWidth*this->outHeight, this->output);
@@ -598,9 +763,13 @@ void ConvolutionalLayer::forward(NetworkState &netState)
         }
     }
 
-   if(this->binary || this->xnor)
+   if(this->residualInput != nullptr && (!epilogueAct || fold))
     {
-        swapBinary();
+        Blas::cpuAxpy(this->outputNum*this->batch, 1.f, this->residualInput, 1, this->output, 1);
+        if(this->postActivation != ActivationType::NONE && this->postActivation != ActivationType::LINEAR)
+        {
+            Activations::activateArray(this->output, this->outputNum*this->batch, this->postActivation, this->postActParam);
+        }
     }
 
    auto so = std::chrono::system_clock::now();
@@ -609,32 +778,517 @@ void ConvolutionalLayer::forward(NetworkState &netState)
 
 }
 
-void ConvolutionalLayer::loadAllWeigths(std::vector<float> &weights)
+void ConvolutionalLayer::loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped)
 {
-    if(weights.size() != this->numWeights)
+    if(len != this->numWeights)
     {
-        throw Exception(1,"Conv weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(weights.size()), __FILE__, __LINE__);
+        throw Exception(1,"Conv weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(len), __FILE__, __LINE__);
     }
 
-   loadWeights(weights.data(), nWeights);
+   /* depthwise / nchwc kernels and the int8 / half epilogues only take a bias, the other paths fold bn when enabled */
+    const bool int8 = this->options.useInt8 && supportInt8();
+    const bool half = supportHalfWeights();
+    const bool fold = this->batchNorm && (this->useDepthwise3x3 || this->nchwc || int8 || half ||
+                                          (this->options.useBatchNormFolding && !this->xnor && !this->binary && this->shareLayer == nullptr));
+
+   /* bn folding and binarization rewrite the weights, every other path only reads (or packs) them */
+    if(mapped && !fold && !this->binary && !this->xnor && this->shareLayer == nullptr)
+    {
+        releaseWeights();
+        this->weights       = const_cast<float*>(weights);
+        this->mappedWeights = 1;
+    }
+    else
+    {
+        if(this->mappedWeights)
+        {
+            releaseWeights();
+            this->weights   = new float[static_cast<size_t>(this->nWeights)]();
+        }
+        loadWeights(weights, nWeights);
+    }
 
    if(this->batchNorm)
     {
-        loadScales(weights.data() + nWeights, nScales);
-        loadBias(weights.data() + nWeights + nScales, nBiases);
-        loadRollMean(weights.data() + nWeights + nScales + nBiases, nRollMean);
-        loadRollVariance(weights.data() + nWeights + nScales + nBiases + nRollMean, nRollVariance);
+        loadScales(weights + nWeights, nScales);
+        loadBias(weights + nWeights + nScales, nBiases);
+        loadRollMean(weights + nWeights + nScales + nBiases, nRollMean);
+        loadRollVariance(weights + nWeights + nScales + nBiases + nRollMean, nRollVariance);
     }
     else
     {
         if(useBias==1)
         {
-            loadBias(weights.data() + nWeights, nBiases);
+            loadBias(weights + nWeights, nBiases);
+        }
+    }
+
+   this->bnFolded = 0;
+    if(fold)
+    {
+        foldBatchNorm();
+        this->bnFolded = 1;
+    }
+
+   if((this->binary || this->xnor) && this->shareLayer == nullptr)
+    {
+        binarizeWeights(this->weights, this->num, this->nWeights / this->num, this->binaryWeights);
+        swapBinary();
+    }
+
+   if(this->xnor)
+    {
+        packBitWeights();
+    }
+    else if(int8)
+    {
+        /* float weights stay until NetBuilder::calibrate / loadQuantWeights quantizes them */
+    }
+    else if(half)
+    {
+        packHalfWeights();
+    }
+    else if(this->nchwc)
+    {
+        packNCHWcWeights();
+    }
+    else if(this->winogradOutTile > 0 && this->options.useWinograd)
+    {
+        transformWinogradWeights();
+    }
+    else if(this->options.usePrePackedWeights || this->useImplicitGemm)
+    {
+        prePackWeights();
+    }
+}
+
+void ConvolutionalLayer::foldBatchNorm()
+{
+    const int wtSize = this->nWeights / this->num;
+
+   for (int c = 0; c < this->num; ++c)
+    {
+        const float scale   = this->scales[c] / sqrt(this->rollVariance[c] + 0.00001f);
+
+       Blas::cpuScale(wtSize, scale, this->weights + c*wtSize, 1);
+
+       this->biases[c]      = this->biases[c] - this->rollMean[c] * scale;
+    }
+}
+
+void ConvolutionalLayer::transformWinogradWeights()
+{
+    if(this->winogradOutTile == 0 || this->weights == nullptr)
+    {
+        return;
+    }
+
+    releasePacked();
+
+    this->winogradWeights   =  static_cast<float *>(Gemm::alignedMalloc(Winograd::getTransformedWeightsSize(this->winogradOutTile, this->num, this->channel)*sizeof(float)));
+
+    Winograd::transformWeights3x3(this->winogradOutTile, this->weights, this->num, this->channel, this->winogradWeights);
+
+    releaseWeights();
+}
+
+void ConvolutionalLayer::packNCHWcWeights()
+{
+    if(this->weights == nullptr)
+    {
+        return;
+    }
+
+    releasePacked();
+
+    this->nchwcWeights      =  static_cast<float *>(Gemm::alignedMalloc(NCHWc::getPackedWeightsSize(this->num, this->channel, this->kSizeX)*sizeof(float)));
+
+    NCHWc::packWeights(this->weights, this->num, this->channel, this->kSizeX, this->nchwcWeights);
+
+    releaseWeights();
+}
+
+bool ConvolutionalLayer::supportNCHWc()
+{
+#ifdef USE_X86
+    const bool simd = this->supportAvx && this->supportFma;
+#elif defined(USE_NEON)
+    const bool simd = true;
+#else
+    const bool simd = false;
+#endif
+
+   return simd && this->groups == 1 && !this->useDepthwise3x3 && !this->useImplicitGemm && !(this->winogradOutTile > 0 && this->options.useWinograd) &&
+           !(this->options.useInt8 && supportInt8()) && !supportHalfWeights() &&
+           !this->xnor && !this->binary && !this->antialiasing && this->shareLayer == nullptr &&
+           this->kSizeX == this->kSizeY && this->strideX == this->strideY && this->paddingX == this->paddingY && this->dilationX == this->dilationY &&
+           this->channel % NCHWC_PACK == 0 && this->num % NCHWC_PACK == 0 && this->outHeight * this->outWidth <= NCHWC_MAX_SPATIAL &&
+           NCHWc::isFaster(this->num, this->kSizeX, this->strideX, this->outHeight, this->outWidth) &&
+           this->activation != ActivationType::NORM_CHAN && this->activation != ActivationType::NORM_CHAN_SOFTMAX &&
+           this->activation != ActivationType::NORM_CHAN_SOFTMAX_MAXVAL;
+}
+
+bool ConvolutionalLayer::supportInt8()
+{
+#ifdef USE_X86
+    return Kernels::get().quantGemm4x16 != nullptr && this->groups == 1 && !this->useDepthwise3x3 && !this->xnor && !this->binary && !this->antialiasing &&
+           this->shareLayer == nullptr;
+#else
+    return false;
+#endif
+}
+
+void ConvolutionalLayer::quantizeInt8(const QuantCalibration &method, const float &percentile)
+{
+    if(this->weights == nullptr || this->inputObserver == nullptr || this->inputObserver->empty)
+    {
+        return;
+    }
+
+    const int k = this->nWeights / this->num;
+
+    std::vector<int8_t> q(static_cast<size_t>(this->nWeights));
+    std::vector<float>  scales(static_cast<size_t>(this->num));
+
+    Quant::quantizeWeights(this->weights, this->num, k, q.data(), scales.data());
+
+    float inScale   = 1.f;
+    int   inZero    = 0;
+    this->inputObserver->getParams(method, percentile, inScale, inZero);
+
+    setInt8Weights(q.data(), scales.data(), inScale, inZero);
+}
+
+void ConvolutionalLayer::setInt8Weights(const int8_t * const &q, const float * const &scales, const float &inScale, const int &inZeroPoint)
+{
+    const int k = this->nWeights / this->num;
+
+    releasePacked();
+    releaseArr(this->int8Scales);
+    releaseArr(this->int8Sums);
+
+    this->int8Weights       =  static_cast<int8_t *>(Gemm::alignedMalloc(Quant::getPackedASize(this->num, k)));
+    this->int8Scales        =  new float[static_cast<size_t>(this->num)]();
+    this->int8Sums          =  new int32_t[static_cast<size_t>(this->num)]();
+
+    Quant::packA(q, this->num, k, this->int8Weights, this->int8Sums);
+    memcpy(this->int8Scales, scales, sizeof(float) * static_cast<size_t>(this->num));
+
+    this->inputScale        =  inScale;
+    this->inputZeroPoint    =  inZeroPoint;
+
+    releaseWeights();
+}
+
+void ConvolutionalLayer::getInt8Weights(int8_t * const &q)
+{
+    Quant::unpackA(this->int8Weights, this->num, this->nWeights / this->num, q);
+}
+
+bool ConvolutionalLayer::supportHalfWeights()
+{
+#if defined(USE_X86) && !defined(USE_OPEN_BLAS)
+    if(this->options.weightStorage == WEIGHT_F32)
+    {
+        return false;
+    }
+
+    return this->supportAvx && this->supportFma && !this->useDepthwise3x3 && !this->xnor && !this->binary && this->shareLayer == nullptr &&
+           !(this->options.useInt8 && supportInt8());
+#else
+    return false;
+#endif
+}
+
+void ConvolutionalLayer::packHalfWeights()
+{
+    if(this->weights == nullptr)
+    {
+        return;
+    }
+
+    int m       =  this->num / this->groups;
+    int k       =  this->kSizeX * this->kSizeY *this->channel / this->groups;
+
+    releasePacked();
+
+    this->packedGroupSize   =  Gemm::getPackedASize(m, k) + GEMM_HALF_PAD;
+    this->halfWeights       =  static_cast<uint16_t *>(Gemm::alignedMalloc(this->packedGroupSize * this->groups * sizeof(uint16_t)));
+    this->halfStorage       =  this->options.weightStorage;
+
+    for (int j = 0; j < this->groups; ++j)
+    {
+        Gemm::cpuGemmPackAHalf(m, k, this->weights + j*this->nWeights/this->groups, k, this->halfWeights + j*this->packedGroupSize, this->halfStorage);
+    }
+
+    releaseWeights();
+}
+
+void ConvolutionalLayer::packBitWeights()
+{
+#ifdef USE_X86
+    if(!this->xnor || !this->supportAvx || this->shareLayer != nullptr || this->weights == nullptr)
+    {
+        return;
+    }
+
+    const int ld            =  Gemm::getXnorLd(this->channel, this->kSizeY, this->kSizeX);
+
+    releaseArr(this->alignBitWeights);
+    releaseArr(this->bitTapSums);
+
+    this->alignBitWeights   =  new char[static_cast<size_t>(this->num) * ld * sizeof(uint32_t)]();
+    this->bitTapSums        =  new int[static_cast<size_t>(this->num) * this->kSizeX * this->kSizeY]();
+
+    Gemm::cpuXnorPackWeights(this->weights, this->num, this->channel, this->kSizeY, this->kSizeX,
+                             reinterpret_cast<uint32_t *>(this->alignBitWeights), this->meanArr, this->bitTapSums);
+
+    releaseWeights();
+#endif
+}
+
+void ConvolutionalLayer::prePackWeights()
+{
+#if defined(USE_X86) && !defined(USE_OPEN_BLAS)
+    if(this->xnor || this->binary || this->shareLayer != nullptr || this->weights == nullptr || this->useDepthwise3x3)
+    {
+        return;
+    }
+
+    int m       =  this->num / this->groups;
+    int k       =  this->kSizeX * this->kSizeY *this->channel / this->groups;
+
+    releasePacked();
+
+    this->packedGroupSize   =  Gemm::getPackedASize(m, k);
+    this->packedWeights     =  static_cast<float *>(Gemm::alignedMalloc(this->packedGroupSize * this->groups * sizeof(float)));
+
+    for (int j = 0; j < this->groups; ++j)
+    {
+        Gemm::cpuGemmPackA(m, k, 1.f, this->weights + j*this->nWeights/this->groups, k, this->packedWeights + j*this->packedGroupSize);
+    }
+
+    releaseWeights();
+#endif
+}
+
+void ConvolutionalLayer::releasePacked()
+{
+    if(!this->mappedPacked)
+    {
+        Gemm::alignedFree(this->packedWeights);
+        Gemm::alignedFree(this->winogradWeights);
+        Gemm::alignedFree(this->nchwcWeights);
+        Gemm::alignedFree(this->halfWeights);
+        Gemm::alignedFree(this->int8Weights);
+    }
+    this->packedWeights     =  nullptr;
+    this->winogradWeights   =  nullptr;
+    this->nchwcWeights      =  nullptr;
+    this->halfWeights       =  nullptr;
+    this->int8Weights       =  nullptr;
+    this->mappedPacked      =  0;
+}
+
+/* plan tensor sizes in bytes, 0 if the layer has no such array */
+static size_t getPlanBytes(ConvolutionalLayer *const &layer, const std::string &name)
+{
+    const size_t n      = static_cast<size_t>(layer->num);
+    const size_t k      = static_cast<size_t>(layer->nWeights / layer->num);
+    const size_t groups = static_cast<size_t>(layer->groups);
+
+   if(name == "weights" || name == "binaryWeights")
+    {
+        return static_cast<size_t>(layer->nWeights) * sizeof(float);
+    }
+    else if(name == "biases" || name == "scales" || name == "rollMean" || name == "rollVariance" || name == "meanArr" || name == "int8Scales")
+    {
+        return n * sizeof(float);
+    }
+    else if(name == "int8Sums")
+    {
+        return n * sizeof(int32_t);
+    }
+    else if(name == "alignBitWeights")
+    {
+        return n * static_cast<size_t>(Gemm::getXnorLd(layer->channel, layer->kSizeY, layer->kSizeX)) * sizeof(uint32_t);
+    }
+    else if(name == "bitTapSums")
+    {
+        return n * static_cast<size_t>(layer->kSizeX * layer->kSizeY) * sizeof(int);
+    }
+    else if(name == "packed")
+    {
+        return layer->packedGroupSize * groups * sizeof(float);
+    }
+    else if(name == "half")
+    {
+        return layer->packedGroupSize * groups * sizeof(uint16_t);
+    }
+    else if(name == "winograd")
+    {
+        return Winograd::getTransformedWeightsSize(layer->winogradOutTile, layer->num, layer->channel) * sizeof(float);
+    }
+    else if(name == "nchwc")
+    {
+        return NCHWc::getPackedWeightsSize(layer->num, layer->channel, layer->kSizeX) * sizeof(float);
+    }
+    else if(name == "int8")
+    {
+        return Quant::getPackedASize(layer->num, static_cast<int>(k));
+    }
+    return 0;
+}
+
+static void addPlanTensor(std::vector<ModelTensor> &tensors, ConvolutionalLayer *const &layer, const std::string &name,
+                          const ModelTensorType &type, const void *const &data)
+{
+    if(data != nullptr)
+    {
+        const size_t elementSize = (type == TENSOR_F32 || type == TENSOR_INT32) ? 4 : ((type == TENSOR_INT8) ? 1 : 2);
+        tensors.push_back(ModelFile::makeTensor(name, -1, type, data, getPlanBytes(layer, name) / elementSize));
+    }
+}
+
+void ConvolutionalLayer::getPlanTensors(std::vector<ModelTensor> &tensors, std::vector<int32_t> &state)
+{
+    int32_t scaleBits = 0;
+    memcpy(&scaleBits, &this->inputScale, sizeof(float));
+
+   /* the kernel choice first, loadPlanTensors compares it with the rebuilt layer */
+    state = {this->winogradOutTile, this->useDepthwise3x3, this->useImplicitGemm, this->nchwc, this->bnFolded,
+             static_cast<int32_t>(this->halfStorage), static_cast<int32_t>(this->packedGroupSize), scaleBits, this->inputZeroPoint};
+
+   tensors.push_back(ModelFile::makeTensor("state", -1, TENSOR_INT32, state.data(), state.size()));
+    addPlanTensor(tensors, this, "weights", TENSOR_F32, this->weights);
+    addPlanTensor(tensors, this, "biases", TENSOR_F32, this->biases);
+    addPlanTensor(tensors, this, "scales", TENSOR_F32, this->scales);
+    addPlanTensor(tensors, this, "rollMean", TENSOR_F32, this->rollMean);
+    addPlanTensor(tensors, this, "rollVariance", TENSOR_F32, this->rollVariance);
+    addPlanTensor(tensors, this, "binaryWeights", TENSOR_F32, this->binaryWeights);
+    addPlanTensor(tensors, this, "meanArr", TENSOR_F32, this->meanArr);
+    addPlanTensor(tensors, this, "alignBitWeights", TENSOR_INT8, this->alignBitWeights);
+    addPlanTensor(tensors, this, "bitTapSums", TENSOR_INT32, this->bitTapSums);
+    addPlanTensor(tensors, this, "packed", TENSOR_F32, this->packedWeights);
+    addPlanTensor(tensors, this, "winograd", TENSOR_F32, this->winogradWeights);
+    addPlanTensor(tensors, this, "nchwc", TENSOR_F32, this->nchwcWeights);
+    addPlanTensor(tensors, this, "half", static_cast<ModelTensorType>(this->halfStorage), this->halfWeights);
+    addPlanTensor(tensors, this, "int8", TENSOR_INT8, this->int8Weights);
+    addPlanTensor(tensors, this, "int8Scales", TENSOR_F32, this->int8Scales);
+    addPlanTensor(tensors, this, "int8Sums", TENSOR_INT32, this->int8Sums);
+}
+
+/* small arrays are copied into owned memory, packed weights are used in place when mapped */
+template<typename T>
+static bool copyPlanTensor(const std::vector<ModelTensor> &tensors, ConvolutionalLayer *const &layer, const std::string &name, T *&dst)
+{
+    return ModelFile::copyTensor(tensors, name, getPlanBytes(layer, name), dst);
+}
+
+template<typename T>
+static bool adoptPlanTensor(const std::vector<ModelTensor> &tensors, ConvolutionalLayer *const &layer, const std::string &name, const bool &mapped, T *&dst)
+{
+    const ModelTensor *t = ModelFile::findTensor(tensors, name);
+    if(t == nullptr)
+    {
+        return true;
+    }
+
+   const size_t bytes = getPlanBytes(layer, name);
+    if(t->bytes != bytes)
+    {
+        return false;
+    }
+
+   if(mapped)
+    {
+        dst                 = static_cast<T*>(const_cast<void*>(t->data));
+        layer->mappedPacked = 1;
+    }
+    else
+    {
+        dst                 = static_cast<T*>(Gemm::alignedMalloc(bytes));
+        memcpy(dst, t->data, bytes);
+    }
+    return true;
+}
+
+bool ConvolutionalLayer::loadPlanTensors(const std::vector<ModelTensor> &tensors, const bool &mapped)
+{
+    const ModelTensor *state = ModelFile::findTensor(tensors, "state");
+    if(state == nullptr || state->type != TENSOR_INT32 || state->getElements() != 9)
+    {
+        return false;
+    }
+
+   const int32_t *s = static_cast<const int32_t*>(state->data);
+    if(s[0] != this->winogradOutTile || s[1] != this->useDepthwise3x3 || s[2] != this->useImplicitGemm || s[3] != this->nchwc)
+    {
+        return false;
+    }
+
+   this->bnFolded          = s[4];
+    this->halfStorage       = static_cast<WeightStorage>(s[5]);
+    this->packedGroupSize   = static_cast<size_t>(s[6]);
+    memcpy(&this->inputScale, s + 7, sizeof(float));
+    this->inputZeroPoint    = s[8];
+
+   releasePacked();
+    releaseArr(this->alignBitWeights);
+    releaseArr(this->bitTapSums);
+    releaseArr(this->int8Scales);
+    releaseArr(this->int8Sums);
+    this->alignBitWeights   = nullptr;
+    this->bitTapSums        = nullptr;
+    this->int8Scales        = nullptr;
+    this->int8Sums          = nullptr;
+
+   /* binarized layers swap weights / binaryWeights in place, they keep owned copies */
+    const ModelTensor *weights = ModelFile::findTensor(tensors, "weights");
+    if(weights == nullptr)
+    {
+        releaseWeights();
+    }
+    else if(mapped && !this->binary && !this->xnor)
+    {
+        if(weights->bytes != getPlanBytes(this, "weights"))
+        {
+            return false;
         }
+        releaseWeights();
+        this->weights       = static_cast<float*>(const_cast<void*>(weights->data));
+        this->mappedWeights = 1;
     }
+    else
+    {
+        if(this->mappedWeights)
+        {
+            releaseWeights();
+        }
+        if(!copyPlanTensor(tensors, this, "weights", this->weights))
+        {
+            return false;
+        }
+    }
+
+   return  copyPlanTensor(tensors, this, "biases", this->biases) &&
+            copyPlanTensor(tensors, this, "scales", this->scales) &&
+            copyPlanTensor(tensors, this, "rollMean", this->rollMean) &&
+            copyPlanTensor(tensors, this, "rollVariance", this->rollVariance) &&
+            copyPlanTensor(tensors, this, "binaryWeights", this->binaryWeights) &&
+            copyPlanTensor(tensors, this, "meanArr", this->meanArr) &&
+            copyPlanTensor(tensors, this, "alignBitWeights", this->alignBitWeights) &&
+            copyPlanTensor(tensors, this, "bitTapSums", this->bitTapSums) &&
+            copyPlanTensor(tensors, this, "int8Scales", this->int8Scales) &&
+            copyPlanTensor(tensors, this, "int8Sums", this->int8Sums) &&
+            adoptPlanTensor(tensors, this, "packed", mapped, this->packedWeights) &&
+            adoptPlanTensor(tensors, this, "winograd", mapped, this->winogradWeights) &&
+            adoptPlanTensor(tensors, this, "nchwc", mapped, this->nchwcWeights) &&
+            adoptPlanTensor(tensors, this, "half", mapped, this->halfWeights) &&
+            adoptPlanTensor(tensors, this, "int8", mapped, this->int8Weights);
 }
 
-void ConvolutionalLayer::loadScales(float * const &weights, const int &len)
+void ConvolutionalLayer::loadScales(const float *const &weights, const int &len)
 {
     if(len != this->nScales)
     {
@@ -643,7 +1297,7 @@ void ConvolutionalLayer::loadScales(float * const &weights, const int &len)
     Blas::cpuCopy(len, weights, 1, this->scales,1);
 }
 
-void ConvolutionalLayer::loadBias(float * const &bias, const int &len)
+void ConvolutionalLayer::loadBias(const float *const &bias, const int &len)
 {
     if(len != this->nBiases)
     {
@@ -652,7 +1306,7 @@ void ConvolutionalLayer::loadBias(float * const &bias, const int &len)
     Blas::cpuCopy(len, bias, 1, this->biases,1);
 }
 
-void ConvolutionalLayer::loadWeights(float * const &weights, const int &len)
+void ConvolutionalLayer::loadWeights(const float *const &weights, const int &len)
 {
     if(len != this->nWeights)
     {
@@ -661,7 +1315,17 @@ void ConvolutionalLayer::loadWeights(float * const &weights, const int &len)
     Blas::cpuCopy(len, weights, 1, this->weights,1);
 }
 
-void ConvolutionalLayer::loadRollMean(float * const &rollMean, const int &len)
+void ConvolutionalLayer::releaseWeights()
+{
+    if(!this->mappedWeights)
+    {
+        releaseArr(this->weights);
+    }
+    this->weights           =  nullptr;
+    this->mappedWeights     =  0;
+}
+
+void ConvolutionalLayer::loadRollMean(const float *const &rollMean, const int &len)
 {
     if(len != this->nRollMean)
     {
@@ -670,7 +1334,7 @@ void ConvolutionalLayer::loadRollMean(float * const &rollMean, const int &len)
     Blas::cpuCopy(len, rollMean, 1, this->rollMean,1);
 }
 
-void ConvolutionalLayer::loadRollVariance(float * const &rollVariance, const int &len)
+void ConvolutionalLayer::loadRollVariance(const float *const &rollVariance, const int &len)
 {
     if(len != this->nRollVariance)
     {
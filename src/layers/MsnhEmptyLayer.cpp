@@ -37,6 +37,6 @@ EmptyLayer::~EmptyLayer()
 
 void EmptyLayer::forward(NetworkState &netState)
 {
-    Blas::cpuCopy(netState.inputNum, netState.input, 1, this->output, 1);
+    Blas::cpuCopy(netState.inputNum*this->batch, netState.input, 1, this->output, 1);
 }
 }
@@ -155,53 +155,52 @@ void LocalAvgPoolLayer::forward(NetworkState &netState)
    for(int b=0; b<this->batch; ++b)                
 
    {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-        for(int k=0; k<mChannel; ++k)               
-
-       {
-            for(int i=0; i<mHeight; ++i)            
-
-           {
-                for(int j=0; j<mWidth; ++j)         
+        ThreadPool::parallelFor(0, mChannel, ThreadPool::grainFor(mHeight*mWidth*this->kSizeX*this->kSizeY), [&](const int &kBegin, const int &kEnd)
+        {
+            for (int k = kBegin; k < kEnd; ++k)
+            {
+                for(int i=0; i<mHeight; ++i)            
 
                {
+                    for(int j=0; j<mWidth; ++j)         
+
+                   {
 
-                   int outIndex = j + mWidth*(i + mHeight*(k + channel*b));
+                       int outIndex = j + mWidth*(i + mHeight*(k + channel*b));
 
-                   float avg    = 0;
+                       float avg    = 0;
 
-                   int counter  = 0;
+                       int counter  = 0;
 
-                   for(int n=0; n<this->kSizeY; ++n)
-                    {
-                        for(int m=0; m<this->kSizeX; ++m)
+                       for(int n=0; n<this->kSizeY; ++n)
                         {
+                            for(int m=0; m<this->kSizeX; ++m)
+                            {
 
-                           int curHeight =  heightOffset + i*this->strideY + n;
+                               int curHeight =  heightOffset + i*this->strideY + n;
 
-                           int curWidth  =  widthOffset  + j*this->strideX + m;
+                               int curWidth  =  widthOffset  + j*this->strideX + m;
 
-                           int index     =  curWidth + this->width*(curHeight + this->height*(k + b*this->channel));
+                               int index     =  curWidth + this->width*(curHeight + this->height*(k + b*this->channel));
 
-                           bool valid    =  (curHeight >=0 && curHeight < this->height &&
-                                              curWidth  >=0 && curWidth  < this->width);
+                               bool valid    =  (curHeight >=0 && curHeight < this->height &&
+                                                  curWidth  >=0 && curWidth  < this->width);
 
-                           if(valid)
-                            {
-                                counter++;
-                                avg += netState.input[index];
+                               if(valid)
+                                {
+                                    counter++;
+                                    avg += netState.input[index];
+                                }
                             }
                         }
-                    }
 
-                   this->output[outIndex] = avg / counter;  
+                       this->output[outIndex] = avg / counter;  
 
-               }
+                   }
 
-           }
-        }
+               }
+            }
+        });
     }
 
    auto so = std::chrono::system_clock::now();
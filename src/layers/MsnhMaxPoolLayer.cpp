@@ -164,49 +164,52 @@ void MaxPoolLayer::forward(NetworkState &netState)
         for(int b=0; b<this->batch; ++b)                    
 
        {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif                                                      
-
-           for(int i=0; i<this->height; i++)               
+            ThreadPool::parallelFor(0, this->height, ThreadPool::grainFor(this->width*this->channel), [&](const int &iBegin, const int &iEnd)
+            {
+                for (int i = iBegin; i < iEnd; ++i)
+                {
+                    for(int j=0; j<this->width; ++j)            
 
-           {
-                for(int j=0; j<this->width; ++j)            
+                   {
+                        for(int g=0; g<this->outChannel; ++g)   
 
-               {
-                    for(int g=0; j<this->outChannel; ++g)   
+                       {
+                            int outIndex = j + this->width*(i + this->height*(g + this->outChannel*b));
+                            float max    = -FLT_MAX;
+                            int maxIndex = -1;
 
-                   {
-                        int outIndex = j + this->width*(i + this->height*(g + this->outChannel*b));
-                        float max    = -FLT_MAX;
-                        int maxIndex = -1;
+                           for(int k=g; k<this->channel; k+=this->outChannel)
+                            {
+                                int inIndex = j + this->width*(i + this->height*(k + this->channel*b));
+                                float val   = netState.input[inIndex];
 
-                       for(int k=g; k<this->channel; k+=this->outChannel)
-                        {
-                            int inIndex = j + this->width*(i + this->height*(k + this->channel*b));
-                            float val   = netState.input[inIndex];
+                               maxIndex    = (val > max)? inIndex:maxIndex;
+                                max         = (val > max)? val:max;
+                            }
 
-                           maxIndex    = (val > max)? inIndex:maxIndex;
-                            max         = (val > max)? val:max;
+                           this->output[outIndex] = max;
                         }
 
-                       this->output[outIndex] = max;
-                    }
+                   }
 
                }
-
-           }
+            });
         }
         return;
     }
-#ifdef USE_X86
-    if((this->strideX == this->strideY) && supportAvx )
+
+   if(this->nchwc)
     {
-        forwardAvx(netState.input,this->output,this->kSizeX, this->kSizeY, this->width,this->height,this->outWidth,
-                   this->outHeight,this->channel,this->paddingX, this->paddingY,this->stride,this->batch);
+        NCHWc::maxPool(netState.input, this->batch, this->channel, this->height, this->width, this->kSizeX, this->kSizeY,
+                       this->strideX, this->strideY, -(this->paddingX + 1)/2, -(this->paddingY + 1)/2,
+                       this->outHeight, this->outWidth, this->output);
+    }
+    else if(this->strideX == this->strideY)
+    {
+        forwardSimd(netState.input,this->output,this->kSizeX, this->kSizeY, this->width,this->height,this->outWidth,
+                    this->outHeight,this->channel,this->paddingX, this->paddingY,this->stride,this->batch);
     }
     else
-#endif
     {
 
        int widthOffset  =     -(this->paddingX + 1)/2;
@@ -220,50 +223,49 @@ void MaxPoolLayer::forward(NetworkState &netState)
        for(int b=0; b<this->batch; ++b)                
 
        {
-            for(int k=0; k<mChannel; ++k)               
-
-           {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-                for(int i=0; i<mHeight; ++i)            
-
-               {
-                    for(int j=0; j<mWidth; ++j)         
+            ThreadPool::parallelFor(0, mChannel, ThreadPool::grainFor(mHeight*mWidth*this->kSizeX*this->kSizeY), [&](const int &kBegin, const int &kEnd)
+            {
+                for (int k = kBegin; k < kEnd; ++k)
+                {
+                    for(int i=0; i<mHeight; ++i)            
 
                    {
+                        for(int j=0; j<mWidth; ++j)         
 
-                       int outIndex = j + mWidth*(i + mHeight*(k + channel*b));
-                        float max    = -FLT_MAX;
-                        int maxIndex = -1;
+                       {
+
+                           int outIndex = j + mWidth*(i + mHeight*(k + channel*b));
+                            float max    = -FLT_MAX;
+                            int maxIndex = -1;
 
-                       for(int n=0; n<this->kSizeY; ++n)
-                        {
-                            for(int m=0; m<this->kSizeX; ++m)
+                           for(int n=0; n<this->kSizeY; ++n)
                             {
+                                for(int m=0; m<this->kSizeX; ++m)
+                                {
 
-                               int curHeight =  heightOffset + i*this->strideY + n;
+                                   int curHeight =  heightOffset + i*this->strideY + n;
 
-                               int curWidth  =  widthOffset  + j*this->strideX + m;
+                                   int curWidth  =  widthOffset  + j*this->strideX + m;
 
-                               int index     =  curWidth + this->width*(curHeight + this->height*(k + b*this->channel));
+                                   int index     =  curWidth + this->width*(curHeight + this->height*(k + b*this->channel));
 
-                               bool valid    =  (curHeight >=0 && curHeight < this->height &&
-                                                  curWidth  >=0 && curWidth  < this->width);
+                                   bool valid    =  (curHeight >=0 && curHeight < this->height &&
+                                                      curWidth  >=0 && curWidth  < this->width);
 
-                               float value   =  (valid)? netState.input[index] : -FLT_MAX;
+                                   float value   =  (valid)? netState.input[index] : -FLT_MAX;
 
-                               maxIndex      =  (value > max) ? index : maxIndex;
+                                   maxIndex      =  (value > max) ? index : maxIndex;
 
-                               max           =  (value > max) ? value : max;
+                                   max           =  (value > max) ? value : max;
+                                }
                             }
-                        }
 
-                       this->output[outIndex] = max;
+                           this->output[outIndex] = max;
 
-                   }
+                       }
+                    }
                 }
-            }
+            });
         }
     }
 
@@ -272,126 +274,26 @@ void MaxPoolLayer::forward(NetworkState &netState)
 
 }
 
-#ifdef USE_X86
-void MaxPoolLayer::forwardAvx(float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY,
-                              const int &width, const int &height, const int &outWidth, const int &outHeight,
-                              const int &channel,const int &paddingX,const int &paddingY,const int &stride, const int &batch)
+void MaxPoolLayer::forwardSimd(float *const &src, float *const &dst, const int &kSizeX, const int &kSizeY,
+                               const int &width, const int &height, const int &outWidth, const int &outHeight,
+                               const int &channel,const int &paddingX,const int &paddingY,const int &stride, const int &batch)
 {
-
-   int widthOffset  =     -(paddingX + 1)/2;
-    int heightOffset =     -(paddingY + 1)/2;
+    const KernelTable &kernels = Kernels::get();
 
    for(int b=0; b<batch; ++b)
     {
-#pragma omp parallel for num_threads(OMP_THREAD)
-        for(int k=0; k<channel; ++k)
+        ThreadPool::parallelFor(0, channel, ThreadPool::grainFor(outHeight*outWidth*kSizeX*kSizeY), [&](const int &kBegin, const int &kEnd)
         {
-            for(int i=0; i<outHeight; ++i)
-            {
-                int j = 0;
-                if(stride == 1)  
-
-               {
-                    for(j=0; j<outWidth - 8 -(kSizeX - 1); j+=8)  
-
-                   {
-                        int outIndex = j + outWidth*(i + outHeight*(k + channel*b));
-                        __m256 max256    = _mm256_set1_ps(-FLT_MAX);
-                        for(int n=0; n<kSizeY; ++n)  
-
-                       {
-                            for(int m=0; m<kSizeX; ++m) 
-
-                           {
-                                int curHeight = heightOffset + i*stride + n;
-                                int curWidth  = widthOffset  + j*stride + m;
-                                int index     = curWidth +width*(curHeight + height*(k + b*channel));
-
-                               int valid     = (curHeight >=0 && curHeight < height && curWidth>=0 && curWidth<width );
-
-                               if(!valid) continue;
-
-                               __m256 src256 = _mm256_loadu_ps(&src[index]);
-
-                               max256        = _mm256_max_ps(src256,max256);
-                            }
-                        }
-
-                       _mm256_storeu_ps(&dst[outIndex], max256);
-
-                   }
-                }
-                else if(kSizeX == 2 && kSizeX == 2 && stride == 2)  
-
-               {
-                    for(j=0; j<outWidth-4; j+=4)
-                    {
-                        int outIndex = j + outWidth * (i + outHeight*(k + channel*b));
-
-                       __m128 max128 = _mm_set1_ps(-FLT_MAX);
-
-                       for(int n=0; n<kSizeX; ++n)
-                        {
-                            int m = 0;
-                            {
-                                int curHeight  = heightOffset + i * stride + n;
-                                int curWidth   = widthOffset  + j * stride + m;
-
-                               int index      = curWidth + width*(curHeight + height*(k + b*channel));
-                                int valid      = (curHeight >=0 && curHeight < height && curWidth>=0 && curWidth<width );
-
-                               if (!valid) continue;
-
-                               __m256 src256   = _mm256_loadu_ps(&src[index]);
-
-                               __m256 src256_2 = _mm256_permute_ps(src256, 0b10110001);
-                                __m256 max256   = _mm256_max_ps(src256, src256_2);
-
-                               __m128 src128_0 = _mm256_extractf128_ps(max256, 0);
-                                __m128 src128_1 = _mm256_extractf128_ps(max256, 1);
-
-                               __m128 src128   = _mm_shuffle_ps(src128_0, src128_1, 0b10001000);
-
-                               max128 = _mm_max_ps(src128, max128);
-
-                           }
-                        }
-
-                       _mm_storeu_ps(&dst[outIndex], max128);
-                    }
-                }
-
-               for(; j<outWidth; ++j)       
-
-               {
-                    int outIndex  =  j + outWidth * (i + outHeight * (k + channel * b));
-                    float max     =  -FLT_MAX;
-                    int maxIndex  =  -1;
-
-                   for(int n=0; n<kSizeY; ++n)
-                    {
-                        for(int m=0; m<kSizeX; ++m)
-                        {
-                            int curHeight    = heightOffset + i*stride + n;
-                            int curWidth     = widthOffset  + j*stride + m;
-
-                           int index        = curWidth + width*(curHeight + height*(k + b*channel));
-                            int valid        = (curHeight >=0 && curHeight < height && curWidth>=0 && curWidth<width );
-
-                           float value      = (valid !=0)?src[index]: -FLT_MAX;
-
-                           maxIndex         = (value > max)?index:maxIndex;
-                            max              = (value > max)?value:max;
-                        }
-                    }
-
-                   dst[outIndex]  = max;
-                }
-            }
-        }
+            kernels.maxPool(src + (b*channel + kBegin)*width*height, dst + (b*channel + kBegin)*outWidth*outHeight, kSizeX, kSizeY,
+                            width, height, outWidth, outHeight, paddingX, paddingY, stride, kEnd - kBegin);
+        });
     }
 }
-#endif
+
+bool MaxPoolLayer::supportNCHWc()
+{
+    return !this->maxPoolDepth && this->channel % NCHWC_PACK == 0;
+}
 
 MaxPoolLayer::~MaxPoolLayer()
 {
@@ -48,38 +48,38 @@ void PaddingLayer::forward(NetworkState &netState)
 {
     for (int i = 0; i < this->batch; ++i)
     {
-        for (int j = 0; j < this->outChannel; ++j)
+        ThreadPool::parallelFor(0, this->outChannel, ThreadPool::grainFor(this->outHeight*this->outWidth), [&](const int &jBegin, const int &jEnd)
         {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-            for (int m = 0; m < this->outHeight; ++m)
+            for (int j = jBegin; j < jEnd; ++j)
             {
-                for (int n = 0; n < this->outWidth; ++n)
+                for (int m = 0; m < this->outHeight; ++m)
                 {
-                    float val = 0;
-
-                   if(m < this->top || (m >= (this->height + this->top)))
+                    for (int n = 0; n < this->outWidth; ++n)
                     {
-                        val     =   this->paddingVal;
-                    }
-                    else
-                    {
-                        if(n < this->left || (n >= (this->width + this->left)))
+                        float val = 0;
+
+                       if(m < this->top || (m >= (this->height + this->top)))
                         {
                             val     =   this->paddingVal;
                         }
                         else
                         {
-                            val     =   netState.input[ i*this->channel*this->height*this->width + j*this->height*this->width + (m-this->top)*this->width + (n - this->left)];
+                            if(n < this->left || (n >= (this->width + this->left)))
+                            {
+                                val     =   this->paddingVal;
+                            }
+                            else
+                            {
+                                val     =   netState.input[ i*this->channel*this->height*this->width + j*this->height*this->width + (m-this->top)*this->width + (n - this->left)];
+                            }
                         }
-                    }
 
-                   this->output[i*this->outChannel*this->outHeight*this->outHeight + j*this->outHeight*this->outWidth + m*this->outWidth + n] = val;
+                       this->output[i*this->outChannel*this->outHeight*this->outHeight + j*this->outHeight*this->outWidth + m*this->outWidth + n] = val;
 
-               }
+                   }
+                }
             }
-        }
+        });
     }
 
 }
@@ -34,7 +34,7 @@ Res2BlockLayer::Res2BlockLayer(const int &batch, NetBuildParams &params, std::ve
                                                                    convParams->kSizeX, convParams->kSizeY, convParams->strideX, convParams->strideY, convParams->dilationX,
                                                                    convParams->dilationY,convParams->paddingX, convParams->paddingY,
                                                                    convParams->activation, convParams->actParams, convParams->batchNorm, convParams->useBias,
-                                                                   0,0,0,0,convParams->antialiasing, nullptr, 0,0);
+                                                                   convParams->binary,convParams->xnor,0,0,convParams->antialiasing, nullptr, 0,0, params.options, convParams->implicitGemm);
 
            if(i == 0)
             {
@@ -45,7 +45,7 @@ Res2BlockLayer::Res2BlockLayer(const int &batch, NetBuildParams &params, std::ve
         {
             ConnectParams *connectParams=   reinterpret_cast<ConnectParams*>(baseParams[i]);
             layer                       =   new ConnectedLayer(params.batch, 1, params.inputNums, connectParams->output, connectParams->activation,
-                                                               connectParams->actParams, connectParams->batchNorm);
+                                                               connectParams->actParams, connectParams->batchNorm, params.options);
             if(i == 0)
             {
                 this->inputNum = layer->inputNum;
@@ -108,6 +108,7 @@ Res2BlockLayer::Res2BlockLayer(const int &batch, NetBuildParams &params, std::ve
         }
 
        this->numWeights    =   this->numWeights + layer->numWeights;
+        this->bFlops        =   this->bFlops + layer->bFlops;
         this->layerDetail   =   this->layerDetail.append(layer->layerDetail);
 
        baseLayers.push_back(layer);
@@ -127,14 +128,14 @@ Res2BlockLayer::Res2BlockLayer(const int &batch, NetBuildParams &params, std::ve
                                                                    convParams->filters,convParams->groups,convParams->kSizeX, convParams->kSizeY, convParams->strideX, convParams->strideY,
                                                                    convParams->dilationX,convParams->dilationY,convParams->paddingX, convParams->paddingY, convParams->activation,
                                                                    convParams->actParams, convParams->batchNorm, convParams->useBias,
-                                                                   0,0,0,0,convParams->antialiasing, nullptr, 0,0);
+                                                                   convParams->binary,convParams->xnor,0,0,convParams->antialiasing, nullptr, 0,0, branchBuildParams.options, convParams->implicitGemm);
 
        }
         else if(branchParams[i]->type == LayerType::CONNECTED)
         {
             ConnectParams *connectParams=   reinterpret_cast<ConnectParams*>(branchParams[i]);
             layer                       =   new ConnectedLayer(branchBuildParams.batch, 1, branchBuildParams.inputNums, connectParams->output, connectParams->activation, connectParams->actParams,
-                                                               connectParams->batchNorm);
+                                                               connectParams->batchNorm, branchBuildParams.options);
         }
         else if(branchParams[i]->type == LayerType::MAXPOOL)
         {
@@ -177,6 +178,7 @@ Res2BlockLayer::Res2BlockLayer(const int &batch, NetBuildParams &params, std::ve
         }
 
        this->numWeights    =   this->numWeights + layer->numWeights;
+        this->bFlops        =   this->bFlops + layer->bFlops;
         this->layerDetail   =   this->layerDetail.append(layer->layerDetail);
 
        branchLayers.push_back(layer);
@@ -195,6 +197,17 @@ Res2BlockLayer::Res2BlockLayer(const int &batch, NetBuildParams &params, std::ve
     this->outChannel        =   params.channels;
     this->outputNum         =   params.inputNums;
 
+   branchRefs.push_back(&baseLayers);
+    branchRefs.push_back(&branchLayers);
+
+   /* the base and the branch may run at the same time, each on its own workspace slice */
+    this->branchWorkSpace       =   (this->workSpaceSize + sizeof(float) - 1) / sizeof(float);
+    this->concurrentBranches    =   BaseLayer::useConcurrentBranches;
+    if(this->concurrentBranches)
+    {
+        this->workSpaceSize     =   this->branchWorkSpace * sizeof(float) * branchRefs.size();
+    }
+
    if(!BaseLayer::isPreviewMode)
     {
         this->output            =   new float[static_cast<size_t>(outputNum * this->batch)]();
@@ -203,26 +216,22 @@ Res2BlockLayer::Res2BlockLayer(const int &batch, NetBuildParams &params, std::ve
    this->layerDetail.append("========================================================================\n");
 }
 
-void Res2BlockLayer::loadAllWeigths(std::vector<float> &weights)
+void Res2BlockLayer::loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped)
 {
 
-   if(weights.size() != this->numWeights)
+   if(len != this->numWeights)
     {
-        throw Exception(1,"Res2Block weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(weights.size()), __FILE__, __LINE__);
+        throw Exception(1,"Res2Block weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(len), __FILE__, __LINE__);
     }
 
    size_t ptr = 0;
-    std::vector<float>::const_iterator first = weights.begin();
-
    for (size_t i = 0; i < baseLayers.size(); ++i)
     {
         if(baseLayers[i]->type == LayerType::CONVOLUTIONAL || baseLayers[i]->type == LayerType::CONNECTED || baseLayers[i]->type == LayerType::BATCHNORM)
         {
             size_t nums = baseLayers[i]->numWeights;
 
-           std::vector<float> weights(first + static_cast<long long>(ptr), first + static_cast<long long>(ptr + nums));
-
-           baseLayers[i]->loadAllWeigths(weights);
+           baseLayers[i]->loadAllWeigths(weights + ptr, nums, mapped);
 
            ptr         =   ptr + nums;
         }
@@ -234,9 +243,7 @@ void Res2BlockLayer::loadAllWeigths(std::vector<float> &weights)
         {
             size_t nums = branchLayers[i]->numWeights;
 
-           std::vector<float> weights(first + static_cast<long long>(ptr), first + static_cast<long long>(ptr + nums));
-
-           branchLayers[i]->loadAllWeigths(weights);
+           branchLayers[i]->loadAllWeigths(weights + ptr, nums, mapped);
 
            ptr         =   ptr + nums;
         }
@@ -246,45 +253,25 @@ void Res2BlockLayer::loadAllWeigths(std::vector<float> &weights)
 void Res2BlockLayer::forward(NetworkState &netState)
 {
 
-   /* TODO: batch */
-    std::vector<float> inputX{netState.input, netState.input + netState.inputNum};
-
-   for (size_t i = 0; i < baseLayers.size(); ++i)
-    {
-        baseLayers[i]->forward(netState);
-
-       netState.input     =   baseLayers[i]->output;
-        netState.inputNum  =   baseLayers[i]->outputNum;
-    }
-
-   netState.input         =    inputX.data();
-    netState.inputNum      =    static_cast<int>(inputX.size());
-
-   for (size_t i = 0; i < branchLayers.size(); ++i)
-    {
-        branchLayers[i]->forward(netState);
-
-       netState.input     =   branchLayers[i]->output;
-        netState.inputNum  =   branchLayers[i]->outputNum;
-
-   }
+   /* the block input stays untouched until the block returns, base and branch read it in place */
+    forwardBranches(branchRefs.data(), branchRefs.size(), netState, this->concurrentBranches, this->branchWorkSpace);
 
-   Blas::cpuAxpy(netState.inputNum, 1.f, baseLayers[baseLayers.size()-1]->output, 1, branchLayers[branchLayers.size()-1]->output, 1);
-    Blas::cpuCopy(netState.inputNum, branchLayers[branchLayers.size()-1]->output, 1, this->output, 1);
+   Blas::cpuAxpy(this->outputNum*this->batch, 1.f, baseLayers[baseLayers.size()-1]->output, 1, branchLayers[branchLayers.size()-1]->output, 1);
+    Blas::cpuCopy(this->outputNum*this->batch, branchLayers[branchLayers.size()-1]->output, 1, this->output, 1);
 
    if(this->activation == ActivationType::NORM_CHAN)
     {
-        Activations::activateArrayNormCh(this->output, this->outputNum, this->batch, this->outChannel,
+        Activations::activateArrayNormCh(this->output, this->outputNum*this->batch, this->batch, this->outChannel,
                                          this->outWidth*this->outHeight, this->output);
     }
     else if(this->activation == ActivationType::NORM_CHAN_SOFTMAX)
     {
-        Activations::activateArrayNormChSoftMax(this->output, this->outputNum, this->batch, this->outChannel,
+        Activations::activateArrayNormChSoftMax(this->output, this->outputNum*this->batch, this->batch, this->outChannel,
                                                 this->outWidth*this->outHeight, this->output,0);
     }
     else if(this->activation == ActivationType::NORM_CHAN_SOFTMAX_MAXVAL)
     {
-        Activations::activateArrayNormChSoftMax(this->output, this->outputNum, this->batch, this->outChannel,
+        Activations::activateArrayNormChSoftMax(this->output, this->outputNum*this->batch, this->batch, this->outChannel,
                                                 this->outWidth*this->outHeight, this->output,1);
     }
     else if(this->activation == ActivationType::NONE)
@@ -295,11 +282,11 @@ void Res2BlockLayer::forward(NetworkState &netState)
     {
         if(actParams.size() > 0)
         {
-            Activations::activateArray(this->output, this->outputNum, this->activation, actParams[0]);
+            Activations::activateArray(this->output, this->outputNum*this->batch, this->activation, actParams[0]);
         }
         else
         {
-            Activations::activateArray(this->output, this->outputNum, this->activation);
+            Activations::activateArray(this->output, this->outputNum*this->batch, this->activation);
         }
     }
 
@@ -31,7 +31,7 @@ ResBlockLayer::ResBlockLayer(const int &batch, NetBuildParams &params, std::vect
                                                                    convParams->kSizeX, convParams->kSizeY, convParams->strideX, convParams->strideY, convParams->dilationX,
                                                                    convParams->dilationY,convParams->paddingX, convParams->paddingY,
                                                                    convParams->activation, convParams->actParams, convParams->batchNorm, convParams->useBias,
-                                                                   0,0,0,0,convParams->antialiasing, nullptr, 0,0);
+                                                                   convParams->binary,convParams->xnor,0,0,convParams->antialiasing, nullptr, 0,0, params.options, convParams->implicitGemm);
 
            if(i == 0)
             {
@@ -42,7 +42,7 @@ ResBlockLayer::ResBlockLayer(const int &batch, NetBuildParams &params, std::vect
         {
             ConnectParams *connectParams=   reinterpret_cast<ConnectParams*>(baseParams[i]);
             layer                       =   new ConnectedLayer(params.batch, 1, params.inputNums, connectParams->output, connectParams->activation,
-                                                               connectParams->actParams, connectParams->batchNorm);
+                                                               connectParams->actParams, connectParams->batchNorm, params.options);
             if(i == 0)
             {
                 this->inputNum = layer->inputNum;
@@ -105,6 +105,7 @@ ResBlockLayer::ResBlockLayer(const int &batch, NetBuildParams &params, std::vect
         }
 
        this->numWeights    =   this->numWeights + layer->numWeights;
+        this->bFlops        =   this->bFlops + layer->bFlops;
         this->layerDetail   =   this->layerDetail.append(layer->layerDetail);
 
        baseLayers.push_back(layer);
@@ -122,26 +123,22 @@ ResBlockLayer::ResBlockLayer(const int &batch, NetBuildParams &params, std::vect
     this->layerDetail.append("========================================================================\n");
 }
 
-void ResBlockLayer::loadAllWeigths(std::vector<float> &weights)
+void ResBlockLayer::loadAllWeigths(const float *const &weights, const size_t &len, const bool &mapped)
 {
 
-   if(weights.size() != this->numWeights)
+   if(len != this->numWeights)
     {
-        throw Exception(1,"ResBlock weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(weights.size()), __FILE__, __LINE__);
+        throw Exception(1,"ResBlock weights load err. needed : " + std::to_string(this->numWeights) + " given : " +  std::to_string(len), __FILE__, __LINE__);
     }
 
    size_t ptr = 0;
-    std::vector<float>::const_iterator first = weights.begin();
-
    for (size_t i = 0; i < baseLayers.size(); ++i)
     {
         if(baseLayers[i]->type == LayerType::CONVOLUTIONAL || baseLayers[i]->type == LayerType::CONNECTED || baseLayers[i]->type == LayerType::BATCHNORM)
         {
             size_t nums = baseLayers[i]->numWeights;
 
-           std::vector<float> weights(first + static_cast<long long>(ptr), first + static_cast<long long>(ptr + nums));
-
-           baseLayers[i]->loadAllWeigths(weights);
+           baseLayers[i]->loadAllWeigths(weights + ptr, nums, mapped);
 
            ptr         =   ptr + nums;
         }
@@ -150,8 +147,14 @@ void ResBlockLayer::loadAllWeigths(std::vector<float> &weights)
 
 void ResBlockLayer::forward(NetworkState &netState)
 {
-    /* TODO: batch */
-    std::vector<float> inputX{netState.input, netState.input + netState.inputNum};
+    /* the block input stays untouched until the block returns, read it in place */
+    float *inputX           =   netState.input;
+    const int inputXNum     =   netState.inputNum;
+
+   if(this->residualFused)
+    {
+        reinterpret_cast<ConvolutionalLayer*>(baseLayers[baseLayers.size()-1])->residualInput = inputX;
+    }
 
    for (size_t i = 0; i < baseLayers.size(); ++i)
     {
@@ -161,22 +164,29 @@ void ResBlockLayer::forward(NetworkState &netState)
         netState.inputNum  =   baseLayers[i]->outputNum;
     }
 
-   Blas::cpuAxpy(netState.inputNum, 1.f, inputX.data(), 1,netState.input, 1);
-    Blas::cpuCopy(netState.inputNum, netState.input, 1, this->output, 1);
+   if(!this->residualFused)
+    {
+        Blas::cpuAxpy(inputXNum*this->batch, 1.f, inputX, 1,netState.input, 1);
+        Blas::cpuCopy(netState.inputNum*this->batch, netState.input, 1, this->output, 1);
+    }
 
-   if(this->activation == ActivationType::NORM_CHAN)
+   if(this->residualFused)
     {
-        Activations::activateArrayNormCh(this->output, this->outputNum, this->batch, this->outChannel,
+        /* the last conv already wrote act(conv + input) into this->output */
+    }
+    else if(this->activation == ActivationType::NORM_CHAN)
+    {
+        Activations::activateArrayNormCh(this->output, this->outputNum*this->batch, this->batch, this->outChannel,
                                          this->outWidth*this->outHeight, this->output);
     }
     else if(this->activation == ActivationType::NORM_CHAN_SOFTMAX)
     {
-        Activations::activateArrayNormChSoftMax(this->output, this->outputNum, this->batch, this->outChannel,
+        Activations::activateArrayNormChSoftMax(this->output, this->outputNum*this->batch, this->batch, this->outChannel,
                                                 this->outWidth*this->outHeight, this->output,0);
     }
     else if(this->activation == ActivationType::NORM_CHAN_SOFTMAX_MAXVAL)
     {
-        Activations::activateArrayNormChSoftMax(this->output, this->outputNum, this->batch, this->outChannel,
+        Activations::activateArrayNormChSoftMax(this->output, this->outputNum*this->batch, this->batch, this->outChannel,
                                                 this->outWidth*this->outHeight, this->output,1);
     }
     else if(this->activation == ActivationType::NONE)
@@ -187,11 +197,11 @@ void ResBlockLayer::forward(NetworkState &netState)
     {
         if(actParams.size() > 0)
         {
-            Activations::activateArray(this->output, this->outputNum, this->activation, actParams[0]);
+            Activations::activateArray(this->output, this->outputNum*this->batch, this->activation, actParams[0]);
         }
         else
         {
-            Activations::activateArray(this->output, this->outputNum, this->activation);
+            Activations::activateArray(this->output, this->outputNum*this->batch, this->activation);
         }
     }
 
@@ -204,6 +214,30 @@ void ResBlockLayer::forward(NetworkState &netState)
 
 }
 
+void ResBlockLayer::fuseResidual()
+{
+    BaseLayer *last = baseLayers[baseLayers.size()-1];
+
+   if(BaseLayer::isPreviewMode || this->output == nullptr || last->type != LayerType::CONVOLUTIONAL ||
+            last->outputNum != this->outputNum || !Gemm::isEpilogueActivation(this->activation))
+    {
+        return;
+    }
+
+   ConvolutionalLayer *conv    =   reinterpret_cast<ConvolutionalLayer*>(last);
+
+   if(conv->ownOutput)
+    {
+        releaseArr(conv->output);
+    }
+
+   conv->output            =   this->output;
+    conv->ownOutput         =   0;
+    conv->postActivation    =   this->activation;
+    conv->postActParam      =   (actParams.size() > 0) ? actParams[0] : 0.1f;
+    this->residualFused     =   1;
+}
+
 ResBlockLayer::~ResBlockLayer()
 {
     for (size_t i = 0; i < baseLayers.size(); ++i)
@@ -18,6 +18,7 @@ RouteLayer::RouteLayer(const int &batch, std::vector<int> &inputLayerIndexes,
 
    this->inputLayerIndexes =   inputLayerIndexes;
     this->inputLayerOutputs =   inputLayerOutputs;
+    this->inputInPlace      =   std::vector<int>(inputLayerIndexes.size(), 0);
 
    for (size_t i = 0; i < inputLayerIndexes.size(); ++i)
     {
@@ -55,10 +56,15 @@ void RouteLayer::forward(NetworkState &netState)
         float *mInput   =   netState.net->layers[static_cast<size_t>(index)]->output;
         int inputLayerOutputs   =   this->inputLayerOutputs[i];
         int partInSize  =   inputLayerOutputs / this->groups;
-        for (int j = 0; j < this->batch; ++j)
+
+       /* input layer already wrote into its slice of this->output */
+        if(!this->inputInPlace[i])
         {
-            Blas::cpuCopy(partInSize, mInput + j*inputLayerOutputs + partInSize*this->groupIndex, 1,
-                          this->output + offset + j*this->outputNum,1);
+            for (int j = 0; j < this->batch; ++j)
+            {
+                Blas::cpuCopy(partInSize, mInput + j*inputLayerOutputs + partInSize*this->groupIndex, 1,
+                              this->output + offset + j*this->outputNum,1);
+            }
         }
 
        offset          = offset + partInSize;
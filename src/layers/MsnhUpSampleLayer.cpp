@@ -65,7 +65,11 @@ void UpSampleLayer::forward(NetworkState &netState)
 
    auto st = std::chrono::system_clock::now();
 
-   if(this->reverse)
+   if(this->nchwc)
+    {
+        NCHWc::upSample(netState.input, this->batch, this->channel, this->height, this->width, this->stride, this->scale, this->output);
+    }
+    else if(this->reverse)
     {
         Blas::cpuUpSample(this->output, this->outWidth, this->outHeight, this->channel, this->batch, this->stride, 0, this->scale, netState.input);
     }
@@ -79,6 +83,11 @@ void UpSampleLayer::forward(NetworkState &netState)
 
 }
 
+bool UpSampleLayer::supportNCHWc()
+{
+    return !this->reverse && this->channel % NCHWC_PACK == 0;
+}
+
 void UpSampleLayer::resize(const int &width, const int &height)
 {
     this->width         =   width;
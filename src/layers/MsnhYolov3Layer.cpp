@@ -45,7 +45,7 @@ void Yolov3Layer::forward(NetworkState &netState)
 {
     auto st = std::chrono::system_clock::now();
 
-   Blas::cpuCopy(netState.inputNum, netState.input, 1, this->output, 1);
+   Blas::cpuCopy(netState.inputNum*this->batch, netState.input, 1, this->output, 1);
 #ifndef USE_GPU
 
    for (int b = 0; b < this->batch; ++b)
@@ -79,40 +79,40 @@ void Yolov3Layer::forward(NetworkState &netState)
 
 void Yolov3Layer::sigmoid(float *val, const int &num)
 {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int i = 0; i < num; ++i)
+    ThreadPool::parallelFor(0, num, ThreadPool::grainFor(16), [&](const int &iBegin, const int &iEnd)
     {
-        val[i] = 1.f/(1.f+expf(-val[i]));
-    }
+        for (int i = iBegin; i < iEnd; ++i)
+        {
+            val[i] = 1.f/(1.f+expf(-val[i]));
+        }
+    });
 }
 
 void Yolov3Layer::exSigmoid(float *val, const int &width, const int&height, const float &ratios, const bool &addGridW)
 {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int i = 0; i < width*height; ++i)
+    ThreadPool::parallelFor(0, width*height, ThreadPool::grainFor(16), [&](const int &iBegin, const int &iEnd)
     {
-        if(addGridW)
+        for (int i = iBegin; i < iEnd; ++i)
         {
-            val[i] = (1.f/(1.f+expf(-val[i])) + i%width)*ratios;
+            if(addGridW)
+            {
+                val[i] = (1.f/(1.f+expf(-val[i])) + i%width)*ratios;
+            }
+            else
+            {
+                val[i] = (1.f/(1.f+expf(-val[i])) + i/width)*ratios;        }
         }
-        else
-        {
-            val[i] = (1.f/(1.f+expf(-val[i])) + i/width)*ratios;        }
-    }
+    });
 }
 
 void Yolov3Layer::aExpT(float *val, const int &num, const float &a)
 {
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int i = 0; i < num; ++i)
+    ThreadPool::parallelFor(0, num, ThreadPool::grainFor(16), [&](const int &iBegin, const int &iEnd)
     {
-        val[i] = a*expf(val[i]);
-    }
+        for (int i = iBegin; i < iEnd; ++i)
+        {
+            val[i] = a*expf(val[i]);
+        }
+    });
 }
 }
@@ -68,8 +68,8 @@ void Yolov3OutLayer::forward(NetworkState &netState)
         for (size_t i = 0; i < this->yolov3Indexes.size(); ++i)
         {
             size_t index        =   static_cast<size_t>(this->yolov3Indexes[i]);
-            float *mInput       =   netState.net->layers[index]->output;
             int yolov3InputNum  =   netState.net->layers[index]->outputNum;
+            float *mInput       =   netState.net->layers[index]->output + b*yolov3InputNum;
 
            Blas::cpuCopy(yolov3InputNum, mInput, 1, this->allInput+offset,1);
 
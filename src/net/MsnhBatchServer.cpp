@@ -0,0 +1,239 @@
+﻿#include "Msnhnet/net/MsnhBatchServer.h"
+namespace Msnhnet
+{
+BatchServer::BatchServer(NetBuilder *const &builder, const int &maxBatch, const int &maxDelayUs, const int &workers)
+{
+    if(maxBatch < 1 || workers < 1 || maxDelayUs < 0)
+    {
+        throw Exception(1, "Batch server needs maxBatch > 0, workers > 0 and maxDelayUs >= 0 !",__FILE__, __LINE__);
+    }
+
+    if(builder->net->layers.empty())
+    {
+        throw Exception(1, "Build the net and load its weights before starting a batch server !",__FILE__, __LINE__);
+    }
+
+    this->builder       =   builder;
+    this->maxBatch      =   maxBatch;
+    this->maxDelayUs    =   maxDelayUs;
+    this->inputNum      =   builder->net->layers[0]->inputNum;
+    this->yolo          =   builder->net->layers.back()->type == LayerType::YOLOV3_OUT;
+
+    try
+    {
+        for (int w = 0; w < workers; ++w)
+        {
+            std::vector<ExecutionContext*> workerContexts;
+            for (int batch = 1; ; batch *= 2)
+            {
+                workerContexts.push_back(builder->createContext(std::min(batch, maxBatch)));
+                if(batch >= maxBatch)
+                {
+                    break;
+                }
+            }
+            this->contexts.push_back(workerContexts);
+        }
+    }
+    catch(Exception &)
+    {
+        for (size_t w = 0; w < this->contexts.size(); ++w)
+        {
+            for (size_t i = 0; i < this->contexts[w].size(); ++i)
+            {
+                builder->releaseContext(this->contexts[w][i]);
+            }
+        }
+        throw;
+    }
+
+    for (size_t w = 0; w < this->contexts.size(); ++w)
+    {
+        this->workers.emplace_back(&BatchServer::work, this, std::cref(this->contexts[w]));
+    }
+}
+
+BatchServer::~BatchServer()
+{
+    stop();
+
+    for (size_t w = 0; w < this->contexts.size(); ++w)
+    {
+        for (size_t i = 0; i < this->contexts[w].size(); ++i)
+        {
+            this->builder->releaseContext(this->contexts[w][i]);
+        }
+    }
+    this->contexts.clear();
+}
+
+std::future<std::vector<float>> BatchServer::submitClassify(std::vector<float> img)
+{
+    if(this->yolo)
+    {
+        throw Exception(1, "Not a classify net, use submitYolov3 !",__FILE__, __LINE__);
+    }
+
+    Request request;
+    request.img = std::move(img);
+    std::future<std::vector<float>> result = request.classify.get_future();
+    submit(request);
+    return result;
+}
+
+std::future<std::vector<Yolov3Box>> BatchServer::submitYolov3(std::vector<float> img)
+{
+    if(!this->yolo)
+    {
+        throw Exception(1, "Not a yolov3 net, use submitClassify !",__FILE__, __LINE__);
+    }
+
+    Request request;
+    request.img = std::move(img);
+    std::future<std::vector<Yolov3Box>> result = request.boxes.get_future();
+    submit(request);
+    return result;
+}
+
+void BatchServer::submit(Request &request)
+{
+    if(request.img.size() != static_cast<size_t>(this->inputNum))
+    {
+        throw Exception(1,"input image size err. Needed :" + std::to_string(this->inputNum) + "given :" +
+                        std::to_string(request.img.size()),__FILE__,__LINE__);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if(this->stopped)
+        {
+            throw Exception(1, "Batch server is stopped !",__FILE__, __LINE__);
+        }
+        request.time = std::chrono::steady_clock::now();
+        this->requests.push_back(std::move(request));
+    }
+
+    /* a waiting worker may now have a full batch */
+    this->wake.notify_all();
+}
+
+void BatchServer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopped = true;
+    }
+    this->wake.notify_all();
+
+    for (size_t w = 0; w < this->workers.size(); ++w)
+    {
+        if(this->workers[w].joinable())
+        {
+            this->workers[w].join();
+        }
+    }
+    this->workers.clear();
+}
+
+float BatchServer::getMeanBatchSize()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return (this->batchCount > 0) ? 1.f * this->imageCount / this->batchCount : 0.f;
+}
+
+void BatchServer::work(const std::vector<ExecutionContext*> &contexts)
+{
+    std::vector<Request> batch;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this]{ return this->stopped || !this->requests.empty(); });
+
+            if(this->requests.empty())
+            {
+                return;
+            }
+
+            /* a full batch goes at once, otherwise the oldest request waits at most maxDelayUs for company */
+            const std::chrono::steady_clock::time_point deadline = this->requests.front().time + std::chrono::microseconds(this->maxDelayUs);
+            this->wake.wait_until(lock, deadline, [this]{ return this->stopped || this->requests.size() >= static_cast<size_t>(this->maxBatch); });
+
+            /* another worker may have taken them meanwhile */
+            const size_t n = std::min(this->requests.size(), static_cast<size_t>(this->maxBatch));
+            for (size_t i = 0; i < n; ++i)
+            {
+                batch.push_back(std::move(this->requests.front()));
+                this->requests.pop_front();
+            }
+
+            if(n > 0)
+            {
+                this->batchCount++;
+                this->imageCount += n;
+            }
+        }
+
+        if(batch.empty())
+        {
+            continue;
+        }
+
+        ExecutionContext *context = contexts.back();
+        for (size_t i = 0; i < contexts.size(); ++i)
+        {
+            if(static_cast<size_t>(contexts[i]->net->batch) >= batch.size())
+            {
+                context = contexts[i];
+                break;
+            }
+        }
+
+        const size_t inNum = static_cast<size_t>(this->inputNum);
+        std::vector<float> input(static_cast<size_t>(context->net->batch) * inNum, 0.f);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            std::copy(batch[i].img.begin(), batch[i].img.end(), input.begin() + static_cast<std::ptrdiff_t>(i * inNum));
+        }
+
+        try
+        {
+            if(this->yolo)
+            {
+                std::vector<std::vector<Yolov3Box>> boxes = context->runYolov3(std::move(input));
+                for (size_t i = 0; i < batch.size(); ++i)
+                {
+                    batch[i].boxes.set_value(std::move(boxes[i]));
+                }
+            }
+            else
+            {
+                std::vector<float> output = context->runClassify(std::move(input));
+                const size_t outNum = output.size() / static_cast<size_t>(context->net->batch);
+                for (size_t i = 0; i < batch.size(); ++i)
+                {
+                    batch[i].classify.set_value(std::vector<float>(output.begin() + static_cast<std::ptrdiff_t>(i * outNum),
+                                                                   output.begin() + static_cast<std::ptrdiff_t>((i + 1) * outNum)));
+                }
+            }
+        }
+        catch(...)
+        {
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                if(this->yolo)
+                {
+                    batch[i].boxes.set_exception(std::current_exception());
+                }
+                else
+                {
+                    batch[i].classify.set_exception(std::current_exception());
+                }
+            }
+        }
+
+        batch.clear();
+    }
+}
+}
@@ -0,0 +1,250 @@
+﻿#include "Msnhnet/net/MsnhExecutionContext.h"
+#include "Msnhnet/net/MsnhNetBuilder.h"
+namespace Msnhnet
+{
+ExecutionContext::ExecutionContext()
+{
+    net             =   new Network();
+    netState        =   new NetworkState();
+    netState->net   =   net;
+}
+
+ExecutionContext::~ExecutionContext()
+{
+    clearLayers(net);
+
+    delete netState;
+    netState    =   nullptr;
+
+    delete net;
+    net         =   nullptr;
+}
+
+std::vector<float> ExecutionContext::runClassify(std::vector<float> img)
+{
+    return runClassify(this->net, this->netState, std::move(img));
+}
+
+std::vector<std::vector<Yolov3Box>> ExecutionContext::runYolov3(std::vector<float> img)
+{
+    return runYolov3(this->net, this->netState, std::move(img));
+}
+
+float ExecutionContext::getInferenceTime()
+{
+    return getInferenceTime(this->net);
+}
+
+std::vector<float> ExecutionContext::runClassify(Network *const &net, NetworkState *const &netState, std::vector<float> img)
+{
+    if(BaseLayer::isPreviewMode)
+    {
+        throw Exception(1, "Can not infer in preview mode !",__FILE__, __LINE__);
+    }
+
+    ThreadPoolScope scope(net->threadPool);
+
+    /* img holds batch images back to back, netState.inputNum is the size of one */
+    const size_t needed =   static_cast<size_t>(net->layers[0]->inputNum) * static_cast<size_t>(net->layers[0]->batch);
+    netState->input     =   img.data();
+    netState->inputNum  =   net->layers[0]->inputNum;
+    if(img.size() != needed)
+    {
+        throw Exception(1,"input image size err. Needed :" + std::to_string(needed) + "given :" +
+                std::to_string(img.size()),__FILE__,__LINE__);
+    }
+
+    int blocked = 0;
+    forwardLayers(net, netState, 0, net->layers.size(), blocked);
+
+    return getOutput(net, netState, blocked);
+}
+
+std::vector<std::vector<Yolov3Box>> ExecutionContext::runYolov3(Network *const &net, NetworkState *const &netState, std::vector<float> img)
+{
+    if(BaseLayer::isPreviewMode)
+    {
+        throw Exception(1, "Can not infer in preview mode !",__FILE__, __LINE__);
+    }
+
+    ThreadPoolScope scope(net->threadPool);
+
+    /* img holds batch images back to back, netState.inputNum is the size of one */
+    const size_t needed =   static_cast<size_t>(net->layers[0]->inputNum) * static_cast<size_t>(net->layers[0]->batch);
+    netState->input     =   img.data();
+    netState->inputNum  =   net->layers[0]->inputNum;
+    if(img.size() != needed)
+    {
+        throw Exception(1,"input image size err. Needed :" + std::to_string(needed) + "given :" +
+                std::to_string(img.size()),__FILE__,__LINE__);
+    }
+
+    int blocked = 0;
+    for (size_t i = 0; i < net->layers.size(); ++i)
+    {
+
+        if(net->layers[i]->type != LayerType::ROUTE && net->layers[i]->type != LayerType::YOLOV3_OUT) 
+
+        {
+            if(netState->inputNum != net->layers[i]->inputNum)
+            {
+                throw Exception(1, "layer " + to_string(i) + " inputNum needed : " + std::to_string(net->layers[i]->inputNum) +
+                                ", given : " + std::to_string(netState->inputNum),__FILE__,__LINE__);
+            }
+        }
+
+        reorderInput(net, netState, i, blocked);
+
+        net->layers[i]->forward(*netState);
+
+        netState->input     =   net->layers[i]->output;
+        netState->inputNum  =   net->layers[i]->outputNum;
+        blocked             =   net->layers[i]->nchwc;
+    }
+
+    if((net->layers[net->layers.size()-1])->type == LayerType::YOLOV3_OUT)
+    {
+        return (reinterpret_cast<Yolov3OutLayer*>((net->layers[net->layers.size()-1])))->finalOut;
+    }
+    else
+    {
+        throw Exception(1,"not a yolov3 net", __FILE__, __LINE__);
+    }
+}
+
+void ExecutionContext::clearLayers(Network *const &net)
+{
+    for (size_t i = 0; i < net->layers.size(); ++i)
+    {
+        if(net->layers[i]!=nullptr)
+        {
+            if(net->layers[i]->type == LayerType::CONVOLUTIONAL)
+            {
+                delete reinterpret_cast<ConvolutionalLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::MAXPOOL)
+            {
+                delete reinterpret_cast<MaxPoolLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::CONNECTED)
+            {
+                delete reinterpret_cast<ConnectedLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::BATCHNORM)
+            {
+                delete reinterpret_cast<BatchNormLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::LOCAL_AVGPOOL)
+            {
+                delete reinterpret_cast<LocalAvgPoolLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::RES_BLOCK)
+            {
+                delete reinterpret_cast<ResBlockLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::RES_2_BLOCK)
+            {
+                delete reinterpret_cast<Res2BlockLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::ADD_BLOCK)
+            {
+                delete reinterpret_cast<AddBlockLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::CONCAT_BLOCK)
+            {
+                delete reinterpret_cast<ConcatBlockLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::ROUTE)
+            {
+                delete reinterpret_cast<RouteLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::UPSAMPLE)
+            {
+                delete reinterpret_cast<UpSampleLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::YOLOV3)
+            {
+                delete reinterpret_cast<Yolov3Layer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::YOLOV3_OUT)
+            {
+                delete reinterpret_cast<Yolov3OutLayer*>(net->layers[i]);
+            }
+            else if(net->layers[i]->type == LayerType::PADDING)
+            {
+                delete reinterpret_cast<PaddingLayer*>(net->layers[i]);
+            }
+
+            net->layers[i] = nullptr;
+        }
+
+        if(i == (net->layers.size()-1))
+        {
+            net->layers.clear();
+        }
+    }
+}
+
+void ExecutionContext::forwardLayers(Network *const &net, NetworkState *const &netState, const size_t &begin, const size_t &end, int &blocked)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        reorderInput(net, netState, i, blocked);
+
+        net->layers[i]->forward(*netState);
+
+        netState->input     =   net->layers[i]->output;
+        netState->inputNum  =   net->layers[i]->outputNum;
+        blocked             =   net->layers[i]->nchwc;
+    }
+}
+
+std::vector<float> ExecutionContext::getOutput(Network *const &net, NetworkState *const &netState, const int &blocked)
+{
+    BaseLayer *last = net->layers[net->layers.size() - 1];
+    if(blocked)
+    {
+        NCHWc::toPlain(netState->input, last->batch, last->outChannel, last->outHeight, last->outWidth, netState->layoutBuffer);
+        netState->input     =   netState->layoutBuffer;
+    }
+
+    std::vector<float> pred(netState->input, netState->input + static_cast<size_t>(netState->inputNum) * static_cast<size_t>(last->batch));
+
+    return pred;
+}
+
+void ExecutionContext::reorderInput(Network *const &net, NetworkState *const &netState, const size_t &index, int &blocked)
+{
+    BaseLayer *layer = net->layers[index];
+
+    /* route and yolov3 out don't read netState.input */
+    if(layer->type == LayerType::ROUTE || layer->type == LayerType::YOLOV3_OUT || layer->nchwc == blocked)
+    {
+        return;
+    }
+
+    if(layer->nchwc)
+    {
+        NCHWc::toBlocked(netState->input, layer->batch, layer->channel, layer->height, layer->width, netState->layoutBuffer);
+    }
+    else
+    {
+        BaseLayer *producer = net->layers[index - 1];
+        NCHWc::toPlain(netState->input, producer->batch, producer->outChannel, producer->outHeight, producer->outWidth, netState->layoutBuffer);
+    }
+
+    netState->input  =   netState->layoutBuffer;
+    blocked         =   layer->nchwc;
+}
+
+float ExecutionContext::getInferenceTime(Network *const &net)
+{
+    float inferTime     =   0.f;
+    for (size_t i = 0; i < net->layers.size(); ++i)
+    {
+        inferTime       +=  net->layers[i]->forwardTime;
+    }
+
+    return inferTime;
+}
+}
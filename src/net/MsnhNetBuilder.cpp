@@ -1,6 +1,193 @@
 ﻿#include "Msnhnet/net/MsnhNetBuilder.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
 namespace Msnhnet
 {
+/* conv / connected (and bn) layers in weight file order (blocks are walked in place) */
+static void collectWeightLayers(const std::vector<BaseLayer*> &layers, std::vector<BaseLayer*> &weightLayers, const bool &batchNorm = false)
+{
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        BaseLayer *layer = layers[i];
+
+        if(layer->type == LayerType::CONVOLUTIONAL || layer->type == LayerType::CONNECTED || (batchNorm && layer->type == LayerType::BATCHNORM))
+        {
+            weightLayers.push_back(layer);
+        }
+        else if(layer->type == LayerType::RES_BLOCK)
+        {
+            collectWeightLayers(reinterpret_cast<ResBlockLayer*>(layer)->baseLayers, weightLayers, batchNorm);
+        }
+        else if(layer->type == LayerType::RES_2_BLOCK)
+        {
+            collectWeightLayers(reinterpret_cast<Res2BlockLayer*>(layer)->baseLayers, weightLayers, batchNorm);
+            collectWeightLayers(reinterpret_cast<Res2BlockLayer*>(layer)->branchLayers, weightLayers, batchNorm);
+        }
+        else if(layer->type == LayerType::ADD_BLOCK)
+        {
+            for (size_t j = 0; j < reinterpret_cast<AddBlockLayer*>(layer)->branchLayers.size(); ++j)
+            {
+                collectWeightLayers(reinterpret_cast<AddBlockLayer*>(layer)->branchLayers[j], weightLayers, batchNorm);
+            }
+        }
+        else if(layer->type == LayerType::CONCAT_BLOCK)
+        {
+            for (size_t j = 0; j < reinterpret_cast<ConcatBlockLayer*>(layer)->branchLayers.size(); ++j)
+            {
+                collectWeightLayers(reinterpret_cast<ConcatBlockLayer*>(layer)->branchLayers[j], weightLayers, batchNorm);
+            }
+        }
+    }
+}
+
+/* conv / connected layers that take the int8 path */
+static void collectQuantLayers(const std::vector<BaseLayer*> &layers, std::vector<BaseLayer*> &quantLayers)
+{
+    std::vector<BaseLayer*> weightLayers;
+    collectWeightLayers(layers, weightLayers);
+
+    for (size_t i = 0; i < weightLayers.size(); ++i)
+    {
+        const bool int8 = (weightLayers[i]->type == LayerType::CONVOLUTIONAL) ? reinterpret_cast<ConvolutionalLayer*>(weightLayers[i])->supportInt8() :
+                                                                                 reinterpret_cast<ConnectedLayer*>(weightLayers[i])->supportInt8();
+        if(int8)
+        {
+            quantLayers.push_back(weightLayers[i]);
+        }
+    }
+}
+
+/* layers that take a slice of the msnhbin in loadAllWeigths */
+static bool isWeightLayer(const BaseLayer *const &layer)
+{
+    return layer->type == LayerType::CONVOLUTIONAL || layer->type == LayerType::CONNECTED || layer->type == LayerType::BATCHNORM ||
+           layer->type == LayerType::RES_BLOCK     || layer->type == LayerType::RES_2_BLOCK || layer->type == LayerType::ADD_BLOCK ||
+           layer->type == LayerType::CONCAT_BLOCK;
+}
+
+static bool hasMappedWeights(const std::vector<BaseLayer*> &layers)
+{
+    std::vector<BaseLayer*> weightLayers;
+    collectWeightLayers(layers, weightLayers);
+
+    for (size_t i = 0; i < weightLayers.size(); ++i)
+    {
+        const int mapped = (weightLayers[i]->type == LayerType::CONVOLUTIONAL) ? (reinterpret_cast<ConvolutionalLayer*>(weightLayers[i])->mappedWeights ||
+                                                                                  reinterpret_cast<ConvolutionalLayer*>(weightLayers[i])->mappedPacked) :
+                                                                                 (reinterpret_cast<ConnectedLayer*>(weightLayers[i])->mappedWeights ||
+                                                                                  reinterpret_cast<ConnectedLayer*>(weightLayers[i])->mappedPacked);
+        if(mapped)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void addTensor(std::vector<ModelTensor> &tensors, const std::string &name, const int &group, const std::vector<int> &shape)
+{
+    ModelTensor tensor;
+    tensor.name     = name;
+    tensor.group    = group;
+    tensor.shape    = shape;
+    tensors.push_back(tensor);
+}
+
+/* one tensor per array, in the order loadAllWeigths reads them, named <layer>[.<sub layer>].<array> */
+static void collectLayerTensors(BaseLayer *const &layer, const std::string &name, const int &group, std::vector<ModelTensor> &tensors)
+{
+    if(layer->type == LayerType::CONVOLUTIONAL)
+    {
+        ConvolutionalLayer *conv = reinterpret_cast<ConvolutionalLayer*>(layer);
+        std::vector<int> shape = {conv->num, conv->channel / conv->groups, conv->kSizeY, conv->kSizeX};
+        if(shape[0] * shape[1] * shape[2] * shape[3] != conv->nWeights)
+        {
+            shape = {conv->nWeights};
+        }
+        addTensor(tensors, name + ".weights", group, shape);
+
+       if(conv->batchNorm)
+        {
+            addTensor(tensors, name + ".scales", group, {conv->nScales});
+            addTensor(tensors, name + ".biases", group, {conv->nBiases});
+            addTensor(tensors, name + ".rollMean", group, {conv->nRollMean});
+            addTensor(tensors, name + ".rollVariance", group, {conv->nRollVariance});
+        }
+        else if(conv->nBiases > 0)
+        {
+            addTensor(tensors, name + ".biases", group, {conv->nBiases});
+        }
+    }
+    else if(layer->type == LayerType::CONNECTED)
+    {
+        ConnectedLayer *fc = reinterpret_cast<ConnectedLayer*>(layer);
+        addTensor(tensors, name + ".weights", group, {fc->outputNum, fc->inputNum});
+
+       if(fc->batchNorm)
+        {
+            addTensor(tensors, name + ".scales", group, {fc->nScales});
+            addTensor(tensors, name + ".rollMean", group, {fc->nRollMean});
+            addTensor(tensors, name + ".rollVariance", group, {fc->nRollVariance});
+        }
+        addTensor(tensors, name + ".biases", group, {fc->nBiases});
+    }
+    else if(layer->type == LayerType::BATCHNORM)
+    {
+        BatchNormLayer *bn = reinterpret_cast<BatchNormLayer*>(layer);
+        addTensor(tensors, name + ".scales", group, {bn->nScales});
+        addTensor(tensors, name + ".biases", group, {bn->nBiases});
+        addTensor(tensors, name + ".rollMean", group, {bn->nRollMean});
+        addTensor(tensors, name + ".rollVariance", group, {bn->nRollVariance});
+    }
+    else if(layer->type == LayerType::RES_BLOCK)
+    {
+        ResBlockLayer *block = reinterpret_cast<ResBlockLayer*>(layer);
+        for (size_t i = 0; i < block->baseLayers.size(); ++i)
+        {
+            if(isWeightLayer(block->baseLayers[i]))
+            {
+                collectLayerTensors(block->baseLayers[i], name + "." + std::to_string(i), group, tensors);
+            }
+        }
+    }
+    else if(layer->type == LayerType::RES_2_BLOCK)
+    {
+        Res2BlockLayer *block = reinterpret_cast<Res2BlockLayer*>(layer);
+        for (size_t i = 0; i < block->baseLayers.size(); ++i)
+        {
+            if(isWeightLayer(block->baseLayers[i]))
+            {
+                collectLayerTensors(block->baseLayers[i], name + ".base." + std::to_string(i), group, tensors);
+            }
+        }
+        for (size_t i = 0; i < block->branchLayers.size(); ++i)
+        {
+            if(isWeightLayer(block->branchLayers[i]))
+            {
+                collectLayerTensors(block->branchLayers[i], name + ".branch." + std::to_string(i), group, tensors);
+            }
+        }
+    }
+    else if(layer->type == LayerType::ADD_BLOCK || layer->type == LayerType::CONCAT_BLOCK)
+    {
+        std::vector<std::vector<BaseLayer*>> &branches = (layer->type == LayerType::ADD_BLOCK) ? reinterpret_cast<AddBlockLayer*>(layer)->branchLayers :
+                                                                                              reinterpret_cast<ConcatBlockLayer*>(layer)->branchLayers;
+        for (size_t i = 0; i < branches.size(); ++i)
+        {
+            for (size_t j = 0; j < branches[i].size(); ++j)
+            {
+                if(isWeightLayer(branches[i][j]))
+                {
+                    collectLayerTensors(branches[i][j], name + "." + std::to_string(i) + "." + std::to_string(j), group, tensors);
+                }
+            }
+        }
+    }
+}
+
 NetBuilder::NetBuilder()
 {
     parser          =   new Parser();
@@ -8,6 +195,9 @@ NetBuilder::NetBuilder()
     netState        =   new NetworkState();
     netState->net   =   net;
 
+    threadPool      =   new ThreadPool(MSNH_DEFAULT_THREADS);
+    net->threadPool =   threadPool;
+
    BaseLayer::initSimd();
 }
 
@@ -24,14 +214,250 @@ NetBuilder::~NetBuilder()
    delete net;
     net         =   nullptr;
 
+   delete threadPool;
+    threadPool  =   nullptr;
 }
 
 void NetBuilder::buildNetFromMsnhNet(const string &path)
 {
-    parser->readCfg(path);
     clearLayers();
+    parser->readCfg(path);
+    buildNetFromParams(net, netState, this->options);
+}
+
+void NetBuilder::buildNetFromMsnhModel(const string &path, const bool &verifyHash)
+{
+    if(BaseLayer::isPreviewMode)
+    {
+        throw Exception(1, "Can not load weights in preview mode !",__FILE__, __LINE__);
+    }
+
+   clearLayers();
+    this->planLoaded = false;
+    this->net->options = this->options;
+
+   if(this->planCacheDir.empty())
+    {
+        parser->readMsnhModel(path, verifyHash);
+        buildNetFromParams(net, netState, this->options);
+        loadWeightsFromMsnhModel();
+        return;
+    }
+
+   /* the plan is found by the model's content hash, so only the header of the model is read on a hit */
+    const uint64_t key          = getPlanKey(ModelFile::readContentHash(path));
+    const std::string planPath  = getPlanPath(key);
+
+   if(std::ifstream(planPath).good())
+    {
+        try
+        {
+            this->planLoaded = loadPlan(planPath, key, verifyHash);
+        }
+        catch(Exception &)
+        {
+            /* a damaged plan is rebuilt below */
+            this->planLoaded = false;
+        }
+
+       if(this->planLoaded)
+        {
+            return;
+        }
+    }
+
+   parser->readMsnhModel(path, verifyHash);
+    buildNetFromParams(net, netState, this->options);
+    loadWeightsFromMsnhModel();
+
+   try
+    {
+        savePlan(planPath, key);
+    }
+    catch(Exception &)
+    {
+        /* the cache is best effort, a read only cache dir only costs the next start */
+    }
+}
+
+uint64_t NetBuilder::getPlanKey(const uint64_t &modelHash)
+{
+    /* everything that changes what loading produces: the model, the kernels this cpu can run, the flags of the net and the packed tile sizes */
+    const NetOptions &opt   = this->net->options;
+    const uint64_t fields[] = {modelHash, MSNH_PLAN_VERSION, sizeof(void*),
+                               BaseLayer::supportAvx, BaseLayer::supportFma, BaseLayer::supportVnni, BaseLayer::supportF16c,
+                               opt.usePrePackedWeights, opt.useWinograd, opt.useImplicitGemm, opt.useNCHWc,
+                               opt.useBatchNormFolding, opt.useEpilogueFusion, opt.useResidualFusion, opt.useInt8,
+                               static_cast<uint64_t>(opt.weightStorage), this->useMemoryPlanner, this->useConcatViews,
+                               GEMM_MR, GEMM_NR, GEMM_KC, GEMM_HALF_PAD, NCHWC_PACK, QUANT_MR, QUANT_NR};
+
+   return ModelFile::hash(reinterpret_cast<const char*>(fields), sizeof(fields), MSNH_MODEL_HASH_SEED);
+}
+
+string NetBuilder::getPlanPath(const uint64_t &key)
+{
+    char name[32];
+#ifdef WIN32
+    sprintf_s(name, "%016llx.msnhplan", static_cast<unsigned long long>(key));
+#else
+    sprintf(name, "%016llx.msnhplan", static_cast<unsigned long long>(key));
+#endif
+    return this->planCacheDir + "/" + name;
+}
+
+/* the plan record: version, key, layer count, arena size, then type / layout / arena offset of every layer */
+static void getPlanRecord(Network *const &net, NetworkState *const &netState, const uint64_t &key, std::vector<int32_t> &record)
+{
+    const int64_t arenaSize = static_cast<int64_t>(net->plannedOutputSize);
+
+   record = {MSNH_PLAN_VERSION, static_cast<int32_t>(key & 0xffffffff), static_cast<int32_t>(key >> 32), static_cast<int32_t>(net->layers.size()),
+              static_cast<int32_t>(arenaSize & 0xffffffff), static_cast<int32_t>(arenaSize >> 32)};
+
+   for (size_t i = 0; i < net->layers.size(); ++i)
+    {
+        const float *output = net->layers[i]->output;
+        const int64_t offset = (netState->memoryArena != nullptr && output >= netState->memoryArena &&
+                                output < netState->memoryArena + net->plannedOutputSize) ? (output - netState->memoryArena) : -1;
+
+       record.push_back(static_cast<int32_t>(net->layers[i]->type));
+        record.push_back(net->layers[i]->nchwc);
+        record.push_back(static_cast<int32_t>(offset & 0xffffffff));
+        record.push_back(static_cast<int32_t>(offset >> 32));
+    }
+}
+
+void NetBuilder::savePlan(const string &path, const uint64_t &key)
+{
+    std::vector<char> graph;
+    parser->serializeParams(graph);
+
+   std::vector<int32_t> record;
+    getPlanRecord(net, netState, key, record);
+
+   std::vector<ModelTensor> tensors;
+    tensors.push_back(ModelFile::makeTensor("plan", -1, TENSOR_INT32, record.data(), record.size()));
+
+   std::vector<BaseLayer*> layers;
+    collectWeightLayers(net->layers, layers, true);
+
+   std::vector<std::vector<int32_t>> states(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        const size_t first = tensors.size();
+        if(layers[i]->type == LayerType::CONVOLUTIONAL)
+        {
+            reinterpret_cast<ConvolutionalLayer*>(layers[i])->getPlanTensors(tensors, states[i]);
+        }
+        else if(layers[i]->type == LayerType::CONNECTED)
+        {
+            reinterpret_cast<ConnectedLayer*>(layers[i])->getPlanTensors(tensors, states[i]);
+        }
+        else
+        {
+            reinterpret_cast<BatchNormLayer*>(layers[i])->getPlanTensors(tensors);
+        }
+
+       for (size_t j = first; j < tensors.size(); ++j)
+        {
+            tensors[j].group = static_cast<int>(i);
+        }
+    }
+
+   /* written aside and renamed, so workers starting together never map a half written plan */
+    const std::string tmpPath = path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    try
+    {
+        ModelFile::write(tmpPath, graph, tensors, MSNH_PLAN_MAGIC);
+    }
+    catch(Exception &)
+    {
+        std::remove(tmpPath.c_str());
+        throw;
+    }
+
+   if(std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        throw Exception(1, path + " write filed!",__FILE__, __LINE__);
+    }
+}
+
+bool NetBuilder::loadPlan(const string &path, const uint64_t &key, const bool &verifyHash)
+{
+    parser->readMsnhModel(path, verifyHash, MSNH_PLAN_MAGIC);
+
+   const std::vector<ModelTensor> &tensors = parser->msnhModelTensors;
+    const ModelTensor *plan = ModelFile::findTensor(tensors, "plan");
+    if(plan == nullptr || plan->type != TENSOR_INT32)
+    {
+        return false;
+    }
+
+   buildNetFromParams(net, netState, this->options);
+
+   /* the rebuilt net must have made the same choices, otherwise the packed weights don't fit its kernels */
+    std::vector<int32_t> record;
+    getPlanRecord(net, netState, key, record);
+    if(plan->bytes != record.size() * sizeof(int32_t) || memcmp(plan->data, record.data(), static_cast<size_t>(plan->bytes)) != 0)
+    {
+        return false;
+    }
+
+   std::vector<BaseLayer*> layers;
+    collectWeightLayers(net->layers, layers, true);
+
+   const bool mapped = this->useMappedWeights;
+    size_t t = 0;
+    std::vector<ModelTensor> layerTensors;
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        layerTensors.clear();
+        for (; t < tensors.size(); ++t)
+        {
+            if(tensors[t].group == static_cast<int>(i))
+            {
+                layerTensors.push_back(tensors[t]);
+            }
+            else if(tensors[t].group > static_cast<int>(i))
+            {
+                break;
+            }
+        }
+
+       bool loaded = false;
+        if(layers[i]->type == LayerType::CONVOLUTIONAL)
+        {
+            loaded = reinterpret_cast<ConvolutionalLayer*>(layers[i])->loadPlanTensors(layerTensors, mapped);
+        }
+        else if(layers[i]->type == LayerType::CONNECTED)
+        {
+            loaded = reinterpret_cast<ConnectedLayer*>(layers[i])->loadPlanTensors(layerTensors, mapped);
+        }
+        else
+        {
+            loaded = reinterpret_cast<BatchNormLayer*>(layers[i])->loadPlanTensors(layerTensors);
+        }
+
+       if(!loaded)
+        {
+            return false;
+        }
+    }
+
+   if(!mapped || !hasMappedWeights(net->layers))
+    {
+        parser->clearMsnhBin();
+    }
+    return true;
+}
+
+void NetBuilder::buildNetFromParams(Network *const &net, NetworkState *const &netState, const NetOptions &options, const int &batch)
+{
+    ExecutionContext::clearLayers(net);
+    net->options    =   options;
 
    NetBuildParams      params;
+    params.options      =   options;
     size_t      maxWorkSpace = 0;
     for (size_t i = 0; i < parser->params.size(); ++i)
     {
@@ -39,7 +465,7 @@ void NetBuilder::buildNetFromMsnhNet(const string &path)
         if(parser->params[i]->type == LayerType::CONFIG)
         {
             NetConfigParams* netCfgParams     =   reinterpret_cast<NetConfigParams*>(parser->params[i]);
-            net->batch                  =   netCfgParams->batch;
+            net->batch                  =   (batch > 0) ? batch : netCfgParams->batch;
             net->channels               =   netCfgParams->channels;
             net->width                  =   netCfgParams->width;
             net->height                 =   netCfgParams->height;
@@ -72,13 +498,13 @@ void NetBuilder::buildNetFromMsnhNet(const string &path)
                                                                                convParams->kSizeX, convParams->kSizeY, convParams->strideX, convParams->strideY, convParams->dilationX,
                                                                                convParams->dilationY,convParams->paddingX, convParams->paddingY,
                                                                                convParams->activation, convParams->actParams, convParams->batchNorm, convParams->useBias,
-                                                                               0,0,0,0,convParams->antialiasing, nullptr, 0,0);
+                                                                               convParams->binary,convParams->xnor,0,0,convParams->antialiasing, nullptr, 0,0, params.options, convParams->implicitGemm);
         }
         else if(parser->params[i]->type == LayerType::CONNECTED)
         {
             ConnectParams *connectParams            =   reinterpret_cast<ConnectParams*>(parser->params[i]);
             layer                                   =   new ConnectedLayer(params.batch, 1, params.inputNums, connectParams->output, connectParams->activation, connectParams->actParams,
-                                                                           connectParams->batchNorm);
+                                                                           connectParams->batchNorm, params.options);
         }
         else if(parser->params[i]->type == LayerType::MAXPOOL)
         {
@@ -213,212 +639,998 @@ void NetBuilder::buildNetFromMsnhNet(const string &path)
             maxWorkSpace = layer->workSpaceSize;
         }
         net->layers.push_back(layer);
-    }
-    netState->workspace     =   new float[maxWorkSpace]();
-}
 
-void NetBuilder::loadWeightsFromMsnhBin(const string &path)
-{
-    if(BaseLayer::isPreviewMode)
-    {
-        throw Exception(1, "Can not load weights in preview mode !",__FILE__, __LINE__);
+       if(this->useMemoryPlanner && !BaseLayer::isPreviewMode && layer->type != LayerType::YOLOV3_OUT)
+        {
+            /* planned outputs are placed in one arena once the whole net is known */
+            delete[] layer->output;
+            layer->output       =   nullptr;
+            layer->ownOutput    =   0;
+        }
     }
 
-   parser->readMsnhBin(path);
-    size_t ptr = 0;
-    std::vector<float>::const_iterator first = parser->msnhF32Weights.begin();
+   planLayout(net);
+    planConcat(net);
+    planMemory(net, netState);
+    bindConcatViews(net);
+    fuseLayers(net);
 
-   for (size_t i = 0; i < net->layers.size(); ++i)
+   size_t maxLayoutSize    =   0;
+    for (size_t i = 0; i < net->layers.size(); ++i)
     {
-        if(net->layers[i]->type == LayerType::CONVOLUTIONAL || net->layers[i]->type == LayerType::CONNECTED || net->layers[i]->type == LayerType::BATCHNORM ||
-                net->layers[i]->type == LayerType::RES_BLOCK   || net->layers[i]->type == LayerType::RES_2_BLOCK || net->layers[i]->type == LayerType::ADD_BLOCK ||
-                net->layers[i]->type == LayerType::CONCAT_BLOCK )
+        if(net->layers[i]->workSpaceSize > maxWorkSpace)
         {
-            size_t nums = net->layers[i]->numWeights;
-
-           if((ptr + nums) > (parser->msnhF32Weights.size()))
-            {
-                throw Exception(1,"Load weights err, need > given. Needed :" + std::to_string(ptr + nums) + "given :" +
-                                std::to_string(parser->msnhF32Weights.size()),__FILE__,__LINE__);
-            }
-
-           std::vector<float> weights(first +  static_cast<long long>(ptr), first + static_cast<long long>(ptr + nums));
-
-           net->layers[i]->loadAllWeigths(weights);
-
-           ptr         =   ptr + nums;
+            maxWorkSpace = net->layers[i]->workSpaceSize;
         }
-    }
 
-   if(ptr != parser->msnhF32Weights.size())
-    {
-        throw Exception(1,"Load weights err, need != given. Needed :" + std::to_string(ptr) + "given :" +
-                        std::to_string(parser->msnhF32Weights.size()),__FILE__,__LINE__);
+       if(net->layers[i]->nchwc)
+        {
+            size_t layoutSize = static_cast<size_t>(std::max(net->layers[i]->inputNum, net->layers[i]->outputNum) * net->layers[i]->batch);
+            maxLayoutSize = (layoutSize > maxLayoutSize) ? layoutSize : maxLayoutSize;
+        }
     }
 
-}
-
-void NetBuilder::setPreviewMode(const bool &mode)
-{
-    BaseLayer::setPreviewMode(mode);
-}
-
-std::vector<float> NetBuilder::runClassify(std::vector<float> img)
-{
-    if(BaseLayer::isPreviewMode)
-    {
-        throw Exception(1, "Can not infer in preview mode !",__FILE__, __LINE__);
-    }
+   netState->releaseArr(netState->workspace);
+    netState->workspace     =   new float[maxWorkSpace]();
 
-   netState->input     =   img.data();
-    netState->inputNum  =   static_cast<int>(img.size());
-    if(net->layers[0]->inputNum != netState->inputNum)
+   netState->releaseArr(netState->layoutBuffer);
+    netState->layoutBuffer  =   nullptr;
+    if(maxLayoutSize > 0 && !BaseLayer::isPreviewMode)
     {
-        throw Exception(1,"input image size err. Needed :" + std::to_string(net->layers[0]->inputNum) + "given :" +
-                std::to_string(img.size()),__FILE__,__LINE__);
+        netState->layoutBuffer  =   new float[maxLayoutSize]();
     }
-
-   for (size_t i = 0; i < net->layers.size(); ++i)
-    {
-        net->layers[i]->forward(*netState);
-
-       netState->input     =   net->layers[i]->output;
-        netState->inputNum  =   net->layers[i]->outputNum;
-
-   }
-
-   std::vector<float> pred(netState->input, netState->input + netState->inputNum);
-
-   return pred;
 }
 
-std::vector<std::vector<Yolov3Box>> NetBuilder::runYolov3(std::vector<float> img)
+void NetBuilder::planLayout(Network *const &net)
 {
-    if(BaseLayer::isPreviewMode)
+    for (size_t i = 0; i < net->layers.size(); ++i)
     {
-        throw Exception(1, "Can not infer in preview mode !",__FILE__, __LINE__);
+        net->layers[i]->nchwc   =   0;
     }
 
-   netState->input     =   img.data();
-    netState->inputNum  =   static_cast<int>(img.size());
-    if(net->layers[0]->inputNum != netState->inputNum)
+   if(!net->options.useNCHWc)
     {
-        throw Exception(1,"input image size err. Needed :" + std::to_string(net->layers[0]->inputNum) + "given :" +
-                std::to_string(img.size()),__FILE__,__LINE__);
+        return;
     }
 
-   for (size_t i = 0; i < net->layers.size(); ++i)
+   /* convs open blocked regions, pooling / bn / upsample only extend them, routes need all inputs blocked */
+    for (size_t i = 0; i < net->layers.size(); ++i)
     {
+        BaseLayer *layer = net->layers[i];
 
-       if(net->layers[i]->type != LayerType::ROUTE && net->layers[i]->type != LayerType::YOLOV3_OUT) 
-
-       {
-            if(netState->inputNum != net->layers[i]->inputNum)
+       if(layer->type == LayerType::CONVOLUTIONAL)
+        {
+            layer->nchwc = layer->supportNCHWc();
+        }
+        else if(layer->type == LayerType::MAXPOOL || layer->type == LayerType::BATCHNORM || layer->type == LayerType::UPSAMPLE)
+        {
+            layer->nchwc = (i > 0 && net->layers[i-1]->nchwc && layer->supportNCHWc());
+        }
+        else if(layer->type == LayerType::ROUTE)
+        {
+            RouteLayer *route   =   reinterpret_cast<RouteLayer*>(layer);
+            route->nchwc        =   (route->groups == 1);
+            for (size_t j = 0; j < route->inputLayerIndexes.size(); ++j)
             {
-                throw Exception(1, "layer " + to_string(i) + " inputNum needed : " + std::to_string(net->layers[i]->inputNum) +
-                                ", given : " + std::to_string(netState->inputNum),__FILE__,__LINE__);
+                BaseLayer *input = net->layers[static_cast<size_t>(route->inputLayerIndexes[j])];
+                if(!input->nchwc || input->outChannel % NCHWC_PACK != 0)
+                {
+                    route->nchwc = 0;
+                }
             }
         }
+    }
 
-       net->layers[i]->forward(*netState);
+   /* routes read other layers' outputs directly, so every route and its inputs must agree on the layout */
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 0; i < net->layers.size(); ++i)
+        {
+            BaseLayer *layer = net->layers[i];
 
-       netState->input     =   net->layers[i]->output;
-        netState->inputNum  =   net->layers[i]->outputNum;
+           if((layer->type == LayerType::MAXPOOL || layer->type == LayerType::BATCHNORM || layer->type == LayerType::UPSAMPLE) &&
+                    layer->nchwc && !net->layers[i-1]->nchwc)
+            {
+                layer->nchwc    =   0;
+                changed         =   true;
+            }
+            else if(layer->type == LayerType::ROUTE)
+            {
+                RouteLayer *route   =   reinterpret_cast<RouteLayer*>(layer);
+                for (size_t j = 0; j < route->inputLayerIndexes.size(); ++j)
+                {
+                    BaseLayer *input = net->layers[static_cast<size_t>(route->inputLayerIndexes[j])];
+                    if(input->nchwc != route->nchwc)
+                    {
+                        route->nchwc    =   0;
+                        input->nchwc    =   0;
+                        changed         =   true;
+                    }
+                }
+            }
+        }
+    }
 
-   }
+   for (size_t i = 0; i < net->layers.size(); ++i)
+    {
+        if(net->layers[i]->type == LayerType::CONVOLUTIONAL && net->layers[i]->nchwc)
+        {
+            net->layers[i]->workSpaceSize = static_cast<size_t>(reinterpret_cast<ConvolutionalLayer*>(net->layers[i])->getConvWorkSpaceSize());
+        }
+    }
+}
 
-   if((net->layers[net->layers.size()-1])->type == LayerType::YOLOV3_OUT)
+void NetBuilder::planConcat(Network *const &net)
+{
+    const size_t layerNum   =   net->layers.size();
+
+   /* an output read by more than one route / yolov3 out (or twice by one) must keep its own buffer */
+    std::vector<int> refs(layerNum, 0);
+    for (size_t i = 0; i < layerNum; ++i)
     {
-        return (reinterpret_cast<Yolov3OutLayer*>((net->layers[net->layers.size()-1])))->finalOut;
+        if(net->layers[i]->type == LayerType::ROUTE)
+        {
+            std::vector<int> &indexes = reinterpret_cast<RouteLayer*>(net->layers[i])->inputLayerIndexes;
+            for (size_t j = 0; j < indexes.size(); ++j)
+            {
+                refs[static_cast<size_t>(indexes[j])]++;
+            }
+        }
+        else if(net->layers[i]->type == LayerType::YOLOV3_OUT)
+        {
+            std::vector<int> &indexes = reinterpret_cast<Yolov3OutLayer*>(net->layers[i])->yolov3Indexes;
+            for (size_t j = 0; j < indexes.size(); ++j)
+            {
+                refs[static_cast<size_t>(indexes[j])]++;
+            }
+        }
     }
-    else
+
+   /* a channel slice of the route is contiguous only without batch stride and groups, in both layouts */
+    for (size_t i = 0; i < layerNum; ++i)
     {
-        throw Exception(1,"not a yolov3 net", __FILE__, __LINE__);
+        if(net->layers[i]->type != LayerType::ROUTE)
+        {
+            continue;
+        }
+
+       RouteLayer *route   =   reinterpret_cast<RouteLayer*>(net->layers[i]);
+        for (size_t j = 0; j < route->inputLayerIndexes.size(); ++j)
+        {
+            BaseLayer *input        =   net->layers[static_cast<size_t>(route->inputLayerIndexes[j])];
+
+           route->inputInPlace[j]  =   (this->useConcatViews && route->groups == 1 && route->batch == 1 &&
+                                         refs[static_cast<size_t>(route->inputLayerIndexes[j])] == 1 &&
+                                         input->type != LayerType::YOLOV3 && input->nchwc == route->nchwc);
+        }
     }
 }
 
-void NetBuilder::clearLayers()
+void NetBuilder::planMemory(Network *const &net, NetworkState *const &netState)
 {
-    for (size_t i = 0; i < net->layers.size(); ++i)
+    const size_t layerNum   =   net->layers.size();
+    const size_t align      =   16;
+
+   std::vector<size_t> sizes(layerNum, 0);
+    std::vector<size_t> firstDef(layerNum, 0);
+    std::vector<size_t> lastUse(layerNum, 0);
+
+   net->naiveOutputSize    =   0;
+    for (size_t i = 0; i < layerNum; ++i)
     {
-        if(net->layers[i]!=nullptr)
+        if(net->layers[i]->type != LayerType::YOLOV3_OUT)
         {
-            if(net->layers[i]->type == LayerType::CONVOLUTIONAL)
+            sizes[i]    =   static_cast<size_t>(net->layers[i]->outputNum) * static_cast<size_t>(net->layers[i]->batch);
+        }
+        net->naiveOutputSize   +=  sizes[i];
+        firstDef[i] =   i;
+        lastUse[i]  =   i;
+    }
+
+   /* inputs written in place live inside their route, which is then alive from the first of them */
+    for (size_t i = 0; i < layerNum; ++i)
+    {
+        if(net->layers[i]->type == LayerType::ROUTE)
+        {
+            RouteLayer *route = reinterpret_cast<RouteLayer*>(net->layers[i]);
+            for (size_t j = 0; j < route->inputLayerIndexes.size(); ++j)
             {
-                delete reinterpret_cast<ConvolutionalLayer*>(net->layers[i]);
+                if(route->inputInPlace[j])
+                {
+                    const size_t index  =   static_cast<size_t>(route->inputLayerIndexes[j]);
+                    sizes[index]        =   0;
+                    firstDef[i]         =   std::min(firstDef[i], firstDef[index]);
+                }
             }
-            else if(net->layers[i]->type == LayerType::MAXPOOL)
+        }
+    }
+
+   /* last consumer of every output: the next layer, routes and yolov3 out (long range), the caller for the last layer */
+    for (size_t i = 0; i < layerNum; ++i)
+    {
+        BaseLayer *layer = net->layers[i];
+
+       if(layer->type == LayerType::ROUTE)
+        {
+            std::vector<int> &indexes = reinterpret_cast<RouteLayer*>(layer)->inputLayerIndexes;
+            for (size_t j = 0; j < indexes.size(); ++j)
             {
-                delete reinterpret_cast<MaxPoolLayer*>(net->layers[i]);
+                lastUse[static_cast<size_t>(indexes[j])] = std::max(lastUse[static_cast<size_t>(indexes[j])], i);
             }
-            else if(net->layers[i]->type == LayerType::CONNECTED)
+        }
+        else if(layer->type == LayerType::YOLOV3_OUT)
+        {
+            std::vector<int> &indexes = reinterpret_cast<Yolov3OutLayer*>(layer)->yolov3Indexes;
+            for (size_t j = 0; j < indexes.size(); ++j)
             {
-                delete reinterpret_cast<ConnectedLayer*>(net->layers[i]);
+                lastUse[static_cast<size_t>(indexes[j])] = std::max(lastUse[static_cast<size_t>(indexes[j])], i);
             }
-            else if(net->layers[i]->type == LayerType::BATCHNORM)
+        }
+        else if(i > 0)
+        {
+            lastUse[i-1] = std::max(lastUse[i-1], i);
+        }
+    }
+
+   if(layerNum > 0)
+    {
+        lastUse[layerNum-1] = layerNum;
+    }
+
+   /* greedy by size, best fit: every output takes the smallest gap left by outputs alive at the same time */
+    std::vector<size_t> order;
+    for (size_t i = 0; i < layerNum; ++i)
+    {
+        if(sizes[i] > 0)
+        {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&sizes](const size_t &a, const size_t &b){ return sizes[a] > sizes[b]; });
+
+   std::vector<size_t> offsets(layerNum, 0);
+    std::vector<size_t> placed;
+    net->plannedOutputSize  =   0;
+
+   for (size_t n = 0; n < order.size(); ++n)
+    {
+        const size_t i      =   order[n];
+        const size_t size   =   (sizes[i] + align - 1) / align * align;
+
+       std::vector<size_t> alive;
+        for (size_t j = 0; j < placed.size(); ++j)
+        {
+            const size_t p = placed[j];
+            if(firstDef[i] <= lastUse[p] && firstDef[p] <= lastUse[i])
             {
-                delete reinterpret_cast<BatchNormLayer*>(net->layers[i]);
+                alive.push_back(p);
             }
-            else if(net->layers[i]->type == LayerType::LOCAL_AVGPOOL)
+        }
+        std::sort(alive.begin(), alive.end(), [&offsets](const size_t &a, const size_t &b){ return offsets[a] < offsets[b]; });
+
+       size_t bestOffset   =   0;
+        size_t bestGap      =   SIZE_MAX;
+        size_t prevEnd      =   0;
+        for (size_t j = 0; j < alive.size(); ++j)
+        {
+            const size_t p = alive[j];
+            if(offsets[p] >= prevEnd + size && offsets[p] - prevEnd < bestGap)
             {
-                delete reinterpret_cast<LocalAvgPoolLayer*>(net->layers[i]);
+                bestGap     =   offsets[p] - prevEnd;
+                bestOffset  =   prevEnd;
             }
-            else if(net->layers[i]->type == LayerType::RES_BLOCK)
+            prevEnd = std::max(prevEnd, offsets[p] + (sizes[p] + align - 1) / align * align);
+        }
+
+       offsets[i]  =   (bestGap == SIZE_MAX) ? prevEnd : bestOffset;
+        placed.push_back(i);
+        net->plannedOutputSize  =   std::max(net->plannedOutputSize, offsets[i] + size);
+    }
+
+   netState->releaseArr(netState->memoryArena);
+    netState->memoryArena   =   nullptr;
+
+   if(!this->useMemoryPlanner || BaseLayer::isPreviewMode || net->plannedOutputSize == 0)
+    {
+        return;
+    }
+
+   netState->memoryArena   =   new float[net->plannedOutputSize]();
+    for (size_t i = 0; i < layerNum; ++i)
+    {
+        if(sizes[i] > 0 && !net->layers[i]->ownOutput)
+        {
+            net->layers[i]->output  =   netState->memoryArena + offsets[i];
+        }
+    }
+}
+
+void NetBuilder::bindConcatViews(Network *const &net)
+{
+    if(BaseLayer::isPreviewMode)
+    {
+        return;
+    }
+
+   /* outer routes first, so a route written into another route hands the final address to its own inputs */
+    for (size_t i = net->layers.size(); i-- > 0;)
+    {
+        if(net->layers[i]->type != LayerType::ROUTE)
+        {
+            continue;
+        }
+
+       RouteLayer *route   =   reinterpret_cast<RouteLayer*>(net->layers[i]);
+        int offset          =   0;
+        for (size_t j = 0; j < route->inputLayerIndexes.size(); ++j)
+        {
+            BaseLayer *input    =   net->layers[static_cast<size_t>(route->inputLayerIndexes[j])];
+            if(route->inputInPlace[j])
             {
-                delete reinterpret_cast<ResBlockLayer*>(net->layers[i]);
+                if(input->ownOutput)
+                {
+                    input->releaseArr(input->output);
+                }
+                input->output       =   route->output + offset;
+                input->ownOutput    =   0;
             }
-            else if(net->layers[i]->type == LayerType::RES_2_BLOCK)
+            offset = offset + route->inputLayerOutputs[j];
+        }
+    }
+
+   for (size_t i = 0; i < net->layers.size() && this->useConcatViews; ++i)
+    {
+        if(net->layers[i]->type == LayerType::CONCAT_BLOCK)
+        {
+            reinterpret_cast<ConcatBlockLayer*>(net->layers[i])->bindBranchOutputs();
+        }
+    }
+}
+
+void NetBuilder::fuseLayers(Network *const &net)
+{
+    if(!net->options.useResidualFusion)
+    {
+        return;
+    }
+
+   for (size_t i = 0; i < net->layers.size(); ++i)
+    {
+        if(net->layers[i]->type == LayerType::RES_BLOCK)
+        {
+            reinterpret_cast<ResBlockLayer*>(net->layers[i])->fuseResidual();
+        }
+    }
+}
+
+void NetBuilder::loadWeightsFromMsnhBin(const string &path)
+{
+    if(BaseLayer::isPreviewMode)
+    {
+        throw Exception(1, "Can not load weights in preview mode !",__FILE__, __LINE__);
+    }
+
+   if(!this->contexts.empty())
+    {
+        throw Exception(1, "Release the execution contexts before changing the weights !",__FILE__, __LINE__);
+    }
+
+   parser->readMsnhBin(path);
+    size_t ptr = 0;
+    const float *first  = parser->msnhF32Data;
+    const bool mapped   = parser->msnhF32Mapped && this->useMappedWeights;
+
+   for (size_t i = 0; i < net->layers.size(); ++i)
+    {
+        if(isWeightLayer(net->layers[i]))
+        {
+            size_t nums = net->layers[i]->numWeights;
+
+           if((ptr + nums) > parser->msnhF32Num)
             {
-                delete reinterpret_cast<Res2BlockLayer*>(net->layers[i]);
+                throw Exception(1,"Load weights err, need > given. Needed :" + std::to_string(ptr + nums) + "given :" +
+                                std::to_string(parser->msnhF32Num),__FILE__,__LINE__);
             }
-            else if(net->layers[i]->type == LayerType::ADD_BLOCK)
+
+           net->layers[i]->loadAllWeigths(first + ptr, nums, mapped);
+
+           ptr         =   ptr + nums;
+        }
+    }
+
+   if(ptr != parser->msnhF32Num)
+    {
+        throw Exception(1,"Load weights err, need != given. Needed :" + std::to_string(ptr) + "given :" +
+                        std::to_string(parser->msnhF32Num),__FILE__,__LINE__);
+    }
+
+   /* layers that fold / pack / convert keep their own copy, the mapping stays only while some layer reads it in place */
+    if(!mapped || !hasMappedWeights(net->layers))
+    {
+        parser->clearMsnhBin();
+    }
+}
+
+void NetBuilder::loadWeightsFromMsnhModel()
+{
+    const std::vector<ModelTensor> &tensors = parser->msnhModelTensors;
+    const bool mapped   = parser->msnhF32Mapped && this->useMappedWeights;
+    size_t t            = 0;
+    std::vector<float> widened;
+
+   for (size_t i = 0; i < net->layers.size(); ++i)
+    {
+        if(!isWeightLayer(net->layers[i]))
+        {
+            continue;
+        }
+
+       /* a layer's float32 tensors are written back to back, so they are one slice of the mapping */
+        const size_t first  = t;
+        size_t nums         = 0;
+        bool contiguous     = true;
+        for (; t < tensors.size() && tensors[t].group == static_cast<int>(i); ++t)
+        {
+            contiguous  = contiguous && tensors[t].type == TENSOR_F32 &&
+                          (t == first || static_cast<const char*>(tensors[t].data) == static_cast<const char*>(tensors[t - 1].data) + tensors[t - 1].bytes);
+            nums        = nums + tensors[t].getElements();
+        }
+
+       if(nums != net->layers[i]->numWeights)
+        {
+            throw Exception(1,"Load weights err, layer " + std::to_string(i) + " needs " + std::to_string(net->layers[i]->numWeights) +
+                            " msnhmodel gives " + std::to_string(nums),__FILE__,__LINE__);
+        }
+
+       if(contiguous)
+        {
+            net->layers[i]->loadAllWeigths(static_cast<const float*>(tensors[first].data), nums, mapped);
+            continue;
+        }
+
+       widened.resize(nums);
+        size_t pos = 0;
+        for (size_t j = first; j < t; ++j)
+        {
+            const size_t n = tensors[j].getElements();
+            if(tensors[j].type == TENSOR_F32)
             {
-                delete reinterpret_cast<AddBlockLayer*>(net->layers[i]);
+                memcpy(widened.data() + pos, tensors[j].data, n * sizeof(float));
             }
-            else if(net->layers[i]->type == LayerType::CONCAT_BLOCK)
+            else if(tensors[j].type == TENSOR_F16 || tensors[j].type == TENSOR_BF16)
             {
-                delete reinterpret_cast<ConcatBlockLayer*>(net->layers[i]);
+                const uint8_t *src = static_cast<const uint8_t*>(tensors[j].data);
+                for (size_t k = 0; k < n; ++k)
+                {
+                    widened[pos + k] = Half::toFloat(static_cast<uint16_t>(src[2 * k] | (src[2 * k + 1] << 8)), static_cast<WeightStorage>(tensors[j].type));
+                }
             }
-            else if(net->layers[i]->type == LayerType::ROUTE)
+            else
             {
-                delete reinterpret_cast<RouteLayer*>(net->layers[i]);
+                throw Exception(1,"msnhmodel tensor " + tensors[j].name + " is not a float tensor",__FILE__,__LINE__);
             }
-            else if(net->layers[i]->type == LayerType::UPSAMPLE)
+            pos += n;
+        }
+        net->layers[i]->loadAllWeigths(widened.data(), nums, false);
+    }
+
+   for (; t < tensors.size(); ++t)
+    {
+        if(tensors[t].group >= 0)
+        {
+            throw Exception(1,"msnhmodel tensor " + tensors[t].name + " does not belong to a layer of this net",__FILE__,__LINE__);
+        }
+
+       /* int8 weights are only used when the net was built for them */
+        if(tensors[t].layout == TENSOR_QUANT_STREAM && net->options.useInt8)
+        {
+            loadQuantWeights(static_cast<const char*>(tensors[t].data), static_cast<size_t>(tensors[t].bytes));
+        }
+    }
+
+   if(!mapped || !hasMappedWeights(net->layers))
+    {
+        parser->clearMsnhBin();
+    }
+}
+
+void NetBuilder::convertMsnhModel(const string &msnhnetPath, const string &msnhbinPath, const string &dstPath,
+                                  const WeightStorage &storage, const string &quantPath)
+{
+    /* the layers are only needed for their shapes */
+    const bool previewMode = BaseLayer::isPreviewMode;
+    BaseLayer::setPreviewMode(true);
+
+   NetBuilder builder;
+    try
+    {
+        builder.buildNetFromMsnhNet(msnhnetPath);
+    }
+    catch(...)
+    {
+        BaseLayer::setPreviewMode(previewMode);
+        throw;
+    }
+    BaseLayer::setPreviewMode(previewMode);
+
+   std::vector<char> graph;
+    builder.parser->serializeParams(graph);
+
+   std::vector<ModelTensor> tensors;
+    for (size_t i = 0; i < builder.net->layers.size(); ++i)
+    {
+        if(isWeightLayer(builder.net->layers[i]))
+        {
+            const size_t first = tensors.size();
+            collectLayerTensors(builder.net->layers[i], std::to_string(i), static_cast<int>(i), tensors);
+            tensors[first].alignment = MSNH_MODEL_TENSOR_ALIGN;
+        }
+    }
+
+   Parser weights;
+    weights.readMsnhBin(msnhbinPath);
+
+   /* weight matrices take the requested storage, bn / bias arrays stay float32 */
+    std::vector<std::vector<uint16_t>> halfData;
+    size_t ptr = 0;
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        const size_t n = tensors[i].getElements();
+        if(ptr + n > weights.msnhF32Num)
+        {
+            throw Exception(1,"Load weights err, need > given. Needed :" + std::to_string(ptr + n) + "given :" +
+                            std::to_string(weights.msnhF32Num),__FILE__,__LINE__);
+        }
+
+       const bool matrix = tensors[i].name.size() > 8 && tensors[i].name.compare(tensors[i].name.size() - 8, 8, ".weights") == 0;
+        if(storage != WEIGHT_F32 && matrix)
+        {
+            halfData.push_back(std::vector<uint16_t>(n));
+            Half::fromFloat(weights.msnhF32Data + ptr, n, storage, halfData.back().data());
+            tensors[i].type     = static_cast<ModelTensorType>(storage);
+            tensors[i].data     = halfData.back().data();
+            tensors[i].bytes    = n * sizeof(uint16_t);
+        }
+        else
+        {
+            tensors[i].data     = weights.msnhF32Data + ptr;
+            tensors[i].bytes    = n * sizeof(float);
+        }
+        ptr += n;
+    }
+
+   if(ptr != weights.msnhF32Num)
+    {
+        throw Exception(1,"Load weights err, need != given. Needed :" + std::to_string(ptr) + "given :" +
+                        std::to_string(weights.msnhF32Num),__FILE__,__LINE__);
+    }
+
+   std::vector<char> quant;
+    if(!quantPath.empty())
+    {
+        std::ifstream file(quantPath, std::ios::in | std::ios::binary | std::ios::ate);
+        if(!file.is_open())
+        {
+            throw Exception(1, quantPath + " open filed!",__FILE__, __LINE__);
+        }
+        quant.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(quant.data(), static_cast<std::streamsize>(quant.size()));
+
+       ModelTensor tensor;
+        tensor.name         = "int8";
+        tensor.type         = TENSOR_INT8;
+        tensor.layout       = TENSOR_QUANT_STREAM;
+        tensor.alignment    = MSNH_MODEL_TENSOR_ALIGN;
+        tensor.shape        = {static_cast<int>(quant.size())};
+        tensor.data         = quant.data();
+        tensor.bytes        = quant.size();
+        tensors.push_back(tensor);
+    }
+
+   ModelFile::write(dstPath, graph, tensors);
+}
+
+void NetBuilder::setPreviewMode(const bool &mode)
+{
+    BaseLayer::setPreviewMode(mode);
+}
+
+void NetBuilder::setPrePackWeights(const bool &prePack)
+{
+    this->options.usePrePackedWeights = prePack;
+}
+
+void NetBuilder::setUseWinograd(const bool &winograd)
+{
+    this->options.useWinograd = winograd;
+}
+
+void NetBuilder::setUseImplicitGemm(const bool &implicitGemm)
+{
+    this->options.useImplicitGemm = implicitGemm;
+}
+
+void NetBuilder::setUseNCHWc(const bool &useNCHWc)
+{
+    this->options.useNCHWc = useNCHWc;
+}
+
+void NetBuilder::setUseMemoryPlanner(const bool &memoryPlanner)
+{
+    this->useMemoryPlanner = memoryPlanner;
+}
+
+void NetBuilder::setPlanCacheDir(const string &dir)
+{
+    this->planCacheDir = dir;
+}
+
+void NetBuilder::setUseMappedWeights(const bool &mappedWeights)
+{
+    this->useMappedWeights = mappedWeights;
+}
+
+void NetBuilder::setUseConcatViews(const bool &concatViews)
+{
+    this->useConcatViews = concatViews;
+}
+
+void NetBuilder::setUseBatchNormFolding(const bool &batchNormFolding)
+{
+    this->options.useBatchNormFolding = batchNormFolding;
+}
+
+void NetBuilder::setUseEpilogueFusion(const bool &epilogueFusion)
+{
+    this->options.useEpilogueFusion = epilogueFusion;
+}
+
+void NetBuilder::setUseResidualFusion(const bool &residualFusion)
+{
+    this->options.useResidualFusion = residualFusion;
+}
+
+void NetBuilder::setUseInt8(const bool &int8)
+{
+    this->options.useInt8 = int8;
+}
+
+void NetBuilder::setWeightStorage(const WeightStorage &storage)
+{
+    this->options.weightStorage = storage;
+}
+
+void NetBuilder::setThreadNum(const int &threadNum, const std::vector<int> &cpus)
+{
+    this->threadPool->setThreadNum(threadNum, cpus);
+}
+
+int NetBuilder::getThreadNum()
+{
+    return this->threadPool->getThreadNum();
+}
+
+std::vector<int> NetBuilder::getCpus()
+{
+    return this->threadPool->getCpus();
+}
+
+void NetBuilder::calibrate(const std::vector<std::vector<float>> &images, const QuantCalibration &method, const float &percentile)
+{
+    if(!net->options.useInt8)
+    {
+        throw Exception(1, "Call setUseInt8(true) before building the net to calibrate !",__FILE__, __LINE__);
+    }
+
+   if(!this->contexts.empty())
+    {
+        throw Exception(1, "Release the execution contexts before changing the weights !",__FILE__, __LINE__);
+    }
+
+   if(images.empty())
+    {
+        throw Exception(1, "No calibration images !",__FILE__, __LINE__);
+    }
+
+   /* pass 1 finds each layer's input range, pass 2 builds the histogram the percentile is taken from */
+    const int passes = (method == QUANT_PERCENTILE) ? 2 : 1;
+
+   for (int pass = 1; pass <= passes; ++pass)
+    {
+        netState->calibrationPass = pass;
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            runClassify(images[i]);
+        }
+    }
+    netState->calibrationPass = 0;
+
+   std::vector<BaseLayer*> quantLayers;
+    collectQuantLayers(net->layers, quantLayers);
+
+   for (size_t i = 0; i < quantLayers.size(); ++i)
+    {
+        if(quantLayers[i]->type == LayerType::CONVOLUTIONAL)
+        {
+            reinterpret_cast<ConvolutionalLayer*>(quantLayers[i])->quantizeInt8(method, percentile);
+        }
+        else
+        {
+            reinterpret_cast<ConnectedLayer*>(quantLayers[i])->quantizeInt8(method, percentile);
+        }
+    }
+}
+
+/* int8 weight file: "MSQ8", version, layer count, then per quantized layer
+ * type, M, K, input scale, input zero point, M weight scales, M*K int8 weights (row major).
+ * Biases (bn folded) still come from the float msnhbin. */
+void NetBuilder::saveQuantWeights(const string &path)
+{
+    std::vector<BaseLayer*> quantLayers;
+    collectQuantLayers(net->layers, quantLayers);
+
+   std::ofstream file(path, std::ios::out | std::ios::binary);
+    if(!file.is_open())
+    {
+        throw Exception(1, path + " open filed!",__FILE__, __LINE__);
+    }
+
+   const uint32_t head[3] = {0x3851534d, 1, static_cast<uint32_t>(quantLayers.size())};
+    file.write(reinterpret_cast<const char*>(head), sizeof(head));
+
+   for (size_t i = 0; i < quantLayers.size(); ++i)
+    {
+        int32_t type    = static_cast<int32_t>(quantLayers[i]->type);
+        int32_t m       = 0;
+        int32_t k       = 0;
+        float   scale   = 0;
+        int32_t zero    = 0;
+        float   *scales = nullptr;
+        std::vector<int8_t> q;
+
+       if(quantLayers[i]->type == LayerType::CONVOLUTIONAL)
+        {
+            ConvolutionalLayer *layer = reinterpret_cast<ConvolutionalLayer*>(quantLayers[i]);
+            if(layer->int8Weights == nullptr)
             {
-                delete reinterpret_cast<UpSampleLayer*>(net->layers[i]);
+                throw Exception(1, "Layer not quantized, calibrate first !",__FILE__, __LINE__);
             }
-            else if(net->layers[i]->type == LayerType::YOLOV3)
+            m       = layer->num;
+            k       = layer->nWeights / layer->num;
+            scale   = layer->inputScale;
+            zero    = layer->inputZeroPoint;
+            scales  = layer->int8Scales;
+            q.resize(static_cast<size_t>(m) * k);
+            layer->getInt8Weights(q.data());
+        }
+        else
+        {
+            ConnectedLayer *layer = reinterpret_cast<ConnectedLayer*>(quantLayers[i]);
+            if(layer->int8Weights == nullptr)
             {
-                delete reinterpret_cast<Yolov3Layer*>(net->layers[i]);
+                throw Exception(1, "Layer not quantized, calibrate first !",__FILE__, __LINE__);
             }
-            else if(net->layers[i]->type == LayerType::YOLOV3_OUT)
+            m       = layer->outputNum;
+            k       = layer->inputNum;
+            scale   = layer->inputScale;
+            zero    = layer->inputZeroPoint;
+            scales  = layer->int8Scales;
+            q.resize(static_cast<size_t>(m) * k);
+            layer->getInt8Weights(q.data());
+        }
+
+       file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+        file.write(reinterpret_cast<const char*>(&m), sizeof(m));
+        file.write(reinterpret_cast<const char*>(&k), sizeof(k));
+        file.write(reinterpret_cast<const char*>(&scale), sizeof(scale));
+        file.write(reinterpret_cast<const char*>(&zero), sizeof(zero));
+        file.write(reinterpret_cast<const char*>(scales), static_cast<std::streamsize>(sizeof(float) * static_cast<size_t>(m)));
+        file.write(reinterpret_cast<const char*>(q.data()), static_cast<std::streamsize>(q.size()));
+    }
+}
+
+void NetBuilder::loadQuantWeights(const string &path)
+{
+    if(!net->options.useInt8)
+    {
+        throw Exception(1, "Call setUseInt8(true) before building the net to load int8 weights !",__FILE__, __LINE__);
+    }
+
+   std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if(!file.is_open())
+    {
+        throw Exception(1, path + " open filed!",__FILE__, __LINE__);
+    }
+
+   std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+   loadQuantWeights(data.data(), data.size());
+}
+
+void NetBuilder::loadQuantWeights(const char * const &data, const size_t &size)
+{
+    if(!net->options.useInt8)
+    {
+        throw Exception(1, "Call setUseInt8(true) before building the net to load int8 weights !",__FILE__, __LINE__);
+    }
+
+   if(!this->contexts.empty())
+    {
+        throw Exception(1, "Release the execution contexts before changing the weights !",__FILE__, __LINE__);
+    }
+
+   std::vector<BaseLayer*> quantLayers;
+    collectQuantLayers(net->layers, quantLayers);
+
+   size_t pos = 0;
+    auto read = [&](void *dst, const size_t &bytes)
+    {
+        if(size - pos < bytes)
+        {
+            throw Exception(1, "Load int8 weights err, file too short",__FILE__, __LINE__);
+        }
+        memcpy(dst, data + pos, bytes);
+        pos += bytes;
+    };
+
+   uint32_t head[3] = {0, 0, 0};
+    if(size < sizeof(head))
+    {
+        throw Exception(1, "Not an int8 weight file of this net!",__FILE__, __LINE__);
+    }
+    read(head, sizeof(head));
+    if(head[0] != 0x3851534d || head[1] != 1 || head[2] != quantLayers.size())
+    {
+        throw Exception(1, "Not an int8 weight file of this net!",__FILE__, __LINE__);
+    }
+
+   for (size_t i = 0; i < quantLayers.size(); ++i)
+    {
+        int32_t type    = 0;
+        int32_t m       = 0;
+        int32_t k       = 0;
+        float   scale   = 0;
+        int32_t zero    = 0;
+
+       read(&type, sizeof(type));
+        read(&m, sizeof(m));
+        read(&k, sizeof(k));
+        read(&scale, sizeof(scale));
+        read(&zero, sizeof(zero));
+
+       const bool conv = quantLayers[i]->type == LayerType::CONVOLUTIONAL;
+        const int  needM = conv ? reinterpret_cast<ConvolutionalLayer*>(quantLayers[i])->num : quantLayers[i]->outputNum;
+        const int  needK = conv ? reinterpret_cast<ConvolutionalLayer*>(quantLayers[i])->nWeights / needM : quantLayers[i]->inputNum;
+
+       if(type != static_cast<int32_t>(quantLayers[i]->type) || m != needM || k != needK)
+        {
+            throw Exception(1, "Load int8 weights err, layer " + std::to_string(i) + " does not match",__FILE__, __LINE__);
+        }
+
+       std::vector<float>  scales(static_cast<size_t>(m));
+        std::vector<int8_t> q(static_cast<size_t>(m) * k);
+        read(scales.data(), sizeof(float) * scales.size());
+        read(q.data(), q.size());
+
+       if(conv)
+        {
+            reinterpret_cast<ConvolutionalLayer*>(quantLayers[i])->setInt8Weights(q.data(), scales.data(), scale, zero);
+        }
+        else
+        {
+            reinterpret_cast<ConnectedLayer*>(quantLayers[i])->setInt8Weights(q.data(), scales.data(), scale, zero);
+        }
+    }
+}
+
+std::vector<float> NetBuilder::runClassify(std::vector<float> img)
+{
+    return ExecutionContext::runClassify(this->net, this->netState, std::move(img));
+}
+
+std::vector<std::vector<Yolov3Box>> NetBuilder::runYolov3(std::vector<float> img)
+{
+    return ExecutionContext::runYolov3(this->net, this->netState, std::move(img));
+}
+
+ExecutionContext *NetBuilder::createContext(const int &batch)
+{
+    if(BaseLayer::isPreviewMode)
+    {
+        throw Exception(1, "Can not create execution contexts in preview mode !",__FILE__, __LINE__);
+    }
+
+   if(net->layers.empty())
+    {
+        throw Exception(1, "Build the net and load its weights before creating execution contexts !",__FILE__, __LINE__);
+    }
+
+   ExecutionContext *context = new ExecutionContext();
+    context->net->threadPool  = this->threadPool;
+    try
+    {
+        buildNetFromParams(context->net, context->netState, net->options, batch);
+
+       /* like a plan load: the same layers and layouts, then the same kernels per weight layer (arena offsets follow the batch) */
+        bool shared = (net->layers.size() == context->net->layers.size());
+        for (size_t i = 0; i < net->layers.size() && shared; ++i)
+        {
+            shared = (net->layers[i]->type == context->net->layers[i]->type && net->layers[i]->nchwc == context->net->layers[i]->nchwc);
+        }
+
+       std::vector<BaseLayer*> layers;
+        std::vector<BaseLayer*> contextLayers;
+        collectWeightLayers(net->layers, layers, true);
+        collectWeightLayers(context->net->layers, contextLayers, true);
+        shared = shared && (layers.size() == contextLayers.size());
+
+       /* large arrays are taken in place like a mapped plan, so the context only owns its activations and small arrays */
+        std::vector<ModelTensor> tensors;
+        std::vector<int32_t> state;
+        for (size_t i = 0; i < layers.size() && shared; ++i)
+        {
+            tensors.clear();
+            if(layers[i]->type == LayerType::CONVOLUTIONAL)
             {
-                delete reinterpret_cast<Yolov3OutLayer*>(net->layers[i]);
+                reinterpret_cast<ConvolutionalLayer*>(layers[i])->getPlanTensors(tensors, state);
+                shared = reinterpret_cast<ConvolutionalLayer*>(contextLayers[i])->loadPlanTensors(tensors, true);
             }
-            else if(net->layers[i]->type == LayerType::PADDING)
+            else if(layers[i]->type == LayerType::CONNECTED)
             {
-                delete reinterpret_cast<PaddingLayer*>(net->layers[i]);
+                reinterpret_cast<ConnectedLayer*>(layers[i])->getPlanTensors(tensors, state);
+                shared = reinterpret_cast<ConnectedLayer*>(contextLayers[i])->loadPlanTensors(tensors, true);
+            }
+            else
+            {
+                reinterpret_cast<BatchNormLayer*>(layers[i])->getPlanTensors(tensors);
+                shared = reinterpret_cast<BatchNormLayer*>(contextLayers[i])->loadPlanTensors(tensors);
             }
-
-           net->layers[i] = nullptr;
         }
 
-       if(i == (net->layers.size()-1))
+       if(!shared)
         {
-            net->layers.clear();
+            throw Exception(1, "Execution context does not match the net !",__FILE__, __LINE__);
         }
     }
+    catch(Exception &)
+    {
+        delete context;
+        throw;
+    }
+
+   this->contexts.push_back(context);
+    return context;
 }
 
-float NetBuilder::getInferenceTime()
+void NetBuilder::releaseContext(ExecutionContext *const &context)
 {
-    float inferTime     =   0.f;
-    for (size_t i = 0; i < this->net->layers.size(); ++i)
+    std::vector<ExecutionContext*>::iterator it = std::find(this->contexts.begin(), this->contexts.end(), context);
+    if(it != this->contexts.end())
     {
-        inferTime       +=  this->net->layers[i]->forwardTime;
+        delete *it;
+        this->contexts.erase(it);
     }
+}
 
-   return inferTime;
+void NetBuilder::clearLayers()
+{
+    for (size_t i = 0; i < this->contexts.size(); ++i)
+    {
+        delete this->contexts[i];
+    }
+    this->contexts.clear();
+
+    ExecutionContext::clearLayers(this->net);
+}
+
+float NetBuilder::getInferenceTime()
+{
+    return ExecutionContext::getInferenceTime(this->net);
 }
 
 string NetBuilder::getLayerDetail()
@@ -454,4 +1666,67 @@ string NetBuilder::getTimeDetail()
     return detail;
 }
 
+string NetBuilder::getMemoryDetail()
+{
+    const float naive   = this->net->naiveOutputSize * sizeof(float) / 1048576.f;
+    const float planned = this->net->plannedOutputSize * sizeof(float) / 1048576.f;
+
+   std::string detail;
+    detail     = detail + "layer outputs (naive)   : " + std::to_string(naive) + " MB\n";
+    detail     = detail + "layer outputs (planned) : " + std::to_string(planned) + " MB" + (this->useMemoryPlanner ? "" : " (planner off)");
+
+   /* conv / fc weight matrices as float32 vs what the layers hold (fp16 / bf16 = 2 bytes, int8 = 1 byte) */
+    std::vector<BaseLayer*> weightLayers;
+    collectWeightLayers(this->net->layers, weightLayers);
+
+   size_t f32Bytes      = 0;
+    size_t residentBytes = 0;
+    size_t mappedBytes   = 0;
+    for (size_t i = 0; i < weightLayers.size(); ++i)
+    {
+        size_t n        = 0;
+        size_t elemSize = sizeof(float);
+        int    mapped   = 0;
+        if(weightLayers[i]->type == LayerType::CONVOLUTIONAL)
+        {
+            ConvolutionalLayer *layer = reinterpret_cast<ConvolutionalLayer*>(weightLayers[i]);
+            if(layer->shareLayer != nullptr)
+            {
+                continue;
+            }
+            n           = static_cast<size_t>(layer->nWeights);
+            elemSize    = (layer->halfWeights != nullptr) ? sizeof(uint16_t) : ((layer->int8Weights != nullptr) ? sizeof(int8_t) : sizeof(float));
+            mapped      = layer->mappedWeights || layer->mappedPacked;
+        }
+        else
+        {
+            ConnectedLayer *layer = reinterpret_cast<ConnectedLayer*>(weightLayers[i]);
+            n           = static_cast<size_t>(layer->nWeights);
+            elemSize    = (layer->halfWeights != nullptr) ? sizeof(uint16_t) : ((layer->int8Weights != nullptr) ? sizeof(int8_t) : sizeof(float));
+            mapped      = layer->mappedWeights || layer->mappedPacked;
+        }
+        f32Bytes        += n * sizeof(float);
+        if(mapped)
+        {
+            mappedBytes     += n * elemSize;
+        }
+        else
+        {
+            residentBytes   += n * elemSize;
+        }
+    }
+
+   detail     = detail + "\nweights (float32)       : " + std::to_string(f32Bytes / 1048576.f) + " MB\n";
+    detail     = detail + "weights (resident)      : " + std::to_string(residentBytes / 1048576.f) + " MB, saved " +
+                 std::to_string((f32Bytes - residentBytes - mappedBytes) / 1048576.f) + " MB\n";
+    detail     = detail + "weights (mapped)        : " + std::to_string(mappedBytes / 1048576.f) + " MB, shared page cache";
+
+   if(!this->contexts.empty())
+    {
+        detail = detail + "\nexecution contexts      : " + std::to_string(this->contexts.size()) + " x " + std::to_string(planned) +
+                 " MB outputs, weights shared";
+    }
+    return detail;
+}
+
 }
@@ -4,5 +4,7 @@ namespace Msnhnet
 NetworkState::~NetworkState()
 {
     releaseArr(workspace);
+    releaseArr(layoutBuffer);
+    releaseArr(memoryArena);
 }
 }
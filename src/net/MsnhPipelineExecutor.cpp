@@ -0,0 +1,459 @@
+﻿#include "Msnhnet/net/MsnhPipelineExecutor.h"
+#include "Msnhnet/utils/MsnhExString.h"
+#include <cmath>
+namespace Msnhnet
+{
+PipelineExecutor::PipelineExecutor(NetBuilder *const &builder, const int &stageNum, const int &threadsPerStage, const int &maxInFlight)
+{
+    const size_t layerNum = builder->net->layers.size();
+    if(stageNum < 1 || threadsPerStage < 0 || maxInFlight < 0)
+    {
+        throw Exception(1, "Pipeline needs stageNum > 0, threadsPerStage >= 0 and maxInFlight >= 0 !",__FILE__, __LINE__);
+    }
+
+    if(layerNum == 0)
+    {
+        throw Exception(1, "Build the net and load its weights before starting a pipeline !",__FILE__, __LINE__);
+    }
+
+    std::vector<int> cpus   =   builder->getCpus();
+    for (int c = 0; cpus.empty() && c < std::max(1, static_cast<int>(std::thread::hardware_concurrency())); ++c)
+    {
+        cpus.push_back(c);
+    }
+    const int cores         =   static_cast<int>(cpus.size());
+
+    this->builder           =   builder;
+    this->stageNum          =   std::min(stageNum, static_cast<int>(layerNum));
+    this->threadsPerStage   =   (threadsPerStage > 0) ? threadsPerStage : std::max(1, cores / this->stageNum);
+    this->inputNum          =   builder->net->layers[0]->inputNum;
+    this->maxInFlight       =   maxInFlight;
+    this->yolo              =   builder->net->layers.back()->type == LayerType::YOLOV3_OUT;
+
+    /* cut where the bFlops prefix is closest to s/stageNum of the total, every stage keeps at least one layer */
+    std::vector<float> prefix(layerNum + 1, 0.f);
+    for (size_t i = 0; i < layerNum; ++i)
+    {
+        prefix[i + 1]   =   prefix[i] + builder->net->layers[i]->bFlops;
+    }
+
+    this->stageBegin.push_back(0);
+    for (int s = 1; s < this->stageNum; ++s)
+    {
+        const float target  =   prefix[layerNum] * s / this->stageNum;
+        const size_t first  =   this->stageBegin.back() + 1;
+        const size_t last   =   layerNum - static_cast<size_t>(this->stageNum - s);
+
+        size_t cut = first;
+        for (size_t i = first; i <= last; ++i)
+        {
+            if(std::abs(prefix[i] - target) < std::abs(prefix[cut] - target))
+            {
+                cut = i;
+            }
+        }
+        this->stageBegin.push_back(cut);
+    }
+    this->stageBegin.push_back(layerNum);
+
+    for (int s = 0; s < this->stageNum; ++s)
+    {
+        this->stageFlops.push_back(prefix[this->stageBegin[s + 1]] - prefix[this->stageBegin[s]]);
+    }
+
+    /* stage s takes the s-th group of threadsPerStage cpus, unpinned if there are not enough */
+    this->stageCpus.resize(static_cast<size_t>(this->stageNum));
+    for (int s = 0; s < this->stageNum && this->stageNum * this->threadsPerStage <= cores; ++s)
+    {
+        this->stageCpus[static_cast<size_t>(s)].assign(cpus.begin() + s * this->threadsPerStage, cpus.begin() + (s + 1) * this->threadsPerStage);
+    }
+
+    try
+    {
+        /* a frame is one image, whatever batch the net file was built with */
+        for (int i = 0; i < this->stageNum + 1; ++i)
+        {
+            this->contexts.push_back(builder->createContext(1));
+            this->freeContexts.push_back(this->contexts.back());
+        }
+    }
+    catch(Exception &)
+    {
+        for (size_t i = 0; i < this->contexts.size(); ++i)
+        {
+            builder->releaseContext(this->contexts[i]);
+        }
+        throw;
+    }
+
+    this->queues.resize(static_cast<size_t>(this->stageNum));
+    this->stageDone.resize(static_cast<size_t>(this->stageNum), 0);
+    this->stageBusy.resize(static_cast<size_t>(this->stageNum), 0);
+
+    for (int s = 0; s < this->stageNum; ++s)
+    {
+        this->stages.emplace_back(&PipelineExecutor::runStage, this, s);
+    }
+    this->preprocessor = std::thread(&PipelineExecutor::runPreprocess, this);
+}
+
+PipelineExecutor::~PipelineExecutor()
+{
+    stop();
+
+    for (size_t i = 0; i < this->contexts.size(); ++i)
+    {
+        this->builder->releaseContext(this->contexts[i]);
+    }
+    this->contexts.clear();
+}
+
+std::future<std::vector<float>> PipelineExecutor::submitClassify(std::vector<float> img)
+{
+    if(this->yolo)
+    {
+        throw Exception(1, "Not a classify net, use submitYolov3 !",__FILE__, __LINE__);
+    }
+
+    Frame *frame    =   new Frame();
+    frame->img      =   std::move(img);
+    std::future<std::vector<float>> result = frame->classify.get_future();
+    submit(frame);
+    return result;
+}
+
+std::future<std::vector<Yolov3Box>> PipelineExecutor::submitYolov3(std::vector<float> img)
+{
+    if(!this->yolo)
+    {
+        throw Exception(1, "Not a yolov3 net, use submitClassify !",__FILE__, __LINE__);
+    }
+
+    Frame *frame    =   new Frame();
+    frame->img      =   std::move(img);
+    std::future<std::vector<Yolov3Box>> result = frame->boxes.get_future();
+    submit(frame);
+    return result;
+}
+
+std::future<std::vector<float>> PipelineExecutor::submitClassify(std::function<std::vector<float>()> preprocess)
+{
+    if(this->yolo)
+    {
+        throw Exception(1, "Not a classify net, use submitYolov3 !",__FILE__, __LINE__);
+    }
+
+    Frame *frame        =   new Frame();
+    frame->preprocess   =   std::move(preprocess);
+    std::future<std::vector<float>> result = frame->classify.get_future();
+    submit(frame);
+    return result;
+}
+
+std::future<std::vector<Yolov3Box>> PipelineExecutor::submitYolov3(std::function<std::vector<float>()> preprocess)
+{
+    if(!this->yolo)
+    {
+        throw Exception(1, "Not a yolov3 net, use submitClassify !",__FILE__, __LINE__);
+    }
+
+    Frame *frame        =   new Frame();
+    frame->preprocess   =   std::move(preprocess);
+    std::future<std::vector<Yolov3Box>> result = frame->boxes.get_future();
+    submit(frame);
+    return result;
+}
+
+void PipelineExecutor::submit(Frame *const &frame)
+{
+    /* a preprocessed image is checked on the preprocessing thread, its error goes to the future */
+    if(!frame->preprocess && frame->img.size() != static_cast<size_t>(this->inputNum))
+    {
+        const size_t given = frame->img.size();
+        delete frame;
+        throw Exception(1,"input image size err. Needed :" + std::to_string(this->inputNum) + "given :" +
+                        std::to_string(given),__FILE__,__LINE__);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->wake.wait(lock, [this]
+        {
+            return this->stopped || this->maxInFlight == 0 || this->inFlight < static_cast<size_t>(this->maxInFlight);
+        });
+
+        if(this->stopped)
+        {
+            delete frame;
+            throw Exception(1, "Pipeline is stopped !",__FILE__, __LINE__);
+        }
+
+        if(this->submitCount == 0)
+        {
+            this->firstSubmit = std::chrono::steady_clock::now();
+        }
+        this->submitCount++;
+        this->inFlight++;
+        this->pending.push_back(frame);
+    }
+
+    this->wake.notify_all();
+}
+
+void PipelineExecutor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopped = true;
+    }
+    this->wake.notify_all();
+
+    if(this->preprocessor.joinable())
+    {
+        this->preprocessor.join();
+    }
+
+    for (size_t s = 0; s < this->stages.size(); ++s)
+    {
+        if(this->stages[s].joinable())
+        {
+            this->stages[s].join();
+        }
+    }
+    this->stages.clear();
+}
+
+float PipelineExecutor::getThroughput()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    const double seconds = std::chrono::duration<double>(this->lastFinish - this->firstSubmit).count();
+    return (this->frameCount > 0 && seconds > 0) ? static_cast<float>(this->frameCount / seconds) : 0.f;
+}
+
+std::vector<float> PipelineExecutor::getStageUtilization()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    const double seconds = std::chrono::duration<double>(this->lastFinish - this->firstSubmit).count();
+
+    std::vector<float> utilization(this->stageBusy.size(), 0.f);
+    for (size_t s = 0; s < this->stageBusy.size() && this->frameCount > 0 && seconds > 0; ++s)
+    {
+        utilization[s] = static_cast<float>(this->stageBusy[s] / seconds);
+    }
+    return utilization;
+}
+
+std::string PipelineExecutor::getStageDetail()
+{
+    const float fps                         =   getThroughput();
+    const std::vector<float> utilization    =   getStageUtilization();
+
+    std::string detail;
+    detail     = detail + "STAGE  LAYERS         GFLOPS      BUSY\n"
+            + "=========================================\n";
+    for (int s = 0; s < this->stageNum; ++s)
+    {
+        const std::string pad = "               ";
+        detail = detail + ExString::left(std::to_string(s) + pad, 7);
+        detail = detail + ExString::left(std::to_string(this->stageBegin[s]) + " - " + std::to_string(this->stageBegin[s + 1] - 1) + pad, 15);
+        detail = detail + ExString::left(std::to_string(this->stageFlops[s]), 8) + "    ";
+        detail = detail + ExString::left(std::to_string(utilization[s] * 100), 4) + "%\n";
+    }
+    detail     = detail + "=========================================\n";
+    detail     = detail + "frames : " + std::to_string(this->frameCount) + ", " + std::to_string(fps) + " fps, " +
+                 std::to_string(this->stageNum) + " stages x " + std::to_string(this->threadsPerStage) + " threads";
+    return detail;
+}
+
+void PipelineExecutor::runPreprocess()
+{
+    while (true)
+    {
+        Frame *frame = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this]{ return this->stopped || !this->pending.empty(); });
+
+            if(this->pending.empty())
+            {
+                this->preDone = true;
+                this->wake.notify_all();
+                return;
+            }
+
+            frame = this->pending.front();
+            this->pending.pop_front();
+        }
+
+        /* frames given as an image pass straight on, so the stages see all frames in submit order */
+        if(frame->preprocess)
+        {
+            try
+            {
+                frame->img = frame->preprocess();
+                if(frame->img.size() != static_cast<size_t>(this->inputNum))
+                {
+                    throw Exception(1,"input image size err. Needed :" + std::to_string(this->inputNum) + "given :" +
+                                    std::to_string(frame->img.size()),__FILE__,__LINE__);
+                }
+            }
+            catch(...)
+            {
+                frame->error = std::current_exception();
+            }
+            frame->preprocess = nullptr;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->queues[0].push_back(frame);
+        }
+        this->wake.notify_all();
+    }
+}
+
+void PipelineExecutor::runStage(const int &stage)
+{
+    /* each stage with its own pool on its own core group, the scope binds the stage thread and its omp threads too.
+     * A core the process may not use leaves the stage unpinned */
+    ThreadPool pool(1);
+    try
+    {
+        pool.setThreadNum(this->threadsPerStage, this->stageCpus[static_cast<size_t>(stage)]);
+    }
+    catch(Exception &)
+    {
+        pool.setThreadNum(this->threadsPerStage);
+    }
+    ThreadPoolScope scope(&pool);
+
+    const size_t s      =   static_cast<size_t>(stage);
+    const bool   last   =   (stage == this->stageNum - 1);
+
+    while (true)
+    {
+        Frame *frame = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            /* the first stage also needs a free context, a stage ends once it is stopped, drained and its feeder ended */
+            this->wake.wait(lock, [this, s]
+            {
+                if(!this->queues[s].empty())
+                {
+                    return s > 0 || !this->freeContexts.empty();
+                }
+                return this->stopped && (s == 0 ? this->preDone : this->stageDone[s - 1] != 0);
+            });
+
+            if(this->queues[s].empty())
+            {
+                this->stageDone[s] = 1;
+                this->wake.notify_all();
+                return;
+            }
+
+            frame = this->queues[s].front();
+            this->queues[s].pop_front();
+
+            if(s == 0)
+            {
+                frame->context = this->freeContexts.front();
+                this->freeContexts.pop_front();
+            }
+        }
+
+        const std::chrono::steady_clock::time_point st = std::chrono::steady_clock::now();
+
+        if(!frame->error)
+        {
+            try
+            {
+                NetworkState *netState  =   frame->context->netState;
+                if(s == 0)
+                {
+                    netState->input     =   frame->img.data();
+                    netState->inputNum  =   this->inputNum;
+                    frame->blocked      =   0;
+                }
+
+                ExecutionContext::forwardLayers(frame->context->net, netState, this->stageBegin[s], this->stageBegin[s + 1], frame->blocked);
+
+                if(last)
+                {
+                    collect(frame);
+                }
+            }
+            catch(...)
+            {
+                frame->error = std::current_exception();
+            }
+        }
+
+        const double busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stageBusy[s] += busy;
+
+            if(last)
+            {
+                this->freeContexts.push_back(frame->context);
+                this->frameCount++;
+                this->inFlight--;
+                this->lastFinish = std::chrono::steady_clock::now();
+            }
+            else
+            {
+                this->queues[s + 1].push_back(frame);
+            }
+        }
+        this->wake.notify_all();
+
+        /* after the count, a caller that waited for its last frame sees it in the stats */
+        if(last)
+        {
+            deliver(frame);
+            delete frame;
+        }
+    }
+}
+
+void PipelineExecutor::collect(Frame *const &frame)
+{
+    Network *net = frame->context->net;
+
+    if(this->yolo)
+    {
+        std::vector<std::vector<Yolov3Box>> &finalOut = reinterpret_cast<Yolov3OutLayer*>(net->layers.back())->finalOut;
+        if(!finalOut.empty())
+        {
+            frame->result = finalOut[0];
+        }
+    }
+    else
+    {
+        frame->output = ExecutionContext::getOutput(net, frame->context->netState, frame->blocked);
+    }
+}
+
+void PipelineExecutor::deliver(Frame *const &frame)
+{
+    if(frame->error && this->yolo)
+    {
+        frame->boxes.set_exception(frame->error);
+    }
+    else if(frame->error)
+    {
+        frame->classify.set_exception(frame->error);
+    }
+    else if(this->yolo)
+    {
+        frame->boxes.set_value(std::move(frame->result));
+    }
+    else
+    {
+        frame->classify.set_value(std::move(frame->output));
+    }
+}
+}
@@ -66,16 +66,16 @@ std::vector<float> OpencvUtil::getImgDataF32C1(cv::Mat &mat, const cv::Size &siz
    int width = mat.cols;
     int height = mat.rows;
 
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int y = 0; y < height; ++y)
+    ThreadPool::parallelFor(0, height, ThreadPool::grainFor(width), [&](const int &yBegin, const int &yEnd)
     {
-        for (int x = 0; x < width; ++x)
+        for (int y = yBegin; y < yEnd; ++y)
         {
-            imgs[static_cast<size_t>(y*width + x)] = mat.data[y*width + x ] / 256.0f;
+            for (int x = 0; x < width; ++x)
+            {
+                imgs[static_cast<size_t>(y*width + x)] = mat.data[y*width + x ] / 256.0f;
+            }
         }
-    }
+    });
     mat.release();
     return imgs;
 }
@@ -103,20 +103,20 @@ std::vector<float> OpencvUtil::getImgDataF32C3(cv::Mat &mat, const cv::Size &siz
 
    int step    = static_cast<int>(mat.step);
 
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int y = 0; y < height; ++y)
+    ThreadPool::parallelFor(0, height, ThreadPool::grainFor(width*channel), [&](const int &yBegin, const int &yEnd)
     {
-        for (int k = 0; k < channel; ++k)
+        for (int y = yBegin; y < yEnd; ++y)
         {
-            for (int x = 0; x < width; ++x)
+            for (int k = 0; k < channel; ++k)
             {
-                imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f;
+                for (int x = 0; x < width; ++x)
+                {
+                    imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f;
 
-           }
+               }
+            }
         }
-    }
+    });
 
    mat.release();
     return imgs;
@@ -145,30 +145,30 @@ std::vector<float> OpencvUtil::getGoogLenetF32C3(cv::Mat &mat, const cv::Size &s
 
    int step    = static_cast<int>(mat.step);
 
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int y = 0; y < height; ++y)
+    ThreadPool::parallelFor(0, height, ThreadPool::grainFor(width*channel), [&](const int &yBegin, const int &yEnd)
     {
-        for (int k = 0; k < channel; ++k)
+        for (int y = yBegin; y < yEnd; ++y)
         {
-            for (int x = 0; x < width; ++x)
+            for (int k = 0; k < channel; ++k)
             {
-                if(k == 0)
+                for (int x = 0; x < width; ++x)
                 {
-                    imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f * (0.229f / 0.5f) + (0.485f - 0.5f) / 0.5f;
-                }
-                else if(k == 1)
-                {
-                    imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f * (0.224f / 0.5f) + (0.456f - 0.5f) / 0.5f;
-                }
-                else if(k == 2)
-                {
-                    imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f * (0.225f / 0.5f) + (0.406f - 0.5f) / 0.5f;
+                    if(k == 0)
+                    {
+                        imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f * (0.229f / 0.5f) + (0.485f - 0.5f) / 0.5f;
+                    }
+                    else if(k == 1)
+                    {
+                        imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f * (0.224f / 0.5f) + (0.456f - 0.5f) / 0.5f;
+                    }
+                    else if(k == 2)
+                    {
+                        imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f * (0.225f / 0.5f) + (0.406f - 0.5f) / 0.5f;
+                    }
                 }
             }
         }
-    }
+    });
 
    mat.release();
     return imgs;
@@ -213,20 +213,20 @@ std::vector<float> OpencvUtil::getPaddingZeroF32C3(cv::Mat &mat, const cv::Size
 
    int step    = static_cast<int>(mat.step);
 
-#ifdef USE_OMP
-#pragma omp parallel for num_threads(OMP_THREAD)
-#endif
-    for (int y = 0; y < height; ++y)
+    ThreadPool::parallelFor(0, height, ThreadPool::grainFor(width*channel), [&](const int &yBegin, const int &yEnd)
     {
-        for (int k = 0; k < channel; ++k)
+        for (int y = yBegin; y < yEnd; ++y)
         {
-            for (int x = 0; x < width; ++x)
+            for (int k = 0; k < channel; ++k)
             {
-                imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f;
+                for (int x = 0; x < width; ++x)
+                {
+                    imgs[static_cast<size_t>(k*width*height + y*width + x)] = mat.data[y*step + x*channel + k] / 255.0f;
 
-           }
+               }
+            }
         }
-    }
+    });
 
    mat.release();
     return imgs;